@@ -7,6 +7,8 @@
 #include <vector>
 #include <iostream>
 
+#include "solverprobe.hpp"
+
 using namespace QuantLib;
 
 namespace {
@@ -52,7 +54,8 @@ namespace {
     Real min = .0025, max = .15;
 
     //invoke bisection solver with IRRSolver functor
-    Real irr = bisection.solve(IRRSolver(fixedRateBond.cashflows(), npv), accuracy, guess, min, max);
+    qltutor::SolveProbe probe("Bisection", "06irr/yieldToMaturity");
+    Real irr = probe.finish(bisection.solve(probe.counted(IRRSolver(fixedRateBond.cashflows(), npv)), accuracy, guess, min, max));
     std::cout << "Bond yield to maturity (IRR) is: " << irr << std::endl;
 
     /*
@@ -1,12 +1,30 @@
 #include "er.hpp"
-#include <ql/QuantLib.hpp>
+#include <ql/quantlib.hpp>
+#include <numeric>
+
+#include "solverprobe.hpp"
 
 using namespace QuantLib;
 
+namespace {
+
+// closed form unconstrained minimum variance weights, inverse(cov) l / (l' inverse(cov) l),
+// with inverse(cov) l from whatever factorization `cov` keeps: anything with solve(b, x)
+template <class Factorization>
+Matrix minimumVarianceWeights(Size n, const Factorization& cov) {
+  Matrix weights(n,1,1);
+  cov.solve(weights.begin(), weights.begin());
+  weights /= std::accumulate(weights.begin(), weights.end(), 0.0);
+  return weights;
+}
+
+}
+
 Matrix WeightsMV(bool isConstrained, Size n, const Matrix& cov) {
   Matrix weights(n,1);
 
   if (isConstrained) {
+    qltutor::AllocationScope scope("09lopt/WeightsMV (Simplex)");
     MeanVarianceFunction mvFunc(cov);
 
     Size maxIterations=10000; //end search after 1000 iterations if no solution
@@ -24,17 +42,18 @@ Matrix WeightsMV(bool isConstrained, Size n, const Matrix& cov) {
 
     CompositeConstraint allConstraints(longOnly, fullyInvested);
 
-    Problem myProb(mvFunc, allConstraints, Array(n-1, 1./n));
+    qltutor::SolveProbe probe("Simplex", "09lopt/WeightsMV", mvFunc, allConstraints);
+    Problem myProb(probe.costFunction(), probe.constraint(), Array(n-1, 1./n));
 
     Simplex solver(.05);
 
-    EndCriteria::Type solution=solver.minimize(myProb, myEndCrit);
+    EndCriteria::Type solution=probe.finish(solver.minimize(myProb, myEndCrit), myProb);
 
     switch (solution) {
       case EndCriteria::None:
       case EndCriteria::MaxIterations:
       case EndCriteria::Unknown:
-        throw("#err: optimization didn't converge - no solution found");
+        QL_FAIL("WeightsMV: optimization didn't converge (" << solution << ")");
       default: ;
     }
 
@@ -47,15 +66,21 @@ Matrix WeightsMV(bool isConstrained, Size n, const Matrix& cov) {
 
     weights[n-1][0] = 1- sumWeights;
   } else {
-    //closed form solution exists for unconstrained
-    Matrix covInv = inverse(cov);
-    Matrix l(n,1,1);
-    weights = (covInv * l) / ( transpose(l) * covInv * l )[0][0];
+    //closed form solution exists for unconstrained, from the Cholesky factor
+    weights = minimumVarianceWeights(n, qltutor::CholeskyFactorization(n, cov.begin(), cov.columns()));
   }
 
   return weights;
 }
 
+Matrix WeightsMV(const qltutor::IncrementalCovariance& cov) {
+  return minimumVarianceWeights(cov.size(), cov);
+}
+
+Matrix WeightsMV(const qltutor::CovarianceModel& cov) {
+  return minimumVarianceWeights(cov.size(), cov);
+}
+
 bool ValidateIdenticalCorrelation(const Matrix& correlation) {
   return false;
 }
@@ -70,6 +95,7 @@ Matrix WeightsERC(Size n, Matrix& cov, const Matrix& correlation) {
   if (ValidateIdenticalCorrelation(correlation)) {
     weights = WeightsInvVol(n);
   } else {
+    qltutor::AllocationScope scope("09lopt/WeightsERC (LevenbergMarquardt)");
     EqualRiskContributionFunction ercFunc(cov);
 
     Size maxIterations=10000; //end search after 1000 iterations if no solution
@@ -88,16 +114,17 @@ Matrix WeightsERC(Size n, Matrix& cov, const Matrix& correlation) {
     CompositeConstraint allConstraints(longOnly, fullyInvested);
 
     //would be better to start with variance weighted array but easier to debug and less inputs
-    Problem myProb(ercFunc, allConstraints, Array(n, 2./n));
+    qltutor::SolveProbe probe("LevenbergMarquardt", "09lopt/WeightsERC", ercFunc, allConstraints);
+    Problem myProb(probe.costFunction(), probe.constraint(), Array(n, 2./n));
 
     LevenbergMarquardt solver;
-    EndCriteria::Type solution=solver.minimize(myProb, myEndCrit);
+    EndCriteria::Type solution=probe.finish(solver.minimize(myProb, myEndCrit), myProb);
 
     switch (solution) {
       case EndCriteria::None:
       case EndCriteria::MaxIterations:
       case EndCriteria::Unknown:
-        throw("#err: optimization didn't converge - no solution found");
+        QL_FAIL("WeightsERC: optimization didn't converge (" << solution << ")");
       default:;
     }
 
@@ -1,81 +1,143 @@
 #include <ql/quantlib.hpp>
 #include <vector>
 
+#include "allocations.hpp"
+#include "portfoliokernels.hpp"
+#include "covupdate.hpp"
+#include "covariancemodel.hpp"
+
 namespace {
   const QuantLib::Real rootEpisilon = 1e-8;
 }
 
 // http://www.thierry-roncalli.com/download/erc.pdf%E2%80%8E
 
+// Both cost functions take a dense covariance matrix or any qltutor::CovarianceModel;
+// with a FactorCovariance every value and gradient is O(nk) instead of O(n^2).
+//
+// Each keeps mutable workspace arrays so the gradient does not allocate: one function
+// object serves one solver at a time, and is not safe to share across threads. Give
+// every thread its own copy.
+
 // mean variance objective function
 class MeanVarianceFunction: public QuantLib::CostFunction {
   private:
-    QuantLib::Matrix covariance_;
+    boost::shared_ptr<const qltutor::CovarianceModel> covariance_;
     QuantLib::Size n;
+    mutable QuantLib::Array weights_, product_;   // workspace: one thread per function object
 
   public:
     MeanVarianceFunction(const QuantLib::Matrix& covariance)
-      : covariance_(covariance) {
+      : covariance_(new qltutor::DenseCovariance(covariance.rows(), covariance.begin(), covariance.columns()))
+      , weights_(covariance.rows()), product_(covariance.rows()) {
       n = covariance.rows();
     }
 
+    MeanVarianceFunction(const boost::shared_ptr<const qltutor::CovarianceModel>& covariance)
+      : covariance_(covariance), weights_(covariance->size()), product_(covariance->size()) {
+      n = covariance->size();
+    }
+
     QuantLib::Real value(const QuantLib::Array& x) const {
+      qltutor::AllocationScope scope("09lopt/MeanVarianceFunction::value");
+      setWeights(x);
+      return covariance_->variance(weights_.begin());
+    }
+
+    QuantLib::Disposable<QuantLib::Array> values(const QuantLib::Array& x) const {
+      QuantLib::Array var(1,value(x));
+      return var;
+    }
+
+    // the n-th weight is 1 - sum(x), so d/dx_i w'Sw = 2 ((Sw)_i - (Sw)_n)
+    void gradient(QuantLib::Array& grad, const QuantLib::Array& x) const {
+      setWeights(x);
+      covariance_->multiply(weights_.begin(), product_.begin());
+      grad.resize(n-1);
+      for (QuantLib::Size i = 0; i < n-1; ++i) {
+        grad[i] = 2 * (product_[i] - product_[n-1]);
+      }
+    }
+
+    QuantLib::Real valueAndGradient(QuantLib::Array& grad, const QuantLib::Array& x) const {
+      gradient(grad, x);
+      return QuantLib::DotProduct(weights_, product_);
+    }
+
+  private:
+    void setWeights(const QuantLib::Array& x) const {
       QL_REQUIRE(x.size()==n-1, "n - 1 weights required");
-      QuantLib::Matrix weights(n,1);
       QuantLib::Real sumWeights(0.);
 
       for (QuantLib::Size i = 0; i < x.size(); ++i) {
         sumWeights += x[i];
-        weights[i][0] = x[i];
+        weights_[i] = x[i];
       }
 
-      weights[n-1][0] = 1 - sumWeights;
-
-      QuantLib::Matrix var = transpose(weights) * covariance_ * weights;
-
-      return var[0][0];
-    }
-
-    QuantLib::Disposable<QuantLib::Array> values(const QuantLib::Array& x) const {
-      QuantLib::Array var(1,value(x));
-      return var;
+      weights_[n-1] = 1 - sumWeights;
     }
 };
 
 class EqualRiskContributionFunction : public QuantLib::CostFunction {
   private:
-    QuantLib::Matrix covariance_;
+    boost::shared_ptr<const qltutor::CovarianceModel> covariance_;
     QuantLib::Size n;
+    mutable QuantLib::Array product_, residual_;   // gradient workspace: one thread per function object
 
   public:
     EqualRiskContributionFunction(const QuantLib::Matrix& covariance)
-      : covariance_(covariance)
+      : covariance_(new qltutor::DenseCovariance(covariance.rows(), covariance.begin(), covariance.columns()))
     {
       n = covariance.rows();
     }
 
+    EqualRiskContributionFunction(const boost::shared_ptr<const qltutor::CovarianceModel>& covariance)
+      : covariance_(covariance)
+    {
+      n = covariance->size();
+    }
+
+    // sum over pairs i > j of (rc_i - rc_j)^2 = n sum rc_i^2 - (sum rc_i)^2, in O(n)
     QuantLib::Real value(const QuantLib::Array& x) const{
 
     QuantLib::Array dsx = values(x);
-    QuantLib::Real res(0.);
+    QuantLib::Real sum(0.), sumSquares(0.);
 
     for (QuantLib::Size i = 0; i < n; ++i) {
-      for(QuantLib::Size j = 0; j < i; ++j) {
-        res += (dsx[i] - dsx[j]) * (dsx[i] - dsx[j]);
-      }
+      sum += dsx[i];
+      sumSquares += dsx[i] * dsx[i];
     }
 
-    return res;
+    return std::max(0., n * sumSquares - sum * sum);
   }
 
   QuantLib::Disposable<QuantLib::Array> values(const QuantLib::Array& x) const {
-    QuantLib::Array dsx(n,0.);
+    qltutor::AllocationScope scope("09lopt/EqualRiskContributionFunction::values");
+    QL_REQUIRE(x.size()==n, "n weights required");
+    QuantLib::Array dsx(n);
+    // dsx[i] = x[i] (cov x)[i]
+    covariance_->riskContributions(x.begin(), dsx.begin());
+    return dsx;
+  }
+
+  // with rc = x o Sx and u = 2 (n rc - sum(rc)), the gradient of value() is
+  // (Sx) o u + S (x o u): two products with the covariance
+  void gradient(QuantLib::Array& grad, const QuantLib::Array& x) const {
+    QL_REQUIRE(x.size()==n, "n weights required");
+    product_.resize(n);
+    residual_.resize(n);
+    covariance_->multiply(x.begin(), product_.begin());
+    QuantLib::Real sum(0.);
+    for (QuantLib::Size i = 0; i < n; ++i) sum += x[i] * product_[i];
+    for (QuantLib::Size i = 0; i < n; ++i) residual_[i] = 2 * (n * x[i] * product_[i] - sum);
+
+    grad.resize(n);
     for (QuantLib::Size i = 0; i < n; ++i) {
-      QuantLib::Array row(covariance_.row_begin(i), covariance_.row_end(i));
-      dsx[i] = QuantLib::DotProduct(row, x) * x[i];
-      double test = dsx[i];
+      grad[i] = x[i] * residual_[i];
+      product_[i] *= residual_[i];
     }
-    return dsx;
+    covariance_->multiply(grad.begin(), residual_.begin());
+    for (QuantLib::Size i = 0; i < n; ++i) grad[i] = product_[i] + residual_[i];
   }
 };
 
@@ -137,4 +199,16 @@ class FullyInvestedConstraint : public QuantLib::Constraint {
     FullyInvestedConstraint () : QuantLib::Constraint(boost::shared_ptr<QuantLib::Constraint::Impl> (new FullyInvestedConstraint::Impl)) {}
 };
 
+// minimum variance weights (n x 1): closed form when unconstrained, Simplex when long only
+QuantLib::Matrix WeightsMV(bool isConstrained, QuantLib::Size n, const QuantLib::Matrix& cov);
+
+// unconstrained minimum variance weights (n x 1) from a factorization kept current
+// under intraday changes: O(n^2) per refresh
+QuantLib::Matrix WeightsMV(const qltutor::IncrementalCovariance& cov);
+
+// unconstrained minimum variance weights (n x 1) from any covariance model: one solve,
+// O(nk) for a factor model
+QuantLib::Matrix WeightsMV(const qltutor::CovarianceModel& cov);
 
+// equal risk contribution weights (n x 1)
+QuantLib::Matrix WeightsERC(QuantLib::Size n, QuantLib::Matrix& cov, const QuantLib::Matrix& correlation);
@@ -8,7 +8,13 @@
 #include <iostream>
 // #include <function>
 #include <functional>
+#include <random>
+#include <chrono>
 
+#ifdef QLTUTOR_ALLOCATION_SCOPES
+#define QLTUTOR_COUNT_ALLOCATIONS   // this translation unit installs the counting operator new
+#endif
+#include "allocations.hpp"
 #include "er.hpp"
 
 namespace {
@@ -100,4 +106,113 @@ BOOST_AUTO_TEST_CASE(testLinearOptimization)
 //  return 0;
 }
 
+// minimum variance weights refreshed from an updated factorization match a full solve
+BOOST_AUTO_TEST_CASE(testMinimumVarianceWeightsRefresh) {
+  Matrix covariance(4, 4);
+  covariance[0][0] = .40; covariance[0][1] = .05;  covariance[0][2] = .02; covariance[0][3] = .04;
+  covariance[1][0] = .05; covariance[1][1] = .20;  covariance[1][2] = .01; covariance[1][3] = -.06;
+  covariance[2][0] = .02; covariance[2][1] = .01;  covariance[2][2] = .30; covariance[2][3] = .03;
+  covariance[3][0] = .04; covariance[3][1] = -.06; covariance[3][2] = .03; covariance[3][3] = .15;
+
+  qltutor::IncrementalCovariance incremental(4, covariance.begin(), covariance.columns());
+  Matrix weights = WeightsMV(incremental), expected = WeightsMV(false, 4, covariance);
+  for (Size i = 0; i < 4; ++i) BOOST_CHECK_CLOSE(weights[i][0], expected[i][0], 1e-10);
+
+  //IBM volatility up by a quarter, AAPL-ORCL correlation to .3
+  incremental.setVolatility(1, 1.25 * std::sqrt(covariance[1][1]));
+  incremental.setCorrelation(0, 2, .3);
+  for (Size i = 0; i < 4; ++i) {
+    covariance[1][i] *= 1.25;
+    covariance[i][1] *= 1.25;
+  }
+  covariance[0][2] = covariance[2][0] = .3 * std::sqrt(covariance[0][0] * covariance[2][2]);
+
+  weights = WeightsMV(incremental);
+  expected = WeightsMV(false, 4, covariance);
+  for (Size i = 0; i < 4; ++i) {
+    BOOST_CHECK_CLOSE(weights[i][0], expected[i][0], 1e-10);
+    for (Size j = 0; j < 4; ++j) BOOST_CHECK_CLOSE(incremental.covariance(i, j), covariance[i][j], 1e-12);
+  }
+  std::cout << boost::format("Minimum variance weights after the update: %.4f %.4f %.4f %.4f (%d updates, drift %.1e)")
+    % weights[0][0] % weights[1][0] % weights[2][0] % weights[3][0]
+    % incremental.updatesSinceFactorization() % incremental.drift() << std::endl;
+}
+
+// a k-factor model through the same cost functions as a dense matrix: identical values
+// and gradients, then O(nk) scaling where the dense matrix stops fitting
+BOOST_AUTO_TEST_CASE(testFactorCovarianceModel) {
+  const Size factors = 20;
+  std::mt19937 rng(39);
+  std::normal_distribution<double> gaussian;
+  std::uniform_real_distribution<double> specific(.01, .04);
+
+  // loadings, a diagonal-dominant factor covariance and specific variances for n assets
+  std::function<boost::shared_ptr<qltutor::FactorCovariance> (Size)> factorModel = [&](Size n) {
+    std::vector<double> loadings(n * factors), variances(n);
+    Matrix factorCovariance(factors, factors, .002);
+    for (Size k = 0; k < factors; ++k) factorCovariance[k][k] = .02 + .002 * k;
+    for (Size i = 0; i < loadings.size(); ++i) loadings[i] = .5 + .3 * gaussian(rng);
+    for (Size i = 0; i < n; ++i) variances[i] = specific(rng);
+    return boost::shared_ptr<qltutor::FactorCovariance>(
+      new qltutor::FactorCovariance(n, factors, &loadings[0], factors, factorCovariance.begin(), factors, &variances[0]));
+  };
+
+  const Size n = 200;
+  boost::shared_ptr<qltutor::FactorCovariance> model = factorModel(n);
+  Matrix dense(n, n);
+  model->copyTo(dense.begin(), n);
+
+  Array x(n - 1), weights(n);
+  for (Size i = 0; i < n - 1; ++i) x[i] = (1. + .2 * gaussian(rng)) / n;
+  for (Size i = 0; i < n; ++i) weights[i] = (1. + .2 * gaussian(rng)) / n;
+  MeanVarianceFunction denseVariance(dense), factorVariance(model);
+  BOOST_CHECK_CLOSE(factorVariance.value(x), denseVariance.value(x), 1e-10);
+  Array denseGradient, factorGradient;
+  denseVariance.gradient(denseGradient, x);
+  factorVariance.gradient(factorGradient, x);
+  for (Size i = 0; i < n - 1; ++i) BOOST_CHECK_CLOSE(factorGradient[i], denseGradient[i], 1e-8);
+  Array up = x, down = x;
+  up[7] += 1e-6;
+  down[7] -= 1e-6;
+  BOOST_CHECK_CLOSE((factorVariance.value(up) - factorVariance.value(down)) / 2e-6, factorGradient[7], 1e-4);
+
+  EqualRiskContributionFunction denseERC(dense), factorERC(model);
+  BOOST_CHECK_CLOSE(factorERC.value(weights), denseERC.value(weights), 1e-8);
+  factorERC.gradient(factorGradient, weights);
+  up = weights;
+  down = weights;
+  up[11] += 1e-6;
+  down[11] -= 1e-6;
+  BOOST_CHECK_CLOSE((factorERC.value(up) - factorERC.value(down)) / 2e-6, factorGradient[11], 1e-4);
+
+  Matrix factorWeights = WeightsMV(*model), denseWeights = WeightsMV(false, n, dense);
+  for (Size i = 0; i < n; ++i) BOOST_CHECK_CLOSE(factorWeights[i][0], denseWeights[i][0], 1e-8);
+
+  // memory and time per variance + gradient evaluation; dense only while it is small
+  typedef std::chrono::steady_clock Clock;
+  std::cout << "assets   factor MB   dense MB   factor us/eval   dense us/eval" << std::endl;
+  for (Size assets : { 1000, 5000, 10000, 20000, 50000 }) {
+    boost::shared_ptr<qltutor::FactorCovariance> large = factorModel(assets);
+    Array y(assets - 1, 1.0 / assets), gradient;
+    const int evaluations = 20;
+    MeanVarianceFunction factorFunction(large);
+    Clock::time_point start = Clock::now();
+    for (int e = 0; e < evaluations; ++e) factorFunction.valueAndGradient(gradient, y);
+    double factorMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / evaluations;
+
+    double denseMB = assets * double(assets) * sizeof(double) / 1e6, denseMicros = 0.0;
+    if (assets <= 5000) {
+      Matrix largeDense(assets, assets);
+      large->copyTo(largeDense.begin(), assets);
+      MeanVarianceFunction denseFunction(largeDense);
+      start = Clock::now();
+      for (int e = 0; e < evaluations; ++e) denseFunction.valueAndGradient(gradient, y);
+      denseMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / evaluations;
+    }
+    std::cout << boost::format("%6d   %9.1f   %8.0f   %14.1f   %13s")
+      % assets % (large->memoryBytes() / 1e6) % denseMB % factorMicros
+      % (denseMicros > 0.0 ? str(boost::format("%.1f") % denseMicros) : std::string("-")) << std::endl;
+  }
+}
+
 }
@@ -10,10 +10,18 @@
 #include <cstdlib>
 #include <functional>
 #include <numeric>
+#include <algorithm>
+#include <random>
+#include <chrono>
 
 #include <ql/quantlib.hpp>
 #include <boost/format.hpp>
 
+#include "portfoliokernels.hpp"
+#include "frontier.hpp"
+#include "covupdate.hpp"
+#include "covariancemodel.hpp"
+
 // Expected return E(Rp) = w1*R1 + (1-w1)*R2
 // Variance Vp = w1^2*V1 + (1-w1)^2*V2 + 2*w1*(1-w1)*cov(R1,R2)
 // Volatility sigma = sqrt(Vp)
@@ -97,34 +105,15 @@ namespace {
     std::cout << boost::format("Portfolio return vector minus constraints (c = %f)") % c << std::endl;
     std::cout << portfolioReturnVectorMinusC << std::endl;
 
-    //inverse of covariance matrix
-    const Matrix inverseOfCovarMatrix = inverse(covarianceMatrix);
-
-    //z vectors
-    //Az: just with return vector
-    const Matrix& portfolioAz = inverseOfCovarMatrix * portfolioReturnVector;
-    std::cout << "Portfolio Az vector" << std::endl;
-    std::cout << portfolioAz << std::endl;
-    double sumOfPortfolioAz = 0.0;
-    std::for_each(portfolioAz.begin(), portfolioAz.end(), [&](Real n) {
-      sumOfPortfolioAz += n;
-    });
-
-    //Bz: just with return vector minus C
-    const Matrix& portfolioBz = inverseOfCovarMatrix * portfolioReturnVectorMinusC;
-    std::cout << "Portfolio Bz vector" << std::endl;
-    std::cout << portfolioBz << std::endl;
-    double sumOfPortfolioBz = 0.0;
-    std::for_each(portfolioBz.begin(), portfolioBz.end(), [&](Real n) {
-      sumOfPortfolioBz += n;
-    });
+    //factor the covariance matrix once; Az = inverse(S) R and Bz = inverse(S) (R - c)
+    //are triangular solves on the factor, normalized to tangency portfolios at 0 and c
+    qltutor::EfficientFrontier frontier(4, covarianceMatrix.begin(), covarianceMatrix.columns(), portfolioReturnVector.begin());
+    std::cout << boost::format("Covariance condition number: %f") % frontier.factorization().conditionEstimate() << std::endl;
 
     //portfolio weights
     Matrix weightsPortfolioA(4,1), weightsPortfolioB(4,1);
-    for (int i=0; i<4; ++i) {
-      weightsPortfolioA[i][0] = portfolioAz[i][0]/sumOfPortfolioAz;
-      weightsPortfolioB[i][0] = portfolioBz[i][0]/sumOfPortfolioBz;
-    }
+    frontier.tangencyWeights(0.0, weightsPortfolioA.begin());
+    frontier.tangencyWeights(c, weightsPortfolioB.begin());
 
     std::cout << "Portfolio A weights" << std::endl;
     std::cout << weightsPortfolioA << std::endl;
@@ -135,8 +124,7 @@ namespace {
     //portfolio risk and return
     const Matrix& expectedReturnPortfolioAMatrix = transpose(weightsPortfolioA) * portfolioReturnVector;
     double expectedReturnPortfolioA = expectedReturnPortfolioAMatrix[0][0];
-    const Matrix& variancePortfolioAMatrix = transpose(weightsPortfolioA) * covarianceMatrix * weightsPortfolioA;
-    double variancePortfolioA = variancePortfolioAMatrix[0][0];
+    double variancePortfolioA = qltutor::quadraticForm(4, covarianceMatrix.begin(), covarianceMatrix.columns(), weightsPortfolioA.begin());
     double stdDeviationPortfolioA = std::sqrt(variancePortfolioA);
     std::cout << boost::format("Portfolio A expected return: %f") % expectedReturnPortfolioA << std::endl;
     std::cout << boost::format("Portfolio A variance: %f") % variancePortfolioA << std::endl;
@@ -144,70 +132,216 @@ namespace {
 
     const Matrix& expectedReturnPortfolioBMatrix = transpose(weightsPortfolioB) * portfolioReturnVector;
     double expectedReturnPortfolioB = expectedReturnPortfolioBMatrix[0][0];
-    const Matrix& variancePortfolioBMatrix = transpose(weightsPortfolioB) * covarianceMatrix * weightsPortfolioB;
-    double variancePortfolioB = variancePortfolioBMatrix[0][0];
+    double variancePortfolioB = qltutor::quadraticForm(4, covarianceMatrix.begin(), covarianceMatrix.columns(), weightsPortfolioB.begin());
     double stdDeviationPortfolioB = std::sqrt(variancePortfolioB);
     std::cout << boost::format("Portfolio B expected return: %f") % expectedReturnPortfolioB << std::endl;
     std::cout << boost::format("Portfolio B variance: %f") % variancePortfolioB << std::endl;
     std::cout << boost::format("Portfolio B std. dev.: %f") % stdDeviationPortfolioB << std::endl;
 
     //covariance and correlation of returns
-    const Matrix& covarianceABMatrix = transpose(weightsPortfolioA) * covarianceMatrix * weightsPortfolioB;
-    double covarianceAB  = covarianceABMatrix[0][0];
+    double covarianceAB  = qltutor::portfolioCovariance(4, covarianceMatrix.begin(), covarianceMatrix.columns(),
+                                                        weightsPortfolioA.begin(), weightsPortfolioB.begin());
     double correlationAB = covarianceAB / stdDeviationPortfolioA / stdDeviationPortfolioB;
     std::cout << boost::format("Covariance of portfolio A and B: %f") % covarianceAB << std::endl;
     std::cout << boost::format("Correlation of portfolio A and B: %f") % correlationAB << std::endl;
 
-    //generate envelope set of portfolios
+    //generate envelope set of portfolios, proportion of A from -.40 to 1.60
+    const int envelopePoints = 21;
     double startingProportion = -.40;
     double increment = .10;
-    // Proportion => (Volatility, return)
-    std::map<double, std::pair<Volatility, double> > mapOfProportionToRiskAndReturn;
-    std::map<Volatility, double> mapOfVolatilityToReturn;
-    for (int i = 0; i < 21; ++i) {
-      double proportionA = startingProportion + i * increment;
-      Volatility riskEF = calculatePortfolioRisk(proportionA, stdDeviationPortfolioA, stdDeviationPortfolioB, covarianceAB);
-      double returnEF = calculatePortfolioReturn(proportionA, expectedReturnPortfolioA, expectedReturnPortfolioB);
-      mapOfProportionToRiskAndReturn[proportionA] = std::make_pair(riskEF, returnEF);
-      mapOfVolatilityToReturn[riskEF] = returnEF;
+    std::vector<double> proportions(envelopePoints), risks(envelopePoints), returns(envelopePoints);
+    for (int i = 0; i < envelopePoints; ++i) {
+      proportions[i] = startingProportion + i * increment;
+      risks[i] = calculatePortfolioRisk(proportions[i], stdDeviationPortfolioA, stdDeviationPortfolioB, covarianceAB);
+      returns[i] = calculatePortfolioReturn(proportions[i], expectedReturnPortfolioA, expectedReturnPortfolioB);
     }
 
     //write data to a file
     std::ofstream envelopeSetFile;
     envelopeSetFile.open("C:\\TEMP\\envelop.csv", std::ios::out);
-    for ( std::map<double, std::pair<Volatility, double> >::const_iterator i = mapOfProportionToRiskAndReturn.begin()
-        ; i != mapOfProportionToRiskAndReturn.end()
-        ; ++i) {
-      envelopeSetFile << boost::format("%f,%f,%f") % i->first % i->second.first % i->second.second << std::endl;
+    for (int i = 0; i < envelopePoints; ++i) {
+      envelopeSetFile << boost::format("%f,%f,%f") % proportions[i] % risks[i] % returns[i] << std::endl;
     }
     envelopeSetFile.close();
 
-    //find minimum risk portfolios on efficient frontier
-    //minimum volatility/risk
-    std::pair<Volatility, double> minimumVariancePortfolioRiskAndReturn = *mapOfVolatilityToReturn.begin();
-    Volatility minimumRisk = minimumVariancePortfolioRiskAndReturn.first;
-    double maximumReturn = minimumVariancePortfolioRiskAndReturn.second;
+    //find minimum risk portfolio on the envelope
+    int minimumIndex = int(std::min_element(risks.begin(), risks.end()) - risks.begin());
+    Volatility minimumRisk = risks[minimumIndex];
+    double maximumReturn = returns[minimumIndex];
     std::cout << boost::format("Maximum portfolio return for risk of %f is %f") % minimumRisk % maximumReturn << std::endl;
 
+    //the envelope of two frontier portfolios is the frontier itself: it cannot beat the analytic minimum
+    std::cout << boost::format("Minimum variance portfolio: return %f, risk %f")
+      % frontier.minimumVarianceReturn() % std::sqrt(frontier.minimumVariance()) << std::endl;
+    BOOST_CHECK(minimumRisk >= std::sqrt(frontier.minimumVariance()) * (1 - 1e-12));
+    BOOST_CHECK_CLOSE(risks[minimumIndex], frontier.volatility(returns[minimumIndex]), 1e-8);
+
     //generate efficient frontier
     //stop at minimum risk
-    std::map<Volatility, double> efficientFrontier;
-    for ( std::map<double, std::pair<Volatility, double> >::const_iterator i = mapOfProportionToRiskAndReturn.begin()
-        ; i != mapOfProportionToRiskAndReturn.end()
-        ; ++i ) {
-      efficientFrontier[i->second.first] = i->second.second;
-      std::cout << boost::format("%f,%f,%f,%f") % i->first % i->second.first % i->second.second % minimumRisk << std::endl;
-      if (i->second.first == minimumRisk) break;
+    for (int i = 0; i <= minimumIndex; ++i) {
+      std::cout << boost::format("%f,%f,%f,%f") % proportions[i] % risks[i] % returns[i] % minimumRisk << std::endl;
     }
 
-    //write efficient frontier to file
+    //write efficient frontier to file, by increasing risk
     std::ofstream efFile;
     efFile.open("C:\\TEMP\\ef.csv", std::ios::out);
-    for ( std::map<Volatility, double>::const_iterator i = efficientFrontier.begin()
-        ; i != efficientFrontier.end()
-        ; ++i ) {
-      efFile << boost::format("%f,%f") % i->first % i->second << std::endl;
+    for (int i = minimumIndex; i >= 0; --i) {
+      efFile << boost::format("%f,%f") % risks[i] % returns[i] << std::endl;
     }
     efFile.close();
   }
+
+  // n-asset frontier: one Cholesky factorization, then flat arrays of frontier points
+  BOOST_AUTO_TEST_CASE(testFrontierEngine) {
+    typedef std::chrono::steady_clock Clock;
+    const Size n = 1500, factors = 10, points = 5000;
+
+    //covariance with a factor structure plus specific risk, as in an equity risk model
+    std::mt19937 rng(2013);
+    std::normal_distribution<double> loading(0.0, .08);
+    std::uniform_real_distribution<double> specific(.01, .04), expected(.02, .12);
+    Matrix exposures(n, factors), returns(n, 1);
+    for (Size i = 0; i < n; ++i) {
+      for (Size k = 0; k < factors; ++k) exposures[i][k] = loading(rng);
+      returns[i][0] = expected(rng);
+    }
+    Matrix covariance = exposures * transpose(exposures);
+    for (Size i = 0; i < n; ++i) covariance[i][i] += specific(rng);
+
+    Clock::time_point start = Clock::now();
+    qltutor::EfficientFrontier frontier(n, covariance.begin(), covariance.columns(), returns.begin());
+    std::vector<double> frontierReturns(points), frontierRisks(points);
+    frontier.trace(frontier.minimumVarianceReturn(), .12, points, &frontierReturns[0], &frontierRisks[0]);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << boost::format("%d assets, %d frontier points in %.3f s, condition number %.1f (lower bound %.1f)")
+      % n % points % seconds % frontier.factorization().conditionEstimate()
+      % frontier.factorization().conditionLowerBound() << std::endl;
+
+    //the weights of a frontier point are fully invested, earn the target and have the traced risk
+    Array weights(n);
+    for (Size k = 0; k < points; k += points / 5) {
+      frontier.weights(frontierReturns[k], weights.begin());
+      Real invested = std::accumulate(weights.begin(), weights.end(), 0.0);
+      Real expectedReturn = DotProduct(weights, Array(returns.begin(), returns.end()));
+      Real risk = std::sqrt(qltutor::quadraticForm(n, covariance.begin(), n, weights.begin()));
+      BOOST_CHECK_CLOSE(invested, 1.0, 1e-8);
+      BOOST_CHECK_CLOSE(expectedReturn, frontierReturns[k], 1e-8);
+      BOOST_CHECK_CLOSE(risk, frontierRisks[k], 1e-6);
+    }
+
+    //risk increases along the efficient branch, starting from the minimum variance portfolio
+    BOOST_CHECK(std::is_sorted(frontierRisks.begin(), frontierRisks.end()));
+    BOOST_CHECK_CLOSE(frontierRisks[0], std::sqrt(frontier.minimumVariance()), 1e-10);
+
+    //no perturbation of the minimum variance portfolio does better
+    Array minimumVariance(n), perturbed(n);
+    frontier.minimumVarianceWeights(minimumVariance.begin());
+    Real variance = qltutor::quadraticForm(n, covariance.begin(), n, minimumVariance.begin());
+    for (Size trial = 0; trial < 5; ++trial) {
+      perturbed = minimumVariance;
+      perturbed[trial] += 1e-3;
+      perturbed[n - 1 - trial] -= 1e-3;
+      BOOST_CHECK(qltutor::quadraticForm(n, covariance.begin(), n, perturbed.begin()) > variance);
+    }
+
+    //a matrix that is not positive definite is refused
+    Matrix indefinite = covariance;
+    indefinite[n / 2][n / 2] = -indefinite[n / 2][n / 2];
+    BOOST_CHECK_THROW(qltutor::CholeskyFactorization(n, indefinite.begin(), n), std::domain_error);
+  }
+
+  // intraday: a few volatilities and correlations move; refresh the frontier in O(n^2)
+  BOOST_AUTO_TEST_CASE(testIncrementalFrontierRefresh) {
+    typedef std::chrono::steady_clock Clock;
+    const Size n = 800, factors = 10, changes = 40;
+
+    std::mt19937 rng(2014);
+    std::normal_distribution<double> loading(0.0, .08);
+    std::uniform_real_distribution<double> specific(.01, .04), expected(.02, .12), bump(.8, 1.25);
+    std::uniform_int_distribution<Size> asset(0, n - 1);
+    Matrix exposures(n, factors);
+    std::vector<double> returns(n);
+    for (Size i = 0; i < n; ++i) {
+      for (Size k = 0; k < factors; ++k) exposures[i][k] = loading(rng);
+      returns[i] = expected(rng);
+    }
+    Matrix covariance = exposures * transpose(exposures);
+    for (Size i = 0; i < n; ++i) covariance[i][i] += specific(rng);
+
+    qltutor::CovarianceUpdateOptions options;
+    options.maxUpdates = 25;          // so that the test also goes through a scheduled refactorization
+    qltutor::IncrementalCovariance incremental(n, covariance.begin(), n, options);
+    qltutor::EfficientFrontier frontier(incremental.factorization(), &returns[0]);
+
+    double incrementalSeconds = 0.0, fullSeconds = 0.0;
+    std::vector<double> refreshed(n), rebuilt(n);
+    for (Size change = 0; change < changes; ++change) {
+      Clock::time_point start = Clock::now();
+      Size i = asset(rng), j = asset(rng);
+      if (change % 2 == 0 || i == j) {
+        incremental.setVolatility(i, bump(rng) * std::sqrt(incremental.covariance(i, i)));
+      } else {
+        Real correlation = incremental.covariance(i, j) / std::sqrt(incremental.covariance(i, i) * incremental.covariance(j, j));
+        incremental.setCorrelation(i, j, .9 * correlation + .02);
+      }
+      frontier.reset(incremental.factorization(), &returns[0]);
+      Clock::time_point refreshedAt = Clock::now();
+      qltutor::EfficientFrontier full(n, incremental.covariance(), n, &returns[0]);
+      fullSeconds += std::chrono::duration<double>(Clock::now() - refreshedAt).count();
+      incrementalSeconds += std::chrono::duration<double>(refreshedAt - start).count();
+
+      frontier.minimumVarianceWeights(&refreshed[0]);
+      full.minimumVarianceWeights(&rebuilt[0]);
+      Real error = 0.0;
+      for (Size k = 0; k < n; ++k) error = std::max(error, std::fabs(refreshed[k] - rebuilt[k]));
+      BOOST_CHECK_SMALL(error, 1e-10);
+      BOOST_CHECK_CLOSE(frontier.volatility(.10), full.volatility(.10), 1e-9);
+      BOOST_CHECK(incremental.drift() <= options.driftTolerance);
+    }
+    std::cout << boost::format("%d changes on %d assets: %.4f s refreshing, %.4f s refactoring; %d factorizations, drift %.1e")
+      % changes % n % incrementalSeconds % fullSeconds % incremental.factorizations() % incremental.drift() << std::endl;
+    // every change was an O(n^2) update: one factorization at construction, one scheduled
+    // after maxUpdates of them, and none forced by drift or a failed downdate. The timings
+    // are only printed, since wall clock depends on the machine's load
+    BOOST_CHECK_EQUAL(incremental.factorizations(), changes / options.maxUpdates + 1);
+    BOOST_CHECK_EQUAL(incremental.updatesSinceFactorization(), changes % options.maxUpdates);
+  }
+
+  // a factor-model frontier solves through Woodbury in O(nk) and never forms the matrix
+  BOOST_AUTO_TEST_CASE(testFactorModelFrontier) {
+    typedef std::chrono::steady_clock Clock;
+    const Size factors = 15;
+    std::mt19937 rng(39);
+    std::normal_distribution<double> loading(1.0, .3);
+    std::uniform_real_distribution<double> specific(.01, .04), expected(.02, .12);
+    Matrix factorCovariance(factors, factors, .001);
+    for (Size k = 0; k < factors; ++k) factorCovariance[k][k] = .01 + .001 * k;
+
+    for (Size n : { 300, 50000 }) {
+      std::vector<double> loadings(n * factors), variances(n), returns(n);
+      for (Size i = 0; i < loadings.size(); ++i) loadings[i] = loading(rng);
+      for (Size i = 0; i < n; ++i) {
+        variances[i] = specific(rng);
+        returns[i] = expected(rng);
+      }
+      Clock::time_point start = Clock::now();
+      qltutor::FactorCovariance model(n, factors, &loadings[0], factors, factorCovariance.begin(), factors, &variances[0]);
+      qltutor::EfficientFrontier frontier(model, &returns[0]);
+      double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+      std::cout << boost::format("Factor-model frontier of %d assets: %.4f s, %.1f MB; minimum variance %.6f at %.4f")
+        % n % seconds % (model.memoryBytes() / 1e6) % frontier.minimumVariance() % frontier.minimumVarianceReturn() << std::endl;
+
+      std::vector<double> weights(n);
+      frontier.weights(.10, &weights[0]);
+      BOOST_CHECK_CLOSE(model.variance(&weights[0]), frontier.variance(.10), 1e-8);
+
+      if (n <= 1000) {
+        Matrix dense(n, n);
+        model.copyTo(dense.begin(), n);
+        qltutor::EfficientFrontier denseFrontier(n, dense.begin(), n, &returns[0]);
+        BOOST_CHECK_CLOSE(frontier.volatility(.10), denseFrontier.volatility(.10), 1e-8);
+        BOOST_CHECK_CLOSE(frontier.minimumVarianceReturn(), denseFrontier.minimumVarianceReturn(), 1e-8);
+      }
+    }
+  }
 }
@@ -14,6 +14,13 @@
 #include <ql/quantlib.hpp>
 #include <boost/format.hpp>
 
+#include "solverprobe.hpp"
+#include "covariancemodel.hpp"
+#ifdef QLTUTOR_ALLOCATION_SCOPES
+#define QLTUTOR_COUNT_ALLOCATIONS   // this translation unit installs the counting operator new
+#endif
+#include "allocations.hpp"
+
 namespace {
 
 using namespace QuantLib;
@@ -46,31 +53,53 @@ class PortfolioAllocationConstraints : public Constraint {
     };
 };
 
-// Optimize for sharp ratio
+// Optimize for sharp ratio: n assets, the n-th weight is 1 - sum of the other n - 1.
+// Takes a dense covariance matrix or any qltutor::CovarianceModel (O(nk) per value
+// and gradient for a factor model).
 class ThetaCostFunction : public CostFunction {
   public:
     ThetaCostFunction( const Matrix& covarianceMatrix
                      , const Matrix& returnMatrix )
-      : covarianceMatrix_(covarianceMatrix)
-      , returnMatrix_(returnMatrix) { }
+      : covariance_(new qltutor::DenseCovariance(covarianceMatrix.rows(), covarianceMatrix.begin(), covarianceMatrix.columns()))
+      , returnMatrix_(returnMatrix)
+      , weights_(returnMatrix.rows()), product_(returnMatrix.rows()) { }
+
+    ThetaCostFunction( const boost::shared_ptr<const qltutor::CovarianceModel>& covariance
+                     , const Matrix& returnMatrix )
+      : covariance_(covariance)
+      , returnMatrix_(returnMatrix)
+      , weights_(returnMatrix.rows()), product_(returnMatrix.rows()) {
+      QL_REQUIRE(covariance->size() == returnMatrix.rows(), "covariance and returns differ in size");
+    }
 
     Real value(const Array& proportions) const {
-      QL_REQUIRE(proportions.size() == 3, "Four assets in portfolio!");
-      Array allProportions(4);
-      allProportions[0] = proportions[0];
-      allProportions[1] = proportions[1];
-      allProportions[2] = proportions[2];
-      allProportions[3] = 1 - proportions[0] - proportions[1] - proportions[2];
-      return -1 * ((portfolioMean(allProportions) - c_)/portfolioStdDeviation(allProportions));
+      qltutor::AllocationScope scope("11popt/ThetaCostFunction::value");
+      setWeights(proportions);
+      return -1 * ((portfolioMean(weights_) - c_)/portfolioStdDeviation(weights_));
     }
 
     Disposable<Array> values(const Array& proportions) const {
-      QL_REQUIRE(proportions.size() == 3, "Four assets in portfolio");
       Array values(1);
       values[0] = value(proportions);
       return values;
     }
 
+    // d theta/dw = (R - (mean - c) S w / variance) / sigma; the n-th weight moves
+    // against each of the others
+    void gradient(Array& grad, const Array& proportions) const {
+      setWeights(proportions);
+      covariance_->multiply(weights_.begin(), product_.begin());
+      Real variance = DotProduct(weights_, product_);
+      Real sigma = std::sqrt(variance);
+      Real excess = portfolioMean(weights_) - c_;
+      Size n = weights_.size();
+      for (Size i = 0; i < n; ++i) {
+        product_[i] = -(returnMatrix_[i][0] - excess * product_[i] / variance) / sigma;
+      }
+      grad.resize(n - 1);
+      for (Size i = 0; i < n - 1; ++i) grad[i] = product_[i] - product_[n - 1];
+    }
+
     void setC(Real c) { c_ = c; }
     Real getC() const { return c_; }
     Real portfolioMean(const Array& proportions) const {
@@ -80,21 +109,29 @@ class ThetaCostFunction : public CostFunction {
     }
 
     Real portfolioStdDeviation(const Array& proportions) const {
-      Matrix matrixProportions(4, 1);
-      for (size_t row = 0; row < 4; ++row) {
-        matrixProportions[row][0] = proportions[row];
-      }
-
-      const Matrix& portfolioVarianceMatrix = transpose(matrixProportions) * covarianceMatrix_ * matrixProportions;
-      Real portfolioVariance = portfolioVarianceMatrix[0][0];
+      qltutor::AllocationScope scope("11popt/ThetaCostFunction::portfolioStdDeviation");
+      QL_REQUIRE(proportions.size() == weights_.size(), weights_.size() << " assets in portfolio");
+      Real portfolioVariance = covariance_->variance(proportions.begin());
       Real stdDeviation = std::sqrt(portfolioVariance);
       //std::cout << boost::format("Portfolio standard deviation: %.4f") % stdDeviation << std::endl;
       return stdDeviation;
     }
 
   private:
-    const Matrix& covarianceMatrix_
-                , returnMatrix_;
+    void setWeights(const Array& proportions) const {
+      Size n = weights_.size();
+      QL_REQUIRE(proportions.size() == n - 1, n << " assets in portfolio");
+      Real sum = 0.0;
+      for (Size i = 0; i < n - 1; ++i) {
+        weights_[i] = proportions[i];
+        sum += proportions[i];
+      }
+      weights_[n - 1] = 1 - sum;
+    }
+
+    boost::shared_ptr<const qltutor::CovarianceModel> covariance_;
+    const Matrix& returnMatrix_;
+    mutable Array weights_, product_;   // workspace
     Real c_;
 };
 
@@ -163,10 +200,13 @@ BOOST_AUTO_TEST_CASE(testNoShortSales) {
     Rate c = startingC + (i * increment);
     ThetaCostFunction thetaCostFunction(covarianceMatrix, portfolioReturnVector);
     thetaCostFunction.setC(c);
-    Problem efficientFrontierNoShortSalesProblem(thetaCostFunction, noShortSalesPortfolioConstraints, Array(3, .2500));
+    qltutor::AllocationScope scope("11popt/noShortSales (Simplex)");
+    qltutor::SolveProbe probe("Simplex", "11popt/noShortSales", thetaCostFunction, noShortSalesPortfolioConstraints);
+    Problem efficientFrontierNoShortSalesProblem(probe.costFunction(), probe.constraint(), Array(3, .2500));
     Simplex solver(.01);
 
-    EndCriteria::Type noShortSalesSolution = solver.minimize(efficientFrontierNoShortSalesProblem, endCriteria);
+    EndCriteria::Type noShortSalesSolution = probe.finish(solver.minimize(efficientFrontierNoShortSalesProblem, endCriteria),
+                                                          efficientFrontierNoShortSalesProblem);
 
     std::cout << boost::format("Solution type: %s") % noShortSalesSolution << std::endl;
 
@@ -212,5 +252,31 @@ BOOST_AUTO_TEST_CASE(testNoShortSales) {
   // plot '/tmp/noshortsales.dat' using 2:3 w linespoints title "No Short Sales", "/tmp/positionlimits.dat" using 2:3 w linespoints title "Position Limits"
 }
 
+// the analytic Sharpe-ratio gradient, dense and through a one-factor model
+BOOST_AUTO_TEST_CASE(testThetaGradient) {
+  const Size n = 4;
+  Real betas[] = { .9, 1.1, 1.3, .7 }, specific[] = { .04, .06, .09, .05 };
+  Matrix factorVariance(1, 1, .05), returns(n, 1), covariance(n, n);
+  returns[0][0] = .08; returns[1][0] = .09; returns[2][0] = .10; returns[3][0] = .11;
+  boost::shared_ptr<const qltutor::CovarianceModel> model(
+    new qltutor::FactorCovariance(n, 1, betas, 1, factorVariance.begin(), 1, specific));
+  model->copyTo(covariance.begin(), n);
+
+  ThetaCostFunction dense(covariance, returns), factor(model, returns);
+  dense.setC(.02);
+  factor.setC(.02);
+  Array x(3), denseGradient, factorGradient;
+  x[0] = .3; x[1] = .2; x[2] = .1;
+  BOOST_CHECK_CLOSE(factor.value(x), dense.value(x), 1e-10);
+  dense.gradient(denseGradient, x);
+  factor.gradient(factorGradient, x);
+  for (Size i = 0; i < 3; ++i) {
+    Array up = x, down = x;
+    up[i] += 1e-6;
+    down[i] -= 1e-6;
+    BOOST_CHECK_CLOSE(denseGradient[i], (dense.value(up) - dense.value(down)) / 2e-6, 1e-4);
+    BOOST_CHECK_CLOSE(factorGradient[i], denseGradient[i], 1e-10);
+  }
+}
 
 }
@@ -17,49 +17,18 @@
 #include <ql/quantlib.hpp>
 #include <boost/format.hpp>
 
+#include "solverprobe.hpp"
+#ifdef QLTUTOR_ALLOCATION_SCOPES
+#define QLTUTOR_COUNT_ALLOCATIONS   // this translation unit installs the counting operator new
+#endif
+#include "allocations.hpp"
+#include "strikeinfo.hpp"
+
 namespace {
 
 using namespace QuantLib;
 
-class StrikeInfo {
-  public:
-    typedef std::pair<SimpleQuote, SimpleQuote> BidAsk;
-
-    StrikeInfo(Option::Type optionType,const BidAsk& bidAsk, Real strike)
-      : _payoff(new PlainVanillaPayoff(optionType, strike))
-      , _bidAsk(bidAsk)
-      , _impliedVol(0.0) {}
-
-    StrikeInfo(const StrikeInfo& that)
-      : _payoff(new PlainVanillaPayoff( that.getPayoff().optionType()
-                                      , that.getPayoff().strike()) )
-      , _bidAsk(that.getBidAsk())
-      , _impliedVol(that.getImpliedVol()) {}
-
-    StrikeInfo& operator=(StrikeInfo that) {
-      swap(*this, that);
-      return *this;
-    }
-
-    friend void swap(StrikeInfo& first, StrikeInfo& second) {
-      using std::swap;
-      first._payoff.swap(second._payoff);
-      std::swap(first._impliedVol, second._impliedVol);
-      std::swap(first._bidAsk, second._bidAsk);
-    }
-
-    const StrikedTypePayoff& getPayoff() const { return *_payoff; }
-    const BidAsk& getBidAsk()            const { return _bidAsk; }
-    Real  getStrike()                    const { return _payoff->strike(); }
-
-    void  setImpliedVol(Volatility impliedVol) { _impliedVol = impliedVol;}
-    const Volatility& getImpliedVol()    const { return _impliedVol; }
-
-  private:
-    boost::scoped_ptr<StrikedTypePayoff> _payoff;
-    Volatility _impliedVol;
-    BidAsk _bidAsk;
-};
+using qltutor::StrikeInfo;
 
 BOOST_AUTO_TEST_CASE(testESFuturesImpliedVolatility) {
   using namespace boost::posix_time;
@@ -116,11 +85,13 @@ BOOST_AUTO_TEST_CASE(testESFuturesImpliedVolatility) {
     Bisection bisection;
     Real accuracy = 0.000001, guess = .20;
     Real min = .05, max = .40;
-    Volatility sigma = bisection.solve([&](const Volatility & sigma) {
+    qltutor::AllocationScope scope("14impvol/put implied vol (Bisection)");
+    qltutor::SolveProbe probe("Bisection", "14impvol/put");
+    Volatility sigma = probe.finish(bisection.solve(probe.counted([&](const Volatility & sigma) {
         Real stdDev = sigma * std::sqrt(timeToMaturity);
         BlackCalculator blackCalculator(payoff.optionType(), payoff.strike(), forwardAsk, stdDev, discount);
         return blackCalculator.value() - price;
-      }, accuracy, guess, min, max);
+      }), accuracy, guess, min, max));
 
     putOption.setImpliedVol(sigma);
     if (payoff(forwardAsk) > 0) { continue; } // skip ITM options
@@ -160,11 +131,13 @@ BOOST_AUTO_TEST_CASE(testESFuturesImpliedVolatility) {
     Real accuracy = 0.000001, guess = .20;
     Real min = .05, max = .40;
 
-    Volatility sigma = bisection.solve([&](const Volatility & sigma) {
+    qltutor::AllocationScope scope("14impvol/call implied vol (Bisection)");
+    qltutor::SolveProbe probe("Bisection", "14impvol/call");
+    Volatility sigma = probe.finish(bisection.solve(probe.counted([&](const Volatility & sigma) {
         Real stdDev = sigma * std::sqrt(timeToMaturity);
         BlackCalculator blackCalculator(payoff.optionType(), payoff.strike(), forwardBid, stdDev, discount);
         return blackCalculator.value() - price;
-        }, accuracy, guess, min, max);
+        }), accuracy, guess, min, max));
 
     callOption.setImpliedVol(sigma);
     if (payoff(forwardBid) > 0) { continue; }
@@ -12,10 +12,20 @@
 #include <fstream>
 #include <cstdlib>
 #include <functional>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
 
 #include <ql/quantlib.hpp>
 #include <boost/format.hpp>
 
+#include "marketsnapshot.hpp"
+#include "lsmamerican.hpp"
+#ifdef QLTUTOR_ALLOCATION_SCOPES
+#define QLTUTOR_COUNT_ALLOCATIONS   // this translation unit installs the counting operator new
+#endif
+#include "allocations.hpp"
+
 namespace {
 
 using namespace QuantLib;
@@ -164,4 +174,171 @@ BOOST_AUTO_TEST_CASE(testAmericanOptionPricingWithDividends) {
   }
 }
 
+// time-to-first-price: bootstrap everything vs attach a snapshot of the bootstrapped market
+struct FirstPrice {
+  double marketSeconds;
+  double priceSeconds;
+  Real npv;
+};
+
+Real priceAmerican
+  ( const Handle<YieldTermStructure>& yieldTermStructure
+  , const Handle<YieldTermStructure>& dividendTermStructure
+  , const Handle<BlackVolTermStructure>& volatilityTermStructure
+  , Real underlying
+  , const Date& settlement
+  , const Date& expiration
+  , Real strike )
+{
+  qltutor::AllocationScope scope("16ameopt/priceAmerican (FD 801x800)");
+  Handle<Quote> underlyingH(boost::shared_ptr<Quote>(new SimpleQuote(underlying)));
+  boost::shared_ptr<BlackScholesMertonProcess> bsmProcess(new BlackScholesMertonProcess(underlyingH, dividendTermStructure, yieldTermStructure, volatilityTermStructure));
+  boost::shared_ptr<PricingEngine> pricingEngine(new FDAmericanEngine<CrankNicolson>(bsmProcess, 801, 800));
+
+  boost::shared_ptr<Exercise> americanExercise(new AmericanExercise(settlement, expiration));
+  boost::shared_ptr<StrikedTypePayoff> payoff(new PlainVanillaPayoff(Option::Call, strike));
+  VanillaOption americanOption(payoff, americanExercise);
+  americanOption.setPricingEngine(pricingEngine);
+  return americanOption.NPV();
+}
+
+BOOST_AUTO_TEST_CASE(testMarketSnapshotTimeToFirstPrice) {
+  using namespace boost::assign;
+  typedef std::chrono::steady_clock Clock;
+
+  Calendar calendar = UnitedStates(UnitedStates::NYSE);
+  Date today(15, Nov, 2013);
+  Date settlement = calendar.advance(today, 2, Days);
+  Real underlying = 24.52;
+  std::vector<Real> strikes;
+  strikes += 22.0, 23.0, 24.0, 25.0, 26.0, 27.0, 28.0;
+  std::vector<Volatility> vols;
+  vols += .23356, .21369, .20657, .20128, .19917, .19978, .20117;
+  Date expiration(21, Feb, 2014);
+  Date exDivDate(5, Feb, 2014);
+  Real annualDividend = .90;
+  Real strike = 25.0;
+
+  const char* configured = std::getenv("QLTUTOR_MARKET_SNAPSHOT");
+  std::string path = configured ? configured : str(boost::format("/tmp/qltutor-amopt-%d.snap") % getpid());
+
+  // cold: bootstrap from the raw quotes, snapshot the result
+  FirstPrice cold;
+  Clock::time_point start = Clock::now();
+  boost::shared_ptr<YieldTermStructure> liborCurve = bootstrapLiborZeroCurve(today);
+  boost::shared_ptr<ZeroCurve> dividendCurve = bootstrapDividendCurve(today, expiration, exDivDate, underlying, annualDividend);
+  boost::shared_ptr<BlackVolTermStructure> volatilityCurve = bootstrapVolatilityCurve(today, strikes, vols, expiration);
+  liborCurve->discount(expiration);   // bootstrap is lazy
+  Clock::time_point built = Clock::now();
+  cold.npv = priceAmerican(Handle<YieldTermStructure>(liborCurve), Handle<YieldTermStructure>(dividendCurve),
+                           Handle<BlackVolTermStructure>(volatilityCurve), underlying, settlement, expiration, strike);
+  cold.marketSeconds = std::chrono::duration<double>(built - start).count();
+  cold.priceSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  Matrix volMatrix(strikes.size(), 1);
+  for (Size i = 0; i < vols.size(); ++i) volMatrix[i][0] = vols[i];
+  std::vector<Real> scalars;
+  scalars += Real(today.serialNumber()), underlying;
+
+  qltutor::SnapshotWriter writer;
+  writer.add("market.scalars", qltutor::SnapshotScalars, scalars);
+  snapshotCurve(writer, "curve.usdlibor", *boost::dynamic_pointer_cast<PiecewiseYieldCurve<ZeroYield, Cubic> >(liborCurve));
+  snapshotCurve(writer, "curve.intc.dividend", *dividendCurve);
+  snapshotVolatilitySurface(writer, "vol.intc", today, std::vector<Date>(1, expiration), strikes, volMatrix);
+  writer.write(path);
+
+  // warm: attach the snapshot and rebuild the term structures over its nodes
+  for (bool verify : { true, false }) {
+    FirstPrice warm;
+    Clock::time_point start = Clock::now();
+    qltutor::SnapshotView view(path, verify);
+    qltutor::SnapshotView::Array market = view.array("market.scalars");
+    Settings::instance().evaluationDate() = Date(BigInteger(market[0]));
+    Handle<YieldTermStructure> yieldTermStructure(attachCurve<Cubic>(view, "curve.usdlibor", Actual360()));
+    Handle<YieldTermStructure> dividendTermStructure(attachCurve<Linear>(view, "curve.intc.dividend", ActualActual(), calendar));
+    Handle<BlackVolTermStructure> volatilityTermStructure(attachVolatilitySurface(view, "vol.intc", calendar, Actual365Fixed()));
+    Clock::time_point built = Clock::now();
+    warm.npv = priceAmerican(yieldTermStructure, dividendTermStructure, volatilityTermStructure,
+                             market[1], settlement, expiration, strike);
+    warm.marketSeconds = std::chrono::duration<double>(built - start).count();
+    warm.priceSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << boost::format("Snapshot (%s checksum): market %.3f ms vs %.3f ms bootstrapped, first price %.3f ms vs %.3f ms")
+      % (verify ? "with" : "without") % (1e3 * warm.marketSeconds) % (1e3 * cold.marketSeconds)
+      % (1e3 * warm.priceSeconds) % (1e3 * cold.priceSeconds) << std::endl;
+    std::cout << boost::format("Intel %s %.2f call: %.6f from snapshot, %.6f bootstrapped")
+      % expiration % strike % warm.npv % cold.npv << std::endl;
+    BOOST_CHECK_CLOSE(warm.npv, cold.npv, 1e-8);
+  }
+
+  // a flipped payload byte must be caught by the integrity check
+  {
+    std::string corrupt = path + ".corrupt";
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    bytes[bytes.size() - 3] ^= 0x10;
+    std::ofstream out(corrupt.c_str(), std::ios::binary);
+    out.write(&bytes[0], bytes.size());
+    out.close();
+    BOOST_CHECK_THROW(qltutor::SnapshotView view(corrupt), std::runtime_error);
+    std::remove(corrupt.c_str());
+  }
+
+  if (!configured) std::remove(path.c_str());
+}
+
+// Longstaff-Schwartz Monte Carlo against the finite-difference engine on the same
+// chain: calls, where the February dividend makes early exercise worth something deep
+// in the money, and puts. LSM exercises on 50 dates only and by a regressed policy, so
+// it sits a little below the FD value.
+BOOST_AUTO_TEST_CASE(testLongstaffSchwartzAgainstFD) {
+  using namespace boost::assign;
+
+  Calendar calendar = UnitedStates(UnitedStates::NYSE);
+  Date today(15, Nov, 2013);
+  Date settlement = calendar.advance(today, 2, Days);
+  Settings::instance().evaluationDate() = today;
+  Real underlying = 24.52;
+  std::vector<Real> strikes;
+  strikes += 22.0, 23.0, 24.0, 25.0, 26.0, 27.0, 28.0;
+  std::vector<Volatility> vols;
+  vols += .23356, .21369, .20657, .20128, .19917, .19978, .20117;
+  Date expiration(21, Feb, 2014);
+  Date exDivDate(5, Feb, 2014);
+  Real annualDividend = .90;
+
+  Handle<YieldTermStructure> yieldTermStructure(bootstrapLiborZeroCurve(today));
+  Handle<YieldTermStructure> dividendTermStructure(bootstrapDividendCurve(today, expiration, exDivDate, underlying, annualDividend));
+  Handle<BlackVolTermStructure> volatilityTermStructure(bootstrapVolatilityCurve(today, strikes, vols, expiration));
+  Handle<Quote> underlyingH(boost::shared_ptr<Quote>(new SimpleQuote(underlying)));
+  boost::shared_ptr<BlackScholesMertonProcess> bsmProcess(new BlackScholesMertonProcess(underlyingH, dividendTermStructure, yieldTermStructure, volatilityTermStructure));
+  boost::shared_ptr<PricingEngine> pricingEngine(new FDAmericanEngine<CrankNicolson>(bsmProcess, 801, 800));
+  boost::shared_ptr<Exercise> americanExercise(new AmericanExercise(settlement, expiration));
+
+  std::cout << "  type  strike    FD       LSM      SE       paths/s    training memory" << std::endl;
+  for (Option::Type type : { Option::Call, Option::Put }) {
+    for (Real strike : strikes) {
+      boost::shared_ptr<StrikedTypePayoff> payoff(new PlainVanillaPayoff(type, strike));
+      VanillaOption americanOption(payoff, americanExercise);
+      americanOption.setPricingEngine(pricingEngine);
+      Real fd = americanOption.NPV();
+      qltutor::LsmResult lsm = qltutor::lsmAmerican(bsmProcess, payoff, expiration);
+      std::cout << boost::format("  %-4s  %6.2f  %7.4f  %7.4f  %.4f  %10.3e  %.1f MB (path matrix %.1f MB)")
+        % type % strike % fd % lsm.value % lsm.standardError % lsm.pathsPerSecond
+        % (lsm.memoryBytes / 1048576.0) % (lsm.pathMatrixBytes / 1048576.0) << std::endl;
+      BOOST_CHECK_SMALL(lsm.value - fd, 4.0 * lsm.standardError + .01);
+      BOOST_CHECK(lsm.memoryBytes * 10 < lsm.pathMatrixBytes);
+    }
+  }
+
+  // the regression accumulators merge in block order
+  boost::shared_ptr<StrikedTypePayoff> put(new PlainVanillaPayoff(Option::Put, 26.0));
+  qltutor::LsmOptions options;
+  options.threads = 1;
+  qltutor::LsmResult one = qltutor::lsmAmerican(bsmProcess, put, expiration, options);
+  options.threads = 4;
+  qltutor::LsmResult four = qltutor::lsmAmerican(bsmProcess, put, expiration, options);
+  BOOST_CHECK_EQUAL(one.value, four.value);
+}
+
 }
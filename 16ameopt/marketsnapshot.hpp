@@ -0,0 +1,113 @@
+#ifndef QLTUTOR_MARKETSNAPSHOT_HPP
+#define QLTUTOR_MARKETSNAPSHOT_HPP
+
+#include <vector>
+#include <string>
+
+#include <ql/quantlib.hpp>
+
+#include "snapshot.hpp"
+
+// QuantLib glue for qltutor::SnapshotWriter/SnapshotView.
+//
+// Curves are saved as their bootstrapped nodes (date serial, zero yield) and come back
+// as interpolated curves over the same nodes and interpolator, so they reproduce the
+// bootstrapped discount factors without re-running the solver. BlackVarianceSurface
+// does not expose its grid, so the surface is saved from its inputs. Day counters and
+// calendars are not stored; the caller passes the ones the market was built with.
+
+inline void snapshotCurveNodes(qltutor::SnapshotWriter& writer, const std::string& name,
+                               const std::vector<QuantLib::Date>& dates, const std::vector<QuantLib::Rate>& yields) {
+  QL_REQUIRE(dates.size() == yields.size(), "curve " << name << ": dates and yields differ in size");
+  std::vector<double> nodes;
+  nodes.reserve(2 * dates.size());
+  for (QuantLib::Size i = 0; i < dates.size(); ++i) {
+    nodes.push_back(dates[i].serialNumber());
+    nodes.push_back(yields[i]);
+  }
+  writer.add(name, qltutor::SnapshotCurveNodes, dates.size(), 2, nodes.empty() ? 0 : &nodes[0]);
+}
+
+template <class Traits, class Interpolator>
+void snapshotCurve(qltutor::SnapshotWriter& writer, const std::string& name,
+                   const QuantLib::PiecewiseYieldCurve<Traits, Interpolator>& curve) {
+  std::vector<std::pair<QuantLib::Date, QuantLib::Real> > nodes = curve.nodes();
+  std::vector<QuantLib::Date> dates;
+  std::vector<QuantLib::Rate> yields;
+  for (QuantLib::Size i = 0; i < nodes.size(); ++i) {
+    dates.push_back(nodes[i].first);
+    yields.push_back(nodes[i].second);
+  }
+  snapshotCurveNodes(writer, name, dates, yields);
+}
+
+template <class Interpolator>
+void snapshotCurve(qltutor::SnapshotWriter& writer, const std::string& name,
+                   const QuantLib::InterpolatedZeroCurve<Interpolator>& curve) {
+  snapshotCurveNodes(writer, name, curve.dates(), curve.zeroRates());
+}
+
+template <class Interpolator>
+boost::shared_ptr<QuantLib::InterpolatedZeroCurve<Interpolator> > attachCurve
+  ( const qltutor::SnapshotView& view
+  , const std::string& name
+  , const QuantLib::DayCounter& dayCounter
+  , const QuantLib::Calendar& calendar = QuantLib::Calendar()
+  , const Interpolator& interpolator = Interpolator() )
+{
+  qltutor::SnapshotView::Array nodes = view.array(name);
+  QL_REQUIRE(nodes.columns == 2 && nodes.rows >= 2, "snapshot section " << name << " is not a curve");
+  std::vector<QuantLib::Date> dates(nodes.rows);
+  std::vector<QuantLib::Rate> yields(nodes.rows);
+  for (QuantLib::Size i = 0; i < nodes.rows; ++i) {
+    dates[i] = QuantLib::Date(QuantLib::BigInteger(nodes(i, 0)));
+    yields[i] = nodes(i, 1);
+  }
+  return boost::shared_ptr<QuantLib::InterpolatedZeroCurve<Interpolator> >(
+    new QuantLib::InterpolatedZeroCurve<Interpolator>(dates, yields, dayCounter, calendar,
+                                            std::vector<QuantLib::Handle<QuantLib::Quote> >(), std::vector<QuantLib::Date>(), interpolator));
+}
+
+// <name>.dates holds the reference date followed by the expiries, <name>.strikes the
+// strikes and <name>.vols the strikes x expiries vol matrix, as BlackVarianceSurface wants it
+inline void snapshotVolatilitySurface
+  ( qltutor::SnapshotWriter& writer
+  , const std::string& name
+  , const QuantLib::Date& referenceDate
+  , const std::vector<QuantLib::Date>& expirations
+  , const std::vector<QuantLib::Real>& strikes
+  , const QuantLib::Matrix& vols )
+{
+  QL_REQUIRE(vols.rows() == strikes.size() && vols.columns() == expirations.size(),
+             "surface " << name << ": vol matrix does not match the strike/expiry grid");
+  std::vector<double> dates(1, referenceDate.serialNumber());
+  for (QuantLib::Size j = 0; j < expirations.size(); ++j) dates.push_back(expirations[j].serialNumber());
+  writer.add(name + ".dates", qltutor::SnapshotSurfaceGrid, dates);
+  writer.add(name + ".strikes", qltutor::SnapshotSurfaceGrid, strikes);
+  writer.add(name + ".vols", qltutor::SnapshotSurfaceGrid, vols.rows(), vols.columns(), vols.begin());
+}
+
+inline boost::shared_ptr<QuantLib::BlackVarianceSurface> attachVolatilitySurface
+  ( const qltutor::SnapshotView& view
+  , const std::string& name
+  , const QuantLib::Calendar& calendar
+  , const QuantLib::DayCounter& dayCounter )
+{
+  qltutor::SnapshotView::Array dates = view.array(name + ".dates");
+  qltutor::SnapshotView::Array strikes = view.array(name + ".strikes");
+  qltutor::SnapshotView::Array vols = view.array(name + ".vols");
+  QL_REQUIRE(dates.size() >= 2 && vols.rows == strikes.size() && vols.columns == dates.size() - 1,
+             "snapshot surface " << name << " has an inconsistent grid");
+
+  std::vector<QuantLib::Date> expirations;
+  for (QuantLib::Size j = 1; j < dates.size(); ++j) expirations.push_back(QuantLib::Date(QuantLib::BigInteger(dates[j])));
+  QuantLib::Matrix volMatrix(vols.rows, vols.columns);
+  std::copy(vols.data, vols.data + vols.size(), volMatrix.begin());
+
+  return boost::shared_ptr<QuantLib::BlackVarianceSurface>(
+    new QuantLib::BlackVarianceSurface(QuantLib::Date(QuantLib::BigInteger(dates[0])), calendar, expirations,
+                             std::vector<QuantLib::Real>(strikes.data, strikes.data + strikes.size()),
+                             volMatrix, dayCounter));
+}
+
+#endif
@@ -20,6 +20,17 @@
 #include <utility>
 #include <boost/assign/std/vector.hpp>
 
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+
+#define QLTUTOR_COUNT_ALLOCATIONS   // this translation unit installs the counting operator new
+#include "allocations.hpp"
+#include "streamingstats.hpp"
+#include "streamingpath.hpp"
+#include "philoxrsg.hpp"
+#include "mcrun.hpp"
+
 using namespace QuantLib;
 
 /*
@@ -103,7 +114,7 @@ void testGeometricBrownieMotion() {
 
   std::transform(samplePathBegin, endMinusOne, beginPlusOne, std::back_inserter(logReturns), calcLogReturns);
 
-  GeneralStatistics statistics;
+  qltutor::StreamingStatistics statistics;
 
   statistics.addSequence(logReturns.begin(), logReturns.end());
   std::cout << boost::format("Std. dev. of simulated returns (Normal): %.4f") % (statistics.standardDeviation() * std::sqrt(255 * 10)) << std::endl;
@@ -169,7 +180,7 @@ void testGeometricBrowianMotionStudentT() {
 
   std::transform(samplePathBegin, endMinusOne, beginPlusOne, std::back_inserter(logReturns), calcLogReturns);
 
-  GeneralStatistics statistics;
+  qltutor::StreamingStatistics statistics;
 
   statistics.addSequence(logReturns.begin(), logReturns.end());
   std::cout << boost::format("Std. dev. of simulated returns (Normal): %.4f") % (statistics.standardDeviation() * std::sqrt(255 * 10)) << std::endl;
@@ -224,7 +235,7 @@ BOOST_AUTO_TEST_CASE(testGeometricBrowianMotionStudentTHalton) {
 
   std::transform(samplePathBegin, endMinusOne, beginPlusOne, std::back_inserter(logReturns), calcLogReturns);
 
-  GeneralStatistics statistics;
+  qltutor::StreamingStatistics statistics;
 
   statistics.addSequence(logReturns.begin(), logReturns.end());
   std::cout << boost::format("Std. dev. of simulated returns (Normal): %.4f") % (statistics.standardDeviation() * std::sqrt(255 * 10)) << std::endl;
@@ -243,10 +254,137 @@ BOOST_AUTO_TEST_CASE(testGeometricBrowianMotionStudentTHalton) {
 }
 */
 
+// per path: mean, min and max price, standard deviation of the log returns
+struct PathStatistics {
+  Real mean, min, max, returnStandardDeviation;
+};
+
+bool sameStatistics(const PathStatistics& x, const PathStatistics& y) {
+  const Real tolerance = 1e-9;
+  return std::fabs(x.mean - y.mean) <= tolerance * std::fabs(x.mean)
+      && x.min == y.min && x.max == y.max
+      && std::fabs(x.returnStandardDeviation - y.returnStandardDeviation) <= tolerance * x.returnStandardDeviation;
+}
+
+// the statistics above for many paths: materialized, transformed and added up as in
+// testGeometricBrownieMotion, against streamed step by step through a PathSummary;
+// both must agree on every path
+void benchmarkStreamingPaths() {
+  typedef std::chrono::steady_clock Clock;
+  typedef BoxMullerGaussianRng<MersenneTwisterUniformRng> MersenneBoxMuller;
+  typedef RandomSequenceGenerator<MersenneBoxMuller> Generator;
+  Size timeSteps = 255 * 10, paths = 2000;
+  Time length = 1;
+  const boost::shared_ptr<StochasticProcess>& gbm =
+    boost::shared_ptr<StochasticProcess>(new GeometricBrownianMotionProcess(20.16, .2312, .2116));
+
+  // the same seed, so both see the same paths
+  Generator materializedSequences(timeSteps, MersenneBoxMuller(MersenneTwisterUniformRng(42)));
+  Generator streamedSequences(timeSteps, MersenneBoxMuller(MersenneTwisterUniformRng(42)));
+  PathGenerator<Generator> pathGenerator(gbm, length, timeSteps, materializedSequences, false);
+  StreamingPathGenerator<Generator> streamingGenerator(gbm, length, timeSteps, streamedSequences);
+
+  // across paths: the returns' standard deviation and the highest price of each path
+  qltutor::MomentAccumulator materializedDeviations, materializedMaxima, streamedDeviations, streamedMaxima;
+  boost::function<Real (Real, Real)> calcLogReturns = [](Real x, Real y) {return std::log(y/x);};
+  std::vector<PathStatistics> materializedPaths(paths), streamedPaths(paths);
+
+  qltutor::AllocationCounts before = qltutor::threadAllocations();
+  Clock::time_point start = Clock::now();
+  for (Size p = 0; p < paths; ++p) {
+    const Path& samplePath = pathGenerator.next().value;
+    std::vector<Real> logReturns;
+    std::transform(samplePath.begin(), std::prev(samplePath.end()), std::next(samplePath.begin()), std::back_inserter(logReturns), calcLogReturns);
+    qltutor::StreamingStatistics statistics;
+    statistics.addSequence(logReturns.begin(), logReturns.end());
+    materializedDeviations.add(statistics.standardDeviation());
+    materializedPaths[p].returnStandardDeviation = statistics.standardDeviation();
+    statistics.reset();
+    statistics.addSequence(samplePath.begin(), samplePath.end());
+    materializedMaxima.add(statistics.max());
+    materializedPaths[p].mean = statistics.mean();
+    materializedPaths[p].min = statistics.min();
+    materializedPaths[p].max = statistics.max();
+  }
+  double materializedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  qltutor::AllocationCounts middle = qltutor::threadAllocations();
+
+  start = Clock::now();
+  PathSummary summary;
+  for (Size p = 0; p < paths; ++p) {
+    streamingGenerator.next(summary);
+    streamedDeviations.add(summary.returnStandardDeviation());
+    streamedMaxima.add(summary.max);
+    PathStatistics streamed = { summary.priceMean(), summary.min, summary.max, summary.returnStandardDeviation() };
+    streamedPaths[p] = streamed;
+  }
+  double streamedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  qltutor::AllocationCounts after = qltutor::threadAllocations();
+
+  Size mismatches = 0;
+  for (Size p = 0; p < paths; ++p) {
+    if (!sameStatistics(materializedPaths[p], streamedPaths[p])) ++mismatches;
+  }
+  BOOST_TEST_EQ(mismatches, 0u);
+
+  // an estimate, not a measurement: bytes moved per path beyond reading the normals,
+  // which both do. PathGenerator copies the normals (read + write), the Path is written
+  // once and read twice, the returns are written, copied about once while the vector
+  // doubles, and read
+  double materializedBytes = sizeof(Real) * (2.0 * timeSteps + 3.0 * (timeSteps + 1) + 4.0 * timeSteps);
+  std::cout << boost::format("%d paths of %d steps, mean return std. dev. %.6f (streamed %.6f), mean maximum %.4f (streamed %.4f)")
+    % paths % timeSteps % materializedDeviations.mean() % streamedDeviations.mean() % materializedMaxima.mean() % streamedMaxima.mean() << std::endl;
+  std::cout << boost::format("%d of %d paths with different statistics") % mismatches % paths << std::endl;
+  std::cout << boost::format("materialized: %8.0f paths/s, %6.1f allocations/path, %8.0f heap bytes/path, %.0f bytes/path estimated path traffic")
+    % (paths / materializedSeconds) % (double(middle.allocations - before.allocations) / paths)
+    % (double(middle.bytes - before.bytes) / paths) % materializedBytes << std::endl;
+  std::cout << boost::format("streamed:     %8.0f paths/s, %6.1f allocations/path, %8.0f heap bytes/path, 0 bytes/path path traffic")
+    % (paths / streamedSeconds) % (double(after.allocations - middle.allocations) / paths)
+    % (double(after.bytes - middle.bytes) / paths) << std::endl;
+}
+
+// the expected highest price of a year's path, run until its standard error is a cent
+// rather than for a fixed number of paths; QLTUTOR_MC_CHECKPOINT names a checkpoint that
+// is kept, so an interrupted run picks up where it stopped
+struct HighestPrice {
+  explicit HighestPrice(std::uint64_t seed)
+    : gbm(new GeometricBrownianMotionProcess(20.16, .2312, .2116)), normals(255, seed) {}
+  Real operator()(std::uint64_t k) {
+    normals.skipTo(k);
+    const std::vector<Real>& z = normals.nextSequence().value;
+    Real price = gbm->x0(), highest = price;
+    for (Size i = 0; i < z.size(); ++i) {
+      price = gbm->evolve(i / 255.0, price, 1 / 255.0, z[i]);
+      highest = std::max(highest, price);
+    }
+    return highest;
+  }
+  boost::shared_ptr<StochasticProcess1D> gbm;
+  qltutor::PhiloxGaussianRsg normals;
+};
+
+void runToTargetError() {
+  const std::uint64_t seed = 42;
+  const char* configured = std::getenv("QLTUTOR_MC_CHECKPOINT");
+  qltutor::McRunOptions options;
+  options.targetStandardError = .01;
+  options.checkpointPath = configured ? configured : str(boost::format("/tmp/qltutor-brownie-%d.ckpt") % getpid());
+  options.checkpointSeconds = 10.0;
+  options.progress = [](const qltutor::McRunResult& run) {
+    std::cout << boost::format("  %9d paths  mean maximum %.4f +- %.4f  %.1f s") % run.samples % run.mean % run.standardError % run.seconds << std::endl;
+  };
+  qltutor::McRunResult run = qltutor::runMonteCarlo(HighestPrice(seed), options, seed);
+  std::cout << boost::format("Mean maximum %.4f +- %.4f from %d paths (%d resumed from %s), %.1f s")
+    % run.mean % run.standardError % run.samples % run.resumedSamples % options.checkpointPath % run.seconds << std::endl;
+  if (!configured) std::remove(options.checkpointPath.c_str());
+}
+
 int main()
 {
   testGeometricBrownieMotion();
-  return 1;
+  benchmarkStreamingPaths();
+  runToTargetError();
+  return boost::report_errors();
 }
 
 
@@ -0,0 +1,105 @@
+#ifndef QLTUTOR_STREAMINGPATH_HPP
+#define QLTUTOR_STREAMINGPATH_HPP
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+
+// PathGenerator without the Path: each step of a one-dimensional process is handed to
+// a functional as soon as it is evolved, so statistics of the path (returns, running
+// extremes, averages) are taken without writing the path out and reading it back.
+//
+// A functional is any class with
+//   void start(Real x0);            // the process' initial value
+//   void operator()(Time t, Real x); // the value at the end of each step
+// and the generator is a template on it, so its state stays in registers across the
+// step loop. The steps are the ones PathGenerator takes (process->evolve on the same
+// time grid, no Brownian bridge), so with the same sequence generator both see the
+// same values.
+
+template <class GSG>
+class StreamingPathGenerator {
+  public:
+    typedef typename GSG::sample_type sequence_type;
+
+    StreamingPathGenerator(const boost::shared_ptr<QuantLib::StochasticProcess>& process, QuantLib::Time length,
+                           QuantLib::Size timeSteps, const GSG& generator)
+      : process_(boost::dynamic_pointer_cast<QuantLib::StochasticProcess1D>(process)), generator_(generator)
+      , timeGrid_(length, timeSteps), last_(0) {
+      QL_REQUIRE(process_, "a one-dimensional process is required");
+      QL_REQUIRE(generator_.dimension() == timeSteps,
+                 "sequence generator dimensionality (" << generator_.dimension() << ") != timeSteps (" << timeSteps << ")");
+    }
+
+    // one path into the functional; returns the path's weight
+    template <class Functional>
+    QuantLib::Real next(Functional& functional) {
+      last_ = &generator_.nextSequence();
+      return evolve(functional, 1.0);
+    }
+
+    // the antithetic of the last path
+    template <class Functional>
+    QuantLib::Real antithetic(Functional& functional) {
+      QL_REQUIRE(last_, "no path to take the antithetic of");
+      return evolve(functional, -1.0);
+    }
+
+    const QuantLib::TimeGrid& timeGrid() const { return timeGrid_; }
+
+  private:
+    template <class Functional>
+    QuantLib::Real evolve(Functional& functional, QuantLib::Real sign) {
+      const std::vector<QuantLib::Real>& dw = last_->value;
+      QuantLib::Real x = process_->x0();
+      functional.start(x);
+      for (QuantLib::Size i = 1; i < timeGrid_.size(); ++i) {
+        x = process_->evolve(timeGrid_[i - 1], x, timeGrid_.dt(i - 1), sign * dw[i - 1]);
+        functional(timeGrid_[i], x);
+      }
+      return last_->weight;
+    }
+
+    boost::shared_ptr<QuantLib::StochasticProcess1D> process_;
+    GSG generator_;
+    QuantLib::TimeGrid timeGrid_;
+    const sequence_type* last_;
+};
+
+// what 17brownie computes from a materialized path: the log returns' mean and standard
+// deviation, and the mean, min and max of the prices (the initial one included).
+// Daily log returns are small, so plain sums of them and their squares lose nothing.
+struct PathSummary {
+  void start(QuantLib::Real x0) {
+    previous = x0;
+    returns = 0;
+    returnSum = returnSquares = 0.0;
+    priceSum = min = max = x0;
+  }
+
+  void operator()(QuantLib::Time, QuantLib::Real x) {
+    QuantLib::Real r = std::log(x / previous);
+    previous = x;
+    ++returns;
+    returnSum += r;
+    returnSquares += r * r;
+    priceSum += x;
+    min = std::min(min, x);
+    max = std::max(max, x);
+  }
+
+  QuantLib::Real returnMean() const { return returnSum / returns; }
+  // unbiased, as GeneralStatistics::standardDeviation
+  QuantLib::Real returnStandardDeviation() const {
+    return std::sqrt(std::max(0.0, (returnSquares - returnSum * returnMean()) / (returns - 1)));
+  }
+  QuantLib::Real priceMean() const { return priceSum / (returns + 1); }
+
+  QuantLib::Real previous;
+  QuantLib::Size returns;
+  QuantLib::Real returnSum, returnSquares, priceSum, min, max;
+};
+
+#endif
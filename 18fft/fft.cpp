@@ -0,0 +1,176 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE FFT
+#include <boost/test/unit_test.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/math/distributions.hpp>
+#include <boost/function.hpp>
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <functional>
+#include <numeric>
+#include <chrono>
+#include <stdexcept>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "cfpricer.hpp"
+
+// Price a whole strike ladder from the characteristic function of ln(S_T/S_0)
+// instead of one numerical integral per strike as in 12opt.
+
+namespace {
+
+using namespace QuantLib;
+
+Real expectedValueCallPayoff(Real spot, Real strike, Rate r, Volatility sigma, Time t, Real x) {
+  Real mean = log(spot) + (r - 0.5 * sigma * sigma) * t;
+  Real stdDev = sigma * sqrt(t);
+  boost::math::lognormal d(mean, stdDev);
+  return PlainVanillaPayoff(Option::Type::Call, strike)(x) * boost::math::pdf(d, x);
+}
+
+std::vector<Real> strikeLadder(Real from, Real to, Size n) {
+  std::vector<Real> strikes(n);
+  for (Size i = 0; i < n; ++i) {
+    strikes[i] = from + (to - from) * i / (n - 1);
+  }
+  return strikes;
+}
+
+double elapsedMicroseconds(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+BOOST_AUTO_TEST_CASE(testStrikeStripAgainstBlackScholes) {
+  Real spot = 100.0;
+  Rate r = 0.03;
+  Rate q = 0.0;
+  Volatility sigma = .20;
+  std::vector<Real> strikes = strikeLadder(60.0, 160.0, 401);
+
+  qltutor::BlackScholesCharFunction bsCharFunction(r, q, sigma);
+  qltutor::CarrMadanPricer<qltutor::BlackScholesCharFunction> carrMadan(bsCharFunction);
+  qltutor::CosPricer<qltutor::BlackScholesCharFunction> cos(bsCharFunction);
+
+  Time expiries[] = { 1.0/12, .25, .5, 1.0, 2.0 };
+  for (Time t : expiries) {
+    DiscountFactor discount = std::exp(-r * t);
+    DiscountFactor growth = std::exp(-q * t);
+
+    std::vector<Real> fftPrices = carrMadan.callPrices(spot, discount, t, strikes);
+    std::vector<Real> cosPrices = cos.callPrices(spot, discount, t, strikes);
+
+    Real maxFftError = 0.0, maxCosError = 0.0;
+    for (Size i = 0; i < strikes.size(); ++i) {
+      BlackScholesCalculator bsCalculator(Option::Type::Call, strikes[i], spot, growth, sigma * std::sqrt(t), discount);
+      maxFftError = std::max(maxFftError, std::fabs(fftPrices[i] - bsCalculator.value()));
+      maxCosError = std::max(maxCosError, std::fabs(cosPrices[i] - bsCalculator.value()));
+    }
+
+    std::cout << boost::format("T=%.3f: max |Carr-Madan - BS| = %.2e, max |COS - BS| = %.2e over %d strikes")
+      % t % maxFftError % maxCosError % strikes.size() << std::endl;
+    BOOST_CHECK_SMALL(maxFftError, 5e-3);
+    BOOST_CHECK_SMALL(maxCosError, 1e-6);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testHestonAndVarianceGammaStrikeStrips) {
+  Real spot = 100.0;
+  Rate r = 0.03;
+  Rate q = 0.01;
+
+  // QuantLib's analytic Heston engine is the reference; the strips use its year fraction
+  Date today(26, August, 2013);
+  Settings::instance().evaluationDate() = today;
+  DayCounter dayCounter = Actual365Fixed();
+  Date expiration = today + 183;
+  Time t = dayCounter.yearFraction(today, expiration);
+  DiscountFactor discount = std::exp(-r * t);
+  std::vector<Real> strikes = strikeLadder(80.0, 120.0, 9);
+
+  qltutor::HestonCharFunction heston(r, q, .04, 1.5, .04, .5, -.7);
+  std::vector<Real> hestonFft = qltutor::CarrMadanPricer<qltutor::HestonCharFunction>(heston).callPrices(spot, discount, t, strikes);
+  std::vector<Real> hestonCos = qltutor::CosPricer<qltutor::HestonCharFunction>(heston).callPrices(spot, discount, t, strikes);
+
+  qltutor::VarianceGammaCharFunction vg(r, q, .12, .2, -.14);
+  std::vector<Real> vgFft = qltutor::CarrMadanPricer<qltutor::VarianceGammaCharFunction>(vg).callPrices(spot, discount, t, strikes);
+  std::vector<Real> vgCos = qltutor::CosPricer<qltutor::VarianceGammaCharFunction>(vg).callPrices(spot, discount, t, strikes);
+
+  Handle<Quote> spotH(boost::shared_ptr<Quote>(new SimpleQuote(spot)));
+  Handle<YieldTermStructure> riskFreeTS(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, r, dayCounter)));
+  Handle<YieldTermStructure> dividendTS(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, q, dayCounter)));
+  boost::shared_ptr<HestonProcess> hestonProcess(new HestonProcess(riskFreeTS, dividendTS, spotH, .04, 1.5, .04, .5, -.7));
+  boost::shared_ptr<PricingEngine> hestonEngine(new AnalyticHestonEngine(boost::shared_ptr<HestonModel>(new HestonModel(hestonProcess))));
+  boost::shared_ptr<Exercise> europeanExercise(new EuropeanExercise(expiration));
+
+  std::cout << "Strike  Heston(FFT)  Heston(COS)  Heston(QL)  VG(FFT)  VG(COS)" << std::endl;
+  for (Size i = 0; i < strikes.size(); ++i) {
+    VanillaOption option(boost::shared_ptr<StrikedTypePayoff>(new PlainVanillaPayoff(Option::Call, strikes[i])), europeanExercise);
+    option.setPricingEngine(hestonEngine);
+    std::cout << boost::format("%6.1f  %11.4f  %11.4f  %10.4f  %7.4f  %7.4f")
+      % strikes[i] % hestonFft[i] % hestonCos[i] % option.NPV() % vgFft[i] % vgCos[i] << std::endl;
+    // the FFT interpolates linearly between grid strikes, worst out of the money
+    BOOST_CHECK_CLOSE(hestonFft[i], option.NPV(), .5);
+    BOOST_CHECK_CLOSE(hestonCos[i], option.NPV(), 1e-3);
+    BOOST_CHECK_CLOSE(vgFft[i], vgCos[i], .5);
+  }
+
+  // strikes beyond the FFT grid are refused, not priced at its edge
+  BOOST_CHECK_THROW(qltutor::CarrMadanPricer<qltutor::HestonCharFunction>(heston).callPrices(spot, discount, t,
+                                                                                            std::vector<Real>(1, 1e-4)),
+                    std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(testStrikeStripBenchmark) {
+  Real spot = 100.0;
+  Rate r = 0.03;
+  Time t = 0.5;
+  Volatility vol = 0.20;
+  DiscountFactor discount = std::exp(-r * t);
+  std::vector<Real> strikes = strikeLadder(70.0, 140.0, 200);
+
+  // one Simpson integral per strike, as in 12opt
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<Real> quadraturePrices;
+  for (Real strike : strikes) {
+    boost::function< Real(Real) > ptrToExpectedValueCallPayoff =
+      boost::bind(&expectedValueCallPayoff, spot, strike, r, vol, t, _1);
+    SimpsonIntegral numInt(.00001, 1000);
+    quadraturePrices.push_back(numInt(ptrToExpectedValueCallPayoff, strike, strike * 10.0) * discount);
+  }
+  double quadratureTime = elapsedMicroseconds(start);
+
+  qltutor::BlackScholesCharFunction bsCharFunction(r, 0.0, vol);
+  Size repetitions = 100;
+
+  start = std::chrono::steady_clock::now();
+  std::vector<Real> fftPrices;
+  for (Size i = 0; i < repetitions; ++i) {
+    fftPrices = qltutor::CarrMadanPricer<qltutor::BlackScholesCharFunction>(bsCharFunction).callPrices(spot, discount, t, strikes);
+  }
+  double fftTime = elapsedMicroseconds(start) / repetitions;
+
+  start = std::chrono::steady_clock::now();
+  std::vector<Real> cosPrices;
+  for (Size i = 0; i < repetitions; ++i) {
+    cosPrices = qltutor::CosPricer<qltutor::BlackScholesCharFunction>(bsCharFunction).callPrices(spot, discount, t, strikes);
+  }
+  double cosTime = elapsedMicroseconds(start) / repetitions;
+
+  Real maxDifference = 0.0;
+  for (Size i = 0; i < strikes.size(); ++i) {
+    maxDifference = std::max(maxDifference, std::fabs(cosPrices[i] - quadraturePrices[i]));
+  }
+
+  std::cout << boost::format("%d strikes: Simpson per strike %.0f us, Carr-Madan FFT %.0f us, COS %.0f us")
+    % strikes.size() % quadratureTime % fftTime % cosTime << std::endl;
+  std::cout << boost::format("max |COS - Simpson| = %.2e") % maxDifference << std::endl;
+  BOOST_CHECK_SMALL(maxDifference, 1e-5);
+}
+
+}
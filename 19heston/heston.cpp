@@ -0,0 +1,313 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE HESTON
+#include <boost/test/unit_test.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <functional>
+#include <chrono>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "hestonpricer.hpp"
+#include "strikeinfo.hpp"
+
+// Calibrate Heston (v0, kappa, theta, xi, rho) to the ES option chain of 14impvol.
+// Residuals and their analytic Jacobian come from qltutor::HestonChainObjective,
+// which prices the strikes across threads; QuantLib's Levenberg-Marquardt is told
+// to use the cost function's Jacobian instead of finite differences.
+
+namespace {
+
+using namespace QuantLib;
+
+using qltutor::StrikeInfo;
+
+// all listed strikes of one expiry
+struct ExpiryChain {
+  Time timeToMaturity;
+  Real forward;
+  DiscountFactor discount;
+  std::vector<StrikeInfo> options;
+};
+
+// Heston parameters must stay inside the admissible region
+class HestonParametersConstraint : public Constraint {
+  private:
+    class Impl : public Constraint::Impl {
+      public:
+        bool test(const Array& x) const {
+          return x[0] > 0.0 && x[1] > 0.0 && x[2] > 0.0 && x[3] > 0.0
+              && x[4] > -1.0 && x[4] < 1.0;
+        }
+    };
+  public:
+    HestonParametersConstraint()
+      : Constraint(boost::shared_ptr<Constraint::Impl>(new HestonParametersConstraint::Impl)) {}
+};
+
+qltutor::HestonParameters toHestonParameters(const Array& x) {
+  return qltutor::HestonParameters(x[0], x[1], x[2], x[3], x[4]);
+}
+
+class HestonCalibrationFunction : public CostFunction {
+  public:
+    HestonCalibrationFunction(const qltutor::HestonChainObjective& objective)
+      : objective_(objective), evaluations_(0) {}
+
+    Real value(const Array& x) const {
+      Array residuals = values(x);
+      return DotProduct(residuals, residuals);
+    }
+
+    Disposable<Array> values(const Array& x) const {
+      Array residuals(objective_.size());
+      objective_.evaluate(toHestonParameters(x), residuals.begin(), 0);
+      ++evaluations_;
+      return residuals;
+    }
+
+    void jacobian(Matrix& jac, const Array& x) const {
+      Array residuals(objective_.size());
+      jac = Matrix(objective_.size(), qltutor::HestonParameters::Size);
+      objective_.evaluate(toHestonParameters(x), residuals.begin(), jac.begin());
+      ++evaluations_;
+    }
+
+    Disposable<Array> valuesAndJacobian(Matrix& jac, const Array& x) const {
+      Array residuals(objective_.size());
+      jac = Matrix(objective_.size(), qltutor::HestonParameters::Size);
+      objective_.evaluate(toHestonParameters(x), residuals.begin(), jac.begin());
+      ++evaluations_;
+      return residuals;
+    }
+
+    // chain evaluations, with or without the Jacobian: LevenbergMarquardt calls
+    // jacobian() directly, so Problem's counters miss those
+    Size evaluations() const { return evaluations_; }
+
+  private:
+    const qltutor::HestonChainObjective& objective_;
+    mutable Size evaluations_;
+};
+
+// keeps the last solution so that the next snapshot of the chain starts from it
+class HestonCalibrator {
+  public:
+    HestonCalibrator(Size threads = qltutor::defaultThreadCount())
+      : threads_(threads), parameters_(5), wallTime_(0.0), evaluations_(0), residualNorm_(0.0) {
+      qltutor::HestonParameters initial;
+      for (Size i = 0; i < 5; ++i) parameters_[i] = initial[i];
+    }
+
+    EndCriteria::Type calibrate(const std::vector<ExpiryChain>& chains) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      std::vector<qltutor::HestonExpiry> expiries;
+      std::vector<qltutor::HestonQuote> quotes;
+      for (Size e = 0; e < chains.size(); ++e) {
+        const ExpiryChain& chain = chains[e];
+        qltutor::HestonExpiry expiry = { chain.timeToMaturity, chain.forward, chain.discount };
+        expiries.push_back(expiry);
+        for (const StrikeInfo& option : chain.options) {
+          const StrikedTypePayoff& payoff = option.getPayoff();
+          if (payoff(chain.forward) > 0) { continue; } // OTM options only
+          const StrikeInfo::BidAsk& bidAsk = option.getBidAsk();
+          Real spread = std::max(bidAsk.second.value() - bidAsk.first.value(), .05);
+          qltutor::HestonQuote quote = { e
+                                       , payoff.strike()
+                                       , payoff.optionType() == Option::Call
+                                       , (bidAsk.first.value() + bidAsk.second.value()) / 2.0
+                                       , 1.0 / spread };
+          quotes.push_back(quote);
+        }
+      }
+
+      qltutor::HestonChainObjective objective(expiries, quotes, threads_, qltutor::HestonFourierPricer(128));
+      HestonCalibrationFunction costFunction(objective);
+      HestonParametersConstraint constraint;
+      Problem problem(costFunction, constraint, parameters_);
+
+      EndCriteria endCriteria(1000, 100, 1e-10, 1e-10, 1e-10);
+      LevenbergMarquardt solver(1e-8, 1e-10, 1e-10, true);
+      EndCriteria::Type solution = solver.minimize(problem, endCriteria);
+
+      parameters_ = problem.currentValue();
+      evaluations_ = costFunction.evaluations();
+      residualNorm_ = std::sqrt(problem.functionValue() / std::max<Size>(quotes.size(), 1));
+      wallTime_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      return solution;
+    }
+
+    qltutor::HestonParameters parameters() const { return toHestonParameters(parameters_); }
+    double wallTimeMilliseconds() const { return wallTime_; }
+    Size evaluations() const { return evaluations_; }
+    Real residualNorm() const { return residualNorm_; }
+
+  private:
+    Size threads_;
+    Array parameters_;
+    double wallTime_;
+    Size evaluations_;
+    Real residualNorm_;
+};
+
+void printCalibration(const std::string& label, const HestonCalibrator& calibrator, EndCriteria::Type solution) {
+  qltutor::HestonParameters p = calibrator.parameters();
+  std::cout << boost::format("%s: v0=%.4f kappa=%.4f theta=%.4f xi=%.4f rho=%.4f (%s)")
+    % label % p.v0 % p.kappa % p.theta % p.xi % p.rho % solution << std::endl;
+  std::cout << boost::format("  weighted rms residual %.4f, %d evaluations, wall time %.2f ms")
+    % calibrator.residualNorm() % calibrator.evaluations() % calibrator.wallTimeMilliseconds() << std::endl;
+}
+
+ExpiryChain esSeptemberChain(Real forwardShift) {
+  using namespace boost::posix_time;
+
+  ActualActual actualActual;
+  Settings::instance().evaluationDate() = Date(26, Month::August, 2013);
+  Date expiration(20, Month::September, 2013);
+
+  Time timeToMaturity = actualActual.yearFraction(Settings::instance().evaluationDate(), expiration);
+  ptime quoteTime(from_iso_string("20130826T143000"));
+  time_duration timeOfDayDuration = quoteTime.time_of_day();
+  timeToMaturity += (timeOfDayDuration.hours() + timeOfDayDuration.minutes()/60.0)/(24.0 * 365.0);
+
+  Rate riskFree = .00273;
+  ExpiryChain chain;
+  chain.timeToMaturity = timeToMaturity;
+  chain.forward = (1656.00 + 1656.25) / 2.0 + forwardShift;
+  chain.discount = std::exp(-riskFree * timeToMaturity);
+
+  // a forward move shifts every quote by roughly its delta
+  Real putShift = -.4 * forwardShift, callShift = .6 * forwardShift;
+  std::vector<StrikeInfo>& o = chain.options;
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(7.75 + putShift, 8.00 + putShift), 1600));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(8.50 + putShift, 9.00 + putShift), 1605));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(9.25 + putShift, 9.75 + putShift), 1610));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(10.25 + putShift, 10.75 + putShift), 1615));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(11.25 + putShift, 11.75 + putShift), 1620));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(12.50 + putShift, 12.75 + putShift), 1625));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(13.75 + putShift, 14.00 + putShift), 1630));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(15.00 + putShift, 15.50 + putShift), 1635));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(16.50 + putShift, 17.00 + putShift), 1640));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(18.00 + putShift, 18.50 + putShift), 1645));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(20.00 + putShift, 20.25 + putShift), 1650));
+  o.push_back(StrikeInfo(Option::Type::Put, std::make_pair(21.75 + putShift, 22.25 + putShift), 1655));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(23.00 + callShift, 23.50 + callShift), 1655));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(20.00 + callShift, 20.50 + callShift), 1660));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(17.25 + callShift, 17.75 + callShift), 1665));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(14.75 + callShift, 15.25 + callShift), 1670));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(12.50 + callShift, 13.00 + callShift), 1675));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(10.50 + callShift, 11.00 + callShift), 1680));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(8.75 + callShift, 9.25 + callShift), 1685));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(7.00 + callShift, 7.50 + callShift), 1690));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(5.75 + callShift, 6.00 + callShift), 1695));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(4.70 + callShift, 4.80 + callShift), 1700));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(3.70 + callShift, 3.85 + callShift), 1705));
+  o.push_back(StrikeInfo(Option::Type::Call, std::make_pair(2.90 + callShift, 3.05 + callShift), 1710));
+  return chain;
+}
+
+BOOST_AUTO_TEST_CASE(testAnalyticGradient) {
+  qltutor::HestonParameters p(.04, 1.5, .04, .5, -.7);
+  qltutor::HestonFourierPricer pricer;
+  qltutor::HestonFourierPricer::Slice slice;
+  Time t = .5;
+  Real forward = 1656.0, discount = .999, strike = 1700.0;
+
+  pricer.prepare(p, t, slice);
+  Real gradient[5];
+  Real price = pricer.callPrice(slice, forward, discount, strike, gradient);
+
+  const char* names[] = { "v0", "kappa", "theta", "xi", "rho" };
+  Real h = 1e-6;
+  for (Size i = 0; i < 5; ++i) {
+    Real bumped[5] = { p.v0, p.kappa, p.theta, p.xi, p.rho };
+    bumped[i] += h;
+    qltutor::HestonFourierPricer::Slice bumpedSlice;
+    pricer.prepare(qltutor::HestonParameters(bumped[0], bumped[1], bumped[2], bumped[3], bumped[4]), t, bumpedSlice);
+    Real finiteDifference = (pricer.callPrice(bumpedSlice, forward, discount, strike) - price) / h;
+    std::cout << boost::format("dC/d%-5s analytic %10.4f finite difference %10.4f")
+      % names[i] % gradient[i] % finiteDifference << std::endl;
+    BOOST_CHECK_CLOSE(gradient[i], finiteDifference, 1e-2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testESChainCalibrationWarmStart) {
+  std::vector<ExpiryChain> snapshot(1, esSeptemberChain(0.0));
+
+  HestonCalibrator calibrator;
+  EndCriteria::Type solution = calibrator.calibrate(snapshot);
+  printCalibration("ES Sep13 cold start", calibrator, solution);
+
+  // the next snapshot, after a two point move in the future
+  std::vector<ExpiryChain> nextSnapshot(1, esSeptemberChain(2.0));
+  solution = calibrator.calibrate(nextSnapshot);
+  printCalibration("ES Sep13 warm start", calibrator, solution);
+
+  HestonCalibrator coldCalibrator;
+  EndCriteria::Type coldSolution = coldCalibrator.calibrate(nextSnapshot);
+  printCalibration("ES Sep13 cold start (same snapshot)", coldCalibrator, coldSolution);
+
+  // starting next to the answer is the point of keeping the last solution
+  BOOST_CHECK(solution != EndCriteria::MaxIterations && coldSolution != EndCriteria::MaxIterations);
+  BOOST_CHECK_LT(calibrator.evaluations(), coldCalibrator.evaluations());
+  BOOST_CHECK_CLOSE(calibrator.residualNorm(), coldCalibrator.residualNorm(), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(testMultiExpiryCalibrationWallTime) {
+  // synthetic chain for every listed expiry from known parameters
+  qltutor::HestonParameters truth(.025, 2.0, .035, .6, -.75);
+  qltutor::HestonFourierPricer pricer(128);
+  Real forward = 1656.0;
+  Rate riskFree = .00273;
+  Time expiries[] = { 25.0/365, 53.0/365, 116.0/365, 207.0/365, 298.0/365, 389.0/365 };
+
+  std::vector<ExpiryChain> chains;
+  for (Time t : expiries) {
+    ExpiryChain chain;
+    chain.timeToMaturity = t;
+    chain.forward = forward;
+    chain.discount = std::exp(-riskFree * t);
+    qltutor::HestonFourierPricer::Slice slice;
+    pricer.prepare(truth, t, slice);
+    for (Real strike = 1400.0; strike <= 1900.0; strike += 5.0) {
+      Real call = pricer.callPrice(slice, forward, chain.discount, strike);
+      Option::Type type = strike < forward ? Option::Put : Option::Call;
+      Real price = type == Option::Call ? call : call - chain.discount * (forward - strike);
+      chain.options.push_back(StrikeInfo(type, std::make_pair(price - .05, price + .05), strike));
+    }
+    chains.push_back(chain);
+  }
+
+  std::cout << boost::format("true parameters: v0=%.4f kappa=%.4f theta=%.4f xi=%.4f rho=%.4f")
+    % truth.v0 % truth.kappa % truth.theta % truth.xi % truth.rho << std::endl;
+  Size threadCounts[] = { 1, qltutor::defaultThreadCount() };
+  std::vector<qltutor::HestonParameters> recovered;
+  for (Size threads : threadCounts) {
+    HestonCalibrator calibrator(threads);
+    EndCriteria::Type solution = calibrator.calibrate(chains);
+    printCalibration(str(boost::format("%d expiries x %d strikes, %d threads")
+      % chains.size() % chains[0].options.size() % threads), calibrator, solution);
+    // the quotes are model prices, so the calibration must find the model again
+    qltutor::HestonParameters p = calibrator.parameters();
+    BOOST_CHECK_CLOSE(p.v0, truth.v0, 1.0);
+    BOOST_CHECK_CLOSE(p.kappa, truth.kappa, 1.0);
+    BOOST_CHECK_CLOSE(p.theta, truth.theta, 1.0);
+    BOOST_CHECK_CLOSE(p.xi, truth.xi, 1.0);
+    BOOST_CHECK_CLOSE(p.rho, truth.rho, 1.0);
+    recovered.push_back(p);
+  }
+  // each quote is priced the same way whatever the thread count
+  for (Size i = 0; i < qltutor::HestonParameters::Size; ++i) {
+    BOOST_CHECK_EQUAL(recovered[0][i], recovered[1][i]);
+  }
+}
+
+}
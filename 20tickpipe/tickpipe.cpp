@@ -0,0 +1,522 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE TICKPIPE
+#include <boost/test/unit_test.hpp>
+#include <boost/detail/lightweight_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cstdio>
+
+#include <unistd.h>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "spscring.hpp"
+
+// Streaming version of 14impvol -> 15volsurf -> 13greeks in one process:
+//
+//   replay source --ring--> implied vol --ring--> surface --ring--> greeks --ring--> sink
+//
+// Every stage is one thread and every hop a single-producer/single-consumer ring.
+// Quotes that did not change are dropped at the implied vol stage, a new vol only
+// patches its own node of the smile, and only the book positions whose interpolation
+// stencil touches that node get their Greeks recomputed.
+
+namespace {
+
+using namespace QuantLib;
+
+typedef long long Nanos;
+
+Nanos nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// F: future (forward) quote, P/C: option quote on strike node strikeIndex
+struct QuoteTick {
+  Nanos ingested;
+  Size expiry, strikeIndex;
+  char kind;
+  Real bid, ask;
+  bool last;
+};
+
+// the strikeIndex of a VolTick or SurfacePatch that only moves the forward, and the
+// position of a GreeksUpdate that only carries a tick's final marker
+const Size noIndex = Size(-1);
+
+// one smile node changed; final marks the last update caused by a tick
+struct VolTick {
+  Nanos ingested;
+  Size expiry, strikeIndex;
+  Volatility vol;
+  Real forward;
+  bool final, last;
+};
+
+// node update plus the range of book positions it invalidates
+struct SurfacePatch {
+  Nanos ingested;
+  Size expiry, strikeIndex, firstPosition, lastPosition;
+  Volatility vol;
+  Real forward;
+  bool final, last;
+};
+
+struct GreeksUpdate {
+  Nanos ingested;
+  Size expiry, position;
+  Real value, delta, gamma, vega;
+  bool final, last;
+};
+
+struct ExpiryDefinition {
+  Time timeToMaturity;
+  DiscountFactor discount;
+  std::vector<Real> strikes;
+};
+
+// changed: ticks that sent an update downstream, each ending in one final marker
+struct PipelineCounters {
+  Size ticks, unchanged, changed, ivSolves, ivFailures, patches, greeks;
+  PipelineCounters() : ticks(0), unchanged(0), changed(0), ivSolves(0), ivFailures(0), patches(0), greeks(0) {}
+};
+
+bool solveImpliedVol( const ExpiryDefinition& expiry, char kind, Real strike, Real forward, Real price
+                    , Volatility& sigma) {
+  Option::Type type = kind == 'P' ? Option::Put : Option::Call;
+  try {
+    Bisection bisection;
+    sigma = bisection.solve([&](const Volatility& s) {
+        BlackCalculator blackCalculator(type, strike, forward, s * std::sqrt(expiry.timeToMaturity), expiry.discount);
+        return blackCalculator.value() - price;
+      }, 1e-6, .20, .01, 1.0);
+    return true;
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
+// book position p sits between smile nodes p / 2 and (p + 1) / 2, at the mean strike and vol
+bool priceBookPosition( const ExpiryDefinition& expiry, const std::vector<Volatility>& vols, Real forward
+                      , Size position, GreeksUpdate& update) {
+  Size lo = position / 2, hi = (position + 1) / 2;
+  if (vols[lo] <= 0.0 || vols[hi] <= 0.0) return false;
+  Real strike = (expiry.strikes[lo] + expiry.strikes[hi]) / 2.0;
+  Volatility vol = (vols[lo] + vols[hi]) / 2.0;
+  Option::Type type = strike < forward ? Option::Put : Option::Call;
+  BlackCalculator black(type, strike, forward, vol * std::sqrt(expiry.timeToMaturity), expiry.discount);
+  update.position = position;
+  update.value = black.value();
+  update.delta = black.deltaForward();
+  update.gamma = black.gammaForward();
+  update.vega = black.vega(expiry.timeToMaturity);
+  return true;
+}
+
+// one line of a recorded quote file; false for a malformed line
+bool parseQuoteLine(const std::string& line, double& offsetMicros, QuoteTick& tick) {
+  std::istringstream fields(line);
+  std::string field;
+  std::vector<std::string> values;
+  while (std::getline(fields, field, ',')) values.push_back(field);
+  if (values.size() != 6) return false;
+  offsetMicros = std::atof(values[0].c_str());
+  QuoteTick parsed = { 0
+                     , Size(std::atoi(values[1].c_str()))
+                     , Size(std::atoi(values[3].c_str()))
+                     , values[2][0]
+                     , std::atof(values[4].c_str())
+                     , std::atof(values[5].c_str())
+                     , false };
+  tick = parsed;
+  return true;
+}
+
+// recorded quote file: one "offset_us,expiry,kind,strikeIndex,bid,ask" line per tick
+void recordQuoteFile( const std::string& fileName
+                    , const ExpiryDefinition& expiry
+                    , Real forward
+                    , Size ticks) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> strikeDist(0, int(expiry.strikes.size()) - 1);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  Volatility smileAtm = .13;
+
+  std::ofstream file(fileName.c_str());
+  Real f = forward;
+  for (Size i = 0; i < ticks; ++i) {
+    Size offset = i * 20;
+    if (uniform(rng) < .01) {
+      f += uniform(rng) < .5 ? -.25 : .25;
+      file << boost::format("%d,0,F,0,%.2f,%.2f") % offset % (f - .125) % (f + .125) << std::endl;
+      continue;
+    }
+    Size k = strikeDist(rng);
+    Real strike = expiry.strikes[k];
+    Option::Type type = strike < f ? Option::Put : Option::Call;
+    Volatility vol = smileAtm - .25 * std::log(strike / f) + .01 * (uniform(rng) - .5);
+    BlackCalculator black(type, strike, f, vol * std::sqrt(expiry.timeToMaturity), expiry.discount);
+    // quotes on a quarter point grid, so many ticks repeat the previous quote
+    Real mid = std::floor(black.value() * 4.0 + .5) / 4.0;
+    file << boost::format("%d,0,%s,%d,%.2f,%.2f")
+      % offset % (type == Option::Put ? "P" : "C") % k % std::max(mid - .125, .05) % (mid + .125) << std::endl;
+  }
+}
+
+// replays a recorded file into the first ring, honouring the recorded offsets
+void replaySource(const std::string& fileName, qltutor::SpscRing<QuoteTick>& out, double speed) {
+  std::ifstream file(fileName.c_str());
+  std::string line;
+  Nanos start = nowNanos();
+  while (std::getline(file, line)) {
+    double offset;
+    QuoteTick tick;
+    if (!parseQuoteLine(line, offset, tick)) continue;
+
+    Nanos due = start + Nanos(offset * 1000.0 / speed);
+    while (nowNanos() < due) std::this_thread::yield();
+
+    tick.ingested = nowNanos();
+    out.push(tick);
+  }
+  QuoteTick end = { nowNanos(), 0, 0, 'F', 0.0, 0.0, true };
+  out.push(end);
+}
+
+// keeps the last quote per node and solves implied vols only for quotes that changed
+// (or for every node of an expiry when its forward moved)
+void impliedVolStage( const std::vector<ExpiryDefinition>& expiries
+                    , const std::vector<Real>& initialForwards
+                    , qltutor::SpscRing<QuoteTick>& in
+                    , qltutor::SpscRing<VolTick>& out
+                    , PipelineCounters& counters) {
+  std::vector<Real> forwards(initialForwards);
+  // last mid per expiry and strike node, -1 means never quoted
+  std::vector<std::vector<Real> > mids(expiries.size());
+  std::vector<std::vector<char> > kinds(expiries.size());
+  for (Size e = 0; e < expiries.size(); ++e) {
+    mids[e].assign(expiries[e].strikes.size(), -1.0);
+    kinds[e].assign(expiries[e].strikes.size(), 'C');
+  }
+
+  auto solve = [&](Size e, Size k, Volatility& sigma) {
+    bool solved = solveImpliedVol(expiries[e], kinds[e][k], expiries[e].strikes[k], forwards[e], mids[e][k], sigma);
+    ++(solved ? counters.ivSolves : counters.ivFailures);
+    return solved;
+  };
+
+  QuoteTick tick;
+  std::vector<VolTick> updates;
+  for (;;) {
+    in.pop(tick);
+    if (tick.last) break;
+    ++counters.ticks;
+
+    if (tick.kind == 'F') {
+      Real forward = (tick.bid + tick.ask) / 2.0;
+      if (forward == forwards[tick.expiry]) { ++counters.unchanged; continue; }
+      forwards[tick.expiry] = forward;
+      // every quoted node of this expiry depends on the forward
+      updates.clear();
+      for (Size k = 0; k < mids[tick.expiry].size(); ++k) {
+        Volatility sigma;
+        if (mids[tick.expiry][k] > 0.0 && solve(tick.expiry, k, sigma)) {
+          VolTick v = { tick.ingested, tick.expiry, k, sigma, forward, false, false };
+          updates.push_back(v);
+        }
+      }
+      // the forward alone still reprices the book when no node could be solved
+      if (updates.empty()) {
+        VolTick v = { tick.ingested, tick.expiry, noIndex, 0.0, forward, false, false };
+        updates.push_back(v);
+      }
+      updates.back().final = true;
+      ++counters.changed;
+      for (const VolTick& v : updates) out.push(v);
+      continue;
+    }
+
+    Real mid = (tick.bid + tick.ask) / 2.0;
+    if (mid == mids[tick.expiry][tick.strikeIndex] && tick.kind == kinds[tick.expiry][tick.strikeIndex]) {
+      ++counters.unchanged;
+      continue;
+    }
+    mids[tick.expiry][tick.strikeIndex] = mid;
+    kinds[tick.expiry][tick.strikeIndex] = tick.kind;
+
+    Volatility sigma;
+    if (solve(tick.expiry, tick.strikeIndex, sigma)) {
+      VolTick v = { tick.ingested, tick.expiry, tick.strikeIndex, sigma, forwards[tick.expiry], true, false };
+      ++counters.changed;
+      out.push(v);
+    }
+  }
+
+  VolTick end = { tick.ingested, 0, 0, 0.0, 0.0, true, true };
+  out.push(end);
+}
+
+// owns the smile grid; a node k is linearly interpolated into book positions
+// 2k-1 .. 2k+1 (nodes sit at even positions, midpoints at odd ones)
+void surfaceStage( const std::vector<ExpiryDefinition>& expiries
+                 , qltutor::SpscRing<VolTick>& in
+                 , qltutor::SpscRing<SurfacePatch>& out
+                 , PipelineCounters& counters) {
+  std::vector<std::vector<Volatility> > smile(expiries.size());
+  for (Size e = 0; e < expiries.size(); ++e) {
+    smile[e].assign(expiries[e].strikes.size(), 0.0);
+  }
+
+  VolTick v;
+  for (;;) {
+    in.pop(v);
+    if (v.last) break;
+    Size positions = 2 * smile[v.expiry].size() - 1;
+    bool node = v.strikeIndex != noIndex;
+    if (node) smile[v.expiry][v.strikeIndex] = v.vol;
+    SurfacePatch patch = { v.ingested
+                         , v.expiry
+                         , v.strikeIndex
+                         , !node || v.strikeIndex == 0 ? 0 : 2 * v.strikeIndex - 1
+                         , node ? std::min(2 * v.strikeIndex + 1, positions - 1) : positions - 1
+                         , v.vol
+                         , v.forward
+                         , v.final
+                         , false };
+    ++counters.patches;
+    out.push(patch);
+  }
+
+  SurfacePatch end = { v.ingested, 0, 0, 0, 0, 0.0, 0.0, true, true };
+  out.push(end);
+}
+
+// keeps a replica of the smile and reprices only the patched book positions, or the
+// whole expiry when its forward moved, since every position is priced off it
+void greeksStage( const std::vector<ExpiryDefinition>& expiries
+                , qltutor::SpscRing<SurfacePatch>& in
+                , qltutor::SpscRing<GreeksUpdate>& out
+                , PipelineCounters& counters) {
+  std::vector<std::vector<Volatility> > smile(expiries.size());
+  std::vector<Real> forwards(expiries.size(), Null<Real>());
+  for (Size e = 0; e < expiries.size(); ++e) {
+    smile[e].assign(expiries[e].strikes.size(), 0.0);
+  }
+
+  SurfacePatch patch;
+  std::vector<GreeksUpdate> updates;
+  for (;;) {
+    in.pop(patch);
+    if (patch.last) break;
+    const ExpiryDefinition& expiry = expiries[patch.expiry];
+    std::vector<Volatility>& vols = smile[patch.expiry];
+    if (patch.strikeIndex != noIndex) vols[patch.strikeIndex] = patch.vol;
+    Size first = patch.firstPosition, last = patch.lastPosition;
+    if (patch.forward != forwards[patch.expiry]) {
+      forwards[patch.expiry] = patch.forward;
+      first = 0;
+      last = 2 * vols.size() - 2;
+    }
+
+    updates.clear();
+    for (Size position = first; position <= last; ++position) {
+      GreeksUpdate update = { patch.ingested, patch.expiry, position, 0.0, 0.0, 0.0, 0.0, false, false };
+      if (priceBookPosition(expiry, vols, patch.forward, position, update)) updates.push_back(update);
+    }
+    counters.greeks += updates.size();
+    // the tick's final marker goes out even when nothing here could be priced
+    if (patch.final && updates.empty()) {
+      GreeksUpdate marker = { patch.ingested, patch.expiry, noIndex, 0.0, 0.0, 0.0, 0.0, false, false };
+      updates.push_back(marker);
+    }
+    if (!updates.empty()) updates.back().final = patch.final;
+    for (const GreeksUpdate& update : updates) out.push(update);
+  }
+
+  GreeksUpdate end = { patch.ingested, 0, 0, 0.0, 0.0, 0.0, 0.0, true, true };
+  out.push(end);
+}
+
+struct PipelineResult {
+  PipelineCounters counters;
+  std::vector<double> latencies; // microseconds, one per tick that reached the sink
+  double seconds;
+  // the last Greeks the sink saw per expiry and book position; noIndex if never priced
+  std::vector<std::vector<GreeksUpdate> > book;
+};
+
+std::vector<std::vector<GreeksUpdate> > emptyBook(const std::vector<ExpiryDefinition>& expiries) {
+  std::vector<std::vector<GreeksUpdate> > book(expiries.size());
+  GreeksUpdate unpriced = { 0, 0, noIndex, 0.0, 0.0, 0.0, 0.0, false, false };
+  for (Size e = 0; e < expiries.size(); ++e) book[e].assign(2 * expiries[e].strikes.size() - 1, unpriced);
+  return book;
+}
+
+// the book from scratch: every tick of the file applied in order, as the implied vol
+// stage does, then every position priced on the final smile and forwards
+std::vector<std::vector<GreeksUpdate> > fullRecompute( const std::string& fileName
+                                                     , const std::vector<ExpiryDefinition>& expiries
+                                                     , const std::vector<Real>& initialForwards) {
+  std::vector<Real> forwards(initialForwards);
+  std::vector<std::vector<Real> > mids(expiries.size());
+  std::vector<std::vector<char> > kinds(expiries.size());
+  std::vector<std::vector<Volatility> > smile(expiries.size());
+  for (Size e = 0; e < expiries.size(); ++e) {
+    mids[e].assign(expiries[e].strikes.size(), -1.0);
+    kinds[e].assign(expiries[e].strikes.size(), 'C');
+    smile[e].assign(expiries[e].strikes.size(), 0.0);
+  }
+  auto solve = [&](Size e, Size k) {
+    Volatility sigma;
+    if (solveImpliedVol(expiries[e], kinds[e][k], expiries[e].strikes[k], forwards[e], mids[e][k], sigma)) smile[e][k] = sigma;
+  };
+
+  std::ifstream file(fileName.c_str());
+  std::string line;
+  while (std::getline(file, line)) {
+    double offset;
+    QuoteTick tick;
+    if (!parseQuoteLine(line, offset, tick)) continue;
+    if (tick.kind == 'F') {
+      Real forward = (tick.bid + tick.ask) / 2.0;
+      if (forward == forwards[tick.expiry]) continue;
+      forwards[tick.expiry] = forward;
+      for (Size k = 0; k < mids[tick.expiry].size(); ++k) {
+        if (mids[tick.expiry][k] > 0.0) solve(tick.expiry, k);
+      }
+      continue;
+    }
+    Real mid = (tick.bid + tick.ask) / 2.0;
+    if (mid == mids[tick.expiry][tick.strikeIndex] && tick.kind == kinds[tick.expiry][tick.strikeIndex]) continue;
+    mids[tick.expiry][tick.strikeIndex] = mid;
+    kinds[tick.expiry][tick.strikeIndex] = tick.kind;
+    solve(tick.expiry, tick.strikeIndex);
+  }
+
+  std::vector<std::vector<GreeksUpdate> > book = emptyBook(expiries);
+  for (Size e = 0; e < expiries.size(); ++e) {
+    for (Size position = 0; position < book[e].size(); ++position) {
+      priceBookPosition(expiries[e], smile[e], forwards[e], position, book[e][position]);
+    }
+  }
+  return book;
+}
+
+PipelineResult runPipeline( const std::string& fileName
+                          , const std::vector<ExpiryDefinition>& expiries
+                          , const std::vector<Real>& forwards
+                          , double speed) {
+  qltutor::SpscRing<QuoteTick> quotes(4096);
+  qltutor::SpscRing<VolTick> vols(4096);
+  qltutor::SpscRing<SurfacePatch> patches(4096);
+  qltutor::SpscRing<GreeksUpdate> greeks(4096);
+
+  PipelineResult result;
+  result.latencies.reserve(1 << 20);
+  result.book = emptyBook(expiries);
+  PipelineCounters ivCounters, surfaceCounters, greeksCounters;
+
+  Nanos start = nowNanos();
+  std::thread source(replaySource, fileName, std::ref(quotes), speed);
+  std::thread ivThread(impliedVolStage, std::cref(expiries), std::cref(forwards), std::ref(quotes), std::ref(vols), std::ref(ivCounters));
+  std::thread surfaceThread(surfaceStage, std::cref(expiries), std::ref(vols), std::ref(patches), std::ref(surfaceCounters));
+  std::thread greeksThread(greeksStage, std::cref(expiries), std::ref(patches), std::ref(greeks), std::ref(greeksCounters));
+
+  // sink: the risk consumer downstream of the Greeks
+  GreeksUpdate update;
+  for (;;) {
+    greeks.pop(update);
+    if (update.last) break;
+    if (update.position != noIndex) result.book[update.expiry][update.position] = update;
+    if (update.final) {
+      result.latencies.push_back((nowNanos() - update.ingested) / 1000.0);
+    }
+  }
+
+  source.join();
+  ivThread.join();
+  surfaceThread.join();
+  greeksThread.join();
+  result.seconds = (nowNanos() - start) / 1e9;
+
+  result.counters = ivCounters;
+  result.counters.patches = surfaceCounters.patches;
+  result.counters.greeks = greeksCounters.greeks;
+  return result;
+}
+
+void printLatencies(const std::string& label, PipelineResult& result) {
+  std::vector<double>& l = result.latencies;
+  std::sort(l.begin(), l.end());
+  auto percentile = [&](double p) {
+    return l.empty() ? 0.0 : l[std::min(l.size() - 1, Size(p * l.size()))];
+  };
+  const PipelineCounters& c = result.counters;
+  std::cout << label << std::endl;
+  std::cout << boost::format("  %d ticks in %.3f s: %d unchanged, %d IV solves (%d failed), %d surface patches, %d Greeks")
+    % c.ticks % result.seconds % c.unchanged % c.ivSolves % c.ivFailures % c.patches % c.greeks << std::endl;
+  std::cout << boost::format("  tick-to-Greeks latency (us): p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f")
+    % percentile(.50) % percentile(.90) % percentile(.99) % percentile(.999)
+    % (l.empty() ? 0.0 : l.back()) << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(testTickPipelineReplay) {
+  // ES Sep13 strikes from 14impvol
+  ExpiryDefinition sep13;
+  sep13.timeToMaturity = 25.6 / 365.0;
+  sep13.discount = std::exp(-.00273 * sep13.timeToMaturity);
+  for (Real strike = 1600.0; strike <= 1710.0; strike += 5.0) {
+    sep13.strikes.push_back(strike);
+  }
+  std::vector<ExpiryDefinition> expiries(1, sep13);
+  std::vector<Real> forwards(1, 1656.125);
+
+  const char* recorded = std::getenv("QLTUTOR_TICK_FILE");
+  std::string fileName = recorded ? recorded : str(boost::format("/tmp/qltutor-es-ticks-%d.csv") % getpid());
+  if (!recorded) {
+    recordQuoteFile(fileName, sep13, forwards[0], 50000);
+  }
+  std::vector<std::vector<GreeksUpdate> > expected = fullRecompute(fileName, expiries, forwards);
+
+  // recorded pace: one tick every 20us
+  PipelineResult paced = runPipeline(fileName, expiries, forwards, 1.0);
+  printLatencies("Replay at recorded speed", paced);
+
+  // as fast as the file can be read: queueing dominates the tail
+  PipelineResult flood = runPipeline(fileName, expiries, forwards, 1e9);
+  printLatencies("Replay as fast as possible", flood);
+
+  for (const PipelineResult* result : { &paced, &flood }) {
+    // every tick that changed anything delivered exactly one final marker to the sink
+    BOOST_CHECK_EQUAL(result->latencies.size(), result->counters.changed);
+    // the incrementally maintained book is the book recomputed from all the ticks
+    for (Size e = 0; e < expected.size(); ++e) {
+      for (Size position = 0; position < expected[e].size(); ++position) {
+        const GreeksUpdate& full = expected[e][position];
+        const GreeksUpdate& incremental = result->book[e][position];
+        BOOST_CHECK_EQUAL(incremental.position, full.position);
+        if (full.position == noIndex || incremental.position == noIndex) continue;
+        BOOST_CHECK_CLOSE(incremental.value, full.value, 1e-9);
+        BOOST_CHECK_CLOSE(incremental.delta, full.delta, 1e-9);
+        BOOST_CHECK_CLOSE(incremental.gamma, full.gamma, 1e-9);
+        BOOST_CHECK_CLOSE(incremental.vega, full.vega, 1e-9);
+      }
+    }
+  }
+
+  if (!recorded) std::remove(fileName.c_str());
+}
+
+}
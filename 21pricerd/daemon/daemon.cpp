@@ -0,0 +1,51 @@
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "../pricerd.hpp"
+
+// The pricing daemon of pricerd.hpp as a process of its own:
+//
+//   ./pricerd-daemon.exe /tmp/pricerd.sock [window microseconds]
+//
+// serves until SIGINT or SIGTERM. The socket and the window can also come from
+// QLTUTOR_PRICERD_SOCKET and QLTUTOR_PRICERD_WINDOW_US.
+
+namespace {
+
+PricingServer* runningServer = 0;
+
+extern "C" void stopRunningServer(int) {
+  if (runningServer) runningServer->stop();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  const char* path = argc > 1 ? argv[1] : std::getenv("QLTUTOR_PRICERD_SOCKET");
+  const char* window = argc > 2 ? argv[2] : std::getenv("QLTUTOR_PRICERD_WINDOW_US");
+  if (!path) {
+    std::cerr << "usage: " << argv[0] << " socket [window microseconds]" << std::endl;
+    return 2;
+  }
+
+  try {
+    MarketState market;
+    PricingServer server(path, market, window ? std::atol(window) : 200);
+    runningServer = &server;
+    std::signal(SIGINT, stopRunningServer);
+    std::signal(SIGTERM, stopRunningServer);
+    std::cout << "Serving on " << path << std::endl;
+    server.run();
+    runningServer = 0;
+    std::cout << boost::format("Priced %d requests in %d batches") % server.priced() % server.batches() << std::endl;
+  } catch (std::exception& e) {
+    runningServer = 0;
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
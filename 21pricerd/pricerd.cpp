@@ -0,0 +1,179 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE PRICERD
+#include <boost/test/unit_test.hpp>
+#include <boost/detail/lightweight_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <random>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "pricerd.hpp"
+
+namespace {
+
+using namespace QuantLib;
+
+struct LoadResult {
+  double seconds;
+  std::vector<double> latencies; // microseconds
+  double meanBatchSize;
+};
+
+bool readFully(int fd, void* data, size_t size) {
+  char* p = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t got = read(fd, p, size);
+    if (got <= 0) return false;
+    p += got;
+    size -= got;
+  }
+  return true;
+}
+
+// every client keeps `depth` requests in flight on its own connection
+LoadResult generateLoad(const std::string& path, Size clients, Size requestsPerClient, Size depth) {
+  typedef std::chrono::steady_clock Clock;
+  std::vector<std::vector<double> > latencies(clients);
+  std::vector<double> batchSums(clients, 0.0);
+
+  Clock::time_point start = Clock::now();
+  std::vector<std::thread> threads;
+  for (Size c = 0; c < clients; ++c) {
+    threads.push_back(std::thread([&, c]() {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+      if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return;
+      }
+
+      std::mt19937 rng(c);
+      std::uniform_real_distribution<double> strikes(1600.0, 1750.0), expiries(.1, 1.0);
+      std::vector<Clock::time_point> sent(requestsPerClient);
+      latencies[c].reserve(requestsPerClient);
+
+      auto send = [&](Size i) {
+        PricingRequest request = { i, i % 2 ? Option::Put : Option::Call, 0, strikes(rng), expiries(rng) };
+        sent[i] = Clock::now();
+        ssize_t ignored = write(fd, &request, sizeof(request));
+        (void)ignored;
+      };
+
+      Size next = 0;
+      for (; next < std::min(depth, requestsPerClient); ++next) send(next);
+      for (Size received = 0; received < requestsPerClient; ++received) {
+        PricingResponse response;
+        if (!readFully(fd, &response, sizeof(response))) break;
+        latencies[c].push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent[response.id]).count());
+        batchSums[c] += response.batchSize;
+        if (next < requestsPerClient) send(next++);
+      }
+      close(fd);
+    }));
+  }
+  for (std::thread& t : threads) t.join();
+
+  LoadResult result;
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  double batchSum = 0.0;
+  for (Size c = 0; c < clients; ++c) {
+    result.latencies.insert(result.latencies.end(), latencies[c].begin(), latencies[c].end());
+    batchSum += batchSums[c];
+  }
+  result.meanBatchSize = result.latencies.empty() ? 0.0 : batchSum / result.latencies.size();
+  std::sort(result.latencies.begin(), result.latencies.end());
+  return result;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+  return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, Size(p * sorted.size()))];
+}
+
+std::string socketPath() {
+  return str(boost::format("/tmp/qltutor-pricerd-%d.sock") % getpid());
+}
+
+BOOST_AUTO_TEST_CASE(testPricingDaemonBatching) {
+  MarketState market;
+
+  // sanity check of the batched closed form against BlackScholesCalculator
+  std::vector<PricingRequest> requests(1);
+  PricingRequest request = { 0, Option::Call, 0, 1700.0, .5 };
+  requests[0] = request;
+  std::vector<PricingResponse> responses;
+  priceBatch(market, requests, responses);
+  DiscountFactor discount = market.discount(.5);
+  BlackScholesCalculator bsCalculator(Option::Call, 1700.0, market.spot(), 1.0,
+                                      market.vol(.5, 1700.0) * std::sqrt(.5), discount);
+  std::cout << boost::format("Batched 1700 call %.4f, BlackScholesCalculator %.4f")
+    % responses[0].npv % bsCalculator.value() << std::endl;
+  BOOST_CHECK_CLOSE(responses[0].npv, bsCalculator.value(), 1e-8);
+
+  Size clients = 16, requestsPerClient = 2000, depth = 4;
+  long windows[] = { 0, 50, 250, 1000 };
+  for (long window : windows) {
+    PricingServer server(socketPath(), market, window, 256);
+    std::thread serverThread([&]() { server.run(); });
+
+    LoadResult result = generateLoad(socketPath(), clients, requestsPerClient, depth);
+    server.stop();
+    serverThread.join();
+
+    std::cout << boost::format("window %4d us: %d requests in %d batches (mean batch seen %.1f), %.0f req/s")
+      % window % server.priced() % server.batches() % result.meanBatchSize
+      % (result.latencies.size() / result.seconds) << std::endl;
+    std::cout << boost::format("  latency us: p50=%.1f p99=%.1f p99.9=%.1f max=%.1f")
+      % percentile(result.latencies, .50) % percentile(result.latencies, .99)
+      % percentile(result.latencies, .999) % (result.latencies.empty() ? 0.0 : result.latencies.back()) << std::endl;
+    BOOST_CHECK_EQUAL(result.latencies.size(), clients * requestsPerClient);
+  }
+}
+
+// a client that sends its requests and shuts down its write side still gets every reply
+BOOST_AUTO_TEST_CASE(testHalfClosedClient) {
+  MarketState market;
+  PricingServer server(socketPath(), market, 1000, 256);
+  std::thread serverThread([&]() { server.run(); });
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, socketPath().c_str(), sizeof(address.sun_path) - 1);
+  BOOST_REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+
+  const Size count = 10;
+  std::vector<PricingRequest> requests;
+  for (Size i = 0; i < count; ++i) {
+    PricingRequest request = { i, Option::Call, 0, 1600.0 + 10.0 * i, .5 };
+    requests.push_back(request);
+  }
+  ssize_t ignored = write(fd, &requests[0], count * sizeof(PricingRequest));
+  (void)ignored;
+  shutdown(fd, SHUT_WR);
+
+  Size received = 0;
+  PricingResponse response;
+  while (readFully(fd, &response, sizeof(response))) {
+    BOOST_CHECK_EQUAL(response.id, received);
+    ++received;
+  }
+  close(fd);
+  server.stop();
+  serverThread.join();
+  BOOST_CHECK_EQUAL(received, count);
+}
+
+}
@@ -0,0 +1,387 @@
+#include <ql/quantlib.hpp>
+#include <boost/assign/std/vector.hpp>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+// Long-lived pricing daemon on a Unix domain socket.
+//
+// One epoll loop owns every connection. Requests are fixed-size records; complete
+// records are queued into the current batch, which is priced in one vectorised pass
+// when its micro-window (a timerfd armed by the first request) expires or it reaches
+// maxBatch, and the responses are written back to whichever connections asked.
+// The curve and the vol surface are built once at start-up and stay hot for the
+// lifetime of the process.
+//
+// A client may write its requests and shut down its side of the socket: the requests
+// it sent are still priced, and the connection closes once their replies are written.
+
+struct PricingRequest {
+  std::uint64_t id;
+  std::int32_t optionType;   // QuantLib::Option::Type
+  std::int32_t padding;
+  double strike;
+  double expiry;             // year fraction from the evaluation date
+};
+
+struct PricingResponse {
+  std::uint64_t id;
+  std::int32_t status;       // 0 ok
+  std::int32_t batchSize;
+  double npv, delta, gamma, vega;
+};
+
+// market objects bootstrapped once per process
+class MarketState {
+  public:
+    MarketState() {
+      using namespace QuantLib;
+      using namespace boost::assign;
+
+      Date evaluationDate(30, Sep, 2013);
+      Settings::instance().evaluationDate() = evaluationDate;
+      dayCounter_ = ActualActual();
+      spot_ = 1680.0;
+
+      //USD LIBOR deposits as in 16ameopt
+      std::vector<boost::shared_ptr<RateHelper> > liborRates;
+      liborRates += boost::shared_ptr<RateHelper>(new DepositRateHelper(.10490/100.0, boost::shared_ptr<IborIndex>(new USDLiborON())));
+      liborRates += boost::shared_ptr<RateHelper>(new DepositRateHelper(.12925/100.0, boost::shared_ptr<IborIndex>(new USDLibor(Period(1, Weeks)))));
+      liborRates += boost::shared_ptr<RateHelper>(new DepositRateHelper(.16750/100.0, boost::shared_ptr<IborIndex>(new USDLibor(Period(1, Months)))));
+      liborRates += boost::shared_ptr<RateHelper>(new DepositRateHelper(.20700/100.0, boost::shared_ptr<IborIndex>(new USDLibor(Period(2, Months)))));
+      liborRates += boost::shared_ptr<RateHelper>(new DepositRateHelper(.23810/100.0, boost::shared_ptr<IborIndex>(new USDLibor(Period(3, Months)))));
+      liborRates += boost::shared_ptr<RateHelper>(new DepositRateHelper(.35140/100.0, boost::shared_ptr<IborIndex>(new USDLibor(Period(6, Months)))));
+      liborRates += boost::shared_ptr<RateHelper>(new DepositRateHelper(.58410/100.0, boost::shared_ptr<IborIndex>(new USDLibor(Period(12, Months)))));
+      curve_ = boost::shared_ptr<YieldTermStructure>(
+        new PiecewiseYieldCurve<ZeroYield, Cubic>(evaluationDate, liborRates, dayCounter_));
+      curve_->enableExtrapolation();
+
+      //ES surface from 15volsurf
+      std::vector<Real> strikes;
+      strikes += 1650.0, 1660.0, 1670.0, 1675.0, 1680.0;
+      std::vector<Date> expirations;
+      expirations += Date(20, Dec, 2013), Date(17, Jan, 2014), Date(21, Mar, 2014), Date(20, Jun, 2014), Date(19, Sep, 2014);
+      Real vols[5][5] = { { .15640, .15433, .16079, .16394, .17383 }
+                        , { .15343, .15240, .15804, .16255, .17303 }
+                        , { .15128, .14888, .15512, .15944, .17038 }
+                        , { .14798, .14906, .15522, .16171, .16156 }
+                        , { .14580, .14576, .15364, .16037, .16042 } };
+      Matrix volMatrix(5, 5);
+      for (Size i = 0; i < 5; ++i) {
+        for (Size j = 0; j < 5; ++j) volMatrix[i][j] = vols[i][j];
+      }
+      surface_ = boost::shared_ptr<BlackVolTermStructure>(new BlackVarianceSurface(
+        evaluationDate, UnitedStates(UnitedStates::NYSE), expirations, strikes, volMatrix, dayCounter_));
+      surface_->enableExtrapolation();
+
+      // force the bootstrap now rather than on the first request
+      curve_->discount(1.0);
+    }
+
+    QuantLib::Real spot() const { return spot_; }
+    QuantLib::DiscountFactor discount(QuantLib::Time t) const { return curve_->discount(t, true); }
+    QuantLib::Volatility vol(QuantLib::Time t, QuantLib::Real strike) const {
+      return surface_->blackVol(t, strike, true);
+    }
+
+  private:
+    QuantLib::DayCounter dayCounter_;
+    QuantLib::Real spot_;
+    boost::shared_ptr<QuantLib::YieldTermStructure> curve_;
+    boost::shared_ptr<QuantLib::BlackVolTermStructure> surface_;
+};
+
+// Black-Scholes over a batch laid out as arrays; market lookups are done first so the
+// arithmetic loop has no calls into QuantLib
+inline void priceBatch( const MarketState& market
+                      , const std::vector<PricingRequest>& requests
+                      , std::vector<PricingResponse>& responses) {
+  const std::size_t n = requests.size();
+  std::vector<double> forward(n), stdDev(n), discount(n), strike(n), sign(n), sqrtT(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const PricingRequest& r = requests[i];
+    double t = std::max(r.expiry, 1.0 / 365.0);
+    discount[i] = market.discount(t);
+    forward[i] = market.spot() / discount[i];
+    sqrtT[i] = std::sqrt(t);
+    stdDev[i] = market.vol(t, r.strike) * sqrtT[i];
+    strike[i] = r.strike;
+    sign[i] = r.optionType == QuantLib::Option::Call ? 1.0 : -1.0;
+  }
+
+  responses.resize(n);
+  const double invSqrt2 = 0.70710678118654752440, invSqrt2Pi = 0.39894228040143267794;
+  for (std::size_t i = 0; i < n; ++i) {
+    const double d1 = std::log(forward[i] / strike[i]) / stdDev[i] + 0.5 * stdDev[i];
+    const double d2 = d1 - stdDev[i];
+    const double nd1 = 0.5 * std::erfc(-sign[i] * d1 * invSqrt2);
+    const double nd2 = 0.5 * std::erfc(-sign[i] * d2 * invSqrt2);
+    const double pdf = invSqrt2Pi * std::exp(-0.5 * d1 * d1);
+    const double spot = forward[i] * discount[i];
+    PricingResponse& out = responses[i];
+    out.id = requests[i].id;
+    out.status = 0;
+    out.batchSize = std::int32_t(n);
+    out.npv = sign[i] * (spot * nd1 - strike[i] * discount[i] * nd2);
+    out.delta = sign[i] * nd1;
+    out.gamma = pdf / (spot * stdDev[i]);
+    out.vega = spot * pdf * sqrtT[i];
+  }
+}
+
+class PricingServer {
+  public:
+    PricingServer( const std::string& path
+                 , const MarketState& market
+                 , long windowMicroseconds = 200
+                 , std::size_t maxBatch = 256)
+      : path_(path), market_(market), window_(windowMicroseconds), maxBatch_(maxBatch)
+      , batches_(0), priced_(0), nextSerial_(1) {
+      listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      if (listenFd_ < 0) throw std::runtime_error("socket() failed");
+      sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+      unlink(path.c_str());
+      if (bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+          || listen(listenFd_, 128) < 0) {
+        close(listenFd_);
+        throw std::runtime_error("cannot listen on " + path + ": " + std::strerror(errno));
+      }
+      stopFd_ = eventfd(0, EFD_NONBLOCK);
+      timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+      epollFd_ = epoll_create1(0);
+      watch(listenFd_, EPOLLIN);
+      watch(stopFd_, EPOLLIN);
+      watch(timerFd_, EPOLLIN);
+    }
+
+    ~PricingServer() {
+      for (std::map<int, Connection>::iterator i = connections_.begin(); i != connections_.end(); ++i) {
+        close(i->first);
+      }
+      close(listenFd_);
+      close(stopFd_);
+      close(timerFd_);
+      close(epollFd_);
+      unlink(path_.c_str());
+    }
+
+    // safe to call from another thread or a signal handler
+    void stop() {
+      std::uint64_t one = 1;
+      ssize_t ignored = write(stopFd_, &one, sizeof(one));
+      (void)ignored;
+    }
+
+    void run() {
+      std::vector<epoll_event> events(64);
+      for (;;) {
+        int n = epoll_wait(epollFd_, &events[0], int(events.size()), -1);
+        if (n < 0 && errno != EINTR) throw std::runtime_error("epoll_wait failed");
+
+        for (int i = 0; i < n; ++i) {
+          int fd = events[i].data.fd;
+          if (fd == stopFd_) {
+            flushBatch();
+            return;
+          } else if (fd == timerFd_) {
+            std::uint64_t expirations;
+            ssize_t ignored = read(timerFd_, &expirations, sizeof(expirations));
+            (void)ignored;
+            flushBatch();
+          } else if (fd == listenFd_) {
+            acceptConnections();
+          } else {
+            if (events[i].events & EPOLLOUT) writePending(fd);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readRequests(fd);
+          }
+        }
+
+        if (batch_.size() >= maxBatch_ || (!batch_.empty() && window_ <= 0)) {
+          flushBatch();
+        }
+      }
+    }
+
+    std::size_t batches() const { return batches_; }
+    std::size_t priced() const { return priced_; }
+
+  private:
+    struct Connection {
+      std::uint64_t serial;
+      std::vector<char> in, out;
+      std::size_t outOffset;
+      std::size_t pending;       // requests queued and not yet answered
+      bool watchingWrites;
+      bool peerClosed;           // read end of file: close when nothing is pending
+    };
+
+    struct Pending {
+      int fd;
+      std::uint64_t serial;
+    };
+
+    void armTimer(long microseconds) {
+      itimerspec spec;
+      std::memset(&spec, 0, sizeof(spec));
+      spec.it_value.tv_sec = microseconds / 1000000;
+      spec.it_value.tv_nsec = (microseconds % 1000000) * 1000;
+      timerfd_settime(timerFd_, 0, &spec, 0);
+    }
+
+    void watch(int fd, std::uint32_t events, int op = EPOLL_CTL_ADD) {
+      epoll_event event;
+      std::memset(&event, 0, sizeof(event));
+      event.events = events;
+      event.data.fd = fd;
+      epoll_ctl(epollFd_, op, fd, &event);
+    }
+
+    void acceptConnections() {
+      for (;;) {
+        int fd = accept4(listenFd_, 0, 0, SOCK_NONBLOCK);
+        if (fd < 0) return;
+        Connection& c = connections_[fd];
+        c.serial = nextSerial_++;
+        c.in.clear();
+        c.out.clear();
+        c.outOffset = 0;
+        c.pending = 0;
+        c.watchingWrites = false;
+        c.peerClosed = false;
+        watch(fd, EPOLLIN);
+      }
+    }
+
+    std::uint32_t events(const Connection& c) const {
+      return (c.peerClosed ? 0 : EPOLLIN) | (c.watchingWrites ? EPOLLOUT : 0);
+    }
+
+    void closeConnection(int fd) {
+      epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, 0);
+      close(fd);
+      connections_.erase(fd);
+    }
+
+    void readRequests(int fd) {
+      std::map<int, Connection>::iterator it = connections_.find(fd);
+      if (it == connections_.end()) return;
+      Connection& c = it->second;
+      if (c.peerClosed) return;
+      char buffer[16384];
+      for (;;) {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got > 0) {
+          c.in.insert(c.in.end(), buffer, buffer + got);
+          continue;
+        }
+        if (got == 0) {
+          c.peerClosed = true;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          closeConnection(fd);
+          return;
+        }
+        break;
+      }
+
+      std::size_t complete = c.in.size() / sizeof(PricingRequest);
+      for (std::size_t i = 0; i < complete; ++i) {
+        PricingRequest request;
+        std::memcpy(&request, &c.in[i * sizeof(PricingRequest)], sizeof(PricingRequest));
+        if (batch_.empty() && window_ > 0) armTimer(window_);
+        batch_.push_back(request);
+        Pending p = { fd, c.serial };
+        owners_.push_back(p);
+      }
+      c.pending += complete;
+      c.in.erase(c.in.begin(), c.in.begin() + complete * sizeof(PricingRequest));
+
+      // half-closed: the requests just queued are answered before the connection goes
+      if (c.peerClosed) {
+        if (c.pending == 0) closeConnection(fd);
+        else watch(fd, events(c), EPOLL_CTL_MOD);
+      }
+    }
+
+    void flushBatch() {
+      if (batch_.empty()) return;
+      armTimer(0);
+      priceBatch(market_, batch_, responses_);
+      ++batches_;
+      priced_ += batch_.size();
+
+      for (std::size_t i = 0; i < batch_.size(); ++i) {
+        std::map<int, Connection>::iterator it = connections_.find(owners_[i].fd);
+        // the client may have gone, and its descriptor may have been reused since
+        if (it == connections_.end() || it->second.serial != owners_[i].serial) continue;
+        const char* bytes = reinterpret_cast<const char*>(&responses_[i]);
+        --it->second.pending;
+        it->second.out.insert(it->second.out.end(), bytes, bytes + sizeof(PricingResponse));
+      }
+      for (std::size_t i = 0; i < owners_.size(); ++i) {
+        if (i == 0 || owners_[i].fd != owners_[i - 1].fd) writePending(owners_[i].fd);
+      }
+      batch_.clear();
+      owners_.clear();
+    }
+
+    void writePending(int fd) {
+      std::map<int, Connection>::iterator it = connections_.find(fd);
+      if (it == connections_.end()) return;
+      Connection& c = it->second;
+      while (c.outOffset < c.out.size()) {
+        // a client gone before its replies must not raise SIGPIPE
+        ssize_t sent = send(fd, &c.out[c.outOffset], c.out.size() - c.outOffset, MSG_NOSIGNAL);
+        if (sent > 0) {
+          c.outOffset += sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          if (!c.watchingWrites) {
+            c.watchingWrites = true;
+            watch(fd, events(c), EPOLL_CTL_MOD);
+          }
+          return;
+        } else {
+          closeConnection(fd);
+          return;
+        }
+      }
+      c.out.clear();
+      c.outOffset = 0;
+      if (c.peerClosed && c.pending == 0) {
+        closeConnection(fd);
+        return;
+      }
+      if (c.watchingWrites) {
+        c.watchingWrites = false;
+        watch(fd, events(c), EPOLL_CTL_MOD);
+      }
+    }
+
+    std::string path_;
+    const MarketState& market_;
+    long window_;
+    std::size_t maxBatch_;
+    std::size_t batches_, priced_;
+    std::uint64_t nextSerial_;
+    int listenFd_, stopFd_, timerFd_, epollFd_;
+    std::map<int, Connection> connections_;
+    std::vector<PricingRequest> batch_;
+    std::vector<Pending> owners_;
+    std::vector<PricingResponse> responses_;
+};
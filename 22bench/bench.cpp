@@ -0,0 +1,569 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE BENCH
+#include <boost/test/unit_test.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/math/distributions.hpp>
+#include <boost/function.hpp>
+#include <boost/assign/std/vector.hpp>
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "bench.hpp"
+#include "er.hpp"
+#include "portfoliokernels.hpp"
+
+// One benchmark case per tutorial module. The workloads rebuild the modules' examples
+// (same instruments, same solvers) with a size parameter, so a slow-down in QuantLib
+// or in our own code shows up against the stored baseline.
+//
+//   make bench      run everything, write bench-results.json, compare with baseline.json
+//   make baseline   run everything and store the result as baseline.json
+//
+// --run_test=benchCashFlowNPV etc. runs a single module.
+
+namespace {
+
+using namespace QuantLib;
+
+qltutor::BenchmarkReport& report() {
+  static qltutor::BenchmarkReport report("qltutor", qltutor::BenchmarkOptions::fromEnvironment());
+  return report;
+}
+
+std::string environment(const char* name, const char* fallback) {
+  const char* value = std::getenv(name);
+  return value ? value : fallback;
+}
+
+// loads $QLTUTOR_BENCH_BASELINE (baseline.json) up front, writes $QLTUTOR_BENCH_JSON at exit
+struct BenchmarkFixture {
+  BenchmarkFixture() {
+    std::string baseline = environment("QLTUTOR_BENCH_BASELINE", "baseline.json");
+    if (report().loadBaseline(baseline) && report().hasBaseline()) {
+      std::cout << "Comparing against baseline " << baseline << std::endl;
+    }
+  }
+  ~BenchmarkFixture() {
+    std::string results = environment("QLTUTOR_BENCH_JSON", "bench-results.json");
+    report().writeJson(results);
+    std::cout << boost::format("Wrote %d benchmarks to %s") % report().results().size() % results << std::endl;
+  }
+};
+
+BOOST_GLOBAL_FIXTURE(BenchmarkFixture);
+
+template <class F>
+void bench(const std::string& name, const std::string& parameters, F workload) {
+  const qltutor::BenchmarkResult& result = report().run(name, parameters, workload);
+  qltutor::BenchmarkComparison comparison = report().compare(result);
+  if (!comparison.found) return;
+  std::cout << boost::format("  %.2fx baseline (%.1f ns)") % comparison.ratio % comparison.baselineMedian << std::endl;
+  BOOST_CHECK_MESSAGE(!comparison.regressed, result.key() << " regressed: median "
+                      << result.nanoseconds.median << " ns vs " << comparison.baselineMedian << " ns");
+  BOOST_CHECK_MESSAGE(!comparison.drifted, result.key() << " returned " << result.result
+                      << ", baseline returned " << comparison.baselineResult);
+}
+
+// fixed-seed covariance with a two-factor structure plus specific risk
+Matrix sampleCovariance(Size n, unsigned seed = 42) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> loading(.2, 1.2), specific(.01, .05);
+  Matrix factors(n, 2);
+  for (Size i = 0; i < n; ++i) {
+    factors[i][0] = loading(rng);
+    factors[i][1] = loading(rng) - .7;
+  }
+  Matrix covariance = factors * transpose(factors) * .04;
+  for (Size i = 0; i < n; ++i) covariance[i][i] += specific(rng);
+  return covariance;
+}
+
+Matrix sampleReturns(Size n, unsigned seed = 7) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> expected(.02, .12);
+  Matrix returns(n, 1);
+  for (Size i = 0; i < n; ++i) returns[i][0] = expected(rng);
+  return returns;
+}
+
+boost::shared_ptr<FixedRateBond> sampleBond(const Date& issueDate, Integer years) {
+  Calendar calendar = UnitedStates(UnitedStates::GovernmentBond);
+  Schedule schedule(issueDate, issueDate + Period(years, Years), Period(Annual), calendar,
+                    Unadjusted, Unadjusted, DateGeneration::Backward, false);
+  std::vector<InterestRate> coupons(years, InterestRate(.05, ActualActual(ActualActual::Bond), Compounded, Annual));
+  return boost::shared_ptr<FixedRateBond>(new FixedRateBond(3, 100.0, schedule, coupons));
+}
+
+// 01pv, 03bond
+BOOST_AUTO_TEST_CASE(benchCashFlowNPV) {
+  Date today(15, Nov, 2013);
+  Settings::instance().evaluationDate() = today;
+  InterestRate rate(.05, ActualActual(), Compounded, Annual);
+
+  Size flows[] = { 3, 30, 360 };
+  for (Size n : flows) {
+    Leg cashFlows;
+    for (Size i = 1; i <= n; ++i) {
+      cashFlows.push_back(boost::shared_ptr<CashFlow>(
+        new SimpleCashFlow(i < n ? 5.0 / 12 : 105.0 / 12, today + Period(Integer(i), Months))));
+    }
+    bench("01pv/cashFlowsNPV", str(boost::format("flows=%d") % n), [&]() {
+      return CashFlows::npv(cashFlows, rate, true);
+    });
+  }
+
+  Integer maturities[] = { 3, 10, 30 };
+  for (Integer years : maturities) {
+    boost::shared_ptr<FixedRateBond> bond = sampleBond(today, years);
+    Handle<YieldTermStructure> curve(boost::shared_ptr<YieldTermStructure>(
+      new FlatForward(today, .03, ActualActual(ActualActual::Bond), Compounded, Annual)));
+    bond->setPricingEngine(boost::shared_ptr<PricingEngine>(new DiscountingBondEngine(curve)));
+    bench("03bond/bondNPV", str(boost::format("years=%d") % years), [&]() {
+      bond->recalculate();
+      return bond->NPV();
+    });
+  }
+}
+
+// 06irr
+BOOST_AUTO_TEST_CASE(benchYieldToMaturity) {
+  Date today(15, Nov, 2013);
+  Settings::instance().evaluationDate() = today;
+
+  Integer maturities[] = { 3, 10, 30 };
+  for (Integer years : maturities) {
+    boost::shared_ptr<FixedRateBond> bond = sampleBond(today, years);
+    Handle<YieldTermStructure> curve(boost::shared_ptr<YieldTermStructure>(
+      new FlatForward(today, .03, ActualActual(ActualActual::Bond), Compounded, Annual)));
+    bond->setPricingEngine(boost::shared_ptr<PricingEngine>(new DiscountingBondEngine(curve)));
+    Real npv = bond->NPV();
+    const Leg& cashFlows = bond->cashflows();
+
+    bench("06irr/bisectionYield", str(boost::format("years=%d") % years), [&]() {
+      Bisection bisection;
+      return bisection.solve([&](Rate rate) {
+          InterestRate interestRate(rate, ActualActual(ActualActual::Bond), Compounded, Annual);
+          return CashFlows::npv(cashFlows, interestRate, false) - npv;
+        }, 1e-7, .10, .0025, .15);
+    });
+    bench("06irr/bondYield", str(boost::format("years=%d") % years), [&]() {
+      return bond->yield(ActualActual(ActualActual::Bond), Compounded, Annual);
+    });
+  }
+}
+
+// 07durationConvexity
+BOOST_AUTO_TEST_CASE(benchDurationConvexity) {
+  Date today(15, Nov, 2013);
+  Settings::instance().evaluationDate() = today;
+
+  Integer maturities[] = { 3, 10, 30 };
+  for (Integer years : maturities) {
+    boost::shared_ptr<FixedRateBond> bond = sampleBond(today, years);
+    InterestRate yield(.03, ActualActual(ActualActual::Bond), Compounded, Annual);
+    bench("07durationConvexity/durationConvexity", str(boost::format("years=%d") % years), [&]() {
+      return BondFunctions::duration(*bond, yield, Duration::Macaulay, today)
+           + BondFunctions::duration(*bond, yield, Duration::Modified, today)
+           + BondFunctions::convexity(*bond, yield, today);
+    });
+  }
+}
+
+// 08futurefwd: every call relinks the curve, so the forward is repriced from scratch
+BOOST_AUTO_TEST_CASE(benchBondForward) {
+  Calendar calendar = UnitedStates(UnitedStates::GovernmentBond);
+  Date today(2, April, 2013);
+  Date issueDate = calendar.adjust(today, ModifiedFollowing);
+  Settings::instance().evaluationDate() = issueDate;
+  Natural settlementDays = 1;
+  Rate rate = .03;
+
+  boost::shared_ptr<FixedRateBond> bond(new FixedRateBond(settlementDays, calendar, 100.0, issueDate,
+    issueDate + Period(3, Years), Period(Annual), std::vector<Rate>(1, .05), ActualActual(ActualActual::Bond)));
+  boost::shared_ptr<YieldTermStructure> curves[] = {
+    boost::shared_ptr<YieldTermStructure>(new FlatForward(issueDate, rate - .01, ActualActual(ActualActual::Bond), Compounded, Annual)),
+    boost::shared_ptr<YieldTermStructure>(new FlatForward(issueDate, rate + .01, ActualActual(ActualActual::Bond), Compounded, Annual))
+  };
+  RelinkableHandle<YieldTermStructure> curve(curves[0]);
+  bond->setPricingEngine(boost::shared_ptr<PricingEngine>(new DiscountingBondEngine(curve)));
+
+  FixedRateBondForward forward(issueDate, issueDate + Period(15, Months), Position::Long, 104.0, settlementDays,
+                               ActualActual(ActualActual::Bond), calendar, ModifiedFollowing, bond, curve, curve);
+  bench("08futurefwd/bondForwardNPV", "shock=+-1%", [&]() {
+    curve.linkTo(curves[1]);
+    Real up = forward.NPV();
+    curve.linkTo(curves[0]);
+    return up + forward.NPV();
+  });
+}
+
+// 09lopt
+BOOST_AUTO_TEST_CASE(benchPortfolioWeights) {
+  Size assets[] = { 4, 8 };
+  for (Size n : assets) {
+    Matrix covariance = sampleCovariance(n);
+    Matrix correlation(n, n);
+    for (Size i = 0; i < n; ++i)
+      for (Size j = 0; j < n; ++j)
+        correlation[i][j] = covariance[i][j] / std::sqrt(covariance[i][i] * covariance[j][j]);
+
+    std::string parameters = str(boost::format("assets=%d") % n);
+    bench("09lopt/weightsMVClosedForm", parameters, [&]() { return WeightsMV(false, n, covariance)[0][0]; });
+    bench("09lopt/weightsMVSimplex", parameters, [&]() { return WeightsMV(true, n, covariance)[0][0]; });
+    bench("09lopt/weightsERC", parameters, [&]() { return WeightsERC(n, covariance, correlation)[0][0]; });
+  }
+}
+
+// 10ef: two-fund frontier through the explicit inverse, as testEfficientFrontier does it
+Real frontierByInversion(const Matrix& covariance, const Matrix& returns, Rate c, Size points) {
+  Size n = covariance.rows();
+  Matrix returnsMinusC(n, 1);
+  for (Size i = 0; i < n; ++i) returnsMinusC[i][0] = returns[i][0] - c;
+
+  Matrix inverseOfCovariance = inverse(covariance);
+  Matrix az = inverseOfCovariance * returns, bz = inverseOfCovariance * returnsMinusC;
+  Real sumAz = std::accumulate(az.begin(), az.end(), 0.0), sumBz = std::accumulate(bz.begin(), bz.end(), 0.0);
+  Matrix weightsA(n, 1), weightsB(n, 1);
+  for (Size i = 0; i < n; ++i) {
+    weightsA[i][0] = az[i][0] / sumAz;
+    weightsB[i][0] = bz[i][0] / sumBz;
+  }
+  Real returnA = (transpose(weightsA) * returns)[0][0], returnB = (transpose(weightsB) * returns)[0][0];
+  Real varianceA = (transpose(weightsA) * covariance * weightsA)[0][0];
+  Real varianceB = (transpose(weightsB) * covariance * weightsB)[0][0];
+  Real covarianceAB = (transpose(weightsA) * covariance * weightsB)[0][0];
+
+  Real minimumRisk = QL_MAX_REAL;
+  for (Size i = 0; i < points; ++i) {
+    Real p = -.4 + 2.0 * i / (points - 1);
+    Real risk = std::sqrt(p * p * varianceA + (1 - p) * (1 - p) * varianceB + 2 * p * (1 - p) * covarianceAB);
+    minimumRisk = std::min(minimumRisk, risk);
+  }
+  return minimumRisk + returnA - returnB;
+}
+
+BOOST_AUTO_TEST_CASE(benchEfficientFrontier) {
+  Size assets[] = { 4, 50, 200 };
+  for (Size n : assets) {
+    Matrix covariance = sampleCovariance(n), returns = sampleReturns(n);
+    bench("10ef/frontierByInversion", str(boost::format("assets=%d,points=21") % n), [&]() {
+      return frontierByInversion(covariance, returns, .05, 21);
+    });
+  }
+}
+
+// common/portfoliokernels.hpp against the Matrix expressions they replace
+BOOST_AUTO_TEST_CASE(benchPortfolioKernels) {
+  Size assets[] = { 4, 50, 200, 1000 };
+  const Size portfolios = 16;
+  for (Size n : assets) {
+    Matrix covariance = sampleCovariance(n);
+    Matrix weights(n, portfolios);       // one portfolio per column, for the Matrix path
+    std::vector<Real> batch(n * portfolios), contributions(n * portfolios);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> weight(-.5, 1.5);
+    for (Size p = 0; p < portfolios; ++p)
+      for (Size i = 0; i < n; ++i) batch[p * n + i] = weights[i][p] = weight(rng) / n;
+    Matrix w(n, 1), v(n, 1);
+    for (Size i = 0; i < n; ++i) {
+      w[i][0] = weights[i][0];
+      v[i][0] = weights[i][1];
+    }
+    Size ld = covariance.columns();
+
+    Real viaMatrix = (transpose(w) * covariance * w)[0][0];
+    Real viaKernel = qltutor::quadraticForm(n, covariance.begin(), ld, w.begin());
+    BOOST_CHECK_CLOSE(viaKernel, viaMatrix, 1e-9);
+    BOOST_CHECK_CLOSE(qltutor::portfolioCovariance(n, covariance.begin(), ld, w.begin(), v.begin()),
+                      (transpose(w) * covariance * v)[0][0], 1e-9);
+
+    std::string parameters = str(boost::format("assets=%d") % n);
+    bench("kernels/quadraticFormMatrix", parameters, [&]() { return (transpose(w) * covariance * w)[0][0]; });
+    bench("kernels/quadraticForm", parameters, [&]() { return qltutor::quadraticForm(n, covariance.begin(), ld, w.begin()); });
+    bench("kernels/portfolioCovarianceMatrix", parameters, [&]() { return (transpose(w) * covariance * v)[0][0]; });
+    bench("kernels/portfolioCovariance", parameters, [&]() {
+      return qltutor::portfolioCovariance(n, covariance.begin(), ld, w.begin(), v.begin());
+    });
+
+    // the blocked batch product, with tiles smaller than n and with the default, and the
+    // risk contributions built on it, against covariance * weights
+    Matrix product = covariance * weights;
+    Real scale = 0.0, contributionScale = 0.0;
+    for (Size i = 0; i < n; ++i) {
+      for (Size p = 0; p < portfolios; ++p) {
+        scale = std::max(scale, std::fabs(product[i][p]));
+        contributionScale = std::max(contributionScale, std::fabs(weights[i][p] * product[i][p]));
+      }
+    }
+    std::vector<Real> blocked(n * portfolios), tiled(n * portfolios);
+    qltutor::symmetricMultiply(n, covariance.begin(), ld, &batch[0], portfolios, &blocked[0]);
+    qltutor::symmetricMultiply(n, covariance.begin(), ld, &batch[0], portfolios, &tiled[0], 3);
+    qltutor::riskContributions(n, covariance.begin(), ld, &batch[0], portfolios, &contributions[0]);
+    Real productError = 0.0, contributionError = 0.0;
+    for (Size p = 0; p < portfolios; ++p) {
+      for (Size i = 0; i < n; ++i) {
+        productError = std::max(productError, std::fabs(blocked[p * n + i] - product[i][p]));
+        productError = std::max(productError, std::fabs(tiled[p * n + i] - product[i][p]));
+        contributionError = std::max(contributionError,
+                                     std::fabs(contributions[p * n + i] - weights[i][p] * product[i][p]));
+      }
+    }
+    BOOST_CHECK_SMALL(productError / scale, 1e-12);
+    BOOST_CHECK_SMALL(contributionError / contributionScale, 1e-12);
+
+    parameters = str(boost::format("assets=%d,portfolios=%d") % n % portfolios);
+    bench("kernels/riskContributionsMatrix", parameters, [&]() {
+      Matrix product = covariance * weights;
+      Real total = 0.0;
+      for (Size i = 0; i < n; ++i)
+        for (Size p = 0; p < portfolios; ++p) total += weights[i][p] * product[i][p];
+      return total;
+    });
+    bench("kernels/riskContributions", parameters, [&]() {
+      qltutor::riskContributions(n, covariance.begin(), ld, &batch[0], portfolios, &contributions[0]);
+      return std::accumulate(contributions.begin(), contributions.end(), 0.0);
+    });
+  }
+}
+
+// 11popt: maximum Sharpe ratio under position limits with Simplex, as in testNoShortSales
+class SharpeCostFunction : public CostFunction {
+  public:
+    SharpeCostFunction(const Matrix& covariance, const Matrix& returns, Rate c)
+      : covariance_(covariance), returns_(returns), c_(c) {}
+
+    Real value(const Array& x) const {
+      Size n = covariance_.rows();
+      Matrix weights(n, 1);
+      Real sum = 0.0;
+      for (Size i = 0; i + 1 < n; ++i) {
+        weights[i][0] = x[i];
+        sum += x[i];
+      }
+      weights[n - 1][0] = 1.0 - sum;
+      Real mean = (transpose(weights) * returns_)[0][0];
+      Real variance = (transpose(weights) * covariance_ * weights)[0][0];
+      return -(mean - c_) / std::sqrt(variance);
+    }
+
+    Disposable<Array> values(const Array& x) const {
+      Array values(1, value(x));
+      return values;
+    }
+
+  private:
+    const Matrix& covariance_;
+    const Matrix& returns_;
+    Rate c_;
+};
+
+class PositionLimitsConstraint : public Constraint {
+  private:
+    class Impl : public Constraint::Impl {
+      public:
+        Impl(Real lower, Real upper) : lower_(lower), upper_(upper) {}
+        bool test(const Array& x) const {
+          Real last = 1.0 - std::accumulate(x.begin(), x.end(), 0.0);
+          for (Size i = 0; i < x.size(); ++i) {
+            if (x[i] < lower_ || x[i] > upper_) return false;
+          }
+          return last >= lower_ && last <= upper_;
+        }
+      private:
+        Real lower_, upper_;
+    };
+  public:
+    PositionLimitsConstraint(Real lower, Real upper)
+      : Constraint(boost::shared_ptr<Constraint::Impl>(new Impl(lower, upper))) {}
+};
+
+BOOST_AUTO_TEST_CASE(benchSharpeRatioSimplex) {
+  Size assets[] = { 4, 8 };
+  for (Size n : assets) {
+    Matrix covariance = sampleCovariance(n), returns = sampleReturns(n);
+    PositionLimitsConstraint limits(.05 / (n / 4), .50);
+    EndCriteria endCriteria(100000, 100, 1e-9, 1e-9, 1e-9);
+    bench("11popt/sharpeSimplex", str(boost::format("assets=%d") % n), [&]() {
+      SharpeCostFunction cost(covariance, returns, .01);
+      Problem problem(cost, limits, Array(n - 1, 1.0 / n));
+      Simplex solver(.01);
+      solver.minimize(problem, endCriteria);
+      return problem.functionValue();
+    });
+  }
+}
+
+Real expectedValueCallPayoff(Real spot, Real strike, Rate r, Volatility sigma, Time t, Real x) {
+  Real mean = std::log(spot) + (r - 0.5 * sigma * sigma) * t;
+  Real stdDev = sigma * std::sqrt(t);
+  boost::math::lognormal d(mean, stdDev);
+  return PlainVanillaPayoff(Option::Call, strike)(x) * boost::math::pdf(d, x);
+}
+
+// 12opt, 13greeks
+BOOST_AUTO_TEST_CASE(benchOptionPricing) {
+  Real spot = 100.0, strike = 110.0;
+  Rate r = .03;
+  Time t = .5;
+  Volatility vol = .20;
+
+  Real accuracies[] = { 1e-3, 1e-5 };
+  for (Real accuracy : accuracies) {
+    boost::function<Real (Real)> integrand = boost::bind(&expectedValueCallPayoff, spot, strike, r, vol, t, _1);
+    bench("12opt/simpsonIntegral", str(boost::format("accuracy=%g") % accuracy), [&]() {
+      SimpsonIntegral integral(accuracy, 1000);
+      return integral(integrand, strike, strike * 10.0) * std::exp(-r * t);
+    });
+  }
+
+  Size chains[] = { 1, 50 };
+  for (Size n : chains) {
+    DiscountFactor discount = std::exp(-r * t);
+    bench("13greeks/blackScholesCalculator", str(boost::format("strikes=%d") % n), [&]() {
+      Real sum = 0.0;
+      for (Size i = 0; i < n; ++i) {
+        BlackScholesCalculator calculator(Option::Call, 80.0 + 40.0 * i / std::max<Size>(1, n - 1), spot,
+                                          1.0, vol * std::sqrt(t), discount);
+        sum += calculator.value() + calculator.delta(spot) + calculator.gamma(spot)
+             + calculator.vega(t) + calculator.theta(spot, t);
+      }
+      return sum;
+    });
+  }
+
+  Date today(15, Nov, 2013);
+  Settings::instance().evaluationDate() = today;
+  Handle<Quote> underlying(boost::shared_ptr<Quote>(new SimpleQuote(spot)));
+  Handle<YieldTermStructure> riskFree(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, r, Actual365Fixed())));
+  Handle<YieldTermStructure> dividends(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, 0.0, Actual365Fixed())));
+  Handle<BlackVolTermStructure> volatility(boost::shared_ptr<BlackVolTermStructure>(
+    new BlackConstantVol(today, UnitedStates(UnitedStates::NYSE), vol, Actual365Fixed())));
+  boost::shared_ptr<BlackScholesMertonProcess> process(new BlackScholesMertonProcess(underlying, dividends, riskFree, volatility));
+  VanillaOption option(boost::shared_ptr<StrikedTypePayoff>(new PlainVanillaPayoff(Option::Call, strike)),
+                       boost::shared_ptr<Exercise>(new EuropeanExercise(today + 182)));
+  option.setPricingEngine(boost::shared_ptr<PricingEngine>(new AnalyticEuropeanEngine(process)));
+  bench("13greeks/analyticEuropeanEngine", "", [&]() {
+    option.recalculate();
+    return option.NPV() + option.delta() + option.gamma() + option.vega() + option.theta();
+  });
+}
+
+// 14impvol: the ES put chain, solved with Bisection on BlackCalculator
+BOOST_AUTO_TEST_CASE(benchImpliedVolatility) {
+  using namespace boost::assign;
+  std::vector<Real> strikes, mids;
+  strikes += 1600, 1605, 1610, 1615, 1620, 1625, 1630, 1635, 1640, 1645, 1650, 1655,
+             1660, 1665, 1670, 1675, 1680, 1685, 1690, 1695, 1700, 1705, 1710;
+  mids += 7.875, 8.75, 9.5, 10.5, 11.5, 12.625, 13.875, 15.25, 16.75, 18.25, 20.125, 22.0,
+          24.125, 26.5, 29.0, 31.75, 34.75, 37.75, 41.25, 44.75, 48.625, 52.625, 56.875;
+  Time timeToMaturity = .0686;
+  Real forward = 1656.25;
+  DiscountFactor discount = std::exp(-.00273 * timeToMaturity);
+
+  Real accuracies[] = { 1e-4, 1e-6 };
+  for (Real accuracy : accuracies) {
+    bench("14impvol/bisectionChain", str(boost::format("strikes=%d,accuracy=%g") % strikes.size() % accuracy), [&]() {
+      Real sum = 0.0;
+      for (Size i = 0; i < strikes.size(); ++i) {
+        Bisection bisection;
+        sum += bisection.solve([&](Volatility sigma) {
+            BlackCalculator blackCalculator(Option::Put, strikes[i], forward, sigma * std::sqrt(timeToMaturity), discount);
+            return blackCalculator.value() - mids[i];
+          }, accuracy, .20, .05, .40);
+      }
+      return sum;
+    });
+  }
+}
+
+// 15volsurf
+BOOST_AUTO_TEST_CASE(benchVolatilitySurfaceQueries) {
+  using namespace boost::assign;
+  std::vector<Real> strikes;
+  strikes += 1650.0, 1660.0, 1670.0, 1675.0, 1680.0;
+  std::vector<Date> expirations;
+  expirations += Date(20, Dec, 2013), Date(17, Jan, 2014), Date(21, Mar, 2014), Date(20, Jun, 2014), Date(19, Sep, 2014);
+  Real vols[] = { .15640, .15433, .16079, .16394, .17383,
+                  .15343, .15240, .15804, .16255, .17303,
+                  .15128, .14888, .15512, .15944, .17038,
+                  .14798, .14906, .15522, .16171, .16156,
+                  .14580, .14576, .15364, .16037, .16042 };
+  Matrix volMatrix(5, 5);
+  std::copy(vols, vols + 25, volMatrix.begin());
+
+  Date evaluationDate(30, Sep, 2013);
+  Settings::instance().evaluationDate() = evaluationDate;
+  BlackVarianceSurface surface(evaluationDate, UnitedStates(UnitedStates::NYSE), expirations, strikes, volMatrix, ActualActual());
+
+  Size queries = 1000;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> strike(1650.0, 1680.0), time(.3, .95);
+  std::vector<std::pair<Time, Real> > points(queries);
+  for (Size i = 0; i < queries; ++i) points[i] = std::make_pair(time(rng), strike(rng));
+
+  for (int bicubic = 0; bicubic < 2; ++bicubic) {
+    if (bicubic) surface.setInterpolation<Bicubic>();
+    bench("15volsurf/blackVol", str(boost::format("%s,queries=%d") % (bicubic ? "bicubic" : "bilinear") % queries), [&]() {
+      Real sum = 0.0;
+      for (Size i = 0; i < queries; ++i) sum += surface.blackVol(points[i].first, points[i].second, true);
+      return sum;
+    });
+  }
+}
+
+// 16ameopt: the INTC call on flat curves, FD grid as the parameter
+BOOST_AUTO_TEST_CASE(benchAmericanFiniteDifferences) {
+  Date today(15, Nov, 2013);
+  Settings::instance().evaluationDate() = today;
+  Date expiration(21, Feb, 2014);
+  Handle<Quote> underlying(boost::shared_ptr<Quote>(new SimpleQuote(24.52)));
+  Handle<YieldTermStructure> riskFree(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, .0024, Actual365Fixed())));
+  Handle<YieldTermStructure> dividends(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, .0098, Actual365Fixed())));
+  Handle<BlackVolTermStructure> volatility(boost::shared_ptr<BlackVolTermStructure>(
+    new BlackConstantVol(today, UnitedStates(UnitedStates::NYSE), .20128, Actual365Fixed())));
+  boost::shared_ptr<BlackScholesMertonProcess> process(new BlackScholesMertonProcess(underlying, dividends, riskFree, volatility));
+
+  VanillaOption option(boost::shared_ptr<StrikedTypePayoff>(new PlainVanillaPayoff(Option::Call, 25.0)),
+                       boost::shared_ptr<Exercise>(new AmericanExercise(today, expiration)));
+  Size grids[] = { 100, 400, 800 };
+  for (Size grid : grids) {
+    option.setPricingEngine(boost::shared_ptr<PricingEngine>(new FDAmericanEngine<CrankNicolson>(process, grid + 1, grid)));
+    bench("16ameopt/fdAmericanEngine", str(boost::format("grid=%dx%d") % (grid + 1) % grid), [&]() {
+      option.recalculate();
+      return option.NPV();
+    });
+  }
+}
+
+// 17brownie: reseeded on every call, so the result is reproducible against the baseline
+BOOST_AUTO_TEST_CASE(benchGeometricBrownianMotionPaths) {
+  typedef BoxMullerGaussianRng<MersenneTwisterUniformRng> MersenneBoxMuller;
+  boost::shared_ptr<StochasticProcess> gbm(new GeometricBrownianMotionProcess(20.16, .2312, .2116));
+
+  Size steps[] = { 255, 2550 };
+  for (Size timeSteps : steps) {
+    Size paths = 100;
+    bench("17brownie/pathGenerator", str(boost::format("steps=%d,paths=%d") % timeSteps % paths), [&]() {
+      MersenneTwisterUniformRng mersenneRng(42);
+      MersenneBoxMuller boxMullerRng(mersenneRng);
+      RandomSequenceGenerator<MersenneBoxMuller> gsg(timeSteps, boxMullerRng);
+      PathGenerator<RandomSequenceGenerator<MersenneBoxMuller> > generator(gbm, 1.0, timeSteps, gsg, false);
+      Real sum = 0.0;
+      for (Size i = 0; i < paths; ++i) sum += generator.next().value.back();
+      return sum / paths;
+    });
+  }
+}
+
+}
@@ -0,0 +1,222 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE LATENCY
+#include <boost/test/unit_test.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <boost/assign/std/vector.hpp>
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <chrono>
+#include <random>
+
+#include <sched.h>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "hdrhistogram.hpp"
+#define QLTUTOR_COUNT_ALLOCATIONS
+#include "allocations.hpp"
+
+// Tail latency of single-request pricing.
+//
+// A fixed, seeded request mix is replayed one request at a time against the pricing
+// functions of 16ameopt (American call through FDAmericanEngine, repriced after a spot
+// move, so the observer notification and the engine's lazy recalculation are part of
+// the request) and 14impvol (one implied vol: Bisection on BlackCalculator, and
+// VanillaOption::impliedVolatility, which builds its own process and engine). Every
+// call's latency goes into an HDR histogram per request kind, next to the number of
+// heap allocations it made.
+//
+//   QLTUTOR_LATENCY_REQUESTS   requests replayed after warmup (default 5000)
+//   QLTUTOR_LATENCY_CPU        pin the replaying thread to this core
+//   QLTUTOR_LATENCY_HISTORY    append a JSON line per run here, to track tails over time
+
+namespace {
+
+using namespace QuantLib;
+
+enum RequestKind { AmericanPrice, ImpliedVolBisection, ImpliedVolInstrument, RequestKinds };
+
+const char* requestKindName(RequestKind kind) {
+  static const char* names[] = { "americanFD", "impliedVolBisection", "impliedVolInstrument" };
+  return names[kind];
+}
+
+struct LatencyRequest {
+  RequestKind kind;
+  Size strikeIndex;
+  Real move;          // relative spot move for pricing, relative price move for IV
+};
+
+struct KindStatistics {
+  KindStatistics() : latency(1, 60ULL * 1000000000ULL, 3), allocations(1, 100000000ULL, 3), bytes(0) {}
+  qltutor::HdrHistogram latency;      // nanoseconds
+  qltutor::HdrHistogram allocations;  // per call
+  std::uint64_t bytes;
+};
+
+std::vector<LatencyRequest> requestMix(Size requests, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::discrete_distribution<int> kind({ 1, 12, 3 });   // FD pricing is the rare, heavy request
+  std::uniform_int_distribution<Size> strike(0, 6);
+  std::normal_distribution<double> move(0.0, .002);
+  std::vector<LatencyRequest> mix(requests);
+  for (LatencyRequest& request : mix) {
+    request.kind = RequestKind(kind(rng));
+    request.strikeIndex = strike(rng);
+    request.move = move(rng);
+  }
+  return mix;
+}
+
+bool pinToCpu(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+BOOST_AUTO_TEST_CASE(testSingleRequestTailLatency) {
+  using namespace boost::assign;
+  typedef std::chrono::steady_clock Clock;
+
+  const char* requestsVariable = std::getenv("QLTUTOR_LATENCY_REQUESTS");
+  Size requests = requestsVariable ? std::atol(requestsVariable) : 5000;
+  Size warmup = std::max<Size>(requests / 10, 50);
+
+  int cpu = -1;
+  if (const char* cpuVariable = std::getenv("QLTUTOR_LATENCY_CPU")) {
+    cpu = std::atoi(cpuVariable);
+    BOOST_REQUIRE_MESSAGE(pinToCpu(cpu), "cannot pin to cpu " << cpu);
+    std::cout << "Pinned to cpu " << cpu << std::endl;
+  }
+
+  // 16ameopt: INTC Feb 21 calls
+  Date today(15, Nov, 2013);
+  Settings::instance().evaluationDate() = today;
+  Date expiration(21, Feb, 2014);
+  std::vector<Real> strikes;
+  strikes += 22.0, 23.0, 24.0, 25.0, 26.0, 27.0, 28.0;
+  Real underlying = 24.52;
+  boost::shared_ptr<SimpleQuote> spot(new SimpleQuote(underlying));
+  Handle<YieldTermStructure> riskFree(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, .0024, Actual365Fixed())));
+  Handle<YieldTermStructure> dividends(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, .0098, Actual365Fixed())));
+  Handle<BlackVolTermStructure> volatility(boost::shared_ptr<BlackVolTermStructure>(
+    new BlackConstantVol(today, UnitedStates(UnitedStates::NYSE), .20128, Actual365Fixed())));
+  boost::shared_ptr<BlackScholesMertonProcess> process(
+    new BlackScholesMertonProcess(Handle<Quote>(spot), dividends, riskFree, volatility));
+  boost::shared_ptr<PricingEngine> fdEngine(new FDAmericanEngine<CrankNicolson>(process, 801, 800));
+  boost::shared_ptr<Exercise> americanExercise(new AmericanExercise(today, expiration));
+  std::vector<boost::shared_ptr<VanillaOption> > americanOptions;
+  for (Real strike : strikes) {
+    americanOptions.push_back(boost::shared_ptr<VanillaOption>(
+      new VanillaOption(boost::shared_ptr<StrikedTypePayoff>(new PlainVanillaPayoff(Option::Call, strike)), americanExercise)));
+    americanOptions.back()->setPricingEngine(fdEngine);
+  }
+
+  // 14impvol: ES puts, mid prices
+  std::vector<Real> esStrikes, esMids;
+  esStrikes += 1640, 1645, 1650, 1655, 1660, 1665, 1670;
+  esMids += 16.75, 18.25, 20.125, 22.0, 24.125, 26.5, 29.0;
+  Time timeToMaturity = .0686;
+  Real forward = 1656.25;
+  Rate esRate = .00273;
+  DiscountFactor discount = std::exp(-esRate * timeToMaturity);
+  Date esExpiration = today + Integer(timeToMaturity * 365 + .5);
+  std::vector<boost::shared_ptr<VanillaOption> > europeanOptions;
+  for (Real strike : esStrikes) {
+    europeanOptions.push_back(boost::shared_ptr<VanillaOption>(
+      new VanillaOption(boost::shared_ptr<StrikedTypePayoff>(new PlainVanillaPayoff(Option::Put, strike)),
+                        boost::shared_ptr<Exercise>(new EuropeanExercise(esExpiration)))));
+  }
+  // futures options: the forward is the spot, with the dividend yield equal to the rate
+  boost::shared_ptr<GeneralizedBlackScholesProcess> esProcess(new BlackScholesMertonProcess(
+    Handle<Quote>(boost::shared_ptr<Quote>(new SimpleQuote(forward))),
+    Handle<YieldTermStructure>(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, esRate, Actual365Fixed()))),
+    Handle<YieldTermStructure>(boost::shared_ptr<YieldTermStructure>(new FlatForward(today, esRate, Actual365Fixed()))),
+    Handle<BlackVolTermStructure>(boost::shared_ptr<BlackVolTermStructure>(
+      new BlackConstantVol(today, UnitedStates(UnitedStates::NYSE), .15, Actual365Fixed())))));
+
+  auto execute = [&](const LatencyRequest& request) -> Real {
+    switch (request.kind) {
+      case AmericanPrice:
+        spot->setValue(underlying * (1.0 + request.move));
+        return americanOptions[request.strikeIndex]->NPV();
+      case ImpliedVolBisection: {
+        Real price = esMids[request.strikeIndex] * (1.0 + request.move);
+        Bisection bisection;
+        return bisection.solve([&](Volatility sigma) {
+            BlackCalculator blackCalculator(Option::Put, esStrikes[request.strikeIndex], forward,
+                                            sigma * std::sqrt(timeToMaturity), discount);
+            return blackCalculator.value() - price;
+          }, 1e-6, .20, .05, .40);
+      }
+      default:
+        return europeanOptions[request.strikeIndex]->impliedVolatility(
+          esMids[request.strikeIndex] * (1.0 + request.move), esProcess, 1e-6, 100, .05, .40);
+    }
+  };
+
+  std::vector<LatencyRequest> mix = requestMix(warmup + requests, 2013);
+  std::vector<KindStatistics> statistics(RequestKinds);
+  KindStatistics all;
+  Real checksum = 0.0;
+
+  for (Size i = 0; i < mix.size(); ++i) {
+    qltutor::AllocationCounts before = qltutor::threadAllocations();
+    Clock::time_point start = Clock::now();
+    checksum += execute(mix[i]);
+    Clock::time_point end = Clock::now();
+    qltutor::AllocationCounts after = qltutor::threadAllocations();
+    if (i < warmup) continue;
+
+    std::uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    KindStatistics& kind = statistics[mix[i].kind];
+    kind.latency.record(nanoseconds);
+    kind.allocations.record(after.allocations - before.allocations);
+    kind.bytes += after.bytes - before.bytes;
+    all.latency.record(nanoseconds);
+    all.allocations.record(after.allocations - before.allocations);
+    all.bytes += after.bytes - before.bytes;
+  }
+  std::cout << boost::format("Replayed %d requests after %d warmup (checksum %.6f)") % requests % warmup % checksum << std::endl;
+
+  std::string history;
+  if (const char* historyVariable = std::getenv("QLTUTOR_LATENCY_HISTORY")) history = historyVariable;
+  std::ostringstream record;
+  record << "{ \"time\": " << std::time(0) << ", \"cpu\": " << cpu << ", \"requests\": " << requests;
+
+  for (int k = 0; k <= RequestKinds; ++k) {
+    const KindStatistics& s = k < RequestKinds ? statistics[k] : all;
+    const char* name = k < RequestKinds ? requestKindName(RequestKind(k)) : "all";
+    if (s.latency.count() == 0) continue;
+    std::cout << boost::format("%s: %d calls, latency us") % name % s.latency.count() << std::endl;
+    s.latency.printPercentiles(std::cout, 1e3, "us");
+    std::cout << boost::format("  allocations per call: mean %.1f p99 %d max %d, %.0f bytes per call")
+      % s.allocations.mean() % s.allocations.valueAtPercentile(99) % s.allocations.max()
+      % (double(s.bytes) / s.latency.count()) << std::endl;
+
+    record << boost::format(", \"%s\": { \"p50_ns\": %d, \"p99_ns\": %d, \"p999_ns\": %d, \"max_ns\": %d, \"allocations\": %.2f }")
+      % name % s.latency.valueAtPercentile(50) % s.latency.valueAtPercentile(99)
+      % s.latency.valueAtPercentile(99.9) % s.latency.max() % s.allocations.mean();
+  }
+  record << " }";
+
+  if (!history.empty()) {
+    std::ofstream out(history.c_str(), std::ios::app);
+    out << record.str() << std::endl;
+    std::cout << "Appended to " << history << std::endl;
+  }
+
+  BOOST_CHECK_EQUAL(all.latency.count(), requests);
+  BOOST_CHECK(all.allocations.max() > 0);   // the counting operator new is really in place
+}
+
+}
@@ -0,0 +1,199 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE COVEST
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <unistd.h>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "returnpanel.hpp"
+#include "cholesky.hpp"
+#include "er.hpp"
+
+// Covariance estimated from return panels instead of typed in: one pass over a
+// memory-mapped panel, then fed to the optimizers of 09lopt.
+
+namespace {
+
+using namespace QuantLib;
+
+// daily returns of n assets driven by `factors` common factors, observations x assets
+std::vector<double> simulateReturns(Size observations, Size n, Size factors, unsigned long seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gaussian;
+  std::vector<double> loadings(n * factors), returns(observations * n), f(factors);
+  for (Size i = 0; i < loadings.size(); ++i) loadings[i] = .006 * gaussian(rng);
+  for (Size t = 0; t < observations; ++t) {
+    for (Size k = 0; k < factors; ++k) f[k] = gaussian(rng);
+    for (Size i = 0; i < n; ++i) {
+      double r = .0003 + .01 * gaussian(rng);
+      for (Size k = 0; k < factors; ++k) r += loadings[i * factors + k] * f[k];
+      returns[t * n + i] = r;
+    }
+  }
+  return returns;
+}
+
+// textbook two passes: means, then weighted centered cross products over the total weight
+Matrix twoPassCovariance(const double* returns, Size observations, Size n, const std::vector<double>& weights) {
+  double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+  std::vector<double> mean(n, 0.0);
+  for (Size t = 0; t < observations; ++t) {
+    for (Size i = 0; i < n; ++i) mean[i] += weights[t] * returns[t * n + i] / total;
+  }
+  Matrix covariance(n, n, 0.0);
+  for (Size t = 0; t < observations; ++t) {
+    const double* x = returns + t * n;
+    for (Size i = 0; i < n; ++i) {
+      for (Size j = 0; j < n; ++j) covariance[i][j] += weights[t] * (x[i] - mean[i]) * (x[j] - mean[j]) / total;
+    }
+  }
+  return covariance;
+}
+
+Real relativeError(const Matrix& a, const Matrix& b) {
+  Real error = 0.0, scale = 0.0;
+  for (Size i = 0; i < a.rows(); ++i) {
+    for (Size j = 0; j < a.columns(); ++j) {
+      error = std::max(error, std::fabs(a[i][j] - b[i][j]));
+      scale = std::max(scale, std::fabs(b[i][j]));
+    }
+  }
+  return error / scale;
+}
+
+Real frobeniusDistance(const Matrix& a, const Matrix& b) {
+  Real s = 0.0;
+  for (Size i = 0; i < a.rows(); ++i) {
+    for (Size j = 0; j < a.columns(); ++j) s += (a[i][j] - b[i][j]) * (a[i][j] - b[i][j]);
+  }
+  return std::sqrt(s);
+}
+
+}
+
+// panel written to a snapshot, mapped back and accumulated by blocks on several threads
+BOOST_AUTO_TEST_CASE(testStreamingPanel) {
+  const Size observations = 500, n = 300;
+  std::vector<double> returns = simulateReturns(observations, n, 5, 1);
+
+  std::string path = str(boost::format("/tmp/qltutor-covest-%d.snap") % getpid());
+  qltutor::SnapshotWriter writer;
+  snapshotReturnPanel(writer, "returns.daily", observations, n, &returns[0]);
+  writer.write(path);
+
+  qltutor::CovarianceEstimatorOptions options;
+  options.blockSize = 48;        // neither divides the panel, so the edge tiles are exercised
+  options.timeBlock = 100;
+  options.threads = 4;
+  qltutor::CovarianceEstimator streamed(n, options);
+  {
+    qltutor::SnapshotView view(path);
+    addReturnPanel(streamed, view, "returns.daily", 128);
+  }
+  std::remove(path.c_str());
+
+  Matrix expected = twoPassCovariance(&returns[0], observations, n, std::vector<double>(observations, 1.0));
+  BOOST_CHECK_EQUAL(streamed.observations(), observations);
+  BOOST_CHECK_SMALL(relativeError(covarianceMatrix(streamed), expected), 1e-10);
+
+  qltutor::CovarianceEstimator rowByRow(n);
+  for (Size t = 0; t < observations; ++t) rowByRow.add(&returns[t * n]);
+  BOOST_CHECK_SMALL(relativeError(covarianceMatrix(rowByRow), expected), 1e-10);
+
+  // throughput on a larger panel
+  const Size largeObservations = 750, largeN = 2000;
+  std::vector<double> large = simulateReturns(largeObservations, largeN, 10, 2);
+  qltutor::CovarianceEstimator estimator(largeN);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  estimator.addPanel(&large[0], largeObservations, largeN);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << boost::format("%d x %d panel: %.3f s, %.2f GFlop/s")
+    % largeObservations % largeN % seconds % (largeObservations * double(largeN) * largeN / seconds / 1e9) << std::endl;
+}
+
+// fewer observations than assets: the sample covariance is singular, the shrunk one is not
+BOOST_AUTO_TEST_CASE(testLedoitWolfShrinkage) {
+  const Size observations = 120, n = 200, factors = 3;
+  std::mt19937 rng(3);
+  std::normal_distribution<double> gaussian;
+  std::vector<double> loadings(n * factors);
+  for (Size i = 0; i < loadings.size(); ++i) loadings[i] = .006 * gaussian(rng);
+  Matrix truth(n, n, 0.0);
+  for (Size i = 0; i < n; ++i) {
+    for (Size j = 0; j < n; ++j) {
+      for (Size k = 0; k < factors; ++k) truth[i][j] += loadings[i * factors + k] * loadings[j * factors + k];
+    }
+    truth[i][i] += .0001;
+  }
+  qltutor::CholeskyFactorization root(n, truth.begin(), n);
+  std::vector<double> returns(observations * n), z(n);
+  for (Size t = 0; t < observations; ++t) {
+    for (Size i = 0; i < n; ++i) z[i] = gaussian(rng);
+    for (Size i = 0; i < n; ++i) returns[t * n + i] = std::inner_product(z.begin(), z.begin() + i + 1, root.lower() + i * n, 0.0);
+  }
+
+  qltutor::CovarianceEstimator estimator(n);
+  estimator.addPanel(&returns[0], observations, n);
+  Real intensity = estimator.shrinkageIntensity();
+  std::cout << boost::format("Ledoit-Wolf intensity with %d observations of %d assets: %.4f") % observations % n % intensity << std::endl;
+  BOOST_CHECK(intensity > 0.0 && intensity < 1.0);
+
+  Matrix sample = covarianceMatrix(estimator), shrunk = covarianceMatrix(estimator, true);
+  // the sample covariance has rank observations - 1; every eigenvalue of the shrunk one
+  // is at least intensity * tr(S)/n, and so is every squared Cholesky pivot
+  Real trace = 0.0;
+  for (Size i = 0; i < n; ++i) trace += sample[i][i];
+  qltutor::CholeskyFactorization factorization(n, shrunk.begin(), n);
+  BOOST_CHECK(factorization.minPivot() * factorization.minPivot() >= intensity * trace / n * (1.0 - 1e-10));
+  std::cout << boost::format("Shrunk covariance condition number: %.1f") % factorization.conditionEstimate() << std::endl;
+  BOOST_CHECK(frobeniusDistance(shrunk, truth) < frobeniusDistance(sample, truth));
+
+  // straight into the optimizers' cost functions
+  Array equalWeights(n - 1, 1.0 / n), portfolio(n, 1.0 / n);
+  MeanVarianceFunction meanVariance(shrunk);
+  Real variance = qltutor::quadraticForm(n, shrunk.begin(), n, portfolio.begin());
+  BOOST_CHECK_CLOSE(meanVariance.value(equalWeights), variance, 1e-10);
+  EqualRiskContributionFunction riskContributions(shrunk);
+  Array contributions = riskContributions.values(portfolio);
+  BOOST_CHECK_CLOSE(std::accumulate(contributions.begin(), contributions.end(), 0.0), variance, 1e-10);
+
+  Matrix weights = WeightsMV(false, n, shrunk);
+  BOOST_CHECK_CLOSE(std::accumulate(weights.begin(), weights.end(), 0.0), 1.0, 1e-10);
+  BOOST_CHECK(qltutor::quadraticForm(n, shrunk.begin(), n, weights.begin()) <= variance);
+}
+
+// a rolling window by add/remove, and exponential weights, against explicit weighted estimates
+BOOST_AUTO_TEST_CASE(testRollingAndExponentialWindows) {
+  const Size observations = 600, n = 40, window = 250;
+  std::vector<double> returns = simulateReturns(observations, n, 3, 4);
+
+  qltutor::CovarianceEstimator rolling(n);
+  for (Size t = 0; t < observations; ++t) {
+    rolling.add(&returns[t * n]);
+    if (t >= window) rolling.remove(&returns[(t - window) * n]);
+  }
+  BOOST_CHECK_EQUAL(rolling.observations(), window);
+  Matrix lastWindow = twoPassCovariance(&returns[(observations - window) * n], window, n, std::vector<double>(window, 1.0));
+  BOOST_CHECK_SMALL(relativeError(covarianceMatrix(rolling), lastWindow), 1e-9);
+
+  qltutor::CovarianceEstimatorOptions options;
+  options.halfLife = 60;
+  qltutor::CovarianceEstimator exponential(n, options);
+  exponential.addPanel(&returns[0], 400, n);
+  for (Size t = 400; t < observations; ++t) exponential.add(&returns[t * n]);
+  std::vector<double> weights(observations);
+  for (Size t = 0; t < observations; ++t) weights[t] = std::pow(.5, (observations - 1 - t) / 60.0);
+  BOOST_CHECK_SMALL(relativeError(covarianceMatrix(exponential), twoPassCovariance(&returns[0], observations, n, weights)), 1e-10);
+  std::cout << boost::format("Half-life 60: %.1f effective observations of %d") % exponential.effectiveObservations() % observations << std::endl;
+  BOOST_CHECK_THROW(exponential.remove(&returns[0]), std::logic_error);
+}
@@ -0,0 +1,47 @@
+#ifndef QLTUTOR_RETURNPANEL_HPP
+#define QLTUTOR_RETURNPANEL_HPP
+
+#include <string>
+#include <algorithm>
+
+#include <ql/quantlib.hpp>
+
+#include "snapshot.hpp"
+#include "covest.hpp"
+
+// QuantLib glue for qltutor::CovarianceEstimator.
+//
+// Return panels are stored as SnapshotReturnPanel sections, observations x assets, so
+// a SnapshotView hands the estimator the mapped rows directly. The estimate comes back
+// as a QuantLib::Matrix, which is what MeanVarianceFunction,
+// EqualRiskContributionFunction and WeightsMV/WeightsERC take.
+
+inline void snapshotReturnPanel(qltutor::SnapshotWriter& writer, const std::string& name,
+                                QuantLib::Size observations, QuantLib::Size assets, const double* returns) {
+  writer.add(name, qltutor::SnapshotReturnPanel, observations, assets, returns);
+}
+
+// adds every observation of a mapped panel, in blocks of `observationsPerPanel` rows
+inline void addReturnPanel(qltutor::CovarianceEstimator& estimator, const qltutor::SnapshotView& view,
+                           const std::string& name, QuantLib::Size observationsPerPanel = 4096) {
+  qltutor::SnapshotView::Array panel = view.array(name);
+  QL_REQUIRE(panel.columns == estimator.size(),
+             "return panel " << name << " has " << panel.columns << " assets, estimator " << estimator.size());
+  for (QuantLib::Size t = 0; t < panel.rows; t += observationsPerPanel) {
+    QuantLib::Size rows = std::min(observationsPerPanel, panel.rows - t);
+    estimator.addPanel(panel.data + t * panel.columns, rows, panel.columns);
+  }
+}
+
+// the sample covariance, or its Ledoit-Wolf shrinkage
+inline QuantLib::Matrix covarianceMatrix(const qltutor::CovarianceEstimator& estimator, bool shrink = false) {
+  QuantLib::Matrix covariance(estimator.size(), estimator.size());
+  if (shrink) {
+    estimator.shrunkCovariance(covariance.begin(), covariance.columns());
+  } else {
+    estimator.covariance(covariance.begin(), covariance.columns());
+  }
+  return covariance;
+}
+
+#endif
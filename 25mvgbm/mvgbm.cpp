@@ -0,0 +1,210 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE MVGBM
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <thread>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "multiassetgbm.hpp"
+#include "covest.hpp"
+#include "streamingstats.hpp"
+
+// Correlated GBM paths for the portfolios of 10ef/11popt: the optimizers' covariance
+// and expected returns in, joint price paths out.
+
+namespace {
+
+using namespace QuantLib;
+
+// AAPL, IBM, ORCL, GOOG as in 11popt
+Matrix portfolioCovariance() {
+  Matrix covariance(4, 4);
+  covariance[0][0] = .10;  covariance[0][1] = .03; covariance[0][2] = -.08; covariance[0][3] = .05;
+  covariance[1][0] = .03;  covariance[1][1] = .20; covariance[1][2] = .02;  covariance[1][3] = .03;
+  covariance[2][0] = -.08; covariance[2][1] = .02; covariance[2][2] = .30;  covariance[2][3] = .20;
+  covariance[3][0] = .05;  covariance[3][1] = .03; covariance[3][2] = .20;  covariance[3][3] = .90;
+  return covariance;
+}
+
+// log returns over the whole horizon, one row per path, filled concurrently by block
+struct TerminalLogReturns {
+  TerminalLogReturns(Size paths, Size assets) : assets_(assets), returns(paths * assets) {}
+  void operator()(const qltutor::GbmPathBlock& block, unsigned) {
+    for (Size i = 0; i < block.assets; ++i) {
+      const double* start = block.slice(0, i);
+      const double* end = block.slice(block.steps, i);
+      for (Size p = 0; p < block.width; ++p) returns[(block.firstPath + p) * assets_ + i] = std::log(end[p] / start[p]);
+    }
+  }
+  Size assets_;
+  std::vector<double> returns;
+};
+
+// sum of terminal prices per block, in block order whatever thread ran it
+struct BlockChecksums {
+  explicit BlockChecksums(Size blocks) : sums(blocks, 0.0) {}
+  void operator()(const qltutor::GbmPathBlock& block, unsigned) {
+    for (Size i = 0; i < block.assets; ++i) {
+      const double* end = block.slice(block.steps, i);
+      for (Size p = 0; p < block.width; ++p) sums[block.block] += end[p];
+    }
+  }
+  std::vector<double> sums;
+};
+
+// statistics of the terminal log returns of asset 0, one accumulator per thread
+struct ThreadStatistics {
+  explicit ThreadStatistics(unsigned threads) : statistics(threads), returns(threads) {}
+  void operator()(const qltutor::GbmPathBlock& block, unsigned thread) {
+    std::vector<double>& x = returns[thread];
+    x.resize(block.width);
+    const double* start = block.slice(0, 0);
+    const double* end = block.slice(block.steps, 0);
+    for (Size p = 0; p < block.width; ++p) x[p] = std::log(end[p] / start[p]);
+    statistics[thread].add(&x[0], block.width);
+  }
+  std::vector<qltutor::StreamingStatistics> statistics;
+  std::vector<std::vector<double> > returns;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(testCorrelatedTerminalMoments) {
+  Matrix covariance = portfolioCovariance();
+  Real expectedReturns[] = { .08, .09, .10, .11 }, spots[] = { 520.0, 185.0, 37.0, 1100.0 };
+  const Size paths = 100000, steps = 12;
+  const Time length = 1.0;
+
+  qltutor::MultiAssetGbm gbm(4, spots, expectedReturns, covariance.begin(), covariance.columns(), length, steps);
+  TerminalLogReturns terminal(paths, 4);
+  gbm.simulate(paths, terminal);
+
+  // log returns are normal with covariance S T and mean (mu - S_ii / 2) T
+  qltutor::CovarianceEstimator estimator(4);
+  estimator.addPanel(&terminal.returns[0], paths, 4);
+  Matrix sample(4, 4);
+  estimator.covariance(sample.begin(), 4);
+  for (Size i = 0; i < 4; ++i) {
+    Real mean = 0.0, growth = 0.0;
+    for (Size p = 0; p < paths; ++p) {
+      mean += terminal.returns[p * 4 + i] / paths;
+      growth += std::exp(terminal.returns[p * 4 + i]) / paths;
+    }
+    Real sigma = std::sqrt(covariance[i][i] * length);
+    BOOST_CHECK_SMALL(mean - (expectedReturns[i] - .5 * covariance[i][i]) * length, 5 * sigma / std::sqrt(Real(paths)));
+    Real growthError = std::sqrt((std::exp(sigma * sigma) - 1) / paths) * std::exp(expectedReturns[i] * length);
+    BOOST_CHECK_SMALL(growth - std::exp(expectedReturns[i] * length), 5 * growthError);
+    for (Size j = 0; j < 4; ++j) {
+      Real standardError = std::sqrt((covariance[i][i] * covariance[j][j] + covariance[i][j] * covariance[i][j]) / paths) * length;
+      BOOST_CHECK_SMALL(sample[i][j] - covariance[i][j] * length, 5 * standardError);
+    }
+  }
+  std::cout << "Sample covariance of simulated annual log returns" << std::endl << sample << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(testReproducibleAcrossThreads) {
+  Matrix covariance = portfolioCovariance();
+  Real expectedReturns[] = { .08, .09, .10, .11 }, spots[] = { 520.0, 185.0, 37.0, 1100.0 };
+  const Size paths = 10000;
+
+  std::vector<double> reference;
+  for (unsigned threads : { 1, 2, 4 }) {
+    qltutor::MultiAssetGbmOptions options;
+    options.threads = threads;
+    qltutor::MultiAssetGbm gbm(4, spots, expectedReturns, covariance.begin(), 4, 1.0, 52, options);
+    BlockChecksums checksums(gbm.blocks(paths));
+    gbm.simulate(paths, checksums);
+    if (reference.empty()) {
+      reference = checksums.sums;
+    } else {
+      BOOST_CHECK(checksums.sums == reference);
+    }
+  }
+}
+
+// constant-memory statistics merged across threads, against GeneralStatistics holding every sample
+BOOST_AUTO_TEST_CASE(testStreamingStatistics) {
+  Matrix covariance = portfolioCovariance();
+  Real expectedReturns[] = { .08, .09, .10, .11 }, spots[] = { 520.0, 185.0, 37.0, 1100.0 };
+  const Size paths = 200000;
+  qltutor::MultiAssetGbmOptions options;
+  options.threads = 4;
+  qltutor::MultiAssetGbm gbm(4, spots, expectedReturns, covariance.begin(), 4, 1.0, 12, options);
+
+  ThreadStatistics perThread(gbm.threads());
+  gbm.simulate(paths, perThread);
+  qltutor::StreamingStatistics streamed;
+  for (Size t = 0; t < perThread.statistics.size(); ++t) streamed.merge(perThread.statistics[t]);
+
+  TerminalLogReturns terminal(paths, 4);
+  gbm.simulate(paths, terminal);
+  GeneralStatistics stored;
+  for (Size p = 0; p < paths; ++p) stored.add(terminal.returns[p * 4]);
+
+  BOOST_CHECK_EQUAL(streamed.samples(), stored.samples());
+  BOOST_CHECK_CLOSE(streamed.mean(), stored.mean(), 1e-9);
+  BOOST_CHECK_CLOSE(streamed.variance(), stored.variance(), 1e-9);
+  BOOST_CHECK_CLOSE(streamed.skewness(), stored.skewness(), 1e-6);
+  BOOST_CHECK_CLOSE(streamed.kurtosis(), stored.kurtosis(), 1e-6);
+  BOOST_CHECK_EQUAL(streamed.min(), stored.min());
+  BOOST_CHECK_EQUAL(streamed.max(), stored.max());
+  for (Real p : { .01, .5, .99 }) {
+    // the sketch is within about a percent of rank of the stored sample
+    Real estimate = streamed.percentile(p);
+    BOOST_CHECK(stored.percentile(std::max(p - .01, 1e-4)) <= estimate && estimate <= stored.percentile(p + .01));
+  }
+  std::cout << boost::format("Terminal log return of AAPL: mean %.4f, sd %.4f, skew %.4f, kurtosis %.4f, median %.4f")
+    % streamed.mean() % streamed.standardDeviation() % streamed.skewness() % streamed.kurtosis() % streamed.median() << std::endl;
+}
+
+// thousands of assets: a dense covariance costs O(n^2) a step, a k-factor model O(nk)
+BOOST_AUTO_TEST_CASE(testLargeUniverse) {
+  typedef std::chrono::steady_clock Clock;
+  const Size factors = 20, steps = 21, paths = 256;
+  std::mt19937 rng(40);
+  std::normal_distribution<double> gaussian;
+  Matrix factorCovariance(factors, factors, 0.0);
+  for (Size k = 0; k < factors; ++k) factorCovariance[k][k] = .02;
+
+  unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << "assets   model    threads   s        M asset-steps/s" << std::endl;
+  for (Size n : { 1000, 5000 }) {
+    std::vector<double> loadings(n * factors), specific(n, .03), spots(n, 100.0), drifts(n, .07);
+    for (Size i = 0; i < loadings.size(); ++i) loadings[i] = .5 * gaussian(rng);
+    qltutor::FactorCovariance model(n, factors, &loadings[0], factors, factorCovariance.begin(), factors, &specific[0]);
+    Matrix dense(n <= 1000 ? n : 0, n <= 1000 ? n : 0);
+    if (n <= 1000) model.copyTo(dense.begin(), n);
+
+    for (unsigned threads : { 1u, hardware }) {
+      qltutor::MultiAssetGbmOptions options;
+      options.threads = threads;
+      for (bool factor : { true, false }) {
+        if (!factor && dense.empty()) continue;
+        boost::shared_ptr<qltutor::MultiAssetGbm> gbm(factor
+          ? new qltutor::MultiAssetGbm(model, &spots[0], &drifts[0], 1.0 / 12, steps, options)
+          : new qltutor::MultiAssetGbm(n, &spots[0], &drifts[0], dense.begin(), n, 1.0 / 12, steps, options));
+        TerminalLogReturns terminal(paths, n);
+        Clock::time_point start = Clock::now();
+        gbm->simulate(paths, terminal);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << boost::format("%6d   %-6s   %7d   %.3f   %.1f")
+          % n % (factor ? "factor" : "dense") % threads % seconds % (paths * steps * double(n) / seconds / 1e6) << std::endl;
+
+        // the monthly variance of the first asset, within sampling error
+        Real mean = 0.0, variance = 0.0;
+        for (Size p = 0; p < paths; ++p) mean += terminal.returns[p * n] / paths;
+        for (Size p = 0; p < paths; ++p) variance += (terminal.returns[p * n] - mean) * (terminal.returns[p * n] - mean) / (paths - 1);
+        Real expected = model.covariance(0, 0) / 12;
+        BOOST_CHECK_SMALL(variance - expected, 5 * expected * std::sqrt(2.0 / paths));
+      }
+      if (hardware == 1) break;
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef QLTUTOR_BOOKREVALUATION_HPP
+#define QLTUTOR_BOOKREVALUATION_HPP
+
+#include <vector>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+
+#include "multiassetgbm.hpp"
+
+// A book of shares and European options on the simulated assets, revalued at the VaR
+// horizon for qltutor::monteCarloVar.
+//
+// Delta and DeltaGamma expand every option around today's spot with the greeks of
+// BlackScholesCalculator (as in 13greeks); Full prices it again at the scenario's spot
+// with the maturity shortened by the horizon, which is what the expansions miss for
+// large moves and short-dated strikes. Volatilities and the rate stay as they are.
+
+struct OptionPosition {
+  QuantLib::Size asset;
+  QuantLib::Option::Type type;
+  QuantLib::Real strike;
+  QuantLib::Time maturity;
+  QuantLib::Volatility volatility;
+  QuantLib::Real contracts;       // negative for written options
+};
+
+class BookRevaluation {
+  public:
+    enum Method { Delta, DeltaGamma, Full };
+
+    BookRevaluation(const std::vector<QuantLib::Real>& spots, const std::vector<QuantLib::Real>& shares,
+                    const std::vector<OptionPosition>& options, QuantLib::Rate riskFree, QuantLib::Time horizon, Method method)
+      : shares_(shares), options_(options), riskFree_(riskFree), horizon_(horizon), method_(method)
+      , delta_(shares), gamma_(spots.size(), 0.0), value_(options.size()) {
+      for (QuantLib::Size k = 0; k < options_.size(); ++k) {
+        const OptionPosition& option = options_[k];
+        QL_REQUIRE(option.maturity > horizon_, "options must outlive the VaR horizon");
+        QuantLib::BlackScholesCalculator calculator = price(option, spots[option.asset], option.maturity);
+        value_[k] = calculator.value();
+        delta_[option.asset] += option.contracts * calculator.delta();
+        gamma_[option.asset] += option.contracts * calculator.gamma();
+      }
+    }
+
+    // today's value of the options
+    QuantLib::Real optionValue() const {
+      QuantLib::Real total = 0.0;
+      for (QuantLib::Size k = 0; k < options_.size(); ++k) total += options_[k].contracts * value_[k];
+      return total;
+    }
+
+    void operator()(const qltutor::GbmPathBlock& block, double* pnl) const {
+      std::fill(pnl, pnl + block.width, 0.0);
+      for (QuantLib::Size i = 0; i < block.assets; ++i) {
+        const double* today = block.slice(0, i);
+        const double* horizon = block.slice(block.steps, i);
+        QuantLib::Real delta = method_ == Full ? shares_[i] : delta_[i];
+        QuantLib::Real halfGamma = method_ == DeltaGamma ? .5 * gamma_[i] : 0.0;
+        for (QuantLib::Size p = 0; p < block.width; ++p) {
+          QuantLib::Real move = horizon[p] - today[p];
+          pnl[p] += (delta + halfGamma * move) * move;
+        }
+      }
+      if (method_ != Full) return;
+      for (QuantLib::Size k = 0; k < options_.size(); ++k) {
+        const OptionPosition& option = options_[k];
+        const double* horizon = block.slice(block.steps, option.asset);
+        for (QuantLib::Size p = 0; p < block.width; ++p) {
+          pnl[p] += option.contracts * (price(option, horizon[p], option.maturity - horizon_).value() - value_[k]);
+        }
+      }
+    }
+
+  private:
+    QuantLib::BlackScholesCalculator price(const OptionPosition& option, QuantLib::Real spot, QuantLib::Time maturity) const {
+      // QL requires sigma * sqrt(T) instead of plain sigma
+      return QuantLib::BlackScholesCalculator(option.type, option.strike, spot, 1.0, option.volatility * std::sqrt(maturity),
+                                              std::exp(-riskFree_ * maturity));
+    }
+
+    std::vector<QuantLib::Real> shares_;
+    std::vector<OptionPosition> options_;
+    QuantLib::Rate riskFree_;
+    QuantLib::Time horizon_;
+    Method method_;
+    std::vector<QuantLib::Real> delta_, gamma_, value_;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE MCVAR
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <numeric>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "montecarlovar.hpp"
+#include "bookrevaluation.hpp"
+
+// One-day VaR and expected shortfall of the 11popt assets, and of options on them, from
+// the scenarios of 25mvgbm: losses go into quantile sketches, not into a vector.
+
+namespace {
+
+using namespace QuantLib;
+
+// AAPL, IBM, ORCL, GOOG as in 11popt
+Matrix portfolioCovariance() {
+  Matrix covariance(4, 4);
+  covariance[0][0] = .10;  covariance[0][1] = .03; covariance[0][2] = -.08; covariance[0][3] = .05;
+  covariance[1][0] = .03;  covariance[1][1] = .20; covariance[1][2] = .02;  covariance[1][3] = .03;
+  covariance[2][0] = -.08; covariance[2][1] = .02; covariance[2][2] = .30;  covariance[2][3] = .20;
+  covariance[3][0] = .05;  covariance[3][1] = .03; covariance[3][2] = .20;  covariance[3][3] = .90;
+  return covariance;
+}
+
+const Real expectedReturns[] = { .08, .09, .10, .11 }, spots[] = { 520.0, 185.0, 37.0, 1100.0 };
+const Time oneDay = 1.0 / 252;
+
+// exposures to log returns: the P&L is exactly normal, so VaR and ES are known
+struct LogReturnExposure {
+  explicit LogReturnExposure(const std::vector<Real>& amounts) : amounts(amounts) {}
+  void operator()(const qltutor::GbmPathBlock& block, double* pnl) const {
+    std::fill(pnl, pnl + block.width, 0.0);
+    for (Size i = 0; i < block.assets; ++i) {
+      const double* today = block.slice(0, i);
+      const double* horizon = block.slice(block.steps, i);
+      for (Size p = 0; p < block.width; ++p) pnl[p] += amounts[i] * std::log(horizon[p] / today[p]);
+    }
+  }
+  std::vector<Real> amounts;
+};
+
+void print(const std::string& name, const qltutor::MonteCarloVarResult& result) {
+  std::cout << boost::format("%-12s VaR %9.2f [%9.2f, %9.2f]   ES %9.2f [%9.2f, %9.2f]   mean P&L %8.2f")
+    % name % result.valueAtRisk % result.valueAtRiskLow % result.valueAtRiskHigh
+    % result.expectedShortfall % result.expectedShortfallLow % result.expectedShortfallHigh % result.meanPnl << std::endl;
+}
+
+}
+
+// the sketch against sorting everything, split over sketches merged afterwards
+BOOST_AUTO_TEST_CASE(testQuantileSketch) {
+  const Size n = 1000000, parts = 16;
+  std::mt19937_64 rng(41);
+  std::student_t_distribution<double> fatTailed(4.0);
+  std::vector<double> losses(n);
+  for (Size i = 0; i < n; ++i) losses[i] = fatTailed(rng);
+
+  qltutor::QuantileSketch merged(256, true);
+  for (Size part = 0; part < parts; ++part) {
+    qltutor::QuantileSketch sketch(256, true, part + 1);
+    sketch.add(&losses[part * n / parts], n / parts);
+    merged.merge(sketch);
+  }
+  BOOST_CHECK_EQUAL(merged.count(), n);
+
+  std::vector<double> sorted(losses);
+  std::sort(sorted.begin(), sorted.end());
+  BOOST_CHECK_EQUAL(merged.max(), sorted.back());
+  for (Real q : { .9, .99, .999 }) {
+    // rank error as a fraction of the tail beyond q
+    Real estimate = merged.quantile(q);
+    Real rank = Real(std::upper_bound(sorted.begin(), sorted.end(), estimate) - sorted.begin()) / n;
+    Size tail = Size((1.0 - q) * n);
+    Real shortfall = std::accumulate(sorted.end() - tail, sorted.end(), 0.0) / tail;
+    std::cout << boost::format("q = %.3f: quantile %.4f (exact %.4f), tail rank error %.2f%%, tail mean %.4f (exact %.4f)")
+      % q % estimate % sorted[Size(q * n)] % (100 * (rank - q) / (1.0 - q)) % merged.tailMean(q) % shortfall << std::endl;
+    BOOST_CHECK_SMALL((rank - q) / (1.0 - q), .05);
+    BOOST_CHECK_CLOSE(merged.tailMean(q), shortfall, 1.0);
+  }
+  std::cout << boost::format("%d losses in %d bytes") % n % (merged.retained() * sizeof(double)) << std::endl;
+}
+
+// P&L linear in log returns is normal: VaR = z s - m and ES = s phi(z) / (1 - c) - m
+BOOST_AUTO_TEST_CASE(testNormalPortfolio) {
+  Matrix covariance = portfolioCovariance();
+  std::vector<Real> amounts = { 52000.0, 37000.0, 37000.0, 55000.0 };
+  qltutor::MultiAssetGbm scenarios(4, spots, expectedReturns, covariance.begin(), 4, oneDay, 1);
+  qltutor::MonteCarloVarResult result = qltutor::monteCarloVar(scenarios, 1000000, LogReturnExposure(amounts));
+  print("normal", result);
+
+  Real mean = 0.0, variance = 0.0;
+  for (Size i = 0; i < 4; ++i) {
+    mean += amounts[i] * (expectedReturns[i] - .5 * covariance[i][i]) * oneDay;
+    for (Size j = 0; j < 4; ++j) variance += amounts[i] * covariance[i][j] * amounts[j] * oneDay;
+  }
+  Real z = InverseCumulativeNormal()(result.confidence), sigma = std::sqrt(variance);
+  Real valueAtRisk = z * sigma - mean, expectedShortfall = sigma * NormalDistribution()(z) / (1.0 - result.confidence) - mean;
+  std::cout << boost::format("analytic     VaR %9.2f                           ES %9.2f") % valueAtRisk % expectedShortfall << std::endl;
+  BOOST_CHECK_CLOSE(result.valueAtRisk, valueAtRisk, 1.0);
+  BOOST_CHECK_CLOSE(result.expectedShortfall, expectedShortfall, 1.0);
+  // a 95% interval, given some slack for the sketch
+  Real slack = .5 * (result.valueAtRiskHigh - result.valueAtRiskLow);
+  BOOST_CHECK(result.valueAtRiskLow - slack < valueAtRisk && valueAtRisk < result.valueAtRiskHigh + slack);
+  BOOST_CHECK(result.expectedShortfallLow - slack < expectedShortfall && expectedShortfall < result.expectedShortfallHigh + slack);
+
+  // the same scenarios and estimates on any number of threads
+  qltutor::MultiAssetGbmOptions options;
+  options.threads = 3;
+  qltutor::MultiAssetGbm threaded(4, spots, expectedReturns, covariance.begin(), 4, oneDay, 1, options);
+  qltutor::MonteCarloVarResult again = qltutor::monteCarloVar(threaded, 1000000, LogReturnExposure(amounts));
+  BOOST_CHECK_EQUAL(again.valueAtRisk, result.valueAtRisk);
+  BOOST_CHECK_EQUAL(again.expectedShortfall, result.expectedShortfall);
+}
+
+// short-dated options: delta and delta-gamma against full repricing
+BOOST_AUTO_TEST_CASE(testOptionBook) {
+  typedef std::chrono::steady_clock Clock;
+  Matrix covariance = portfolioCovariance();
+  std::vector<Real> spotVector(spots, spots + 4), shares = { 100.0, 200.0, 1000.0, 0.0 };
+  std::vector<OptionPosition> options = {
+    { 0, Option::Put, 500.0, 1.0 / 12, std::sqrt(covariance[0][0]), 100.0 },     // protective puts
+    { 1, Option::Call, 190.0, 1.0 / 12, std::sqrt(covariance[1][1]), -200.0 },   // covered calls
+    { 3, Option::Call, 1100.0, 1.0 / 52, std::sqrt(covariance[3][3]), -40.0 },   // written at the money
+    { 3, Option::Put, 1000.0, 1.0 / 52, std::sqrt(covariance[3][3]), -40.0 }
+  };
+  const Rate riskFree = .03;
+  const Size count = 200000;
+  qltutor::MultiAssetGbm scenarios(4, spots, expectedReturns, covariance.begin(), 4, oneDay, 1);
+
+  std::vector<qltutor::MonteCarloVarResult> results;
+  const char* names[] = { "delta", "delta-gamma", "full" };
+  for (BookRevaluation::Method method : { BookRevaluation::Delta, BookRevaluation::DeltaGamma, BookRevaluation::Full }) {
+    BookRevaluation book(spotVector, shares, options, riskFree, oneDay, method);
+    Clock::time_point start = Clock::now();
+    results.push_back(qltutor::monteCarloVar(scenarios, count, book));
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    print(names[method], results.back());
+    std::cout << boost::format("             %.0f scenarios/s on %d threads, %d bytes of sketch instead of %d of losses")
+      % (count / seconds) % scenarios.threads() % results.back().sketchBytes % (count * sizeof(double)) << std::endl;
+  }
+  // the book is short gamma: delta understates the tail; delta-gamma is nearer but
+  // overshoots, since the gamma of the weekly options fades away from their strikes
+  const qltutor::MonteCarloVarResult& delta = results[0], & deltaGamma = results[1], & full = results[2];
+  BOOST_CHECK(full.expectedShortfall > delta.expectedShortfall);
+  BOOST_CHECK(std::fabs(deltaGamma.expectedShortfall - full.expectedShortfall) < std::fabs(delta.expectedShortfall - full.expectedShortfall));
+  BOOST_CHECK(full.valueAtRisk < full.expectedShortfall);
+}
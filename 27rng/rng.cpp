@@ -0,0 +1,195 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE RNG
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+#include <boost/math/distributions/chi_squared.hpp>
+
+#include "philoxrsg.hpp"
+#include "streamingstats.hpp"
+
+// Counter-based random numbers for the path generators of 17brownie: Philox words in
+// bulk, normals by the ziggurat, and the sequence-generator interface PathGenerator
+// expects, against Mersenne Twister feeding Box-Muller one number at a time.
+
+namespace {
+
+using namespace QuantLib;
+
+// P(sqrt(n) D > lambda) for the Kolmogorov-Smirnov statistic D
+Real kolmogorovPValue(Real lambda) {
+  if (lambda < .2) return 1.0;
+  Real p = 0.0;
+  for (int k = 1; k <= 100; ++k) p += 2.0 * ((k % 2) ? 1.0 : -1.0) * std::exp(-2.0 * k * k * lambda * lambda);
+  return std::min(1.0, std::max(0.0, p));
+}
+
+Real chiSquarePValue(const std::vector<Size>& counts, Real expected) {
+  Real statistic = 0.0;
+  for (Size i = 0; i < counts.size(); ++i) statistic += (counts[i] - expected) * (counts[i] - expected) / expected;
+  return boost::math::cdf(boost::math::complement(boost::math::chi_squared(counts.size() - 1.0), statistic));
+}
+
+}
+
+// the known-answer vectors of Random123, and bulk, scalar and skip-ahead agreeing
+BOOST_AUTO_TEST_CASE(testPhiloxKnownAnswers) {
+  std::uint32_t out[4];
+  qltutor::Philox4x32::block(0, 0, 0, out);
+  BOOST_CHECK(out[0] == 0x6627e8d5 && out[1] == 0xe169c58d && out[2] == 0xbc57ac4c && out[3] == 0x9b00dbd8);
+  qltutor::Philox4x32::block(~0ULL, ~0ULL, ~0ULL, out);
+  BOOST_CHECK(out[0] == 0x408f276d && out[1] == 0x41c83b0e && out[2] == 0xa20bc7c6 && out[3] == 0x6d5451fd);
+  qltutor::Philox4x32::block(0x299f31d0a4093822ULL, 0x0370734413198a2eULL, 0x85a308d3243f6a88ULL, out);
+  BOOST_CHECK(out[0] == 0xd16cfe09 && out[1] == 0x94fdcceb && out[2] == 0x5001e420 && out[3] == 0x24126ea1);
+
+  qltutor::Philox4x32 bulk(7, 3), scalar(7, 3), skipping(7, 3);
+  std::vector<std::uint32_t> words(1003);
+  bulk();
+  bulk.fill(&words[0], words.size());
+  scalar();
+  for (Size i = 0; i < words.size(); ++i) BOOST_REQUIRE_EQUAL(words[i], scalar());
+  skipping.discard(501);
+  BOOST_CHECK_EQUAL(skipping(), words[500]);
+
+  // normals do not depend on how they are asked for
+  qltutor::Philox4x32 once(9, 2), inPieces(9, 2);
+  std::vector<double> all(1000), pieces(1000);
+  qltutor::ZigguratNormal::fill(once, &all[0], all.size());
+  for (Size i = 0; i < pieces.size();) {
+    Size size = std::min<Size>(pieces.size() - i, 1 + i % 37);
+    qltutor::ZigguratNormal::fill(inPieces, &pieces[i], size);
+    i += size;
+  }
+  BOOST_CHECK(all == pieces);
+  BOOST_CHECK_EQUAL(once.position(), inPieces.position());
+}
+
+BOOST_AUTO_TEST_CASE(testStatisticalQuality) {
+  const Size n = 4000000, bins = 1000;
+
+  // uniforms: equidistribution, and pairs of consecutive draws on a 32 x 32 grid
+  qltutor::Philox4x32 generator(2012);
+  std::vector<double> u(n);
+  generator.fillUniform(&u[0], n);
+  std::vector<Size> counts(bins, 0), pairs(32 * 32, 0);
+  Real lagProduct = 0.0;
+  for (Size i = 0; i < n; ++i) {
+    ++counts[Size(u[i] * bins)];
+    if (i % 2) ++pairs[Size(u[i - 1] * 32) * 32 + Size(u[i] * 32)];
+    if (i) lagProduct += (u[i - 1] - .5) * (u[i] - .5);
+  }
+  Real uniformP = chiSquarePValue(counts, Real(n) / bins), pairP = chiSquarePValue(pairs, n / 2.0 / (32 * 32));
+  Real lagCorrelation = lagProduct / (n - 1) * 12.0;
+  std::cout << boost::format("uniforms: chi-square p %.3f (%d bins), pairs p %.3f, lag-1 correlation %.2e")
+    % uniformP % bins % pairP % lagCorrelation << std::endl;
+  BOOST_CHECK(uniformP > 1e-4 && pairP > 1e-4);
+  BOOST_CHECK_SMALL(lagCorrelation, 5.0 / std::sqrt(Real(n)));
+
+  // normals: moments, Kolmogorov-Smirnov, the tail beyond the ziggurat's base strip
+  std::vector<double> z(n);
+  qltutor::ZigguratNormal::fill(generator, &z[0], n);
+  qltutor::MomentAccumulator moments;
+  moments.add(&z[0], n);
+  std::sort(z.begin(), z.end());
+  CumulativeNormalDistribution phi;
+  Real distance = 0.0;
+  for (Size i = 0; i < n; ++i) {
+    Real f = phi(z[i]);
+    distance = std::max(distance, std::max(Real(i + 1) / n - f, f - Real(i) / n));
+  }
+  Real ksP = kolmogorovPValue(std::sqrt(Real(n)) * distance);
+  Real beyond = Real(z.end() - std::upper_bound(z.begin(), z.end(), 3.442619855899)) / n;
+  Real expectedBeyond = 1.0 - phi(3.442619855899);
+  std::cout << boost::format("normals: mean %.2e, variance %.5f, skewness %.2e, kurtosis %.2e, KS p %.3f, P(z > R) %.3e (%.3e)")
+    % moments.mean() % moments.variance() % moments.skewness() % moments.kurtosis() % ksP % beyond % expectedBeyond << std::endl;
+  BOOST_CHECK_SMALL(moments.mean(), 5.0 / std::sqrt(Real(n)));
+  BOOST_CHECK_SMALL(moments.variance() - 1.0, 5.0 * std::sqrt(2.0 / n));
+  BOOST_CHECK_SMALL(moments.skewness(), 5.0 * std::sqrt(6.0 / n));
+  BOOST_CHECK_SMALL(moments.kurtosis(), 5.0 * std::sqrt(24.0 / n));
+  BOOST_CHECK(ksP > 1e-4);
+  BOOST_CHECK_SMALL(beyond - expectedBeyond, 5.0 * std::sqrt(expectedBeyond / n));
+
+  // neighbouring streams are uncorrelated
+  qltutor::Philox4x32 stream0(2012, 0), stream1(2012, 1);
+  std::vector<double> a(1000000), b(1000000);
+  qltutor::ZigguratNormal::fill(stream0, &a[0], a.size());
+  qltutor::ZigguratNormal::fill(stream1, &b[0], b.size());
+  Real cross = 0.0;
+  for (Size i = 0; i < a.size(); ++i) cross += a[i] * b[i] / a.size();
+  BOOST_CHECK_SMALL(cross, 5.0 / std::sqrt(Real(a.size())));
+}
+
+// the generators drop into PathGenerator and InverseCumulativeRsg
+BOOST_AUTO_TEST_CASE(testSequenceGeneratorConcept) {
+  Real startingPrice = 20.16, mu = .2312;
+  Volatility sigma = .2116;
+  Size timeSteps = 255, paths = 20000;
+  boost::shared_ptr<StochasticProcess> gbm(new GeometricBrownianMotionProcess(startingPrice, mu, sigma));
+
+  qltutor::PhiloxGaussianRsg normals(timeSteps, 42);
+  PathGenerator<qltutor::PhiloxGaussianRsg> pathGenerator(gbm, 1.0, timeSteps, normals, false);
+  qltutor::StreamingStatistics terminal;
+  for (Size p = 0; p < paths; ++p) terminal.add(pathGenerator.next().value.back());
+  // E[S_T] = S_0 e^{mu T}
+  Real expected = startingPrice * std::exp(mu);
+  std::cout << boost::format("Philox/ziggurat GBM: mean terminal price %.4f (expected %.4f, error estimate %.4f)")
+    % terminal.mean() % expected % terminal.errorEstimate() << std::endl;
+  BOOST_CHECK_SMALL(terminal.mean() - expected, 5.0 * terminal.errorEstimate());
+
+  // sequence k is the same whatever came before it
+  qltutor::PhiloxGaussianRsg first(timeSteps, 42), second(timeSteps, 42);
+  for (Size k = 0; k < 10; ++k) first.nextSequence();
+  second.skipTo(9);
+  BOOST_CHECK(first.lastSequence().value == second.nextSequence().value);
+
+  InverseCumulativeRsg<qltutor::PhiloxUniformRsg, InverseCumulativeNormal> inverted(qltutor::PhiloxUniformRsg(timeSteps, 42));
+  qltutor::MomentAccumulator moments;
+  for (Size p = 0; p < 1000; ++p) moments.add(&inverted.nextSequence().value[0], timeSteps);
+  BOOST_CHECK_SMALL(moments.mean(), 5.0 / std::sqrt(1000.0 * timeSteps));
+  BOOST_CHECK_SMALL(moments.variance() - 1.0, 5.0 * std::sqrt(2.0 / (1000.0 * timeSteps)));
+}
+
+// normals per second on one core, a path of 17brownie (2550 steps) at a time
+BOOST_AUTO_TEST_CASE(testNormalThroughput) {
+  typedef std::chrono::steady_clock Clock;
+  typedef BoxMullerGaussianRng<MersenneTwisterUniformRng> MersenneBoxMuller;
+  const Size dimension = 255 * 10, sequences = 4000;
+
+  RandomSequenceGenerator<MersenneBoxMuller> boxMuller(dimension, MersenneBoxMuller(MersenneTwisterUniformRng(42)));
+  qltutor::PhiloxGaussianRsg ziggurat(dimension, 42);
+  qltutor::PhiloxUniformRsg uniforms(dimension, 42);
+  InverseCumulativeRsg<qltutor::PhiloxUniformRsg, InverseCumulativeNormal> inverse(uniforms);
+
+  Real check = 0.0;
+  Clock::time_point start = Clock::now();
+  for (Size k = 0; k < sequences; ++k) check += boxMuller.nextSequence().value[k % dimension];
+  double boxMullerSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  start = Clock::now();
+  for (Size k = 0; k < sequences; ++k) check += inverse.nextSequence().value[k % dimension];
+  double inverseSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  start = Clock::now();
+  for (Size k = 0; k < sequences; ++k) check += ziggurat.nextSequence().value[k % dimension];
+  double zigguratSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<std::uint32_t> words(1 << 16);
+  qltutor::Philox4x32 generator(42);
+  start = Clock::now();
+  for (Size k = 0; k < 1000; ++k) generator.fill(&words[0], words.size());
+  double wordSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  Real total = Real(dimension) * sequences;
+  std::cout << boost::format("MT19937 + Box-Muller:              %6.1f M normals/s") % (total / boxMullerSeconds / 1e6) << std::endl;
+  std::cout << boost::format("Philox + InverseCumulativeNormal:  %6.1f M normals/s") % (total / inverseSeconds / 1e6) << std::endl;
+  std::cout << boost::format("Philox + ziggurat:                 %6.1f M normals/s") % (total / zigguratSeconds / 1e6) << std::endl;
+  std::cout << boost::format("Philox words:                      %6.1f M words/s (check %.3f)")
+    % (1000.0 * words.size() / wordSeconds / 1e6) % check << std::endl;
+  BOOST_CHECK(zigguratSeconds < boxMullerSeconds);
+}
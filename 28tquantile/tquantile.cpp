@@ -0,0 +1,149 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE TQuantile
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/math/distributions/students_t.hpp>
+
+#include "tabulatedquantile.hpp"
+
+// Student-t and other heavy-tailed samplers for the GBM tests of main: the quantile
+// tabulated once from boost::math, against calling boost's inversion for every draw
+// through boost::function.
+
+namespace {
+
+using namespace QuantLib;
+
+Real studentTInverse(boost::math::students_t_distribution<> d, const Real& p) {
+  return quantile(d, p);
+}
+
+// uniforms spread over the body and, a third of them, deep into either tail
+std::vector<Real> testProbabilities(Size n) {
+  MersenneTwisterUniformRng uniform(2012);
+  std::vector<Real> p(n);
+  for (Size i = 0; i < n; ++i) {
+    p[i] = uniform.next().value;
+    if (i % 3 == 0) p[i] = std::ldexp(p[i], -int(i % 50));
+    if (i % 2) p[i] = 1.0 - p[i];
+  }
+  return p;
+}
+
+}
+
+// within the error the tables report, from the body to 2^-50 in both tails
+BOOST_AUTO_TEST_CASE(testStudentTAccuracy) {
+  std::vector<Real> p = testProbabilities(100000), x(p.size());
+  Real dofs[] = { 1.0, 3.0, 5.0, 30.0 };
+  for (Size k = 0; k < 4; ++k) {
+    boost::math::students_t_distribution<> studentT(dofs[k]);
+    qltutor::TabulatedInverseCdf icd(boost::bind(studentTInverse, studentT, _1));
+    icd.transform(&p[0], &x[0], p.size());
+    Real worst = 0.0;
+    bool same = true;
+    for (Size i = 0; i < p.size(); ++i) {
+      Real expected = quantile(studentT, p[i]);
+      worst = std::max(worst, std::fabs(icd(p[i]) - expected) / std::max(1.0, std::fabs(expected)));
+      same = same && x[i] == icd(p[i]);
+    }
+    std::cout << boost::format("Student-t(%g): %d pieces, %d bytes, reported error %.2e, observed %.2e")
+      % dofs[k] % icd.pieces() % icd.memoryBytes() % icd.maxError() % worst << std::endl;
+    BOOST_CHECK(icd.maxError() <= 1e-12);
+    BOOST_CHECK(worst <= 2.0 * std::max(icd.maxError(), 1e-15));
+    BOOST_CHECK(same);
+    // below the tables the exact quantile is called
+    BOOST_CHECK_EQUAL(icd(std::ldexp(1.0, -60)), quantile(studentT, std::ldexp(1.0, -60)));
+  }
+}
+
+// a law with different tails: Pareto, x >= 1 with P(X > x) = x^-alpha
+BOOST_AUTO_TEST_CASE(testAsymmetricTails) {
+  const Real alpha = 1.5;
+  qltutor::TabulatedInverseCdf icd([alpha](double q) { return std::pow(1.0 - q, -1.0 / alpha); },
+                                   [alpha](double q) { return std::pow(q, -1.0 / alpha); });
+  std::vector<Real> p = testProbabilities(100000);
+  Real worst = 0.0;
+  for (Size i = 0; i < p.size(); ++i) {
+    Real expected = std::pow(1.0 - p[i], -1.0 / alpha);
+    worst = std::max(worst, std::fabs(icd(p[i]) - expected) / expected);
+  }
+  std::cout << boost::format("Pareto(%g): %d pieces, reported error %.2e, observed %.2e")
+    % alpha % icd.pieces() % icd.maxError() % worst << std::endl;
+  BOOST_CHECK(worst <= 2.0 * std::max(icd.maxError(), 1e-15));
+  // the largest uniform below 1, where 1 - p has no rounding error
+  BOOST_CHECK_CLOSE(icd(1.0 - std::ldexp(1.0, -53)), std::pow(2.0, 53.0 / alpha), 1e-10);
+}
+
+// the same uniforms through InverseCumulativeRsg and PathGenerator give the same paths
+BOOST_AUTO_TEST_CASE(testInverseCumulativeRsg) {
+  Size timeSteps = 255;
+  boost::math::students_t_distribution<> studentT(5);
+  boost::function<Real (Real)> exact = boost::bind(studentTInverse, studentT, _1);
+  qltutor::TabulatedInverseCdf tabulated(exact);
+
+  typedef RandomSequenceGenerator<MersenneTwisterUniformRng> Uniforms;
+  InverseCumulativeRsg<Uniforms, boost::function<Real (Real)> > exactRsg(Uniforms(timeSteps, MersenneTwisterUniformRng(42)), exact);
+  InverseCumulativeRsg<Uniforms, qltutor::TabulatedInverseCdf> tabulatedRsg(Uniforms(timeSteps, MersenneTwisterUniformRng(42)), tabulated);
+
+  boost::shared_ptr<StochasticProcess> gbm(new GeometricBrownianMotionProcess(20.16, .2312, std::sqrt(.2116 * .2116 * 3 / 5)));
+  PathGenerator<InverseCumulativeRsg<Uniforms, boost::function<Real (Real)> > > exactPaths(gbm, 1.0, timeSteps, exactRsg, false);
+  PathGenerator<InverseCumulativeRsg<Uniforms, qltutor::TabulatedInverseCdf> > tabulatedPaths(gbm, 1.0, timeSteps, tabulatedRsg, false);
+  Real worst = 0.0;
+  for (Size k = 0; k < 100; ++k) {
+    const Path& a = exactPaths.next().value;
+    const Path& b = tabulatedPaths.next().value;
+    for (Size i = 0; i < a.length(); ++i) worst = std::max(worst, std::fabs(a[i] - b[i]) / a[i]);
+  }
+  BOOST_CHECK_SMALL(worst, 1e-10);
+}
+
+// quantiles per second: boost's inversion through boost::function, the tables one at
+// a time as InverseCumulativeRsg calls them, and a block at a time
+BOOST_AUTO_TEST_CASE(testThroughput) {
+  typedef std::chrono::steady_clock Clock;
+  boost::math::students_t_distribution<> studentT(5);
+  boost::function<Real (Real)> exact = boost::bind(studentTInverse, studentT, _1);
+
+  Clock::time_point start = Clock::now();
+  qltutor::TabulatedInverseCdf tabulated(exact);
+  double buildSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<Real> p(1 << 16), x(p.size());
+  MersenneTwisterUniformRng uniform(42);
+  for (Size i = 0; i < p.size(); ++i) p[i] = uniform.next().value;
+
+  Real check = 0.0;
+  start = Clock::now();
+  for (Size i = 0; i < p.size(); ++i) check += exact(p[i]);
+  double exactSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  const Size rounds = 50;
+  start = Clock::now();
+  for (Size r = 0; r < rounds; ++r)
+    for (Size i = 0; i < p.size(); ++i) check += tabulated(p[i]);
+  double scalarSeconds = std::chrono::duration<double>(Clock::now() - start).count() / rounds;
+  start = Clock::now();
+  for (Size r = 0; r < rounds; ++r) {
+    tabulated.transform(&p[0], &x[0], p.size());
+    check += x[r];
+  }
+  double blockSeconds = std::chrono::duration<double>(Clock::now() - start).count() / rounds;
+
+  Real n = Real(p.size());
+  std::cout << boost::format("tables built in %.3f s, %d bytes") % buildSeconds % tabulated.memoryBytes() << std::endl;
+  std::cout << boost::format("boost quantile:      %8.2f M/s") % (n / exactSeconds / 1e6) << std::endl;
+  std::cout << boost::format("tabulated, scalar:   %8.2f M/s") % (n / scalarSeconds / 1e6) << std::endl;
+  std::cout << boost::format("tabulated, block:    %8.2f M/s (check %.3f)") % (n / blockSeconds / 1e6) % check << std::endl;
+  BOOST_CHECK(scalarSeconds < exactSeconds);
+}
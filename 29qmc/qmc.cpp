@@ -0,0 +1,151 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE QMC
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "qmcpaths.hpp"
+#include "philoxrsg.hpp"
+#include "streamingstats.hpp"
+
+// Scrambled Sobol paths with a Brownian bridge for the GBM of main and 17brownie,
+// against pseudo-random paths: the standard error at equal path counts, and the rate
+// at which it falls.
+
+namespace {
+
+using namespace QuantLib;
+
+const Real startingPrice = 20.16, strike = 21.0, rate = .0125;
+const Volatility sigma = .2116;
+const Time maturity = 1.0;
+const Size timeSteps = 64;
+
+boost::shared_ptr<StochasticProcess> intcProcess() {
+  return boost::shared_ptr<StochasticProcess>(new GeometricBrownianMotionProcess(startingPrice, rate, sigma));
+}
+
+struct DiscountedCall {
+  Real operator()(const Path& path) const { return std::exp(-rate * maturity) * std::max(path.back() - strike, 0.0); }
+};
+
+struct DiscountedAsianCall {
+  Real operator()(const Path& path) const {
+    Real average = 0.0;
+    for (Size i = 1; i < path.length(); ++i) average += path[i] / (path.length() - 1);
+    return std::exp(-rate * maturity) * std::max(average - strike, 0.0);
+  }
+};
+
+// the pseudo-random baseline: Philox/ziggurat paths, error from the sample variance
+template <class Functional>
+qltutor::StreamingStatistics monteCarloEstimate(Size paths, Functional f) {
+  qltutor::PhiloxGaussianRsg normals(timeSteps, 2012);
+  PathGenerator<qltutor::PhiloxGaussianRsg> generator(intcProcess(), maturity, timeSteps, normals, false);
+  qltutor::StreamingStatistics statistics;
+  for (Size p = 0; p < paths; ++p) statistics.add(f(generator.next().value));
+  return statistics;
+}
+
+}
+
+// each coordinate is stratified and the first two are a (0, m, 2)-net, whatever the seed
+BOOST_AUTO_TEST_CASE(testScrambledSobolNets) {
+  const Size m = 10, n = 1 << m, dimension = 255;
+  std::shared_ptr<const std::vector<std::uint32_t> > directions = qltutor::sobolDirectionIntegers(dimension);
+  for (Size j = 0; j < qltutor::ScrambledSobolRsg::bits; ++j) BOOST_REQUIRE_EQUAL((*directions)[j], 1u << (31 - j));
+
+  for (std::uint64_t seed = 1; seed <= 3; ++seed) {
+    qltutor::ScrambledSobolRsg sobol(directions, dimension, seed);
+    std::vector<std::vector<double> > points;
+    for (Size i = 0; i < n; ++i) points.push_back(sobol.nextSequence().value);
+    bool stratified = true, net = true;
+    for (Size k = 0; k < dimension; ++k) {
+      std::vector<Size> counts(n, 0);
+      for (Size i = 0; i < n; ++i) ++counts[Size(points[i][k] * n)];
+      stratified = stratified && *std::max_element(counts.begin(), counts.end()) == 1;
+    }
+    for (Size a = 0; a <= m; ++a) {
+      std::vector<Size> counts(n, 0);
+      for (Size i = 0; i < n; ++i) ++counts[Size(points[i][0] * (1 << a)) << (m - a) | Size(points[i][1] * (1 << (m - a)))];
+      net = net && *std::max_element(counts.begin(), counts.end()) == 1;
+    }
+    BOOST_CHECK(stratified);
+    BOOST_CHECK(net);
+
+    qltutor::ScrambledSobolRsg skipping(directions, dimension, seed);
+    skipping.skipTo(777);
+    BOOST_CHECK(skipping.nextSequence().value == points[777]);
+    BOOST_CHECK(skipping.nextSequence().value == points[778]);
+  }
+}
+
+// blocks are started by skip-ahead and summed in order: threads do not change the result
+BOOST_AUTO_TEST_CASE(testThreadIndependence) {
+  qltutor::QmcOptions options;
+  options.threads = 1;
+  qltutor::QmcEstimate one = qltutor::qmcPathEstimate(intcProcess(), maturity, timeSteps, 5000, DiscountedAsianCall(), options);
+  options.threads = 4;
+  qltutor::QmcEstimate four = qltutor::qmcPathEstimate(intcProcess(), maturity, timeSteps, 5000, DiscountedAsianCall(), options);
+  BOOST_CHECK(one.replicaValues == four.replicaValues);
+}
+
+// standard error against paths, scrambled Sobol with and without the bridge against
+// pseudo-random, at the same number of paths
+BOOST_AUTO_TEST_CASE(testConvergence) {
+  typedef std::chrono::steady_clock Clock;
+  Real blackScholes = BlackScholesCalculator(Option::Call, strike, startingPrice, std::exp(rate * maturity),
+                                             sigma * std::sqrt(maturity), std::exp(-rate * maturity)).value();
+  qltutor::QmcOptions bridge, noBridge;
+  bridge.threads = noBridge.threads = 1;
+  noBridge.brownianBridge = false;
+
+  for (int payoff = 0; payoff < 2; ++payoff) {
+    std::cout << (payoff == 0 ? "European call" : "Asian call")
+              << boost::format(" (Black-Scholes %.4f for the European), 16 replicas") % blackScholes << std::endl;
+    std::cout << "  points/replica   MC SE      QMC SE     QMC+BB SE  paths saved   MC paths/s  QMC+BB paths/s" << std::endl;
+    Real firstMc = 0.0, firstQmc = 0.0, lastMc = 0.0, lastQmc = 0.0;
+    const Size smallest = 1 << 8, largest = 1 << 14;
+    for (Size points = smallest; points <= largest; points *= 4) {
+      Size paths = points * bridge.replicas;
+      Clock::time_point start = Clock::now();
+      qltutor::StreamingStatistics mc = payoff == 0 ? monteCarloEstimate(paths, DiscountedCall())
+                                                    : monteCarloEstimate(paths, DiscountedAsianCall());
+      double mcSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+      start = Clock::now();
+      qltutor::QmcEstimate qmcBridge = payoff == 0
+        ? qltutor::qmcPathEstimate(intcProcess(), maturity, timeSteps, points, DiscountedCall(), bridge)
+        : qltutor::qmcPathEstimate(intcProcess(), maturity, timeSteps, points, DiscountedAsianCall(), bridge);
+      double qmcSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+      qltutor::QmcEstimate qmc = payoff == 0
+        ? qltutor::qmcPathEstimate(intcProcess(), maturity, timeSteps, points, DiscountedCall(), noBridge)
+        : qltutor::qmcPathEstimate(intcProcess(), maturity, timeSteps, points, DiscountedAsianCall(), noBridge);
+
+      Real saved = std::pow(mc.errorEstimate() / qmcBridge.standardError, 2);
+      std::cout << boost::format("  %14d   %.2e   %.2e   %.2e   %9.1fx   %10.0f   %14.0f")
+        % points % mc.errorEstimate() % qmc.standardError % qmcBridge.standardError % saved
+        % (paths / mcSeconds) % (paths / qmcSeconds) << std::endl;
+      BOOST_CHECK_SMALL(qmcBridge.value - mc.mean(), 5.0 * std::sqrt(std::pow(mc.errorEstimate(), 2) + std::pow(qmcBridge.standardError, 2)));
+      if (points == smallest) {
+        firstMc = mc.errorEstimate();
+        firstQmc = qmcBridge.standardError;
+      }
+      lastMc = mc.errorEstimate();
+      lastQmc = qmcBridge.standardError;
+    }
+    Real doublings = std::log(Real(largest) / smallest) / std::log(2.0);
+    std::cout << boost::format("  rate: MC N^%.2f, QMC+BB N^%.2f")
+      % (std::log(lastMc / firstMc) / std::log(2.0) / doublings) % (std::log(lastQmc / firstQmc) / std::log(2.0) / doublings) << std::endl;
+    // an order of magnitude fewer paths for the same error
+    if (payoff == 0) BOOST_CHECK(std::pow(lastMc / lastQmc, 2) > 10.0);
+    BOOST_CHECK(lastQmc < lastMc);
+  }
+}
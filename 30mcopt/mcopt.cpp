@@ -0,0 +1,154 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE MCOPT
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "mcpricer.hpp"
+
+// The European call of 13greeks priced by simulation on the GBM of 17brownie, and an
+// arithmetic Asian call on the same paths, with and without variance reduction:
+// accuracy against Black-Scholes, and error per CPU second.
+
+namespace {
+
+using namespace QuantLib;
+
+const Real spot = 100.0, strike = 110.0;
+const Time maturity = .5;
+const Rate riskFree = .03;
+const Volatility sigma = .20;
+
+boost::shared_ptr<GeometricBrownianMotionProcess> gbm() {
+  return boost::shared_ptr<GeometricBrownianMotionProcess>(new GeometricBrownianMotionProcess(spot, riskFree, sigma));
+}
+
+Real blackScholes(Real k) {
+  return BlackScholesCalculator(Option::Call, k, spot, std::exp(riskFree * maturity), sigma * std::sqrt(maturity),
+                                std::exp(-riskFree * maturity)).value();
+}
+
+struct EuropeanCall {
+  explicit EuropeanCall(Real strike) : strike(strike) {}
+  Real operator()(const Path& path) const { return std::max(path.back() - strike, 0.0); }
+  Real strike;
+};
+
+struct ArithmeticAsianCall {
+  explicit ArithmeticAsianCall(Real strike) : strike(strike) {}
+  Real operator()(const Path& path) const {
+    Real average = 0.0;
+    for (Size i = 1; i < path.length(); ++i) average += path[i];
+    return std::max(average / (path.length() - 1) - strike, 0.0);
+  }
+  Real strike;
+};
+
+struct Method {
+  std::string name;
+  qltutor::McPricerOptions options;
+};
+
+std::vector<Method> methods(Size paths, qltutor::McPricerOptions::ControlVariate control) {
+  std::vector<Method> all(6);
+  for (Size m = 0; m < all.size(); ++m) all[m].options.paths = paths;
+  all[0].name = "plain";
+  all[1].name = "antithetic";
+  all[1].options.antithetic = true;
+  all[2].name = "control variate";
+  all[2].options.controlVariate = control;
+  all[2].options.controlStrike = strike;
+  all[3].name = "moment matching";
+  all[3].options.momentMatching = true;
+  all[4].name = "importance sampling";
+  all[4].options.importanceDrift = qltutor::importanceDriftFor(gbm(), maturity, strike);
+  all[5].name = "all four";
+  all[5].options = all[4].options;
+  all[5].options.antithetic = all[5].options.momentMatching = true;
+  all[5].options.controlVariate = control;
+  all[5].options.controlStrike = strike;
+  return all;
+}
+
+void report(const std::string& name, const qltutor::McPrice& price, const qltutor::McPrice& plain) {
+  std::cout << boost::format("  %-20s %8.4f  %.2e  %6.3f s  %10.3e  %6.1fx  %9d")
+    % name % price.value % price.standardError % price.cpuSeconds % price.efficiency()
+    % (price.efficiency() / plain.efficiency()) % price.pathsFor(.001) << std::endl;
+}
+
+const char* header = "  method                  price  SE        CPU       efficiency  vs plain  paths for SE .001";
+
+}
+
+BOOST_AUTO_TEST_CASE(testEuropeanCall) {
+  Real exact = blackScholes(strike);
+  std::cout << boost::format("European call, Black-Scholes %.4f") % exact << std::endl << header << std::endl;
+  // the control at the money, not the option itself
+  std::vector<Method> all = methods(200000, qltutor::McPricerOptions::TerminalCall);
+  all[2].options.controlStrike = all[5].options.controlStrike = spot;
+  qltutor::McPrice plain = qltutor::mcPrice(gbm(), maturity, 1, EuropeanCall(strike), all[0].options);
+  for (Size m = 0; m < all.size(); ++m) {
+    qltutor::McPrice price = m == 0 ? plain : qltutor::mcPrice(gbm(), maturity, 1, EuropeanCall(strike), all[m].options);
+    report(all[m].name, price, plain);
+    BOOST_CHECK_SMALL(price.value - exact, 4.0 * price.standardError);
+    if (m > 0) BOOST_CHECK(price.standardError < plain.standardError);
+  }
+}
+
+// nearly three standard deviations out of the money, where few plain paths pay anything
+BOOST_AUTO_TEST_CASE(testDeepOutOfTheMoney) {
+  const Real deepStrike = 150.0;
+  Real exact = blackScholes(deepStrike);
+  qltutor::McPricerOptions options;
+  qltutor::McPrice plain = qltutor::mcPrice(gbm(), maturity, 1, EuropeanCall(deepStrike), options);
+  options.importanceDrift = qltutor::importanceDriftFor(gbm(), maturity, deepStrike);
+  qltutor::McPrice shifted = qltutor::mcPrice(gbm(), maturity, 1, EuropeanCall(deepStrike), options);
+  std::cout << boost::format("Call struck at %.0f, Black-Scholes %.6f") % deepStrike % exact << std::endl << header << std::endl;
+  report("plain", plain, plain);
+  report("importance sampling", shifted, plain);
+  BOOST_CHECK_SMALL(shifted.value - exact, 4.0 * shifted.standardError);
+  BOOST_CHECK(shifted.standardError * 3.0 < plain.standardError);
+}
+
+// no closed form: every method agrees with the plain estimate, and the geometric
+// average call, which has one, is a close control
+BOOST_AUTO_TEST_CASE(testArithmeticAsianCall) {
+  const Size timeSteps = 64;
+  std::vector<Method> all = methods(100000, qltutor::McPricerOptions::GeometricAverageCall);
+  qltutor::McPrice plain = qltutor::mcPrice(gbm(), maturity, timeSteps, ArithmeticAsianCall(strike), all[0].options);
+  std::cout << boost::format("Arithmetic Asian call, %d fixings") % timeSteps << std::endl << header << std::endl;
+  for (Size m = 0; m < all.size(); ++m) {
+    qltutor::McPrice price = m == 0 ? plain : qltutor::mcPrice(gbm(), maturity, timeSteps, ArithmeticAsianCall(strike), all[m].options);
+    report(all[m].name, price, plain);
+    BOOST_CHECK_SMALL(price.value - plain.value, 5.0 * std::sqrt(price.standardError * price.standardError + plain.standardError * plain.standardError));
+  }
+  qltutor::McPrice controlled = qltutor::mcPrice(gbm(), maturity, timeSteps, ArithmeticAsianCall(strike), all[2].options);
+  BOOST_CHECK(controlled.controlBeta > 0.0);
+  BOOST_CHECK(controlled.standardError * 3.0 < plain.standardError);
+  // the European call on S_T is a weaker control for an average
+  all[2].options.controlVariate = qltutor::McPricerOptions::TerminalCall;
+  qltutor::McPrice terminal = qltutor::mcPrice(gbm(), maturity, timeSteps, ArithmeticAsianCall(strike), all[2].options);
+  report("control: terminal", terminal, plain);
+  BOOST_CHECK(controlled.standardError < terminal.standardError && terminal.standardError < plain.standardError);
+}
+
+BOOST_AUTO_TEST_CASE(testThreadIndependence) {
+  qltutor::McPricerOptions options;
+  options.antithetic = options.momentMatching = true;
+  options.controlVariate = qltutor::McPricerOptions::GeometricAverageCall;
+  options.paths = 20000;
+  options.threads = 1;
+  qltutor::McPrice one = qltutor::mcPrice(gbm(), maturity, 16, ArithmeticAsianCall(strike), options);
+  options.threads = 4;
+  qltutor::McPrice four = qltutor::mcPrice(gbm(), maturity, 16, ArithmeticAsianCall(strike), options);
+  BOOST_CHECK_EQUAL(one.value, four.value);
+  BOOST_CHECK_EQUAL(one.standardError, four.standardError);
+}
@@ -0,0 +1,112 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE MLMC
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "mlmc.hpp"
+
+// Multilevel Monte Carlo on the GBM of 17brownie, stepped by
+// GeometricBrownianMotionProcess::evolve (Euler in the price) as the brownie paths
+// are: the discretization bias and the statistical error together within a target
+// RMSE, against plain Monte Carlo at the resolution that meets the same bias.
+
+namespace {
+
+using namespace QuantLib;
+
+const Real spot = 100.0, strike = 110.0;
+const Time maturity = .5;
+const Rate riskFree = .03;
+const Volatility sigma = .20;
+
+boost::shared_ptr<GeometricBrownianMotionProcess> gbm() {
+  return boost::shared_ptr<GeometricBrownianMotionProcess>(new GeometricBrownianMotionProcess(spot, riskFree, sigma));
+}
+
+struct DiscountedCall {
+  Real operator()(const Path& path) const { return std::exp(-riskFree * maturity) * std::max(path.back() - strike, 0.0); }
+};
+
+// the continuous average, by the trapezoid rule on the path's grid
+struct DiscountedAsianCall {
+  Real operator()(const Path& path) const {
+    Real average = 0.0;
+    for (Size i = 1; i < path.length(); ++i) average += .5 * (path[i - 1] + path[i]) / (path.length() - 1);
+    return std::exp(-riskFree * maturity) * std::max(average - strike, 0.0);
+  }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(testEuropeanCall) {
+  const Real eps = .005;
+  Real exact = BlackScholesCalculator(Option::Call, strike, spot, std::exp(riskFree * maturity), sigma * std::sqrt(maturity),
+                                      std::exp(-riskFree * maturity)).value();
+  qltutor::MlmcResult call = qltutor::mlmcEstimate(gbm(), maturity, DiscountedCall(), eps);
+  std::cout << boost::format("European call: MLMC %.4f +- %.4f, bias estimate %.4f, Black-Scholes %.4f")
+    % call.value % call.standardError % call.biasEstimate % exact << std::endl;
+  std::cout << "  level  steps  samples     mean of P_l - P_l-1   variance" << std::endl;
+  for (Size l = 0; l < call.levels.size(); ++l)
+    std::cout << boost::format("  %5d  %5d  %9d   %18.3e   %.3e") % l % call.levels[l].steps % call.levels[l].samples
+      % call.levels[l].mean % call.levels[l].variance << std::endl;
+  BOOST_CHECK(call.converged);
+  BOOST_CHECK_SMALL(call.value - exact, 3.0 * eps);
+  BOOST_CHECK(call.standardError <= eps / std::sqrt(2.0) * 1.1);
+  // the coupled differences shrink, so the fine levels need fewer samples
+  BOOST_CHECK(call.levels.back().variance < call.levels[1].variance / 4.0);
+  BOOST_CHECK(call.levels.back().samples < call.levels[1].samples / 4);
+}
+
+// cost against RMSE: MLMC grows about as eps^-2 (log eps)^2 for Euler, plain Monte
+// Carlo as eps^-3, with the bias met by a finer grid and the variance by more paths
+BOOST_AUTO_TEST_CASE(testCostVersusRmse) {
+  typedef std::chrono::steady_clock Clock;
+  std::cout << "Asian call (continuous average)" << std::endl;
+  std::cout << "  eps      levels  MLMC steps   MC steps     MC/MLMC  eps^2 MLMC  eps^2 MC   MLMC s   MC s" << std::endl;
+  Real firstRatio = 0.0, lastRatio = 0.0;
+  Real targets[] = { .02, .01, .005, .0025 };
+  for (Size k = 0; k < 4; ++k) {
+    Real eps = targets[k];
+    qltutor::MlmcResult asian = qltutor::mlmcEstimate(gbm(), maturity, DiscountedAsianCall(), eps);
+    Real mcCost = asian.singleLevelCost(eps);
+    // plain Monte Carlo actually run for the larger targets
+    std::string mcSeconds = "     -";
+    if (eps >= .005) {
+      const qltutor::MlmcLevel& finest = asian.levels.back();
+      Size samples = Size(std::ceil(2.0 * finest.fineVariance / (eps * eps)));
+      Clock::time_point start = Clock::now();
+      qltutor::MlmcLevel plain = qltutor::singleLevelEstimate(gbm(), maturity, DiscountedAsianCall(), asian.levels.size() - 1, samples);
+      mcSeconds = (boost::format("%6.2f") % std::chrono::duration<double>(Clock::now() - start).count()).str();
+      BOOST_CHECK_SMALL(plain.mean - asian.value, 3.0 * eps);
+    }
+    std::cout << boost::format("  %.4f   %6d  %10.3e   %10.3e   %7.1f   %9.1f   %8.1f   %6.2f   %s")
+      % eps % asian.levels.size() % asian.cost % mcCost % (mcCost / asian.cost) % (eps * eps * asian.cost)
+      % (eps * eps * mcCost) % asian.cpuSeconds % mcSeconds << std::endl;
+    BOOST_CHECK(asian.converged);
+    if (k == 0) firstRatio = mcCost / asian.cost;
+    lastRatio = mcCost / asian.cost;
+  }
+  BOOST_CHECK(lastRatio > firstRatio);
+  BOOST_CHECK(lastRatio > 3.0);
+}
+
+// samples of a level are fixed Philox sequences and batch sums merge in order
+BOOST_AUTO_TEST_CASE(testThreadIndependence) {
+  qltutor::MlmcOptions options;
+  options.threads = 1;
+  qltutor::MlmcResult one = qltutor::mlmcEstimate(gbm(), maturity, DiscountedAsianCall(), .02, options);
+  options.threads = 4;
+  qltutor::MlmcResult four = qltutor::mlmcEstimate(gbm(), maturity, DiscountedAsianCall(), .02, options);
+  BOOST_CHECK_EQUAL(one.value, four.value);
+  BOOST_CHECK_EQUAL(one.levels.size(), four.levels.size());
+}
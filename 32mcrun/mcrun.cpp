@@ -0,0 +1,126 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE MCRUN
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cmath>
+
+#include <unistd.h>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "philoxrsg.hpp"
+#include "mcrun.hpp"
+
+// The GBM of 17brownie run to a target error rather than a fixed path count: the
+// expected discounted highest price over a year of daily steps, stopped by standard
+// or relative error, interrupted and resumed from its checkpoint.
+
+namespace {
+
+using namespace QuantLib;
+
+const Real startingPrice = 20.16, mu = .2312;
+const Volatility sigma = .2116;
+const Size timeSteps = 255;
+const Time length = 1;
+
+// sample k: the highest price on the path of Philox sequence k, stepped by evolve()
+class DiscountedMaximum {
+  public:
+    explicit DiscountedMaximum(std::uint64_t seed)
+      : process_(new GeometricBrownianMotionProcess(startingPrice, mu, sigma)), normals_(timeSteps, seed) {}
+    Real operator()(std::uint64_t k) {
+      normals_.skipTo(k);
+      const std::vector<Real>& z = normals_.nextSequence().value;
+      const Time dt = length / timeSteps;
+      Real price = process_->x0(), highest = price;
+      for (Size i = 0; i < timeSteps; ++i) {
+        price = process_->evolve(i * dt, price, dt, z[i]);
+        highest = std::max(highest, price);
+      }
+      return std::exp(-mu * length) * highest;
+    }
+  private:
+    boost::shared_ptr<StochasticProcess1D> process_;
+    qltutor::PhiloxGaussianRsg normals_;
+};
+
+struct Interrupted {};
+
+std::string checkpointPath() { return str(boost::format("/tmp/qltutor-mcrun-%d.ckpt") % getpid()); }
+
+}
+
+BOOST_AUTO_TEST_CASE(testTargetErrors) {
+  qltutor::McRunOptions options;
+  options.targetStandardError = .005;
+  qltutor::McRunResult absolute = qltutor::runMonteCarlo(DiscountedMaximum(42), options, 42);
+  std::cout << boost::format("standard error target %.4f: %.4f +- %.4f after %d paths, %.2f s")
+    % options.targetStandardError % absolute.mean % absolute.standardError % absolute.samples % absolute.seconds << std::endl;
+  BOOST_CHECK_EQUAL(absolute.stop, qltutor::McRunResult::StandardErrorReached);
+  BOOST_CHECK(absolute.standardError <= options.targetStandardError);
+  // one round fewer would not have done: the run stops at the first round that meets it
+  Real roundSamples = Real(options.batch * options.roundBatches);
+  BOOST_CHECK(absolute.standardError * std::sqrt(absolute.samples / (absolute.samples - roundSamples)) > options.targetStandardError * .98);
+
+  options.targetStandardError = qltutor::McRunOptions::noTarget;
+  options.targetRelativeError = 2e-4;
+  qltutor::McRunResult relative = qltutor::runMonteCarlo(DiscountedMaximum(42), options, 42);
+  std::cout << boost::format("relative error target %.0e: %.4f +- %.4f after %d paths, %.2f s")
+    % options.targetRelativeError % relative.mean % relative.standardError % relative.samples % relative.seconds << std::endl;
+  BOOST_CHECK_EQUAL(relative.stop, qltutor::McRunResult::RelativeErrorReached);
+  BOOST_CHECK(relative.standardError <= options.targetRelativeError * relative.mean);
+  BOOST_CHECK_SMALL(relative.mean - absolute.mean, 4.0 * absolute.standardError);
+
+  options.maxSamples = 50000;
+  qltutor::McRunResult limited = qltutor::runMonteCarlo(DiscountedMaximum(42), options, 42);
+  BOOST_CHECK_EQUAL(limited.stop, qltutor::McRunResult::SampleLimit);
+  BOOST_CHECK_EQUAL(limited.samples, options.maxSamples);
+}
+
+// a run killed after a few rounds and restarted ends where the uninterrupted run does,
+// to the bit, on any number of threads
+BOOST_AUTO_TEST_CASE(testCheckpointRestart) {
+  qltutor::McRunOptions options;
+  options.targetStandardError = .005;
+  options.threads = 1;
+  qltutor::McRunResult uninterrupted = qltutor::runMonteCarlo(DiscountedMaximum(42), options, 42);
+
+  std::string path = checkpointPath();
+  std::remove(path.c_str());
+  options.checkpointPath = path;
+  options.checkpointSeconds = 0.0;
+  options.threads = 4;
+  Size rounds = 0;
+  options.progress = [&rounds](const qltutor::McRunResult&) { if (++rounds == 3) throw Interrupted(); };
+  BOOST_CHECK_THROW(qltutor::runMonteCarlo(DiscountedMaximum(42), options, 42), Interrupted);
+
+  options.progress = [](const qltutor::McRunResult& run) {
+    std::cout << boost::format("  %9d paths  %.4f +- %.5f") % run.samples % run.mean % run.standardError << std::endl;
+  };
+  qltutor::McRunResult resumed = qltutor::runMonteCarlo(DiscountedMaximum(42), options, 42);
+  std::cout << boost::format("resumed at %d paths: %.10f, uninterrupted %.10f, %d checkpoints")
+    % resumed.resumedSamples % resumed.mean % uninterrupted.mean % resumed.checkpoints << std::endl;
+  BOOST_CHECK_EQUAL(resumed.resumedSamples, 3 * options.batch * options.roundBatches);
+  BOOST_CHECK_EQUAL(resumed.samples, uninterrupted.samples);
+  BOOST_CHECK_EQUAL(resumed.mean, uninterrupted.mean);
+  BOOST_CHECK_EQUAL(resumed.standardError, uninterrupted.standardError);
+
+  // finished: a restart reports the result without simulating
+  qltutor::McRunResult again = qltutor::runMonteCarlo(DiscountedMaximum(42), options, 42);
+  BOOST_CHECK_EQUAL(again.resumedSamples, uninterrupted.samples);
+  BOOST_CHECK_EQUAL(again.checkpoints, 0u);
+  BOOST_CHECK_EQUAL(again.mean, uninterrupted.mean);
+
+  // another seed must not pick up this run's state
+  BOOST_CHECK_THROW(qltutor::runMonteCarlo(DiscountedMaximum(7), options, 7), std::runtime_error);
+  std::remove(path.c_str());
+}
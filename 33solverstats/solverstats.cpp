@@ -0,0 +1,207 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE SOLVERSTATS
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <cmath>
+
+#include <ql/quantlib.hpp>
+#include <boost/format.hpp>
+
+#include "solverprobe.hpp"
+
+// The probes of solverprobe.hpp, built with QLTUTOR_SOLVER_STATS (see the makefile):
+// what they record against evaluations counted by the functions themselves.
+
+#ifndef QLTUTOR_SOLVER_STATS
+#error "build with -DQLTUTOR_SOLVER_STATS"
+#endif
+
+namespace {
+
+using namespace QuantLib;
+
+class CountedSquare {
+  public:
+    explicit CountedSquare(Size& calls) : calls_(calls) {}
+    Real operator()(Real x) const {
+      ++calls_;
+      return x * x - 2.0;
+    }
+  private:
+    Size& calls_;
+};
+
+// (x - 1)' (x - 1) + 3 with its gradient, counting both
+class CountedQuadratic : public CostFunction {
+  public:
+    CountedQuadratic() : values_(0), gradients_(0) {}
+
+    Real value(const Array& x) const {
+      ++values_;
+      return norm(x);
+    }
+
+    Disposable<Array> values(const Array& x) const {
+      Array v(1, value(x));
+      return v;
+    }
+
+    void gradient(Array& grad, const Array& x) const {
+      ++gradients_;
+      grad = 2.0 * (x - 1.0);
+    }
+
+    Real valueAndGradient(Array& grad, const Array& x) const {
+      gradient(grad, x);
+      return value(x);
+    }
+
+    Size valueCalls() const { return values_; }
+    Size gradientCalls() const { return gradients_; }
+
+  private:
+    static Real norm(const Array& x) {
+      Real sum = 3.0;
+      for (Size i = 0; i < x.size(); ++i) sum += (x[i] - 1.0) * (x[i] - 1.0);
+      return sum;
+    }
+    mutable Size values_, gradients_;
+};
+
+// x_i <= bound, counting the points it refuses
+class CountedUpperBound : public Constraint {
+  private:
+    class Impl : public Constraint::Impl {
+      public:
+        Impl(Real bound, Size& rejected) : bound_(bound), rejected_(rejected) {}
+        bool test(const Array& x) const {
+          for (Size i = 0; i < x.size(); ++i) {
+            if (x[i] > bound_) {
+              ++rejected_;
+              return false;
+            }
+          }
+          return true;
+        }
+      private:
+        Real bound_;
+        Size& rejected_;
+    };
+  public:
+    CountedUpperBound(Real bound, Size& rejected)
+      : Constraint(boost::shared_ptr<Constraint::Impl>(new Impl(bound, rejected))) {}
+};
+
+qltutor::SolveRecord lastSolve() {
+  std::vector<qltutor::SolveRecord> records = qltutor::recentSolves();
+  BOOST_REQUIRE(!records.empty());
+  return records.back();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testBisectionRecord) {
+  Size calls = 0;
+  qltutor::SolveProbe probe("Bisection", "33solverstats/sqrt2");
+  Real root = probe.finish(Bisection().solve(probe.counted(CountedSquare(calls)), 1e-10, 1.0, 0.0, 2.0));
+
+  const qltutor::SolveRecord r = lastSolve();
+  std::cout << boost::format("sqrt(2) = %.10f after %d evaluations") % root % calls << std::endl;
+  BOOST_CHECK_EQUAL(std::string(r.label), "33solverstats/sqrt2");
+  BOOST_CHECK(r.converged);
+  BOOST_CHECK_EQUAL(r.evaluations, calls);
+  BOOST_CHECK_EQUAL(r.iterations, calls - 2);
+  BOOST_CHECK_EQUAL(r.value, root);
+  BOOST_CHECK_CLOSE(root, std::sqrt(2.0), 1e-7);
+}
+
+// a probe that goes out of scope without finish() records the solve as failed
+BOOST_AUTO_TEST_CASE(testThrowingSolve) {
+  Size calls = 0;
+  {
+    qltutor::SolveProbe probe("Bisection", "33solverstats/unbracketed");
+    BOOST_CHECK_THROW(Bisection().solve(probe.counted(CountedSquare(calls)), 1e-10, 3.0, 2.0, 4.0), Error);
+  }
+  const qltutor::SolveRecord r = lastSolve();
+  BOOST_CHECK_EQUAL(std::string(r.label), "33solverstats/unbracketed");
+  BOOST_CHECK(!r.converged);
+  BOOST_CHECK_EQUAL(std::string(r.termination), "Exception");
+  BOOST_CHECK_EQUAL(r.evaluations, calls);
+}
+
+// the wrappers count what the solver asks for, and pass gradients through
+BOOST_AUTO_TEST_CASE(testCostFunctionRecords) {
+  EndCriteria endCriteria(1000, 100, 1e-10, 1e-12, 1e-10);
+
+  CountedQuadratic simplexFunction;
+  Size rejected = 0;
+  CountedUpperBound bound(2.0, rejected);   // the first simplex, 2.5 wide, crosses it
+  qltutor::SolveProbe simplexProbe("Simplex", "33solverstats/quadratic", simplexFunction, bound);
+  Problem simplexProblem(simplexProbe.costFunction(), simplexProbe.constraint(), Array(3, 0.0));
+  EndCriteria::Type type = simplexProbe.finish(Simplex(2.5).minimize(simplexProblem, endCriteria), simplexProblem);
+  const qltutor::SolveRecord simplex = lastSolve();
+  std::cout << boost::format("Simplex: %s after %d evaluations, %d improving, %d rejected")
+    % type % simplex.evaluations % simplex.iterations % simplex.rejections << std::endl;
+  BOOST_CHECK(simplex.converged);
+  BOOST_CHECK_EQUAL(simplex.evaluations, simplexFunction.valueCalls());
+  BOOST_CHECK_EQUAL(simplex.rejections, rejected);
+  BOOST_CHECK(rejected > 0);
+  BOOST_CHECK(simplex.iterations > 0 && simplex.iterations <= simplex.evaluations);
+  BOOST_CHECK_CLOSE(simplex.value, 3.0, 1e-6);
+
+  CountedQuadratic gradientFunction;
+  NoConstraint none;
+  qltutor::SolveProbe gradientProbe("ConjugateGradient", "33solverstats/quadratic", gradientFunction, none);
+  Problem gradientProblem(gradientProbe.costFunction(), gradientProbe.constraint(), Array(3, 0.0));
+  gradientProbe.finish(ConjugateGradient().minimize(gradientProblem, endCriteria), gradientProblem);
+  const qltutor::SolveRecord conjugate = lastSolve();
+  std::cout << boost::format("ConjugateGradient: %d evaluations, %d analytic gradients")
+    % conjugate.evaluations % gradientFunction.gradientCalls() << std::endl;
+  BOOST_CHECK(conjugate.converged);
+  BOOST_CHECK(gradientFunction.gradientCalls() > 0);
+  BOOST_CHECK_EQUAL(conjugate.evaluations, gradientFunction.valueCalls());
+  BOOST_CHECK_CLOSE(conjugate.value, 3.0, 1e-6);
+
+  std::ostringstream dump;
+  qltutor::dumpSolves(dump, qltutor::recentSolves());
+  BOOST_CHECK(dump.str().find("ConjugateGradient  33solverstats/quadratic") != std::string::npos);
+}
+
+// totals fold every thread's solves, including threads that have exited
+BOOST_AUTO_TEST_CASE(testSolveSummary) {
+  const std::string key = "Bisection 33solverstats/threads";
+  const Size threads = 4, solvesPerThread = 25;
+  std::vector<Size> calls(threads, 0);
+  std::vector<std::thread> workers;
+  for (Size t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&calls, t]() {
+      for (Size i = 0; i < solvesPerThread; ++i) {
+        qltutor::SolveProbe probe("Bisection", "33solverstats/threads");
+        probe.finish(Bisection().solve(probe.counted(CountedSquare(calls[t])), 1e-10, 1.0, 0.0, 2.0));
+      }
+    }));
+  }
+  for (Size t = 0; t < threads; ++t) workers[t].join();
+
+  qltutor::SolveSummary summary = qltutor::solveSummary();
+  BOOST_REQUIRE(summary.count(key) == 1);
+  const qltutor::SolveTotals& totals = summary[key];
+  Size evaluations = 0;
+  for (Size t = 0; t < threads; ++t) evaluations += calls[t];
+  BOOST_CHECK_EQUAL(totals.solves, threads * solvesPerThread);
+  BOOST_CHECK_EQUAL(totals.failures, 0u);
+  BOOST_CHECK_EQUAL(totals.evaluations, evaluations);
+  BOOST_CHECK_EQUAL(totals.iterations, evaluations - 2 * threads * solvesPerThread);
+  BOOST_CHECK_EQUAL(totals.terminations.find("Converged")->second, threads * solvesPerThread);
+
+  std::ostringstream printed;
+  qltutor::printSolveSummary(printed, summary);
+  std::cout << printed.str();
+  BOOST_CHECK(printed.str().find(key) != std::string::npos);
+}
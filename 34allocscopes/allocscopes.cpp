@@ -0,0 +1,128 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_AUTO_TEST_MAIN
+#define BOOST_TEST_MODULE ALLOCSCOPES
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <thread>
+
+#include <boost/format.hpp>
+
+#define QLTUTOR_COUNT_ALLOCATIONS   // this translation unit installs the counting operator new
+#include "allocations.hpp"
+
+// The scopes of allocations.hpp, built with QLTUTOR_ALLOCATION_SCOPES (see the makefile):
+// what they record for allocation patterns known in advance.
+
+#ifndef QLTUTOR_ALLOCATION_SCOPES
+#error "build with -DQLTUTOR_ALLOCATION_SCOPES"
+#endif
+
+namespace {
+
+typedef std::vector<std::vector<double> > Buffers;
+
+// `count` vectors of `size` doubles, kept in `out` so the allocations cannot be elided
+void allocateVectors(Buffers& out, std::size_t count, std::size_t size) {
+  qltutor::AllocationScope scope("34allocscopes/allocateVectors");
+  for (std::size_t i = 0; i < count; ++i) out.push_back(std::vector<double>(size));
+}
+
+// the same inside an outer scope, which also counts what the inner one allocates
+void allocateNested(Buffers& out, std::size_t count, std::size_t size) {
+  qltutor::AllocationScope scope("34allocscopes/allocateNested");
+  out.push_back(std::vector<double>(size));
+  allocateVectors(out, count, size);
+}
+
+double sumWithoutAllocating(const Buffers& buffers) {
+  qltutor::AllocationScope scope("34allocscopes/sumWithoutAllocating");
+  double sum = 0.0;
+  for (std::size_t i = 0; i < buffers.size(); ++i) sum += buffers[i].size();
+  return sum;
+}
+
+qltutor::AllocationScopeTotals totals(const std::string& name) {
+  qltutor::AllocationScopeSummary summary = qltutor::allocationScopeSummary();
+  BOOST_REQUIRE(summary.count(name) == 1);
+  return summary[name];
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(testThreadCounters) {
+  Buffers buffers;
+  buffers.reserve(8);
+  qltutor::AllocationCounts before = qltutor::threadAllocations();
+  for (std::size_t i = 0; i < 8; ++i) buffers.push_back(std::vector<double>(100));
+  qltutor::AllocationCounts after = qltutor::threadAllocations();
+  BOOST_CHECK_EQUAL(after.allocations - before.allocations, 8u);
+  BOOST_CHECK_EQUAL(after.bytes - before.bytes, 8 * 100 * sizeof(double));
+}
+
+// N vectors per call in a named scope: N allocations per call, every call
+BOOST_AUTO_TEST_CASE(testScopeCounts) {
+  const std::size_t calls = 50, vectors = 7, size = 32;
+  Buffers buffers;
+  buffers.reserve(calls * (vectors + 1));
+  for (std::size_t c = 0; c < calls; ++c) allocateVectors(buffers, vectors, size);
+
+  qltutor::AllocationScopeTotals t = totals("34allocscopes/allocateVectors");
+  std::cout << boost::format("allocateVectors: %d calls, %.2f allocs/call, %.1f bytes/call")
+    % t.calls % (double(t.allocations) / t.calls) % (double(t.bytes) / t.calls) << std::endl;
+  BOOST_CHECK_EQUAL(t.calls, calls);
+  BOOST_CHECK_EQUAL(t.allocations, calls * vectors);
+  BOOST_CHECK_EQUAL(t.maxAllocations, vectors);
+  BOOST_CHECK_EQUAL(t.bytes, calls * vectors * size * sizeof(double));
+
+  BOOST_CHECK_EQUAL(sumWithoutAllocating(buffers), double(calls * vectors * size));
+  qltutor::AllocationScopeTotals none = totals("34allocscopes/sumWithoutAllocating");
+  BOOST_CHECK_EQUAL(none.calls, 1u);
+  BOOST_CHECK_EQUAL(none.allocations, 0u);
+  BOOST_CHECK_EQUAL(none.bytes, 0u);
+}
+
+// scopes are inclusive: the outer one counts its own vector and the inner ones'
+BOOST_AUTO_TEST_CASE(testNestedScopes) {
+  const std::size_t calls = 10, vectors = 3, size = 16;
+  qltutor::AllocationScopeTotals inner = totals("34allocscopes/allocateVectors");
+  Buffers buffers;
+  buffers.reserve(calls * (vectors + 1));
+  for (std::size_t c = 0; c < calls; ++c) allocateNested(buffers, vectors, size);
+
+  qltutor::AllocationScopeTotals outer = totals("34allocscopes/allocateNested");
+  BOOST_CHECK_EQUAL(outer.calls, calls);
+  BOOST_CHECK_EQUAL(outer.allocations, calls * (vectors + 1));
+  BOOST_CHECK_EQUAL(outer.maxAllocations, vectors + 1);
+  qltutor::AllocationScopeTotals innerAfter = totals("34allocscopes/allocateVectors");
+  BOOST_CHECK_EQUAL(innerAfter.calls - inner.calls, calls);
+  BOOST_CHECK_EQUAL(innerAfter.allocations - inner.allocations, calls * vectors);
+}
+
+// the summary folds every thread's totals, including threads that have exited
+BOOST_AUTO_TEST_CASE(testThreadTotals) {
+  const std::size_t threads = 4, calls = 20, vectors = 5, size = 8;
+  qltutor::AllocationScopeTotals before = totals("34allocscopes/allocateVectors");
+  std::vector<std::thread> workers;
+  for (std::size_t t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([]() {
+      Buffers buffers;
+      buffers.reserve(calls * vectors);
+      for (std::size_t c = 0; c < calls; ++c) allocateVectors(buffers, vectors, size);
+    }));
+  }
+  for (std::size_t t = 0; t < threads; ++t) workers[t].join();
+
+  qltutor::AllocationScopeTotals after = totals("34allocscopes/allocateVectors");
+  BOOST_CHECK_EQUAL(after.calls - before.calls, threads * calls);
+  BOOST_CHECK_EQUAL(after.allocations - before.allocations, threads * calls * vectors);
+  BOOST_CHECK_EQUAL(after.bytes - before.bytes, threads * calls * vectors * size * sizeof(double));
+
+  std::ostringstream printed;
+  qltutor::printAllocationScopes(printed, qltutor::allocationScopeSummary());
+  std::cout << printed.str();
+  BOOST_CHECK(printed.str().find("34allocscopes/allocateVectors") != std::string::npos);
+}
@@ -0,0 +1,244 @@
+#ifndef QLTUTOR_ALLOCATIONS_HPP
+#define QLTUTOR_ALLOCATIONS_HPP
+
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef QLTUTOR_ALLOCATION_SCOPES
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <ostream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#endif
+
+// Per-thread heap allocation counters.
+//
+// The counters only move if the program replaces the global operator new/delete with
+// the counting ones below: exactly one translation unit defines
+// QLTUTOR_COUNT_ALLOCATIONS before including this header. Everything else sees
+// counters that stay at zero.
+//
+// AllocationScope attributes what the counters record to a named scope:
+//
+//   Real value(const Array& x) const {
+//     qltutor::AllocationScope scope("09lopt/MeanVarianceFunction::value");
+//     ...
+//   }
+//
+// With QLTUTOR_ALLOCATION_SCOPES defined (make ALLOCATION_SCOPES=1), each scope adds
+// its calls, allocations and bytes to per-thread totals, and the totals of all threads
+// are printed to stderr at exit. Scopes are inclusive (an outer scope also counts what
+// its inner scopes allocate) and keyed by the address of their name, which must be a
+// string literal. The bookkeeping itself never allocates inside a scope. Without
+// QLTUTOR_ALLOCATION_SCOPES a scope is an empty object.
+
+namespace qltutor {
+
+struct AllocationCounts {
+  std::uint64_t allocations;
+  std::uint64_t bytes;
+};
+
+namespace detail {
+  inline AllocationCounts& threadAllocationCounts() {
+    static thread_local AllocationCounts counts = { 0, 0 };
+    return counts;
+  }
+
+  inline void* countedAllocate(std::size_t size) {
+    AllocationCounts& counts = threadAllocationCounts();
+    ++counts.allocations;
+    counts.bytes += size;
+    return std::malloc(size ? size : 1);
+  }
+}
+
+inline AllocationCounts threadAllocations() { return detail::threadAllocationCounts(); }
+
+#ifdef QLTUTOR_ALLOCATION_SCOPES
+
+struct AllocationScopeTotals {
+  AllocationScopeTotals() : calls(0), allocations(0), bytes(0), maxAllocations(0) {}
+
+  void add(const AllocationScopeTotals& t) {
+    calls += t.calls;
+    allocations += t.allocations;
+    bytes += t.bytes;
+    maxAllocations = std::max(maxAllocations, t.maxAllocations);
+  }
+
+  std::uint64_t calls, allocations, bytes, maxAllocations;
+};
+
+// scope name -> totals
+typedef std::map<std::string, AllocationScopeTotals> AllocationScopeSummary;
+
+inline void printAllocationScopes(std::ostream& out, const AllocationScopeSummary& summary) {
+  char line[256];
+  for (AllocationScopeSummary::const_iterator i = summary.begin(); i != summary.end(); ++i) {
+    const AllocationScopeTotals& t = i->second;
+    std::snprintf(line, sizeof(line), "%-48s %10llu calls %10.2f allocs/call (max %llu) %12.1f bytes/call %14llu allocs",
+                  i->first.c_str(), static_cast<unsigned long long>(t.calls), double(t.allocations) / t.calls,
+                  static_cast<unsigned long long>(t.maxAllocations), double(t.bytes) / t.calls,
+                  static_cast<unsigned long long>(t.allocations));
+    out << line << "\n";
+  }
+  out.flush();
+}
+
+namespace detail {
+
+  class AllocationScopeTable;
+
+  struct AllocationScopeRegistry {
+    std::mutex mutex;
+    std::vector<AllocationScopeTable*> tables;
+    AllocationScopeSummary retired;      // totals of threads that have exited
+
+    ~AllocationScopeRegistry();
+  };
+
+  inline AllocationScopeRegistry& allocationScopeRegistry() {
+    static AllocationScopeRegistry registry;
+    return registry;
+  }
+
+  // open addressing on the name's address, fixed size so that recording never allocates
+  class AllocationScopeTable {
+    public:
+      static const std::size_t slots = 512;
+
+      AllocationScopeTable() : names_(), used_(0) {
+        AllocationScopeRegistry& registry = allocationScopeRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.tables.push_back(this);
+      }
+
+      ~AllocationScopeTable() {
+        AllocationScopeRegistry& registry = allocationScopeRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.tables.erase(std::remove(registry.tables.begin(), registry.tables.end(), this), registry.tables.end());
+        addTotalsTo(registry.retired);
+      }
+
+      void record(const char* name, std::uint64_t allocations, std::uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);   // uncontended except while a summary is taken
+        std::size_t i = (reinterpret_cast<std::uintptr_t>(name) >> 3) % slots;
+        for (std::size_t probe = 0; probe < slots; ++probe, i = (i + 1) % slots) {
+          if (names_[i] == name) break;
+          if (!names_[i]) {
+            if (used_ + 1 == slots) return;   // full: keep one slot free so lookups terminate
+            names_[i] = name;
+            ++used_;
+            break;
+          }
+        }
+        AllocationScopeTotals& t = totals_[i];
+        ++t.calls;
+        t.allocations += allocations;
+        t.bytes += bytes;
+        t.maxAllocations = std::max(t.maxAllocations, allocations);
+      }
+
+      void addTotalsTo(AllocationScopeSummary& summary) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < slots; ++i) {
+          if (names_[i]) summary[names_[i]].add(totals_[i]);
+        }
+      }
+
+    private:
+      std::mutex mutex_;
+      const char* names_[slots];
+      AllocationScopeTotals totals_[slots];
+      std::size_t used_;
+  };
+
+  inline AllocationScopeTable& threadAllocationScopes() {
+    static thread_local AllocationScopeTable table;
+    return table;
+  }
+
+  inline AllocationScopeRegistry::~AllocationScopeRegistry() {
+    if (!retired.empty()) {
+      std::cerr << "Allocations by scope:" << std::endl;
+      printAllocationScopes(std::cerr, retired);
+    }
+  }
+}
+
+class AllocationScope {
+  public:
+    explicit AllocationScope(const char* name)
+      : name_(name), table_(detail::threadAllocationScopes()), start_(threadAllocations()) {}
+
+    ~AllocationScope() {
+      const AllocationCounts& now = detail::threadAllocationCounts();
+      table_.record(name_, now.allocations - start_.allocations, now.bytes - start_.bytes);
+    }
+
+  private:
+    AllocationScope(const AllocationScope&);
+    AllocationScope& operator=(const AllocationScope&);
+
+    const char* name_;
+    detail::AllocationScopeTable& table_;
+    AllocationCounts start_;
+};
+
+inline AllocationScopeSummary allocationScopeSummary() {
+  detail::AllocationScopeRegistry& registry = detail::allocationScopeRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  AllocationScopeSummary summary = registry.retired;
+  for (std::size_t i = 0; i < registry.tables.size(); ++i) registry.tables[i]->addTotalsTo(summary);
+  return summary;
+}
+
+#else
+
+class AllocationScope {
+  public:
+    explicit AllocationScope(const char*) {}
+};
+
+#endif
+
+}
+
+#ifdef QLTUTOR_COUNT_ALLOCATIONS
+
+void* operator new(std::size_t size) {
+  void* p = qltutor::detail::countedAllocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size) {
+  void* p = qltutor::detail::countedAllocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return qltutor::detail::countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return qltutor::detail::countedAllocate(size);
+}
+
+// kept out of line, so GCC does not pair an inlined free() with operator new and warn
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef QLTUTOR_BENCH_HPP
+#define QLTUTOR_BENCH_HPP
+
+#include <vector>
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cctype>
+
+// Micro/macro benchmark harness.
+//
+// A workload is any callable returning a double. Each timed sample calls it enough
+// times to last at least minSampleSeconds (calibrated once, during warmup), and the
+// per-call times of all samples are summarised robustly (median and MAD next to mean
+// and standard deviation). Results are written as JSON and can be compared with a
+// previously stored run: a workload regresses when its median is more than
+// `tolerance` slower than the baseline by more than the noise of either run, and
+// drifts when it returns a different number.
+
+namespace qltutor {
+
+struct BenchmarkOptions {
+  std::size_t warmup;          // untimed samples
+  std::size_t repetitions;     // timed samples
+  double minSampleSeconds;
+  double tolerance;            // allowed relative slow-down against the baseline
+
+  BenchmarkOptions() : warmup(2), repetitions(15), minSampleSeconds(.01), tolerance(.10) {}
+
+  // QLTUTOR_BENCH_WARMUP, QLTUTOR_BENCH_REPETITIONS, QLTUTOR_BENCH_MIN_SAMPLE_MS, QLTUTOR_BENCH_TOLERANCE
+  static BenchmarkOptions fromEnvironment() {
+    BenchmarkOptions options;
+    if (const char* value = std::getenv("QLTUTOR_BENCH_WARMUP")) options.warmup = std::atoi(value);
+    if (const char* value = std::getenv("QLTUTOR_BENCH_REPETITIONS")) options.repetitions = std::max(1, std::atoi(value));
+    if (const char* value = std::getenv("QLTUTOR_BENCH_MIN_SAMPLE_MS")) options.minSampleSeconds = std::atof(value) / 1e3;
+    if (const char* value = std::getenv("QLTUTOR_BENCH_TOLERANCE")) options.tolerance = std::atof(value);
+    return options;
+  }
+};
+
+struct BenchmarkSummary {
+  double min, median, mean, stddev, mad, p90, max;
+};
+
+inline BenchmarkSummary summarize(std::vector<double> samples) {
+  BenchmarkSummary s = { 0, 0, 0, 0, 0, 0, 0 };
+  if (samples.empty()) return s;
+  std::sort(samples.begin(), samples.end());
+  std::size_t n = samples.size();
+  s.min = samples.front();
+  s.max = samples.back();
+  s.median = n % 2 ? samples[n / 2] : .5 * (samples[n / 2 - 1] + samples[n / 2]);
+  s.p90 = samples[std::min(n - 1, std::size_t(std::ceil(.9 * n)) - 1)];
+  for (std::size_t i = 0; i < n; ++i) s.mean += samples[i];
+  s.mean /= n;
+  for (std::size_t i = 0; i < n; ++i) s.stddev += (samples[i] - s.mean) * (samples[i] - s.mean);
+  s.stddev = n > 1 ? std::sqrt(s.stddev / (n - 1)) : 0.0;
+
+  std::vector<double> deviations(n);
+  for (std::size_t i = 0; i < n; ++i) deviations[i] = std::fabs(samples[i] - s.median);
+  std::nth_element(deviations.begin(), deviations.begin() + n / 2, deviations.end());
+  s.mad = deviations[n / 2];
+  return s;
+}
+
+struct BenchmarkResult {
+  std::string name;            // <module>/<workload>
+  std::string parameters;      // e.g. "flows=360"
+  std::size_t callsPerSample;
+  BenchmarkSummary nanoseconds;  // per call
+  double result;               // value returned by the last call
+
+  std::string key() const { return parameters.empty() ? name : name + "[" + parameters + "]"; }
+};
+
+struct BenchmarkComparison {
+  bool found;
+  double ratio;                // current / baseline median
+  double baselineMedian;
+  double baselineResult;
+  bool regressed;
+  bool drifted;
+};
+
+class BenchmarkReport {
+  public:
+    explicit BenchmarkReport(const std::string& suite, const BenchmarkOptions& options = BenchmarkOptions())
+      : suite_(suite), options_(options) {}
+
+    const BenchmarkOptions& options() const { return options_; }
+    const std::vector<BenchmarkResult>& results() const { return results_; }
+
+    template <class F>
+    const BenchmarkResult& run(const std::string& name, const std::string& parameters, F workload) {
+      typedef std::chrono::steady_clock Clock;
+      volatile double sink = 0.0;
+      double last = 0.0;
+
+      // calibrate: grow the calls per sample until one sample is long enough
+      std::size_t calls = 1;
+      for (;;) {
+        Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < calls; ++i) sink = last = workload();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds >= options_.minSampleSeconds || calls >= (std::size_t(1) << 30)) break;
+        calls *= seconds > 0 ? std::max<std::size_t>(2, std::min<std::size_t>(64, std::size_t(options_.minSampleSeconds / seconds))) : 64;
+      }
+      for (std::size_t w = 0; w < options_.warmup; ++w) {
+        for (std::size_t i = 0; i < calls; ++i) sink = last = workload();
+      }
+
+      std::vector<double> samples(options_.repetitions);
+      for (std::size_t r = 0; r < options_.repetitions; ++r) {
+        Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < calls; ++i) sink = last = workload();
+        samples[r] = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+      }
+      (void)sink;
+
+      BenchmarkResult result;
+      result.name = name;
+      result.parameters = parameters;
+      result.callsPerSample = calls;
+      result.nanoseconds = summarize(samples);
+      result.result = last;
+      results_.push_back(result);
+      print(std::cout, results_.back());
+      return results_.back();
+    }
+
+    // baseline written by an earlier writeJson; a missing file is not an error
+    bool loadBaseline(const std::string& path) {
+      std::ifstream in(path.c_str());
+      if (!in) return false;
+      std::stringstream text;
+      text << in.rdbuf();
+      std::vector<std::map<std::string, std::string> > objects = parseBenchmarks(text.str());
+      for (std::size_t i = 0; i < objects.size(); ++i) {
+        std::map<std::string, std::string>& o = objects[i];
+        BenchmarkResult r;
+        r.name = o["name"];
+        r.parameters = o["parameters"];
+        r.callsPerSample = std::atol(o["calls_per_sample"].c_str());
+        r.nanoseconds.min = std::atof(o["min_ns"].c_str());
+        r.nanoseconds.median = std::atof(o["median_ns"].c_str());
+        r.nanoseconds.mean = std::atof(o["mean_ns"].c_str());
+        r.nanoseconds.stddev = std::atof(o["stddev_ns"].c_str());
+        r.nanoseconds.mad = std::atof(o["mad_ns"].c_str());
+        r.nanoseconds.p90 = std::atof(o["p90_ns"].c_str());
+        r.nanoseconds.max = std::atof(o["max_ns"].c_str());
+        r.result = std::atof(o["result"].c_str());
+        baseline_[r.key()] = r;
+      }
+      return true;
+    }
+
+    bool hasBaseline() const { return !baseline_.empty(); }
+
+    BenchmarkComparison compare(const BenchmarkResult& current, double resultTolerance = 1e-6) const {
+      BenchmarkComparison c = { false, 1.0, 0.0, 0.0, false, false };
+      std::map<std::string, BenchmarkResult>::const_iterator it = baseline_.find(current.key());
+      if (it == baseline_.end() || it->second.nanoseconds.median <= 0.0) return c;
+      const BenchmarkResult& base = it->second;
+      c.found = true;
+      c.baselineMedian = base.nanoseconds.median;
+      c.baselineResult = base.result;
+      c.ratio = current.nanoseconds.median / base.nanoseconds.median;
+      double noise = 3.0 * std::max(current.nanoseconds.mad, base.nanoseconds.mad);
+      c.regressed = c.ratio > 1.0 + options_.tolerance
+                 && current.nanoseconds.median - base.nanoseconds.median > noise;
+      c.drifted = std::fabs(current.result - base.result)
+                > resultTolerance * std::max(1.0, std::fabs(base.result));
+      return c;
+    }
+
+    void writeJson(const std::string& path) const {
+      std::ofstream out(path.c_str());
+      out << "{\n  \"suite\": " << quote(suite_) << ",\n"
+          << "  \"context\": { \"compiler\": " << quote(compiler())
+          << ", \"hardware_threads\": " << std::thread::hardware_concurrency()
+          << ", \"warmup\": " << options_.warmup
+          << ", \"repetitions\": " << options_.repetitions << " },\n"
+          << "  \"benchmarks\": [\n";
+      for (std::size_t i = 0; i < results_.size(); ++i) {
+        const BenchmarkResult& r = results_[i];
+        char numbers[512];
+        std::snprintf(numbers, sizeof(numbers),
+                      "\"calls_per_sample\": %lu, \"min_ns\": %.3f, \"median_ns\": %.3f, \"mean_ns\": %.3f, "
+                      "\"stddev_ns\": %.3f, \"mad_ns\": %.3f, \"p90_ns\": %.3f, \"max_ns\": %.3f, \"result\": %.17g",
+                      static_cast<unsigned long>(r.callsPerSample), r.nanoseconds.min, r.nanoseconds.median,
+                      r.nanoseconds.mean, r.nanoseconds.stddev, r.nanoseconds.mad, r.nanoseconds.p90,
+                      r.nanoseconds.max, r.result);
+        out << "    { \"name\": " << quote(r.name) << ", \"parameters\": " << quote(r.parameters)
+            << ", " << numbers << " }" << (i + 1 < results_.size() ? "," : "") << "\n";
+      }
+      out << "  ]\n}\n";
+    }
+
+    static void print(std::ostream& out, const BenchmarkResult& r) {
+      char line[256];
+      std::snprintf(line, sizeof(line), "%-44s median %12.1f ns  mad %9.1f  min %12.1f  p90 %12.1f  (%lu calls/sample)",
+                    r.key().c_str(), r.nanoseconds.median, r.nanoseconds.mad, r.nanoseconds.min,
+                    r.nanoseconds.p90, static_cast<unsigned long>(r.callsPerSample));
+      out << line << std::endl;
+    }
+
+  private:
+    static std::string compiler() {
+#ifdef __VERSION__
+      return __VERSION__;
+#else
+      return "unknown";
+#endif
+    }
+
+    static std::string quote(const std::string& s) {
+      std::string q = "\"";
+      for (std::size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\') q += '\\';
+        q += s[i];
+      }
+      return q + "\"";
+    }
+
+    // just enough JSON for the flat objects writeJson puts in "benchmarks"
+    static std::vector<std::map<std::string, std::string> > parseBenchmarks(const std::string& text) {
+      std::vector<std::map<std::string, std::string> > objects;
+      std::size_t pos = text.find("\"benchmarks\"");
+      if (pos == std::string::npos) return objects;
+      while ((pos = text.find('{', pos)) != std::string::npos) {
+        std::map<std::string, std::string> object;
+        ++pos;
+        for (;;) {
+          pos = text.find_first_of("\"}", pos);
+          if (pos == std::string::npos || text[pos] == '}') break;
+          std::string key = readString(text, pos);
+          pos = text.find(':', pos) + 1;
+          while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+          if (pos < text.size() && text[pos] == '"') {
+            object[key] = readString(text, pos);
+          } else {
+            std::size_t end = text.find_first_of(",}", pos);
+            object[key] = text.substr(pos, end - pos);
+            pos = end;
+          }
+        }
+        if (pos == std::string::npos) break;
+        objects.push_back(object);
+        ++pos;
+      }
+      return objects;
+    }
+
+    // reads the string literal starting at text[pos] == '"' and leaves pos past it
+    static std::string readString(const std::string& text, std::size_t& pos) {
+      std::string s;
+      for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+        if (text[pos] == '\\' && pos + 1 < text.size()) ++pos;
+        s += text[pos];
+      }
+      ++pos;
+      return s;
+    }
+
+    std::string suite_;
+    BenchmarkOptions options_;
+    std::vector<BenchmarkResult> results_;
+    std::map<std::string, BenchmarkResult> baseline_;
+};
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef QLTUTOR_COVARIANCEMODEL_HPP
+#define QLTUTOR_COVARIANCEMODEL_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include "portfoliokernels.hpp"
+#include "cholesky.hpp"
+
+// Covariance matrices the optimizers can use without holding them as n x n arrays.
+//
+// CovarianceModel is what the cost functions and the frontier need: w' S w, S w (the
+// variance gradient is 2 S w), risk contributions w_i (S w)_i and solves S x = b.
+//
+// DenseCovariance is an ordinary matrix: n^2 doubles, O(n^2) per product, and a
+// Cholesky factor, built on the first solve, for O(n^2) solves after O(n^3) once.
+//
+// FactorCovariance is the factor model S = B F B' + D with n x k loadings B, k x k
+// factor covariance F and diagonal specific variances D. It keeps G = B L, L the
+// Cholesky factor of F, so S = G G' + D and
+//   S w = G (G' w) + D w,                    O(nk)
+//   S^-1 b = D^-1 (b - G M^-1 G' D^-1 b),    M = I + G' D^-1 G (Woodbury), O(nk + k^2)
+// after O(nk^2) to build G and M. Memory is (k + 1) n doubles.
+//
+// The models keep k-sized workspaces (and the dense one its lazy factor), so an
+// instance is not for concurrent use: give each thread its own.
+
+namespace qltutor {
+
+class CovarianceModel {
+  public:
+    virtual ~CovarianceModel() {}
+
+    virtual std::size_t size() const = 0;
+    virtual double covariance(std::size_t i, std::size_t j) const = 0;
+    // w' S w
+    virtual double variance(const double* w) const = 0;
+    // y <- S w; y must not overlap w
+    virtual void multiply(const double* w, double* y) const = 0;
+    // x <- S^-1 b; x may be b
+    virtual void solve(const double* b, double* x) const = 0;
+    // the full matrix, n x n row-major with `ld` doubles between rows
+    virtual void copyTo(double* out, std::size_t ld) const = 0;
+    virtual std::size_t memoryBytes() const = 0;
+
+    // rc[i] = w[i] (S w)[i]; they add up to the variance. rc must not overlap w.
+    void riskContributions(const double* w, double* rc) const {
+      multiply(w, rc);
+      for (std::size_t i = 0; i < size(); ++i) rc[i] *= w[i];
+    }
+};
+
+class DenseCovariance : public CovarianceModel {
+  public:
+    // from the lower triangle of cov, row-major with `ld` doubles between rows
+    DenseCovariance(std::size_t n, const double* cov, std::size_t ld) : n_(n), covariance_(n * n), factored_(false) {
+      for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) covariance_[i * n + j] = covariance_[j * n + i] = cov[i * ld + j];
+      }
+    }
+
+    std::size_t size() const { return n_; }
+    double covariance(std::size_t i, std::size_t j) const { return covariance_[i * n_ + j]; }
+    double variance(const double* w) const { return quadraticForm(n_, &covariance_[0], n_, w); }
+    void multiply(const double* w, double* y) const { symmetricMultiply(n_, &covariance_[0], n_, w, y); }
+
+    void solve(const double* b, double* x) const {
+      if (!factored_) {
+        factorization_.factor(n_, &covariance_[0], n_);
+        factored_ = true;
+      }
+      factorization_.solve(b, x);
+    }
+
+    void copyTo(double* out, std::size_t ld) const {
+      for (std::size_t i = 0; i < n_; ++i) std::copy(&covariance_[i * n_], &covariance_[i * n_] + n_, out + i * ld);
+    }
+
+    std::size_t memoryBytes() const { return covariance_.size() * sizeof(double); }
+
+  private:
+    std::size_t n_;
+    std::vector<double> covariance_;
+    mutable CholeskyFactorization factorization_;
+    mutable bool factored_;
+};
+
+class FactorCovariance : public CovarianceModel {
+  public:
+    // loadings n x k (ld doubles between rows), factor covariance k x k (lower triangle
+    // read), specific variances n, all positive
+    FactorCovariance(std::size_t n, std::size_t k, const double* loadings, std::size_t loadingsLd,
+                     const double* factorCovariance, std::size_t factorLd, const double* specificVariances)
+      : n_(n), k_(k), g_(n * k), specific_(specificVariances, specificVariances + n), t_(k), u_(k) {
+      if (k == 0) throw std::invalid_argument("a factor model needs at least one factor");
+      for (std::size_t i = 0; i < n; ++i) {
+        if (!(specific_[i] > 0.0)) throw std::domain_error("specific variances must be positive");
+      }
+      CholeskyFactorization factorRoot(k, factorCovariance, factorLd);
+      for (std::size_t i = 0; i < n; ++i) {
+        const double* b = loadings + i * loadingsLd;
+        double* g = &g_[i * k];
+        for (std::size_t m = 0; m < k; ++m) {
+          double s = 0.0;
+          for (std::size_t l = m; l < k; ++l) s += b[l] * factorRoot(l, m);
+          g[m] = s;
+        }
+      }
+
+      // M = I + G' D^-1 G, lower triangle, accumulated row by row of G
+      std::vector<double> m(k * k, 0.0);
+      for (std::size_t i = 0; i < n; ++i) {
+        const double* g = &g_[i * k];
+        double scale = 1.0 / specific_[i];
+        for (std::size_t a = 0; a < k; ++a) {
+          double ga = scale * g[a];
+          for (std::size_t b = 0; b <= a; ++b) m[a * k + b] += ga * g[b];
+        }
+      }
+      for (std::size_t a = 0; a < k; ++a) m[a * k + a] += 1.0;
+      woodbury_.factor(k, &m[0], k);
+    }
+
+    std::size_t size() const { return n_; }
+    std::size_t factors() const { return k_; }
+    double specificVariance(std::size_t i) const { return specific_[i]; }
+    // G = B chol(F), n x k row-major: S = G G' + D
+    const double* rootLoadings() const { return &g_[0]; }
+
+    double covariance(std::size_t i, std::size_t j) const {
+      double s = detail::dot(&g_[i * k_], &g_[j * k_], k_);
+      return i == j ? s + specific_[i] : s;
+    }
+
+    double variance(const double* w) const {
+      project(w);
+      double s = detail::dot(&t_[0], &t_[0], k_);
+      for (std::size_t i = 0; i < n_; ++i) s += specific_[i] * w[i] * w[i];
+      return s;
+    }
+
+    void multiply(const double* w, double* y) const {
+      project(w);
+      for (std::size_t i = 0; i < n_; ++i) y[i] = detail::dot(&g_[i * k_], &t_[0], k_) + specific_[i] * w[i];
+    }
+
+    void solve(const double* b, double* x) const {
+      std::fill(u_.begin(), u_.end(), 0.0);
+      for (std::size_t i = 0; i < n_; ++i) {
+        double scaled = b[i] / specific_[i];
+        const double* g = &g_[i * k_];
+        for (std::size_t m = 0; m < k_; ++m) u_[m] += g[m] * scaled;
+      }
+      woodbury_.solve(&u_[0], &u_[0]);
+      for (std::size_t i = 0; i < n_; ++i) x[i] = (b[i] - detail::dot(&g_[i * k_], &u_[0], k_)) / specific_[i];
+    }
+
+    void copyTo(double* out, std::size_t ld) const {
+      for (std::size_t i = 0; i < n_; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) out[i * ld + j] = out[j * ld + i] = covariance(i, j);
+      }
+    }
+
+    std::size_t memoryBytes() const { return (g_.size() + specific_.size()) * sizeof(double); }
+
+  private:
+    // t_ <- G' w
+    void project(const double* w) const {
+      std::fill(t_.begin(), t_.end(), 0.0);
+      for (std::size_t i = 0; i < n_; ++i) {
+        const double* g = &g_[i * k_];
+        double wi = w[i];
+        for (std::size_t m = 0; m < k_; ++m) t_[m] += g[m] * wi;
+      }
+    }
+
+    std::size_t n_, k_;
+    std::vector<double> g_, specific_;
+    CholeskyFactorization woodbury_;
+    mutable std::vector<double> t_, u_;
+};
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef QLTUTOR_COVEST_HPP
+#define QLTUTOR_COVEST_HPP
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "portfoliokernels.hpp"
+
+// Covariance of asset returns, estimated in one pass over a return panel.
+//
+// A panel is T observations (rows, oldest first) of n asset returns, row-major with
+// `ld` doubles between rows; a SnapshotView of a return panel hands out exactly that
+// without copying. The estimator keeps weighted moment sums, so panels and single
+// observations can be added in any mix, and with equal weights observations can be
+// removed again for a rolling window.
+//
+// addPanel() is a SYRK: the lower triangle of sum_t w_t x_t x_t' is computed in
+// blockSize x blockSize tiles, timeBlock observations at a time, with both column
+// blocks of a tile packed asset-major so the innermost loop is a contiguous dot
+// product. Tiles are split among threads in contiguous runs, each thread owning its
+// tiles outright, so there is no locking and a thread reuses its packed row block
+// across the tiles of a tile row.
+//
+// With a half-life h, an observation k steps older than the newest weighs
+// 0.5^(k/h). The covariance divides by the total weight (the maximum likelihood
+// estimate, as Ledoit-Wolf use); for equal weights multiply by T/(T-1) for the
+// unbiased one.
+//
+// Ledoit-Wolf (2004) shrinks towards the scaled identity mu I, mu = tr(S)/n, with
+// intensity min(b^2, d^2)/d^2, where d^2 = |S - mu I|^2 and
+//   b^2 = sum_t w_t |z_t z_t' - S|^2 / (W T_eff),   z_t = x_t - mean,
+// T_eff = W^2 / sum_t w_t^2 (T for equal weights). The fourth-moment term is expanded
+// around the final mean from running sums, so it needs no second pass either.
+
+namespace qltutor {
+
+struct CovarianceEstimatorOptions {
+  CovarianceEstimatorOptions() : halfLife(0.0), blockSize(64), timeBlock(256), threads(0) {}
+  double halfLife;          // in observations; 0 for equal weights
+  std::size_t blockSize;    // assets per tile side
+  std::size_t timeBlock;    // observations per sweep over the tiles
+  unsigned threads;         // 0 for std::thread::hardware_concurrency()
+};
+
+class CovarianceEstimator {
+  public:
+    explicit CovarianceEstimator(std::size_t n, const CovarianceEstimatorOptions& options = CovarianceEstimatorOptions())
+      : n_(n), options_(options), decay_(options.halfLife > 0.0 ? std::pow(0.5, 1.0 / options.halfLife) : 1.0)
+      , weight_(0.0), weightSquared_(0.0), fourth_(0.0), count_(0)
+      , first_(n, 0.0), secondTimesNorm_(n, 0.0), second_(n * n, 0.0) {
+      if (options_.blockSize == 0 || options_.timeBlock == 0) throw std::invalid_argument("block sizes must be positive");
+    }
+
+    std::size_t size() const { return n_; }
+    std::size_t observations() const { return count_; }
+    double totalWeight() const { return weight_; }
+    double effectiveObservations() const { return weightSquared_ > 0.0 ? weight_ * weight_ / weightSquared_ : 0.0; }
+
+    // T observations, oldest first; with a half-life the estimator's earlier state ages by T steps
+    void addPanel(const double* returns, std::size_t observations, std::size_t ld) {
+      if (observations == 0) return;
+      decay(std::pow(decay_, double(observations)));
+      std::vector<double> weights(observations);
+      for (std::size_t t = 0; t < observations; ++t) {
+        weights[t] = std::pow(decay_, double(observations - 1 - t));
+        addMoments(returns + t * ld, weights[t], 1.0);
+      }
+      syrk(returns, observations, ld, &weights[0]);
+      count_ += observations;
+    }
+
+    // one new observation
+    void add(const double* x) {
+      decay(decay_);
+      addMoments(x, 1.0, 1.0);
+      rankOne(x, 1.0);
+      ++count_;
+    }
+
+    // drops an observation added earlier; equal weights only
+    void remove(const double* x) {
+      if (decay_ != 1.0) throw std::logic_error("observations cannot be removed under exponential weighting");
+      if (count_ == 0) throw std::logic_error("no observation to remove");
+      addMoments(x, 1.0, -1.0);
+      rankOne(x, -1.0);
+      --count_;
+    }
+
+    // sample covariance, n x n with both triangles
+    void covariance(double* out, std::size_t ld) const {
+      std::vector<double> mean(n_);
+      meanInto(&mean[0]);
+      for (std::size_t i = 0; i < n_; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) {
+          out[i * ld + j] = out[j * ld + i] = second_[i * n_ + j] / weight_ - mean[i] * mean[j];
+        }
+      }
+    }
+
+    // Ledoit-Wolf intensity in [0, 1]
+    double shrinkageIntensity() const {
+      double mu, d2, b2;
+      ledoitWolf(mu, d2, b2);
+      return d2 > 0.0 ? std::min(b2, d2) / d2 : 1.0;
+    }
+
+    // (1 - delta) S + delta mu I
+    void shrunkCovariance(double* out, std::size_t ld) const {
+      double mu, d2, b2;
+      ledoitWolf(mu, d2, b2);
+      double delta = d2 > 0.0 ? std::min(b2, d2) / d2 : 1.0;
+      covariance(out, ld);
+      for (std::size_t i = 0; i < n_; ++i) {
+        for (std::size_t j = 0; j < n_; ++j) out[i * ld + j] *= 1.0 - delta;
+        out[i * ld + i] += delta * mu;
+      }
+    }
+
+  private:
+    void meanInto(double* mean) const {
+      if (!(weight_ > 0.0)) throw std::logic_error("no observations");
+      for (std::size_t i = 0; i < n_; ++i) mean[i] = first_[i] / weight_;
+    }
+
+    void decay(double factor) {
+      if (factor == 1.0) return;
+      weight_ *= factor;
+      weightSquared_ *= factor * factor;
+      fourth_ *= factor;
+      for (std::size_t i = 0; i < n_; ++i) {
+        first_[i] *= factor;
+        secondTimesNorm_[i] *= factor;
+        double* row = &second_[i * n_];
+        for (std::size_t j = 0; j <= i; ++j) row[j] *= factor;
+      }
+    }
+
+    // everything but the second moments, O(n); sign -1 removes
+    void addMoments(const double* x, double w, double sign) {
+      double norm = detail::dot(x, x, n_);
+      weight_ += sign * w;
+      weightSquared_ += sign * w * w;
+      fourth_ += sign * w * norm * norm;
+      for (std::size_t i = 0; i < n_; ++i) {
+        first_[i] += sign * w * x[i];
+        secondTimesNorm_[i] += sign * w * norm * x[i];
+      }
+    }
+
+    void rankOne(const double* x, double w) {
+      for (std::size_t i = 0; i < n_; ++i) {
+        double wxi = w * x[i];
+        double* row = &second_[i * n_];
+        for (std::size_t j = 0; j <= i; ++j) row[j] += wxi * x[j];
+      }
+    }
+
+    void syrk(const double* returns, std::size_t observations, std::size_t ld, const double* weights) {
+      std::size_t b = options_.blockSize, blocks = (n_ + b - 1) / b;
+      std::size_t tiles = blocks * (blocks + 1) / 2;
+      unsigned threads = options_.threads ? options_.threads : std::max(1u, std::thread::hardware_concurrency());
+      threads = unsigned(std::min<std::size_t>(threads, tiles));
+
+      std::vector<std::thread> workers;
+      for (unsigned p = 1; p < threads; ++p) {
+        workers.push_back(std::thread(&CovarianceEstimator::syrkTiles, this, returns, observations, ld, weights,
+                                      tiles * p / threads, tiles * (p + 1) / threads));
+      }
+      syrkTiles(returns, observations, ld, weights, 0, tiles / threads);
+      for (std::size_t p = 0; p < workers.size(); ++p) workers[p].join();
+    }
+
+    // tiles numbered row by row over the lower triangle: (0,0), (1,0), (1,1), (2,0), ...
+    void syrkTiles(const double* returns, std::size_t observations, std::size_t ld, const double* weights,
+                   std::size_t firstTile, std::size_t endTile) {
+      if (firstTile >= endTile) return;
+      std::size_t b = options_.blockSize, tb = options_.timeBlock;
+      std::vector<double> rowBlock(b * tb), columnBlock(b * tb);
+      double* second = &second_[0];   // only this thread's tiles are written
+
+      for (std::size_t t0 = 0; t0 < observations; t0 += tb) {
+        std::size_t tl = std::min(tb, observations - t0);
+        std::size_t tile = 0, packedRow = std::size_t(-1);
+        for (std::size_t ib = 0; tile < endTile; ++ib) {
+          for (std::size_t jb = 0; jb <= ib && tile < endTile; ++jb, ++tile) {
+            if (tile < firstTile) continue;
+            std::size_t i0 = ib * b, iEnd = std::min(i0 + b, n_);
+            std::size_t j0 = jb * b, jEnd = std::min(j0 + b, n_);
+            if (packedRow != ib) {
+              pack(returns, ld, t0, tl, i0, iEnd, weights, &rowBlock[0]);
+              packedRow = ib;
+            }
+            pack(returns, ld, t0, tl, j0, jEnd, 0, &columnBlock[0]);
+            for (std::size_t i = i0; i < iEnd; ++i) {
+              const double* wx = &rowBlock[(i - i0) * tl];
+              double* row = second + i * n_;
+              std::size_t jLast = std::min(jEnd, i + 1);
+              for (std::size_t j = j0; j < jLast; ++j) row[j] += detail::dot(wx, &columnBlock[(j - j0) * tl], tl);
+            }
+          }
+        }
+      }
+    }
+
+    // columns [c0, cEnd) of rows [t0, t0 + tl), asset-major, optionally times the row weights
+    static void pack(const double* returns, std::size_t ld, std::size_t t0, std::size_t tl,
+                     std::size_t c0, std::size_t cEnd, const double* weights, double* out) {
+      for (std::size_t t = 0; t < tl; ++t) {
+        const double* row = returns + (t0 + t) * ld;
+        double w = weights ? weights[t0 + t] : 1.0;
+        for (std::size_t c = c0; c < cEnd; ++c) out[(c - c0) * tl + t] = w * row[c];
+      }
+    }
+
+    void ledoitWolf(double& mu, double& d2, double& b2) const {
+      std::vector<double> mean(n_), secondTimesMean(n_);
+      meanInto(&mean[0]);
+      symmetricMultiply(n_, &second_[0], n_, &mean[0], &secondTimesMean[0]);
+
+      double mm = detail::dot(&mean[0], &mean[0], n_);
+      double trace = 0.0, normSquared = 0.0;
+      for (std::size_t i = 0; i < n_; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) {
+          double s = second_[i * n_ + j] / weight_ - mean[i] * mean[j];
+          normSquared += (i == j ? 1.0 : 2.0) * s * s;
+          if (i == j) trace += s;
+        }
+      }
+      double secondTrace = 0.0;
+      for (std::size_t i = 0; i < n_; ++i) secondTrace += second_[i * n_ + i];
+
+      // sum_t w_t |x_t - mean|^4
+      double centeredFourth = fourth_
+        - 4.0 * detail::dot(&mean[0], &secondTimesNorm_[0], n_)
+        + 4.0 * detail::dot(&mean[0], &secondTimesMean[0], n_)
+        + 2.0 * mm * secondTrace
+        - 4.0 * mm * detail::dot(&mean[0], &first_[0], n_)
+        + mm * mm * weight_;
+
+      mu = trace / n_;
+      d2 = normSquared - n_ * mu * mu;
+      b2 = std::max(0.0, centeredFourth / weight_ - normSquared) / effectiveObservations();
+    }
+
+    std::size_t n_;
+    CovarianceEstimatorOptions options_;
+    double decay_;
+    double weight_, weightSquared_, fourth_;   // sum w, sum w^2, sum w |x|^4
+    std::size_t count_;
+    std::vector<double> first_;                // sum w x
+    std::vector<double> secondTimesNorm_;      // sum w |x|^2 x
+    std::vector<double> second_;               // sum w x x', lower triangle
+};
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef QLTUTOR_COVUPDATE_HPP
+#define QLTUTOR_COVUPDATE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "cholesky.hpp"
+#include "portfoliokernels.hpp"
+
+// A covariance matrix and its Cholesky factor, kept in step under small changes.
+//
+// Changing one asset's volatility, one correlation or one row of the matrix is a
+// symmetric rank-2 change, S + p p' - q q', applied to the factor as one rank-one
+// update and one downdate: O(n^2) instead of refactoring in O(n^3). Updates are used
+// rather than Sherman-Morrison-Woodbury on an explicit inverse, which compounds
+// rounding error with every change.
+//
+// Downdates still lose accuracy when the matrix is close to singular, so after every
+// change the factor is checked against the matrix on a fixed probe vector z:
+//   drift = |L L' z - S z|_inf / |S z|_inf,
+// another O(n^2). The factor is rebuilt from the matrix once the drift exceeds
+// `driftTolerance`, after `maxUpdates` changes, or when a downdate breaks down. A change
+// that leaves the matrix not positive definite is rolled back and refused.
+
+namespace qltutor {
+
+struct CovarianceUpdateOptions {
+  CovarianceUpdateOptions() : driftTolerance(1e-10), maxUpdates(500) {}
+  double driftTolerance;
+  std::size_t maxUpdates;
+};
+
+class IncrementalCovariance {
+  public:
+    IncrementalCovariance(std::size_t n, const double* covariance, std::size_t ld,
+                          const CovarianceUpdateOptions& options = CovarianceUpdateOptions())
+      : n_(n), covariance_(n * n), options_(options), updates_(0), factorizations_(0), drift_(0.0)
+      , probe_(n), p_(n), q_(n), row_(n), sz_(n), llz_(n), t_(n) {
+      for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) {
+          covariance_[i * n + j] = covariance_[j * n + i] = covariance[i * ld + j];
+        }
+      }
+      // fixed, deterministic, not aligned with any structure of the matrix
+      for (std::size_t i = 0; i < n; ++i) probe_[i] = (i % 3 == 0 ? -1.0 : 1.0) * (1.0 + 0.5 * std::sin(double(i)));
+      refactor();
+    }
+
+    std::size_t size() const { return n_; }
+    // n x n row-major, both triangles
+    const double* covariance() const { return &covariance_[0]; }
+    double covariance(std::size_t i, std::size_t j) const { return covariance_[i * n_ + j]; }
+    const CholeskyFactorization& factorization() const { return factorization_; }
+
+    // x <- S^-1 b in O(n^2); x may be b
+    void solve(const double* b, double* x) const { factorization_.solve(b, x); }
+
+    // rescales row and column i, correlations unchanged
+    void setVolatility(std::size_t i, double volatility) {
+      double scale = volatility / std::sqrt(covariance_[i * n_ + i]);
+      for (std::size_t j = 0; j < n_; ++j) row_[j] = covariance_[i * n_ + j] * scale;
+      row_[i] = volatility * volatility;
+      replaceRow(i);
+    }
+
+    void setCorrelation(std::size_t i, std::size_t j, double correlation) {
+      setCovariance(i, j, correlation * std::sqrt(covariance_[i * n_ + i] * covariance_[j * n_ + j]));
+    }
+
+    void setCovariance(std::size_t i, std::size_t j, double value) {
+      std::copy(&covariance_[i * n_], &covariance_[i * n_] + n_, row_.begin());
+      row_[j] = value;
+      replaceRow(i);
+    }
+
+    // row and column i become `row`
+    void setRow(std::size_t i, const double* row) {
+      std::copy(row, row + n_, row_.begin());
+      replaceRow(i);
+    }
+
+    void refactor() {
+      factorization_.factor(n_, &covariance_[0], n_);
+      ++factorizations_;
+      updates_ = 0;
+      drift_ = 0.0;
+    }
+
+    std::size_t updatesSinceFactorization() const { return updates_; }
+    std::size_t factorizations() const { return factorizations_; }
+    double drift() const { return drift_; }     // as measured after the last change
+
+  private:
+    // S <- S + e_i d' + d e_i' - d_i e_i e_i', d = row_ - S_i. With d~ = d - d_i e_i / 2
+    // and a = t e_i, b = d~ / t, that is a b' + b a' = p p' - q q' for p, q = (a +- b)/sqrt(2).
+    void replaceRow(std::size_t i) {
+      double* si = &covariance_[i * n_];
+      double norm = 0.0;
+      for (std::size_t j = 0; j < n_; ++j) {
+        p_[j] = row_[j] - si[j];
+        norm = std::max(norm, std::fabs(p_[j]));
+      }
+      if (norm == 0.0) return;
+      p_[i] *= 0.5;
+      double t = std::sqrt(norm);
+      for (std::size_t j = 0; j < n_; ++j) {
+        double b = p_[j] / t;
+        p_[j] = (j == i ? t + b : b) * std::sqrt(0.5);
+        q_[j] = (j == i ? t - b : -b) * std::sqrt(0.5);
+      }
+
+      // apply to the matrix, keeping the old row for a rollback
+      std::swap_ranges(si, si + n_, row_.begin());
+      for (std::size_t j = 0; j < n_; ++j) covariance_[j * n_ + i] = si[j];
+
+      if (factorization_.rankOneUpdate(&p_[0], 1.0) && factorization_.rankOneUpdate(&q_[0], -1.0)) {
+        ++updates_;
+        if (updates_ >= options_.maxUpdates || measureDrift() > options_.driftTolerance) refactor();
+        return;
+      }
+      try {
+        refactor();
+      } catch (std::domain_error&) {
+        std::copy(row_.begin(), row_.end(), si);
+        for (std::size_t j = 0; j < n_; ++j) covariance_[j * n_ + i] = si[j];
+        refactor();
+        throw;
+      }
+    }
+
+    double measureDrift() {
+      symmetricMultiply(n_, &covariance_[0], n_, &probe_[0], &sz_[0]);
+      factorization_.multiply(&probe_[0], &llz_[0], &t_[0]);
+      double error = 0.0, scale = 0.0;
+      for (std::size_t j = 0; j < n_; ++j) {
+        error = std::max(error, std::fabs(llz_[j] - sz_[j]));
+        scale = std::max(scale, std::fabs(sz_[j]));
+      }
+      drift_ = error / scale;
+      return drift_;
+    }
+
+    std::size_t n_;
+    std::vector<double> covariance_;
+    CholeskyFactorization factorization_;
+    CovarianceUpdateOptions options_;
+    std::size_t updates_, factorizations_;
+    double drift_;
+    std::vector<double> probe_, p_, q_, row_, sz_, llz_, t_;
+};
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef QLTUTOR_FFT_HPP
+#define QLTUTOR_FFT_HPP
+
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+namespace qltutor {
+
+// in-place iterative radix-2 FFT, X[k] = Sum_j x[j] exp(-2 pi i jk/N)
+// N must be a power of two; twiddles are computed once per stage
+inline void fft(std::vector<std::complex<double> >& x) {
+  const std::size_t n = x.size();
+  if (n < 2) return;
+  if ((n & (n - 1)) != 0) {
+    throw std::invalid_argument("fft size must be a power of two");
+  }
+
+  // bit reversal permutation
+  for (std::size_t i = 1, j = 0; i < n; ++i) {
+    std::size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) std::swap(x[i], x[j]);
+  }
+
+  const double pi = 3.14159265358979323846;
+  std::vector<std::complex<double> > twiddle(n / 2);
+  for (std::size_t len = 2; len <= n; len <<= 1) {
+    const std::size_t half = len / 2;
+    const double angle = -2.0 * pi / len;
+    for (std::size_t k = 0; k < half; ++k) {
+      twiddle[k] = std::polar(1.0, angle * k);
+    }
+    for (std::size_t i = 0; i < n; i += len) {
+      for (std::size_t k = 0; k < half; ++k) {
+        std::complex<double> u = x[i + k];
+        std::complex<double> v = x[i + k + half] * twiddle[k];
+        x[i + k] = u + v;
+        x[i + k + half] = u - v;
+      }
+    }
+  }
+}
+
+}
+
+#endif
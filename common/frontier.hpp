@@ -0,0 +1,126 @@
+#ifndef QLTUTOR_FRONTIER_HPP
+#define QLTUTOR_FRONTIER_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "cholesky.hpp"
+#include "covariancemodel.hpp"
+
+// Analytic mean-variance frontier of n assets, fully invested, shorting allowed.
+//
+// With x = S^-1 1 and y = S^-1 R (two triangular solves each on the Cholesky factor
+// of the covariance S) and the scalars
+//   A = 1'x,  B = 1'y,  C = R'y,  D = AC - B^2,
+// every frontier portfolio is a combination of the two funds x/A and y/B:
+//   w(m) = ((C - Bm) x + (Am - B) y) / D,   variance(m) = (Am^2 - 2Bm + C) / D.
+// The minimum variance portfolio earns B/A at variance 1/A; the tangency portfolio
+// for a riskless rate c is S^-1 (R - c1) normalized, i.e. (y - cx) / (B - cA).
+// Once built, points and weights cost O(1) and O(n) each.
+//
+// Built from a CovarianceModel, the two solves are the model's (O(nk) for a factor
+// model, which never forms S); the model must outlive the frontier and factorization()
+// is then empty.
+
+namespace qltutor {
+
+class EfficientFrontier {
+  public:
+    EfficientFrontier(std::size_t n, const double* covariance, std::size_t ld, const double* expectedReturns)
+      : factorization_(n, covariance, ld), model_(0) {
+      reset(expectedReturns);
+    }
+
+    EfficientFrontier(const CholeskyFactorization& factorization, const double* expectedReturns)
+      : factorization_(factorization), model_(0) {
+      reset(expectedReturns);
+    }
+
+    EfficientFrontier(const CovarianceModel& covariance, const double* expectedReturns)
+      : model_(&covariance) {
+      reset(expectedReturns);
+    }
+
+    // after the covariance changed: O(n^2) from an updated factorization
+    void reset(const CholeskyFactorization& factorization, const double* expectedReturns) {
+      factorization_ = factorization;
+      model_ = 0;
+      reset(expectedReturns);
+    }
+
+    // after the expected returns changed
+    void reset(const double* expectedReturns) {
+      std::size_t n = model_ ? model_->size() : factorization_.size();
+      returns_.assign(expectedReturns, expectedReturns + n);
+      x_.assign(n, 1.0);
+      solve(&x_[0]);
+      y_ = returns_;
+      solve(&y_[0]);
+      a_ = b_ = c_ = 0.0;
+      for (std::size_t i = 0; i < n; ++i) {
+        a_ += x_[i];
+        b_ += y_[i];
+        c_ += returns_[i] * y_[i];
+      }
+      d_ = a_ * c_ - b_ * b_;
+      if (!(d_ > 1e-14 * a_ * c_)) {
+        throw std::domain_error("degenerate frontier: expected returns are (nearly) all equal");
+      }
+    }
+
+    std::size_t size() const { return returns_.size(); }
+    const CholeskyFactorization& factorization() const { return factorization_; }
+    CholeskyFactorization& factorization() { return factorization_; }
+
+    double minimumVarianceReturn() const { return b_ / a_; }
+    double minimumVariance() const { return 1.0 / a_; }
+
+    double variance(double targetReturn) const {
+      return (a_ * targetReturn * targetReturn - 2.0 * b_ * targetReturn + c_) / d_;
+    }
+    double volatility(double targetReturn) const { return std::sqrt(variance(targetReturn)); }
+
+    void weights(double targetReturn, double* w) const {
+      double lambda = (c_ - b_ * targetReturn) / d_, gamma = (a_ * targetReturn - b_) / d_;
+      for (std::size_t i = 0; i < x_.size(); ++i) w[i] = lambda * x_[i] + gamma * y_[i];
+    }
+
+    void minimumVarianceWeights(double* w) const {
+      for (std::size_t i = 0; i < x_.size(); ++i) w[i] = x_[i] / a_;
+    }
+
+    void tangencyWeights(double riskFree, double* w) const {
+      double scale = b_ - riskFree * a_;
+      if (scale == 0.0) throw std::domain_error("riskless rate equals the minimum variance return");
+      for (std::size_t i = 0; i < x_.size(); ++i) w[i] = (y_[i] - riskFree * x_[i]) / scale;
+    }
+
+    // `count` points evenly spaced in expected return over [fromReturn, toReturn]
+    void trace(double fromReturn, double toReturn, std::size_t count, double* returns, double* volatilities) const {
+      for (std::size_t k = 0; k < count; ++k) {
+        double m = count > 1 ? fromReturn + (toReturn - fromReturn) * k / (count - 1) : fromReturn;
+        returns[k] = m;
+        volatilities[k] = volatility(m);
+      }
+    }
+
+  private:
+    void solve(double* x) const {
+      if (model_) {
+        model_->solve(x, x);
+      } else {
+        factorization_.solve(x, x);
+      }
+    }
+
+    CholeskyFactorization factorization_;
+    const CovarianceModel* model_;
+    std::vector<double> returns_, x_, y_;
+    double a_, b_, c_, d_;
+};
+
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef QLTUTOR_HDRHISTOGRAM_HPP
+#define QLTUTOR_HDRHISTOGRAM_HPP
+
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+// High dynamic range histogram (after Gil Tene's HdrHistogram).
+//
+// Values are bucketed log-linearly: every power-of-two range is split into the same
+// number of linear sub-buckets, enough to keep `significantDigits` decimal digits of
+// precision across [lowest, highest]. Recording is an index computation and an
+// increment, memory is fixed up front, and histograms of the same shape add up.
+
+namespace qltutor {
+
+class HdrHistogram {
+  public:
+    HdrHistogram(std::uint64_t lowest = 1, std::uint64_t highest = 3600ULL * 1000000000ULL, int significantDigits = 3)
+      : lowest_(lowest), highest_(highest), total_(0), saturated_(0)
+      , min_(UINT64_MAX), max_(0), sum_(0.0) {
+      if (lowest < 1 || highest < 2 * lowest || significantDigits < 1 || significantDigits > 5) {
+        throw std::invalid_argument("invalid histogram range or precision");
+      }
+      std::uint64_t largestSingleUnitResolution = 2;
+      for (int i = 0; i < significantDigits; ++i) largestSingleUnitResolution *= 10;
+      int subBucketCountMagnitude = int(std::ceil(std::log2(double(largestSingleUnitResolution))));
+      subBucketHalfCountMagnitude_ = std::max(subBucketCountMagnitude, 1) - 1;
+      unitMagnitude_ = int(std::floor(std::log2(double(lowest))));
+      subBucketCount_ = std::uint64_t(1) << (subBucketHalfCountMagnitude_ + 1);
+      subBucketHalfCount_ = subBucketCount_ / 2;
+      subBucketMask_ = (subBucketCount_ - 1) << unitMagnitude_;
+
+      std::uint64_t smallestUntrackable = subBucketCount_ << unitMagnitude_;
+      int buckets = 1;
+      while (smallestUntrackable <= highest) {
+        if (smallestUntrackable > UINT64_MAX / 2) {
+          ++buckets;
+          break;
+        }
+        smallestUntrackable <<= 1;
+        ++buckets;
+      }
+      counts_.assign((buckets + 1) * subBucketHalfCount_, 0);
+    }
+
+    void record(std::uint64_t value, std::uint64_t count = 1) {
+      if (value > highest_) {
+        value = highest_;
+        saturated_ += count;
+      }
+      counts_[countsIndex(value)] += count;
+      total_ += count;
+      min_ = std::min(min_, value);
+      max_ = std::max(max_, value);
+      sum_ += double(value) * count;
+    }
+
+    void add(const HdrHistogram& other) {
+      if (other.counts_.size() != counts_.size() || other.unitMagnitude_ != unitMagnitude_
+          || other.subBucketHalfCountMagnitude_ != subBucketHalfCountMagnitude_) {
+        throw std::invalid_argument("histograms have different shapes");
+      }
+      for (std::size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+      total_ += other.total_;
+      saturated_ += other.saturated_;
+      min_ = std::min(min_, other.min_);
+      max_ = std::max(max_, other.max_);
+      sum_ += other.sum_;
+    }
+
+    void reset() {
+      std::fill(counts_.begin(), counts_.end(), 0);
+      total_ = saturated_ = 0;
+      min_ = UINT64_MAX;
+      max_ = 0;
+      sum_ = 0.0;
+    }
+
+    std::uint64_t count() const { return total_; }
+    std::uint64_t saturated() const { return saturated_; }    // recorded above `highest`
+    std::uint64_t min() const { return total_ ? min_ : 0; }
+    std::uint64_t max() const { return max_; }
+    double mean() const { return total_ ? sum_ / total_ : 0.0; }
+
+    // highest value equivalent to the one at percentile p (0..100)
+    std::uint64_t valueAtPercentile(double p) const {
+      if (total_ == 0) return 0;
+      p = std::min(std::max(p, 0.0), 100.0);
+      std::uint64_t target = std::max<std::uint64_t>(1, std::uint64_t(std::ceil(p / 100.0 * total_)));
+      std::uint64_t cumulative = 0;
+      for (std::size_t i = 0; i < counts_.size(); ++i) {
+        cumulative += counts_[i];
+        if (cumulative >= target) return std::min(highestEquivalentValue(valueFromIndex(i)), max_);
+      }
+      return max_;
+    }
+
+    // percentile distribution, HdrHistogram style, values divided by `unit`
+    void printPercentiles(std::ostream& out, double unit = 1.0, const char* unitName = "") const {
+      static const double percentiles[] = { 50, 75, 90, 95, 99, 99.5, 99.9, 99.99, 100 };
+      char line[128];
+      for (std::size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+        std::snprintf(line, sizeof(line), "  %8.3f%%  %14.3f %s", percentiles[i],
+                      valueAtPercentile(percentiles[i]) / unit, unitName);
+        out << line << "\n";
+      }
+      std::snprintf(line, sizeof(line), "  mean %.3f %s, min %.3f, max %.3f, count %llu",
+                    mean() / unit, unitName, min() / unit, max() / unit,
+                    static_cast<unsigned long long>(total_));
+      out << line << std::endl;
+    }
+
+  private:
+    int bucketIndex(std::uint64_t value) const {
+      int pow2Ceiling = 64 - __builtin_clzll(value | subBucketMask_);
+      return pow2Ceiling - unitMagnitude_ - (subBucketHalfCountMagnitude_ + 1);
+    }
+
+    std::size_t countsIndex(std::uint64_t value) const {
+      int bucket = bucketIndex(value);
+      std::uint64_t subBucket = value >> (bucket + unitMagnitude_);
+      return (std::size_t(bucket + 1) << subBucketHalfCountMagnitude_) + (subBucket - subBucketHalfCount_);
+    }
+
+    std::uint64_t valueFromIndex(std::size_t index) const {
+      int bucket = int(index >> subBucketHalfCountMagnitude_) - 1;
+      std::uint64_t subBucket = (index & (subBucketHalfCount_ - 1)) + subBucketHalfCount_;
+      if (bucket < 0) {
+        subBucket -= subBucketHalfCount_;
+        bucket = 0;
+      }
+      return subBucket << (bucket + unitMagnitude_);
+    }
+
+    std::uint64_t highestEquivalentValue(std::uint64_t value) const {
+      int bucket = bucketIndex(value);
+      std::uint64_t subBucket = value >> (bucket + unitMagnitude_);
+      int adjustedBucket = subBucket >= subBucketCount_ ? bucket + 1 : bucket;
+      std::uint64_t range = std::uint64_t(1) << (unitMagnitude_ + adjustedBucket);
+      std::uint64_t lowestEquivalent = subBucket << (bucket + unitMagnitude_);
+      return lowestEquivalent + range - 1;
+    }
+
+    std::uint64_t lowest_, highest_;
+    int unitMagnitude_, subBucketHalfCountMagnitude_;
+    std::uint64_t subBucketCount_, subBucketHalfCount_, subBucketMask_;
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t total_, saturated_, min_, max_;
+    double sum_;
+};
+
+}
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef QLTUTOR_HESTONPRICER_HPP
+#define QLTUTOR_HESTONPRICER_HPP
+
+#include "parallel.hpp"
+
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+// Heston call prices and their exact parameter gradients for calibration.
+//
+// The characteristic function of x = ln(S_T/F) is written in the "little trap"
+// form and evaluated on a small forward-mode dual number, so d phi/d theta for
+// theta = (v0, kappa, theta, xi, rho) comes out of the same pass as phi itself.
+// phi depends on the expiry only, so it is cached on the quadrature nodes once per
+// expiry ("slice") and every strike of that expiry costs one O(N) sum:
+//
+//   C = D [ (F - K)/2 + 1/pi Int(0, U) Re( exp(-iuk)/(iu) (F phi(u-i) - K phi(u)) ) du ],  k = ln(K/F)
+
+namespace qltutor {
+
+struct HestonParameters {
+  enum { Size = 5 };
+  double v0, kappa, theta, xi, rho;
+
+  HestonParameters() : v0(.04), kappa(1.5), theta(.04), xi(.5), rho(-.7) {}
+  HestonParameters(double v0, double kappa, double theta, double xi, double rho)
+    : v0(v0), kappa(kappa), theta(theta), xi(xi), rho(rho) {}
+
+  double operator[](std::size_t i) const {
+    const double* p[] = { &v0, &kappa, &theta, &xi, &rho };
+    return *p[i];
+  }
+};
+
+namespace detail {
+
+  typedef std::complex<double> Complex;
+
+  // complex value with its gradient w.r.t. the five Heston parameters
+  struct HestonDual {
+    Complex v;
+    Complex d[HestonParameters::Size];
+
+    HestonDual(const Complex& value = Complex()) : v(value) {
+      for (int i = 0; i < HestonParameters::Size; ++i) d[i] = 0.0;
+    }
+    static HestonDual variable(double value, int index) {
+      HestonDual x(value);
+      x.d[index] = 1.0;
+      return x;
+    }
+  };
+
+  inline HestonDual operator+(const HestonDual& a, const HestonDual& b) {
+    HestonDual r(a.v + b.v);
+    for (int i = 0; i < HestonParameters::Size; ++i) r.d[i] = a.d[i] + b.d[i];
+    return r;
+  }
+  inline HestonDual operator-(const HestonDual& a, const HestonDual& b) {
+    HestonDual r(a.v - b.v);
+    for (int i = 0; i < HestonParameters::Size; ++i) r.d[i] = a.d[i] - b.d[i];
+    return r;
+  }
+  inline HestonDual operator*(const HestonDual& a, const HestonDual& b) {
+    HestonDual r(a.v * b.v);
+    for (int i = 0; i < HestonParameters::Size; ++i) r.d[i] = a.d[i] * b.v + a.v * b.d[i];
+    return r;
+  }
+  inline HestonDual operator/(const HestonDual& a, const HestonDual& b) {
+    HestonDual r(a.v / b.v);
+    const Complex inv2 = 1.0 / (b.v * b.v);
+    for (int i = 0; i < HestonParameters::Size; ++i) r.d[i] = (a.d[i] * b.v - a.v * b.d[i]) * inv2;
+    return r;
+  }
+  inline HestonDual exp(const HestonDual& a) {
+    HestonDual r(std::exp(a.v));
+    for (int i = 0; i < HestonParameters::Size; ++i) r.d[i] = a.d[i] * r.v;
+    return r;
+  }
+  inline HestonDual log(const HestonDual& a) {
+    HestonDual r(std::log(a.v));
+    for (int i = 0; i < HestonParameters::Size; ++i) r.d[i] = a.d[i] / a.v;
+    return r;
+  }
+  inline HestonDual sqrt(const HestonDual& a) {
+    HestonDual r(std::sqrt(a.v));
+    const Complex half = 0.5 / r.v;
+    for (int i = 0; i < HestonParameters::Size; ++i) r.d[i] = a.d[i] * half;
+    return r;
+  }
+
+  // little trap characteristic function of ln(S_T/F) and its parameter gradient
+  inline HestonDual hestonCharFunction(const HestonParameters& p, const Complex& u, double t) {
+    const Complex i(0.0, 1.0);
+    HestonDual v0 = HestonDual::variable(p.v0, 0);
+    HestonDual kappa = HestonDual::variable(p.kappa, 1);
+    HestonDual theta = HestonDual::variable(p.theta, 2);
+    HestonDual xi = HestonDual::variable(p.xi, 3);
+    HestonDual rho = HestonDual::variable(p.rho, 4);
+
+    HestonDual iu(i * u);
+    HestonDual xi2 = xi * xi;
+    HestonDual beta = kappa - rho * xi * iu;
+    HestonDual d = sqrt(beta * beta + xi2 * (iu + HestonDual(u * u)));
+    HestonDual betaMinusD = beta - d;
+    HestonDual g = betaMinusD / (beta + d);
+    HestonDual edt = exp(HestonDual(-t) * d);
+    HestonDual one(1.0);
+    HestonDual oneMinusGe = one - g * edt;
+    HestonDual c = kappa * theta / xi2
+                 * (betaMinusD * HestonDual(t) - HestonDual(2.0) * log(oneMinusGe / (one - g)));
+    HestonDual dd = betaMinusD / xi2 * (one - edt) / oneMinusGe;
+    return exp(c + dd * v0);
+  }
+
+}
+
+class HestonFourierPricer {
+  public:
+    // phi and d phi/d theta at the quadrature nodes for one expiry
+    struct Slice {
+      double t;
+      std::vector<std::complex<double> > phi, phiShifted;
+      std::vector<std::complex<double> > dphi[HestonParameters::Size];
+      std::vector<std::complex<double> > dphiShifted[HestonParameters::Size];
+    };
+
+    explicit HestonFourierPricer(std::size_t nodes = 96, double upper = 200.0) {
+      gaussLegendre(nodes, upper);
+    }
+
+    std::size_t nodes() const { return u_.size(); }
+
+    void prepare(const HestonParameters& p, double t, Slice& slice) const {
+      const std::size_t n = u_.size();
+      slice.t = t;
+      slice.phi.resize(n);
+      slice.phiShifted.resize(n);
+      for (int j = 0; j < HestonParameters::Size; ++j) {
+        slice.dphi[j].resize(n);
+        slice.dphiShifted[j].resize(n);
+      }
+      for (std::size_t k = 0; k < n; ++k) {
+        detail::HestonDual a = detail::hestonCharFunction(p, std::complex<double>(u_[k], 0.0), t);
+        detail::HestonDual b = detail::hestonCharFunction(p, std::complex<double>(u_[k], -1.0), t);
+        slice.phi[k] = a.v;
+        slice.phiShifted[k] = b.v;
+        for (int j = 0; j < HestonParameters::Size; ++j) {
+          slice.dphi[j][k] = a.d[j];
+          slice.dphiShifted[j][k] = b.d[j];
+        }
+      }
+    }
+
+    // discounted call price; gradient (size 5) is filled when non-null
+    double callPrice( const Slice& slice
+                    , double forward
+                    , double discount
+                    , double strike
+                    , double* gradient = 0) const {
+      const double pi = 3.14159265358979323846;
+      const double k = std::log(strike / forward);
+      const std::size_t n = u_.size();
+      double integral = 0.0;
+      double dintegral[HestonParameters::Size] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+      for (std::size_t m = 0; m < n; ++m) {
+        // w_m exp(-iuk)/(iu)
+        const std::complex<double> kernel =
+          std::polar(w_[m], -u_[m] * k) / std::complex<double>(0.0, u_[m]);
+        integral += (kernel * (forward * slice.phiShifted[m] - strike * slice.phi[m])).real();
+        if (gradient) {
+          for (int j = 0; j < HestonParameters::Size; ++j) {
+            dintegral[j] += (kernel * (forward * slice.dphiShifted[j][m] - strike * slice.dphi[j][m])).real();
+          }
+        }
+      }
+
+      if (gradient) {
+        for (int j = 0; j < HestonParameters::Size; ++j) {
+          gradient[j] = discount * dintegral[j] / pi;
+        }
+      }
+      return discount * (0.5 * (forward - strike) + integral / pi);
+    }
+
+  private:
+    // Gauss-Legendre nodes and weights on [0, upper]
+    void gaussLegendre(std::size_t n, double upper) {
+      const double pi = 3.14159265358979323846;
+      u_.resize(n);
+      w_.resize(n);
+      for (std::size_t i = 0; i < (n + 1) / 2; ++i) {
+        double z = std::cos(pi * (i + 0.75) / (n + 0.5));
+        double dp = 0.0;
+        for (int iter = 0; iter < 100; ++iter) {
+          double p0 = 1.0, p1 = 0.0;
+          for (std::size_t j = 0; j < n; ++j) {
+            double p2 = p1;
+            p1 = p0;
+            p0 = ((2.0 * j + 1.0) * z * p1 - j * p2) / (j + 1.0);
+          }
+          dp = n * (z * p0 - p1) / (z * z - 1.0);
+          double dz = p0 / dp;
+          z -= dz;
+          if (std::fabs(dz) < 1e-15) break;
+        }
+        const double weight = upper / ((1.0 - z * z) * dp * dp);
+        u_[i] = 0.5 * upper * (1.0 - z);
+        u_[n - 1 - i] = 0.5 * upper * (1.0 + z);
+        w_[i] = weight;
+        w_[n - 1 - i] = weight;
+      }
+    }
+
+    std::vector<double> u_, w_;
+};
+
+// one quote of a calibration chain; puts are priced through put-call parity
+struct HestonQuote {
+  std::size_t expiry;
+  double strike;
+  bool isCall;
+  double price;
+  double weight;
+};
+
+struct HestonExpiry {
+  double t, forward, discount;
+};
+
+// weighted price residuals w (model - market) and their Jacobian for a whole chain.
+// An evaluation is two parallelFors: one over expiries to prepare their slices, then
+// one over the flattened quote list, in contiguous chunks, to price every strike
+// against its expiry's slice, so a single-expiry chain, the usual case, still spreads
+// its ~100 strikes of O(N) each across threads. parallelFor starts its threads per
+// call; each pass is long enough that starting a few threads does not show. Every
+// quote is priced the same way whichever thread takes it, so the residuals do not
+// depend on the thread count.
+class HestonChainObjective {
+  public:
+    HestonChainObjective( const std::vector<HestonExpiry>& expiries
+                        , const std::vector<HestonQuote>& quotes
+                        , std::size_t threads = defaultThreadCount()
+                        , const HestonFourierPricer& pricer = HestonFourierPricer())
+      : expiries_(expiries), quotes_(quotes), threads_(threads), pricer_(pricer)
+      , slices_(expiries.size()) {
+      for (std::size_t i = 0; i < quotes.size(); ++i) {
+        if (quotes[i].expiry >= expiries.size()) {
+          throw std::out_of_range("quote refers to an unknown expiry");
+        }
+      }
+    }
+
+    std::size_t size() const { return quotes_.size(); }
+
+    // residuals has size() entries, jacobian (optional) is size() x 5 row-major
+    void evaluate(const HestonParameters& p, double* residuals, double* jacobian) const {
+      const HestonFourierPricer& pricer = pricer_;
+      const std::vector<HestonExpiry>& expiries = expiries_;
+      std::vector<HestonFourierPricer::Slice>& slices = slices_;
+      const std::vector<HestonQuote>& quotes = quotes_;
+
+      parallelFor(0, expiries.size(), threads_, [&](std::size_t from, std::size_t to, std::size_t) {
+        for (std::size_t e = from; e < to; ++e) pricer.prepare(p, expiries[e].t, slices[e]);
+      });
+
+      parallelFor(0, quotes.size(), threads_, [&](std::size_t from, std::size_t to, std::size_t) {
+        for (std::size_t q = from; q < to; ++q) {
+          const HestonQuote& quote = quotes[q];
+          const HestonExpiry& expiry = expiries[quote.expiry];
+          double* row = jacobian ? jacobian + q * HestonParameters::Size : 0;
+          double model = pricer.callPrice(slices[quote.expiry], expiry.forward, expiry.discount, quote.strike, row);
+          if (!quote.isCall) {
+            model -= expiry.discount * (expiry.forward - quote.strike);
+          }
+          residuals[q] = quote.weight * (model - quote.price);
+          if (row) {
+            for (int j = 0; j < HestonParameters::Size; ++j) row[j] *= quote.weight;
+          }
+        }
+      });
+    }
+
+  private:
+    std::vector<HestonExpiry> expiries_;
+    std::vector<HestonQuote> quotes_;
+    std::size_t threads_;
+    HestonFourierPricer pricer_;
+    mutable std::vector<HestonFourierPricer::Slice> slices_;
+};
+
+}
+
+#endif
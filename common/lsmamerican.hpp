@@ -0,0 +1,264 @@
+#ifndef QLTUTOR_LSMAMERICAN_HPP
+#define QLTUTOR_LSMAMERICAN_HPP
+
+#include <ql/quantlib.hpp>
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include "philox.hpp"
+#include "ziggurat.hpp"
+#include "parallel.hpp"
+
+// American options by least-squares Monte Carlo (Longstaff and Schwartz), for the
+// chains 16ameopt prices with FDAmericanEngine:
+//
+//   qltutor::LsmResult lsm = qltutor::lsmAmerican(bsmProcess, payoff, expiration);
+//   // lsm.value +- lsm.standardError, lsm.pathsPerSecond, lsm.memoryBytes
+//
+// The option is Bermudan on `exerciseDates` equally spaced dates to expiry, on a GBM
+// with the constant rate, dividend yield and volatility the finite-difference engine
+// takes from the process (zero rates to expiry, Black volatility at the strike).
+//
+// Training: the continuation value at each date is the regression of the discounted
+// cash flows of in-the-money paths on 1, x, .., x^basisDegree, x = S / K. The paths
+// are simulated backwards, the Brownian motion at t_j drawn from the bridge between 0
+// and its value at t_{j+1}, so only the current time slice and the cash flows are held:
+// two doubles per path, where the usual algorithm holds the whole path matrix. The
+// normal of path p at date j is Philox block (p) of stream j, so any thread can draw it.
+// Each date's regression is a QR factorization accumulated by Givens rotations over
+// blocks of cached basis rows, one accumulator per block of paths, merged in block
+// order, so the coefficients do not depend on the number of threads; solving R b = Q'y
+// avoids the squared condition number of the normal equations.
+//
+// Pricing: fresh paths forward, each stopped at the first date where exercise pays at
+// least the regressed continuation value. Paths are independent given the cached
+// coefficients, so this pass is parallel in blocks, and the estimate is unbiased for the
+// policy: low by its suboptimality, where the in-sample estimate is biased high.
+
+namespace qltutor {
+
+struct LsmOptions {
+  LsmOptions()
+    : trainingPaths(50000), paths(200000), exerciseDates(50), basisDegree(3), block(1024), seed(42)
+    , threads(defaultThreadCount()) {}
+  QuantLib::Size trainingPaths, paths;
+  QuantLib::Size exerciseDates;
+  QuantLib::Size basisDegree;
+  QuantLib::Size block;
+  std::uint64_t seed;
+  QuantLib::Size threads;
+};
+
+struct LsmResult {
+  QuantLib::Real value, standardError;
+  QuantLib::Size trainingPaths, paths, exerciseDates;
+  double trainingSeconds, pricingSeconds;
+  QuantLib::Real pathsPerSecond;            // pricing pass
+  std::size_t memoryBytes;                  // path state held by the training pass
+  std::size_t pathMatrixBytes;              // what storing every path would take
+  std::vector<QuantLib::Real> boundary;     // exercise boundary found at each date, S / K
+};
+
+namespace detail {
+
+  // least squares by rows: R and Q'y of the rows seen so far, updated by Givens rotations
+  class GivensLeastSquares {
+    public:
+      explicit GivensLeastSquares(std::size_t columns = 0) : k_(columns), r_(columns * columns, 0.0), qty_(columns, 0.0) {}
+
+      void add(const double* row, double y) {
+        std::vector<double>& x = scratch_;
+        x.assign(row, row + k_);
+        for (std::size_t i = 0; i < k_; ++i) {
+          if (x[i] == 0.0) continue;
+          double& rii = r_[i * k_ + i];
+          double h = std::hypot(rii, x[i]), c = rii / h, s = x[i] / h;
+          rii = h;
+          for (std::size_t j = i + 1; j < k_; ++j) {
+            double a = r_[i * k_ + j], b = x[j];
+            r_[i * k_ + j] = c * a + s * b;
+            x[j] = c * b - s * a;
+          }
+          double a = qty_[i];
+          qty_[i] = c * a + s * y;
+          y = c * y - s * a;
+        }
+      }
+      // the rows of another accumulator, through its R
+      void merge(const GivensLeastSquares& other) {
+        for (std::size_t i = 0; i < k_; ++i) add(&other.r_[i * k_], other.qty_[i]);
+      }
+      // b with R b = Q'y; columns with a negligible pivot get 0
+      std::vector<double> solve() const {
+        std::vector<double> b(k_, 0.0);
+        double scale = 0.0;
+        for (std::size_t i = 0; i < k_; ++i) scale = std::max(scale, std::fabs(r_[i * k_ + i]));
+        for (std::size_t i = k_; i-- > 0;) {
+          double rii = r_[i * k_ + i];
+          if (std::fabs(rii) <= 1e-12 * scale) continue;
+          double s = qty_[i];
+          for (std::size_t j = i + 1; j < k_; ++j) s -= r_[i * k_ + j] * b[j];
+          b[i] = s / rii;
+        }
+        return b;
+      }
+
+    private:
+      std::size_t k_;
+      std::vector<double> r_, qty_, scratch_;
+  };
+
+  inline double lsmPayoff(QuantLib::Option::Type type, double strike, double s) {
+    return std::max(type == QuantLib::Option::Call ? s - strike : strike - s, 0.0);
+  }
+
+  inline double lsmContinuation(const std::vector<double>& b, double x) {
+    double c = 0.0;
+    for (std::size_t i = b.size(); i-- > 0;) c = c * x + b[i];
+    return c;
+  }
+
+}
+
+inline LsmResult lsmAmerican(QuantLib::Option::Type type, QuantLib::Real strike, QuantLib::Real spot, QuantLib::Rate r,
+                             QuantLib::Rate q, QuantLib::Volatility sigma, QuantLib::Time maturity,
+                             const LsmOptions& options = LsmOptions()) {
+  using namespace QuantLib;
+  typedef std::chrono::steady_clock Clock;
+  QL_REQUIRE(options.exerciseDates > 0 && options.trainingPaths > 0 && options.paths > 1, "need exercise dates and paths");
+  const Size n = options.exerciseDates, k = options.basisDegree + 1, block = options.block;
+  const Time dt = maturity / n;
+  const Real drift = r - q - .5 * sigma * sigma, discount = std::exp(-r * dt);
+  const InverseCumulativeNormal inverse;
+
+  LsmResult result;
+  result.trainingPaths = options.trainingPaths;
+  result.paths = options.paths;
+  result.exerciseDates = n;
+  result.boundary.assign(n, Null<Real>());
+  result.boundary[n - 1] = 1.0;
+  std::vector<std::vector<double> > coefficients(n, std::vector<double>(k, 0.0));
+
+  // training, backwards: w[p] is the Brownian motion at the current date, cash[p] the
+  // path's cash flow discounted to it
+  Clock::time_point start = Clock::now();
+  const Size training = options.trainingPaths, blocks = (training + block - 1) / block;
+  std::vector<double> w(training), cash(training);
+  std::vector<detail::GivensLeastSquares> regressions(blocks, detail::GivensLeastSquares(k));
+  for (Size j = n; j >= 1; --j) {
+    const Time t = j * dt;
+    parallelFor(0, blocks, options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+      std::vector<double> basis(block * k);
+      for (std::size_t b = from; b < to; ++b) {
+        const Size first = b * block, last = std::min(training, first + block);
+        regressions[b] = detail::GivensLeastSquares(k);
+        Size rows = 0;
+        for (Size p = first; p < last; ++p) {
+          std::uint32_t words[4];
+          Philox4x32::block(options.seed, j, p, words);
+          double z = inverse(Philox4x32::toUniform(words[0], words[1]));
+          if (j == n) {
+            w[p] = std::sqrt(t) * z;
+          } else {
+            // the bridge from 0 at 0 to w[p] at t + dt
+            w[p] = t / (t + dt) * w[p] + std::sqrt(t * dt / (t + dt)) * z;
+            cash[p] *= discount;
+          }
+          double s = spot * std::exp(drift * t + sigma * w[p]);
+          double exercise = detail::lsmPayoff(type, strike, s);
+          if (j == n) {
+            cash[p] = exercise;
+          } else if (exercise > 0.0) {
+            double* row = &basis[rows * k];
+            row[0] = 1.0;
+            for (Size i = 1; i < k; ++i) row[i] = row[i - 1] * (s / strike);
+            regressions[b].add(row, cash[p]);
+            ++rows;
+          }
+        }
+      }
+    });
+    if (j == n) continue;
+    detail::GivensLeastSquares total(k);
+    for (Size b = 0; b < blocks; ++b) total.merge(regressions[b]);
+    coefficients[j - 1] = total.solve();
+
+    // exercise where it pays more than continuing
+    std::vector<Real> lowest(blocks, QL_MAX_REAL), highest(blocks, -QL_MAX_REAL);
+    parallelFor(0, blocks, options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+      for (std::size_t b = from; b < to; ++b) {
+        for (Size p = b * block; p < std::min(training, (b + 1) * block); ++p) {
+          double s = spot * std::exp(drift * t + sigma * w[p]);
+          double exercise = detail::lsmPayoff(type, strike, s);
+          if (exercise > 0.0 && exercise >= detail::lsmContinuation(coefficients[j - 1], s / strike)) {
+            cash[p] = exercise;
+            lowest[b] = std::min(lowest[b], s / strike);
+            highest[b] = std::max(highest[b], s / strike);
+          }
+        }
+      }
+    });
+    Real low = *std::min_element(lowest.begin(), lowest.end()), high = *std::max_element(highest.begin(), highest.end());
+    if (low != QL_MAX_REAL) result.boundary[j - 1] = type == Option::Call ? low : high;
+  }
+  result.trainingSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  result.memoryBytes = (w.capacity() + cash.capacity()) * sizeof(double)
+                       + blocks * (k * k + k) * sizeof(double) + n * k * sizeof(double);
+  result.pathMatrixBytes = training * (n + 1) * sizeof(double);
+
+  // pricing, forwards on independent paths: stream p of the next seed
+  start = Clock::now();
+  const Size pricingBlocks = (options.paths + block - 1) / block;
+  std::vector<Real> sums(pricingBlocks, 0.0), squares(pricingBlocks, 0.0);
+  parallelFor(0, pricingBlocks, options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+    std::vector<double> z(n);
+    for (std::size_t b = from; b < to; ++b) {
+      for (Size p = b * block; p < std::min(options.paths, (b + 1) * block); ++p) {
+        Philox4x32 generator(options.seed + 1, p);
+        ZigguratNormal::fill(generator, &z[0], n);
+        double logS = std::log(spot), value = 0.0;
+        for (Size j = 1; j <= n; ++j) {
+          logS += drift * dt + sigma * std::sqrt(dt) * z[j - 1];
+          double s = std::exp(logS), exercise = detail::lsmPayoff(type, strike, s);
+          if (j == n || (exercise > 0.0 && exercise >= detail::lsmContinuation(coefficients[j - 1], s / strike))) {
+            value = exercise * std::exp(-r * j * dt);
+            break;
+          }
+        }
+        sums[b] += value;
+        squares[b] += value * value;
+      }
+    }
+  });
+  Real sum = 0.0, sumSquares = 0.0;
+  for (Size b = 0; b < pricingBlocks; ++b) {
+    sum += sums[b];
+    sumSquares += squares[b];
+  }
+  Real mean = sum / options.paths;
+  result.value = std::max(mean, detail::lsmPayoff(type, strike, spot));
+  result.standardError = std::sqrt(std::max(0.0, (sumSquares / options.paths - mean * mean) / (options.paths - 1)));
+  result.pricingSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  result.pathsPerSecond = options.paths / result.pricingSeconds;
+  return result;
+}
+
+// the option as FDAmericanEngine sees it: constant rates and volatility to expiry
+inline LsmResult lsmAmerican(const boost::shared_ptr<QuantLib::GeneralizedBlackScholesProcess>& process,
+                             const boost::shared_ptr<QuantLib::StrikedTypePayoff>& payoff, const QuantLib::Date& expiration,
+                             const LsmOptions& options = LsmOptions()) {
+  using namespace QuantLib;
+  Time maturity = process->time(expiration);
+  Rate r = process->riskFreeRate()->zeroRate(maturity, Continuous, NoFrequency, true);
+  Rate q = process->dividendYield()->zeroRate(maturity, Continuous, NoFrequency, true);
+  Volatility sigma = process->blackVolatility()->blackVol(maturity, payoff->strike(), true);
+  return lsmAmerican(payoff->optionType(), payoff->strike(), process->x0(), r, q, sigma, maturity, options);
+}
+
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef QLTUTOR_MCPRICER_HPP
+#define QLTUTOR_MCPRICER_HPP
+
+#include <ql/quantlib.hpp>
+
+#include <vector>
+#include <cmath>
+#include <ctime>
+#include <cstdint>
+
+#include "philoxrsg.hpp"
+#include "parallel.hpp"
+
+// Monte Carlo prices of European and path-dependent payoffs on a
+// GeometricBrownianMotionProcess, with variance reduction:
+//
+//   qltutor::McPricerOptions options;
+//   options.antithetic = true;
+//   options.controlVariate = qltutor::McPricerOptions::GeometricAverageCall;
+//   options.controlStrike = 21.0;
+//   qltutor::McPrice price = qltutor::mcPrice(gbm, 1.0, 255, ArithmeticAsianCall(21.0), options);
+//   // price.value +- price.standardError, price.efficiency(), price.pathsFor(.001)
+//
+// The payoff is a functional of the Path (undiscounted); the price is discounted at the
+// process drift. Paths are stepped exactly, S e^{(mu - sigma^2/2) dt + sigma sqrt(dt) z},
+// from the process's x0, drift and diffusion: its own evolve() is an Euler step in the
+// price, whose terminal law is not lognormal, and the control variate needs its mean
+// exactly. Normals are Philox/ziggurat (philoxrsg.hpp), sequence k for sample k, so
+// batches run on any thread and the result does not depend on the thread count.
+//
+// - antithetic: each sample is the mean over the normals z and -z, two paths.
+// - controlVariate: a discounted call at controlStrike (at the money by default) on
+//   the same path, whose mean is a BlackScholesCalculator price: the European call on
+//   S_T, or the call on the geometric average of the fixings S_1..S_n, lognormal with
+//   log-variance sigma^2 dt (n + 1)(2n + 1) / 6n, for arithmetic averages. The
+//   coefficient is the regression of payoff on control over all samples.
+// - momentMatching: within each batch the normals of every time step are shifted and
+//   scaled to sample mean 0 and variance 1. Samples of a batch are then dependent, so
+//   the standard error is taken from the spread of the batch estimates.
+// - importanceDrift: the Brownian motion gets drift lambda, each normal z + lambda
+//   sqrt(dt), and payoffs are weighted by the likelihood ratio e^{-lambda W_T +
+//   lambda^2 T / 2}; importanceDriftFor() centres W_T on a strike, for out-of-the-money
+//   payoffs.
+//
+// The price reports the process CPU time it took, so methods compare by efficiency,
+// 1 / (variance x CPU time): the one with the higher efficiency reaches a target
+// standard error sooner.
+
+namespace qltutor {
+
+struct McPricerOptions {
+  enum ControlVariate { NoControl, TerminalCall, GeometricAverageCall };
+  McPricerOptions()
+    : paths(100000), batch(1024), seed(42), antithetic(false), controlVariate(NoControl)
+    , controlStrike(QuantLib::Null<QuantLib::Real>()), momentMatching(false), importanceDrift(0.0)
+    , threads(defaultThreadCount()) {}
+  QuantLib::Size paths;          // antithetic partners included
+  QuantLib::Size batch;          // samples per unit of work and of moment matching
+  std::uint64_t seed;
+  bool antithetic;
+  ControlVariate controlVariate;
+  QuantLib::Real controlStrike;
+  bool momentMatching;
+  QuantLib::Real importanceDrift;
+  QuantLib::Size threads;
+};
+
+struct McPrice {
+  QuantLib::Real value, standardError;
+  QuantLib::Size paths;
+  double cpuSeconds;
+  QuantLib::Real controlBeta;
+
+  // 1 / (variance x CPU time)
+  QuantLib::Real efficiency() const { return 1.0 / (standardError * standardError * cpuSeconds); }
+  // paths for a standard error of `target` with this method
+  QuantLib::Size pathsFor(QuantLib::Real target) const {
+    return QuantLib::Size(std::ceil(paths * (standardError / target) * (standardError / target)));
+  }
+};
+
+// the Brownian drift that puts the median of S_T at `strike`
+inline QuantLib::Real importanceDriftFor(const boost::shared_ptr<QuantLib::GeometricBrownianMotionProcess>& process,
+                                         QuantLib::Time maturity, QuantLib::Real strike) {
+  QuantLib::Real r = process->drift(0.0, 1.0), sigma = process->diffusion(0.0, 1.0);
+  return (std::log(strike / process->x0()) - (r - .5 * sigma * sigma) * maturity) / (sigma * maturity);
+}
+
+namespace detail {
+  struct McSums {
+    McSums() : n(0.0), y(0.0), c(0.0), yy(0.0), cc(0.0), yc(0.0) {}
+    void add(QuantLib::Real payoff, QuantLib::Real control) {
+      n += 1.0;
+      y += payoff;
+      c += control;
+      yy += payoff * payoff;
+      cc += control * control;
+      yc += payoff * control;
+    }
+    void merge(const McSums& other) {
+      n += other.n;
+      y += other.y;
+      c += other.c;
+      yy += other.yy;
+      cc += other.cc;
+      yc += other.yc;
+    }
+    QuantLib::Real n, y, c, yy, cc, yc;
+  };
+}
+
+template <class Payoff>
+McPrice mcPrice(const boost::shared_ptr<QuantLib::GeometricBrownianMotionProcess>& process, QuantLib::Time maturity,
+                QuantLib::Size timeSteps, Payoff payoff, const McPricerOptions& options = McPricerOptions()) {
+  using namespace QuantLib;
+  QL_REQUIRE(timeSteps > 0 && options.batch > 0, "need time steps and a batch size");
+  std::clock_t startClock = std::clock();
+
+  const Real s0 = process->x0(), r = process->drift(0.0, 1.0), sigma = process->diffusion(0.0, 1.0);
+  const Time dt = maturity / timeSteps;
+  const Real drift = (r - .5 * sigma * sigma) * dt, volatility = sigma * std::sqrt(dt);
+  const Real lambda = options.importanceDrift, shift = lambda * std::sqrt(dt);
+  const DiscountFactor discount = std::exp(-r * maturity);
+  const Real controlStrike = options.controlStrike == Null<Real>() ? s0 : options.controlStrike;
+  const bool geometric = options.controlVariate == McPricerOptions::GeometricAverageCall;
+  // log S_T, or log of the geometric average, is normal with this mean and variance
+  const Real n = Real(timeSteps);
+  const Real logMean = std::log(s0) + (r - .5 * sigma * sigma) * (geometric ? dt * (n + 1) / 2 : maturity);
+  const Real logVariance = sigma * sigma * (geometric ? dt * (n + 1) * (2 * n + 1) / (6 * n) : maturity);
+  const Real controlMean = BlackScholesCalculator(Option::Call, controlStrike, s0, std::exp(logMean + .5 * logVariance) / s0,
+                                                  std::sqrt(logVariance), discount).value();
+
+  const Size draws = options.antithetic ? 2 : 1;
+  const Size batches = std::max<Size>(2, (options.paths / draws + options.batch - 1) / options.batch);
+  const Size batch = options.batch;
+  std::vector<detail::McSums> sums(batches);
+
+  parallelFor(0, batches, options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+    PhiloxGaussianRsg normals(timeSteps, options.seed);
+    std::vector<double> z(batch * timeSteps);
+    TimeGrid grid(maturity, timeSteps);
+    Path path(grid);
+    Payoff f(payoff);
+    for (std::size_t b = from; b < to; ++b) {
+      normals.skipTo(b * batch);
+      for (Size k = 0; k < batch; ++k) {
+        const std::vector<Real>& sequence = normals.nextSequence().value;
+        std::copy(sequence.begin(), sequence.end(), z.begin() + k * timeSteps);
+      }
+      if (options.momentMatching) {
+        for (Size i = 0; i < timeSteps; ++i) {
+          Real mean = 0.0, squares = 0.0;
+          if (!options.antithetic) {
+            for (Size k = 0; k < batch; ++k) mean += z[k * timeSteps + i] / batch;
+          }
+          for (Size k = 0; k < batch; ++k) squares += (z[k * timeSteps + i] - mean) * (z[k * timeSteps + i] - mean);
+          Real scale = 1.0 / std::sqrt(squares / batch);
+          for (Size k = 0; k < batch; ++k) z[k * timeSteps + i] = (z[k * timeSteps + i] - mean) * scale;
+        }
+      }
+      for (Size k = 0; k < batch; ++k) {
+        Real y = 0.0, c = 0.0;
+        for (Size d = 0; d < draws; ++d) {
+          Real sign = d == 0 ? 1.0 : -1.0, logPrice = std::log(s0), logSum = 0.0, brownian = 0.0;
+          path[0] = s0;
+          for (Size i = 0; i < timeSteps; ++i) {
+            Real w = sign * z[k * timeSteps + i] + shift;
+            brownian += w;
+            logPrice += drift + volatility * w;
+            logSum += logPrice;
+            path[i + 1] = std::exp(logPrice);
+          }
+          Real underlying = geometric ? std::exp(logSum / timeSteps) : path.back();
+          Real weight = lambda == 0.0 ? 1.0 : std::exp(-lambda * brownian * std::sqrt(dt) + .5 * lambda * lambda * maturity);
+          y += discount * weight * f(path) / draws;
+          c += discount * weight * std::max(underlying - controlStrike, 0.0) / draws;
+        }
+        sums[b].add(y, c);
+      }
+    }
+  });
+
+  detail::McSums total;
+  for (Size b = 0; b < batches; ++b) total.merge(sums[b]);
+  Real samples = total.n;
+  Real varianceY = (total.yy - total.y * total.y / samples) / (samples - 1);
+  Real varianceC = (total.cc - total.c * total.c / samples) / (samples - 1);
+  Real covariance = (total.yc - total.y * total.c / samples) / (samples - 1);
+  Real beta = options.controlVariate != McPricerOptions::NoControl && varianceC > 0.0 ? covariance / varianceC : 0.0;
+
+  McPrice price;
+  price.value = (total.y - beta * (total.c - samples * controlMean)) / samples;
+  price.controlBeta = beta;
+  price.paths = Size(samples) * draws;
+  if (options.momentMatching) {
+    Real squares = 0.0;
+    for (Size b = 0; b < batches; ++b) {
+      Real estimate = (sums[b].y - beta * (sums[b].c - sums[b].n * controlMean)) / sums[b].n;
+      squares += (estimate - price.value) * (estimate - price.value);
+    }
+    price.standardError = std::sqrt(squares / (batches - 1) / batches);
+  } else {
+    price.standardError = std::sqrt(std::max(0.0, varianceY - 2.0 * beta * covariance + beta * beta * varianceC) / samples);
+  }
+  price.cpuSeconds = double(std::clock() - startClock) / CLOCKS_PER_SEC;
+  return price;
+}
+
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef QLTUTOR_MCRUN_HPP
+#define QLTUTOR_MCRUN_HPP
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "parallel.hpp"
+#include "snapshot.hpp"
+#include "streamingstats.hpp"
+
+// A Monte Carlo run that stops at a target error instead of a fixed path count, and
+// survives being killed:
+//
+//   qltutor::McRunOptions options;
+//   options.targetStandardError = .001;
+//   options.checkpointPath = "/var/tmp/overnight.ckpt";
+//   qltutor::McRunResult run = qltutor::runMonteCarlo(DiscountedMaximum(process, seed), options, seed);
+//   // run.mean +- run.standardError, run.stop, run.resumedSamples
+//
+// The sampler gives the value of sample k, `Real operator()(std::uint64_t k)`, drawn
+// from random numbers it addresses by k (sequence k of a PhiloxGaussianRsg, say), and
+// is copied once per thread. So the run's only random state is the index of the next
+// sample: that and the running MomentAccumulator are all a checkpoint holds.
+//
+// Samples go in batches of `batch`, each summed on any thread into its own accumulator;
+// after every round of `roundBatches` batches the batch accumulators are merged in order
+// into the total and the stopping rule is checked: at least `minSamples`, and the
+// standard error at most `targetStandardError` or `targetRelativeError` x |mean|. Rounds
+// are fixed in samples, so where a run stops and every bit of its result depend on
+// neither the thread count nor where it was interrupted.
+//
+// At the end of a round, once `checkpointSeconds` have passed since the last one, the
+// state is written as a snapshot (snapshot.hpp: checksummed, replaced by rename, so a
+// crash mid-write leaves the previous checkpoint), and once more when the run stops. A
+// run given an existing checkpoint continues from it, after checking it was written
+// for the same fingerprint (the seed, say), batch and round sizes; a finished run
+// restarted just reports its result. The progress callback sees the state after each
+// round.
+
+namespace qltutor {
+
+struct McRunResult {
+  enum Stop { Running, StandardErrorReached, RelativeErrorReached, SampleLimit };
+  double mean, standardError;
+  std::uint64_t samples;
+  std::uint64_t resumedSamples;    // restored from a checkpoint
+  std::size_t checkpoints;         // written by this run
+  double seconds;                  // by this run
+  Stop stop;
+  MomentAccumulator statistics;
+};
+
+struct McRunOptions {
+  enum { noTarget = 0 };
+  McRunOptions()
+    : targetStandardError(noTarget), targetRelativeError(noTarget), minSamples(10000), maxSamples(100000000)
+    , batch(1024), roundBatches(64), threads(defaultThreadCount()), checkpointSeconds(60.0) {}
+  double targetStandardError, targetRelativeError;
+  std::uint64_t minSamples, maxSamples;
+  std::size_t batch, roundBatches;
+  std::size_t threads;
+  std::string checkpointPath;      // empty: no checkpoints
+  double checkpointSeconds;
+  std::function<void(const McRunResult&)> progress;
+};
+
+namespace detail {
+
+  // run state sections: fingerprint halves, batch, round, next sample, stop; accumulator
+  inline void writeRunCheckpoint(const std::string& path, std::uint64_t fingerprint, const McRunOptions& options,
+                                 const McRunResult& run) {
+    std::vector<double> position(6), state(MomentAccumulator::stateSize);
+    position[0] = double(fingerprint >> 32);
+    position[1] = double(fingerprint & 0xffffffffULL);
+    position[2] = double(options.batch);
+    position[3] = double(options.roundBatches);
+    position[4] = double(run.samples);
+    position[5] = double(run.stop);
+    run.statistics.saveState(&state[0]);
+    SnapshotWriter writer;
+    writer.add("run.position", SnapshotRunState, position);
+    writer.add("run.statistics", SnapshotRunState, state);
+    writer.write(path);
+  }
+
+  inline bool readRunCheckpoint(const std::string& path, std::uint64_t fingerprint, const McRunOptions& options,
+                                McRunResult& run) {
+    if (access(path.c_str(), F_OK) != 0) return false;
+    SnapshotView view(path);
+    SnapshotView::Array position = view.array("run.position"), state = view.array("run.statistics");
+    if (position.size() != 6 || state.size() != std::size_t(MomentAccumulator::stateSize)) {
+      throw std::runtime_error("checkpoint " + path + " is not a Monte Carlo run");
+    }
+    if (position[0] != double(fingerprint >> 32) || position[1] != double(fingerprint & 0xffffffffULL)
+        || position[2] != double(options.batch) || position[3] != double(options.roundBatches)) {
+      throw std::runtime_error("checkpoint " + path + " belongs to a different run");
+    }
+    run.samples = run.resumedSamples = std::uint64_t(position[4]);
+    run.stop = McRunResult::Stop(int(position[5]));
+    run.statistics.restoreState(state.data);
+    return true;
+  }
+
+  inline void updateRun(McRunResult& run, const McRunOptions& options) {
+    run.mean = run.samples > 0 ? run.statistics.mean() : 0.0;
+    run.standardError = run.samples > 1 ? run.statistics.errorEstimate() : 0.0;
+    if (run.stop != McRunResult::Running || run.samples < std::max<std::uint64_t>(2, options.minSamples)) return;
+    if (options.targetStandardError > 0.0 && run.standardError <= options.targetStandardError) {
+      run.stop = McRunResult::StandardErrorReached;
+    } else if (options.targetRelativeError > 0.0 && run.standardError <= options.targetRelativeError * std::fabs(run.mean)) {
+      run.stop = McRunResult::RelativeErrorReached;
+    } else if (run.samples >= options.maxSamples) {
+      run.stop = McRunResult::SampleLimit;
+    }
+  }
+
+}
+
+template <class Sampler>
+McRunResult runMonteCarlo(Sampler sampler, const McRunOptions& options = McRunOptions(), std::uint64_t fingerprint = 0) {
+  typedef std::chrono::steady_clock Clock;
+  if (options.batch == 0 || options.roundBatches == 0) throw std::invalid_argument("need a batch and a round size");
+  Clock::time_point start = Clock::now(), lastCheckpoint = start;
+
+  McRunResult run;
+  run.samples = run.resumedSamples = 0;
+  run.checkpoints = 0;
+  run.stop = McRunResult::Running;
+  const bool checkpointing = !options.checkpointPath.empty();
+  if (checkpointing) detail::readRunCheckpoint(options.checkpointPath, fingerprint, options, run);
+  detail::updateRun(run, options);
+
+  std::vector<MomentAccumulator> batches(options.roundBatches);
+  while (run.stop == McRunResult::Running) {
+    // one round: its batches on any thread, merged in order
+    const std::uint64_t first = run.samples;
+    const std::uint64_t count = std::min<std::uint64_t>(options.batch * options.roundBatches,
+                                                        std::max(options.maxSamples, options.minSamples) - first);
+    const std::size_t used = std::size_t((count + options.batch - 1) / options.batch);
+    parallelFor(0, used, options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+      Sampler f(sampler);
+      for (std::size_t b = from; b < to; ++b) {
+        batches[b].reset();
+        std::uint64_t begin = first + b * options.batch, end = std::min<std::uint64_t>(begin + options.batch, first + count);
+        for (std::uint64_t k = begin; k < end; ++k) batches[b].add(f(k));
+      }
+    });
+    for (std::size_t b = 0; b < used; ++b) run.statistics.merge(batches[b]);
+    run.samples += count;
+    detail::updateRun(run, options);
+
+    Clock::time_point now = Clock::now();
+    if (checkpointing && (run.stop != McRunResult::Running
+                          || std::chrono::duration<double>(now - lastCheckpoint).count() >= options.checkpointSeconds)) {
+      detail::writeRunCheckpoint(options.checkpointPath, fingerprint, options, run);
+      ++run.checkpoints;
+      lastCheckpoint = now;
+    }
+    run.seconds = std::chrono::duration<double>(now - start).count();
+    if (options.progress) options.progress(run);
+  }
+  run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return run;
+}
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef QLTUTOR_MLMC_HPP
+#define QLTUTOR_MLMC_HPP
+
+#include <ql/quantlib.hpp>
+
+#include <vector>
+#include <cmath>
+#include <ctime>
+#include <cstdint>
+#include <algorithm>
+
+#include "philoxrsg.hpp"
+#include "parallel.hpp"
+
+// Multilevel Monte Carlo (Giles) for functionals of the paths of a one-dimensional
+// process, stepped by its own evolve():
+//
+//   qltutor::MlmcResult asian = qltutor::mlmcEstimate(gbm, 1.0, DiscountedAsianCall(), .01);
+//   // asian.value, with root mean square error about .01 against the continuous limit
+//
+// Level l has M^l time steps. Its estimator is the mean of P_l - P_{l-1}: the
+// functional on a path with M^l steps less the functional on a path with M^{l-1}
+// steps driven by the same Brownian motion, each coarse increment the sum of M fine
+// ones. The two are close, so the variance of the difference falls with l and the
+// fine levels need few samples; the sum over levels telescopes to E[P_L].
+//
+// The driver starts with levels 0..2 and `initialSamples` each, then repeats:
+// samples per level N_l = 2 / eps^2 sqrt(V_l / C_l) sum_k sqrt(V_k C_k), which
+// minimizes the cost for a variance eps^2 / 2; then if the bias estimate from the
+// last two levels, |E[P_L - P_{L-1}]| / (M^alpha - 1), is above eps / sqrt(2), a level
+// is added. alpha, the weak order, is fitted to the level means (at least 1/2).
+//
+// The cost of a sample is counted in evolve() steps, M^l + M^{l-1}, so the allocation
+// does not depend on timing and a run is reproducible; CPU time is reported beside
+// it. Each round's new samples are cut into batches over all levels at once and run on
+// any thread; sample k of level l is Philox sequence k of the level's stream, and
+// batch sums are merged in order, so the thread count does not change the result.
+
+namespace qltutor {
+
+struct MlmcOptions {
+  MlmcOptions()
+    : refinement(2), maxLevel(12), initialSamples(2000), batch(256), seed(42), threads(defaultThreadCount()) {}
+  QuantLib::Size refinement;       // M, steps of level l + 1 per step of level l
+  QuantLib::Size maxLevel;
+  QuantLib::Size initialSamples;
+  QuantLib::Size batch;
+  std::uint64_t seed;
+  QuantLib::Size threads;
+};
+
+struct MlmcLevel {
+  QuantLib::Size steps, samples;
+  QuantLib::Real mean, variance;          // of P_l - P_{l-1}
+  QuantLib::Real fineMean, fineVariance;  // of P_l alone
+  QuantLib::Real cost;                    // evolve() steps per sample
+};
+
+struct MlmcResult {
+  QuantLib::Real value, standardError, biasEstimate;
+  std::vector<MlmcLevel> levels;
+  QuantLib::Real cost;                    // evolve() steps in all
+  double cpuSeconds;
+  bool converged;                         // the bias estimate met the target before maxLevel
+  // what plain Monte Carlo on the finest level costs for the same variance, in steps
+  QuantLib::Real singleLevelCost(QuantLib::Real eps) const {
+    const MlmcLevel& finest = levels.back();
+    return std::ceil(2.0 * finest.fineVariance / (eps * eps)) * finest.steps;
+  }
+};
+
+namespace detail {
+
+  struct MlmcSums {
+    MlmcSums() : n(0.0), y(0.0), yy(0.0), p(0.0), pp(0.0) {}
+    void merge(const MlmcSums& other) {
+      n += other.n;
+      y += other.y;
+      yy += other.yy;
+      p += other.p;
+      pp += other.pp;
+    }
+    QuantLib::Real n, y, yy, p, pp;
+  };
+
+  // samples [first, first + count) of level `level`; coarse = false gives P_l alone
+  template <class Functional>
+  MlmcSums mlmcSamples(const boost::shared_ptr<QuantLib::StochasticProcess1D>& process, QuantLib::Time length,
+                       Functional& f, QuantLib::Size level, std::uint64_t first, QuantLib::Size count,
+                       const MlmcOptions& options, bool coarse = true) {
+    using namespace QuantLib;
+    const Size m = options.refinement;
+    Size fineSteps = 1;
+    for (Size l = 0; l < level; ++l) fineSteps *= m;
+    coarse = coarse && level > 0;
+    const Size coarseSteps = coarse ? fineSteps / m : 1;
+    const Time fineDt = length / fineSteps, coarseDt = length / coarseSteps;
+
+    PhiloxGaussianRsg normals(fineSteps, options.seed * 0x9e3779b97f4a7c15ULL + level);
+    normals.skipTo(first);
+    TimeGrid fineGrid(length, fineSteps), coarseGrid(length, coarseSteps);
+    Path fine(fineGrid), rough(coarseGrid);
+    MlmcSums sums;
+    for (Size k = 0; k < count; ++k) {
+      const std::vector<Real>& z = normals.nextSequence().value;
+      fine[0] = rough[0] = process->x0();
+      for (Size i = 0; i < fineSteps; ++i) fine[i + 1] = process->evolve(i * fineDt, fine[i], fineDt, z[i]);
+      Real pFine = f(fine), y = pFine;
+      if (coarse) {
+        const Real scale = 1.0 / std::sqrt(Real(m));
+        for (Size i = 0; i < coarseSteps; ++i) {
+          Real dw = 0.0;
+          for (Size j = 0; j < m; ++j) dw += z[i * m + j];
+          rough[i + 1] = process->evolve(i * coarseDt, rough[i], coarseDt, dw * scale);
+        }
+        y -= f(rough);
+      }
+      sums.n += 1.0;
+      sums.y += y;
+      sums.yy += y * y;
+      sums.p += pFine;
+      sums.pp += pFine * pFine;
+    }
+    return sums;
+  }
+
+}
+
+// plain Monte Carlo with M^level steps and `samples` paths, for comparison; the
+// level's own stream, so it shares the fine paths of mlmcEstimate's level
+template <class Functional>
+MlmcLevel singleLevelEstimate(const boost::shared_ptr<QuantLib::StochasticProcess1D>& process, QuantLib::Time length,
+                              Functional f, QuantLib::Size level, QuantLib::Size samples,
+                              const MlmcOptions& options = MlmcOptions()) {
+  using namespace QuantLib;
+  const Size batches = (samples + options.batch - 1) / options.batch;
+  std::vector<detail::MlmcSums> sums(batches);
+  parallelFor(0, batches, options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+    Functional functional(f);
+    for (std::size_t b = from; b < to; ++b)
+      sums[b] = detail::mlmcSamples(process, length, functional, level, b * options.batch,
+                                    std::min(options.batch, samples - b * options.batch), options, false);
+  });
+  detail::MlmcSums total;
+  for (Size b = 0; b < batches; ++b) total.merge(sums[b]);
+  MlmcLevel result;
+  result.steps = Size(std::pow(Real(options.refinement), Real(level)) + .5);
+  result.samples = samples;
+  result.mean = result.fineMean = total.p / total.n;
+  result.variance = result.fineVariance = std::max(0.0, (total.pp - total.p * total.p / total.n) / (total.n - 1));
+  result.cost = Real(result.steps);
+  return result;
+}
+
+template <class Functional>
+MlmcResult mlmcEstimate(const boost::shared_ptr<QuantLib::StochasticProcess1D>& process, QuantLib::Time length,
+                        Functional f, QuantLib::Real eps, const MlmcOptions& options = MlmcOptions()) {
+  using namespace QuantLib;
+  QL_REQUIRE(eps > 0.0 && options.refinement >= 2 && options.initialSamples > 1, "invalid MLMC parameters");
+  std::clock_t startClock = std::clock();
+  const Real m = Real(options.refinement);
+
+  std::vector<detail::MlmcSums> levels;
+  std::vector<Size> wanted;
+  std::vector<Real> costs;
+  for (Size l = 0; l <= 2; ++l) {
+    levels.push_back(detail::MlmcSums());
+    wanted.push_back(options.initialSamples);
+    costs.push_back(std::pow(m, Real(l)) + (l > 0 ? std::pow(m, Real(l) - 1.0) : 0.0));
+  }
+
+  MlmcResult result;
+  result.converged = false;
+  for (;;) {
+    // one round: every level's missing samples, in batches over all levels
+    struct Task { Size level; std::uint64_t first; Size count; };
+    std::vector<Task> tasks;
+    for (Size l = 0; l < levels.size(); ++l) {
+      for (std::uint64_t first = std::uint64_t(levels[l].n); first < wanted[l]; first += options.batch) {
+        Task task = { l, first, Size(std::min<std::uint64_t>(options.batch, wanted[l] - first)) };
+        tasks.push_back(task);
+      }
+    }
+    std::vector<detail::MlmcSums> sums(tasks.size());
+    parallelFor(0, tasks.size(), options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+      Functional functional(f);
+      for (std::size_t t = from; t < to; ++t)
+        sums[t] = detail::mlmcSamples(process, length, functional, tasks[t].level, tasks[t].first, tasks[t].count, options);
+    });
+    for (Size t = 0; t < tasks.size(); ++t) levels[tasks[t].level].merge(sums[t]);
+
+    // level statistics, and the weak order from the means of levels 1..L
+    const Size top = levels.size() - 1;
+    std::vector<Real> means(levels.size()), variances(levels.size());
+    for (Size l = 0; l <= top; ++l) {
+      means[l] = levels[l].y / levels[l].n;
+      variances[l] = std::max(0.0, (levels[l].yy - levels[l].y * levels[l].y / levels[l].n) / (levels[l].n - 1));
+    }
+    Real sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0, count = 0.0;
+    for (Size l = 1; l <= top; ++l) {
+      Real y = std::log(std::max(std::fabs(means[l]), 1e-300)) / std::log(m);
+      sx += l;
+      sy += y;
+      sxx += Real(l) * l;
+      sxy += l * y;
+      count += 1.0;
+    }
+    Real alpha = std::max(.5, -(count * sxy - sx * sy) / (count * sxx - sx * sx));
+
+    // samples for a variance eps^2 / 2 at least cost
+    Real sumRoot = 0.0;
+    for (Size l = 0; l <= top; ++l) sumRoot += std::sqrt(variances[l] * costs[l]);
+    bool more = false;
+    for (Size l = 0; l <= top; ++l) {
+      Size optimal = Size(std::ceil(2.0 / (eps * eps) * std::sqrt(variances[l] / costs[l]) * sumRoot));
+      if (optimal > wanted[l]) {
+        wanted[l] = optimal;
+        more = true;
+      }
+    }
+    if (more) continue;
+
+    Real bias = std::max(std::fabs(means[top]), std::fabs(means[top - 1]) / std::pow(m, alpha)) / (std::pow(m, alpha) - 1.0);
+    result.biasEstimate = bias;
+    if (bias <= eps / std::sqrt(2.0)) {
+      result.converged = true;
+      break;
+    }
+    if (top == options.maxLevel) break;
+    // a new level, with the initial samples to start its variance
+    levels.push_back(detail::MlmcSums());
+    wanted.push_back(options.initialSamples);
+    costs.push_back(std::pow(m, Real(top + 1)) + std::pow(m, Real(top)));
+  }
+
+  result.value = 0.0;
+  result.cost = 0.0;
+  Real variance = 0.0;
+  for (Size l = 0; l < levels.size(); ++l) {
+    MlmcLevel level;
+    level.steps = Size(std::pow(m, Real(l)) + .5);
+    level.samples = Size(levels[l].n);
+    level.mean = levels[l].y / levels[l].n;
+    level.variance = std::max(0.0, (levels[l].yy - levels[l].y * levels[l].y / levels[l].n) / (levels[l].n - 1));
+    level.fineMean = levels[l].p / levels[l].n;
+    level.fineVariance = std::max(0.0, (levels[l].pp - levels[l].p * levels[l].p / levels[l].n) / (levels[l].n - 1));
+    level.cost = costs[l];
+    result.levels.push_back(level);
+    result.value += level.mean;
+    result.cost += level.samples * level.cost;
+    variance += level.variance / level.samples;
+  }
+  result.standardError = std::sqrt(variance);
+  result.cpuSeconds = double(std::clock() - startClock) / CLOCKS_PER_SEC;
+  return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef QLTUTOR_MONTECARLOVAR_HPP
+#define QLTUTOR_MONTECARLOVAR_HPP
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+#include "multiassetgbm.hpp"
+#include "quantilesketch.hpp"
+
+// Value at risk and expected shortfall of a portfolio by Monte Carlo: joint scenarios
+// of the risk factors at the horizon from a MultiAssetGbm (one step of the horizon's
+// length), a revaluation per scenario, and the losses streamed into quantile sketches
+// instead of being stored.
+//
+// The revaluation is called as
+//   revalue(const GbmPathBlock& block, double* pnl)
+// concurrently from several threads, and fills pnl[p] for the block's `width`
+// scenarios from the prices at step 0 (today) and step block.steps (the horizon). It can
+// be linear in the price moves or a full repricing.
+//
+// Scenarios are cut into `batches` runs of consecutive path blocks. A thread takes a
+// whole batch and feeds its own sketch, so nothing is shared while simulating; the batch
+// sketches are then merged in batch order. The estimates therefore do not depend on the
+// number of threads, and the spread of the per-batch estimates gives a 95% confidence
+// interval by batch means. Memory is one sketch per batch, a few thousand doubles each,
+// whatever the number of scenarios.
+
+namespace qltutor {
+
+struct MonteCarloVarOptions {
+  MonteCarloVarOptions() : confidence(.99), batches(32), sketchCapacity(256) {}
+  double confidence;            // VaR level, e.g. .99
+  std::size_t batches;          // for the confidence intervals; at least 2
+  std::size_t sketchCapacity;   // rank accuracy of the loss tail, see QuantileSketch
+};
+
+struct MonteCarloVarResult {
+  double confidence;
+  std::uint64_t scenarios;
+  double valueAtRisk, valueAtRiskLow, valueAtRiskHigh;                       // loss quantile and its 95% interval
+  double expectedShortfall, expectedShortfallLow, expectedShortfallHigh;     // mean loss beyond it
+  double meanPnl;
+  std::size_t sketchBytes;      // memory of the merged loss sketch
+};
+
+namespace detail {
+
+// two-sided 95% Student-t quantile, Cornish-Fisher expansion in 1/dof (a few 1e-4 from 3 dof on)
+inline double studentQuantile975(double dof) {
+  const double z = 1.959963984540054;
+  double z3 = z * z * z, z5 = z3 * z * z;
+  return z + (z3 + z) / (4.0 * dof) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * dof * dof);
+}
+
+}
+
+template <class Revaluation>
+MonteCarloVarResult monteCarloVar(const MultiAssetGbm& scenarios, std::size_t count, const Revaluation& revalue,
+                                  const MonteCarloVarOptions& options = MonteCarloVarOptions()) {
+  if (!(options.confidence > 0.0 && options.confidence < 1.0)) throw std::invalid_argument("VaR confidence must be in (0, 1)");
+  std::size_t blocks = scenarios.blocks(count);
+  std::size_t batches = std::min(options.batches, blocks);
+  if (batches < 2) throw std::invalid_argument("VaR needs at least two batches of scenarios");
+
+  std::vector<QuantileSketch> sketches;
+  for (std::size_t b = 0; b < batches; ++b) sketches.push_back(QuantileSketch(options.sketchCapacity, true, b + 1));
+  std::vector<double> pnlSums(batches, 0.0);
+  std::atomic<std::size_t> next(0);
+
+  auto work = [&]() {
+    std::vector<double> workspace(scenarios.workspaceSize());
+    std::vector<double> pnl;
+    for (std::size_t b = next++; b < batches; b = next++) {
+      for (std::size_t block = b * blocks / batches; block < (b + 1) * blocks / batches; ++block) {
+        GbmPathBlock paths = scenarios.simulateBlock(block, count, &workspace[0]);
+        pnl.resize(paths.width);
+        revalue(paths, &pnl[0]);
+        for (std::size_t p = 0; p < paths.width; ++p) {
+          pnlSums[b] += pnl[p];
+          sketches[b].add(-pnl[p]);
+        }
+      }
+    }
+  };
+  unsigned threads = unsigned(std::min<std::size_t>(scenarios.threads(), batches));
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < threads; ++t) workers.push_back(std::thread(work));
+  work();
+  for (std::size_t t = 0; t < workers.size(); ++t) workers[t].join();
+
+  double q = options.confidence;
+  std::vector<double> vars(batches), shortfalls(batches);
+  QuantileSketch losses(options.sketchCapacity, true);
+  double pnlSum = 0.0;
+  for (std::size_t b = 0; b < batches; ++b) {
+    vars[b] = sketches[b].quantile(q);
+    shortfalls[b] = sketches[b].tailMean(q);
+    losses.merge(sketches[b]);
+    pnlSum += pnlSums[b];
+  }
+
+  // batch means: the batch estimates are close to independent and normal
+  double t = detail::studentQuantile975(double(batches - 1));
+  auto halfWidth = [&](const std::vector<double>& x) {
+    double mean = 0.0, variance = 0.0;
+    for (std::size_t b = 0; b < batches; ++b) mean += x[b] / batches;
+    for (std::size_t b = 0; b < batches; ++b) variance += (x[b] - mean) * (x[b] - mean) / (batches - 1);
+    return t * std::sqrt(variance / batches);
+  };
+  double varHalfWidth = halfWidth(vars), esHalfWidth = halfWidth(shortfalls);
+
+  MonteCarloVarResult result;
+  result.confidence = q;
+  result.scenarios = losses.count();
+  result.valueAtRisk = losses.quantile(q);
+  result.valueAtRiskLow = result.valueAtRisk - varHalfWidth;
+  result.valueAtRiskHigh = result.valueAtRisk + varHalfWidth;
+  result.expectedShortfall = losses.tailMean(q);
+  result.expectedShortfallLow = result.expectedShortfall - esHalfWidth;
+  result.expectedShortfallHigh = result.expectedShortfall + esHalfWidth;
+  result.meanPnl = pnlSum / double(count);
+  result.sketchBytes = losses.retained() * sizeof(double);
+  return result;
+}
+
+}
+
+#endif
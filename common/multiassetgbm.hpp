@@ -0,0 +1,245 @@
+#ifndef QLTUTOR_MULTIASSETGBM_HPP
+#define QLTUTOR_MULTIASSETGBM_HPP
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "cholesky.hpp"
+#include "covariancemodel.hpp"
+
+// Correlated geometric Brownian motion for n assets:
+//   S_i(t + dt) = S_i(t) exp((mu_i - S_ii / 2) dt + sqrt(dt) (A z)_i),   A A' = S,
+// with S the annualized covariance and mu the expected returns the optimizers use.
+//
+// The square root A is taken once: the Cholesky factor of a dense covariance (n normals
+// a step), or G and sqrt(D) of a FactorCovariance (k + n normals a step, O(nk) a
+// step instead of O(n^2)).
+//
+// Paths are simulated in blocks of pathBlock paths, laid out time-major, structure of
+// arrays: prices[(t * n + i) * width + p] for step t, asset i, path p. Each step is one
+// blocked product of A with the normals of the whole block: assetBlock x assetBlock
+// tiles of A are applied to every path while they are in cache, four rows by four
+// paths at a time in registers, and all inner loops run over contiguous paths.
+//
+// Every block draws from its own generator, seeded from (seed, block index), so a run
+// is reproducible whatever the number of threads. Threads take blocks from a shared
+// counter and hand them to a visitor, called as
+//   visitor(const GbmPathBlock& block, unsigned thread)
+// concurrently from different threads; `thread` indexes per-thread accumulators.
+
+namespace qltutor {
+
+struct MultiAssetGbmOptions {
+  MultiAssetGbmOptions() : pathBlock(64), assetBlock(64), threads(0), seed(42) {}
+  std::size_t pathBlock;    // paths simulated together
+  std::size_t assetBlock;   // tile size of the per-step product
+  unsigned threads;         // 0 for std::thread::hardware_concurrency()
+  unsigned long seed;
+};
+
+// one block of simulated paths; prices of step 0 are the spots
+struct GbmPathBlock {
+  const double* prices;
+  std::size_t steps, assets, width;   // time steps, assets, paths in the block
+  std::size_t block, firstPath;
+  double operator()(std::size_t t, std::size_t i, std::size_t p) const { return prices[(t * assets + i) * width + p]; }
+  // the `width` prices of asset i at step t
+  const double* slice(std::size_t t, std::size_t i) const { return prices + (t * assets + i) * width; }
+};
+
+class MultiAssetGbm {
+  public:
+    // dense covariance, lower triangle read, row-major with `ld` doubles between rows
+    MultiAssetGbm(std::size_t n, const double* spots, const double* drifts, const double* covariance, std::size_t ld,
+                  double length, std::size_t steps, const MultiAssetGbmOptions& options = MultiAssetGbmOptions())
+      : n_(n), k_(0), steps_(steps), dt_(length / steps), options_(options) {
+      CholeskyFactorization root(n, covariance, ld);
+      lower_.assign(root.lower(), root.lower() + n * n);
+      std::vector<double> variances(n);
+      for (std::size_t i = 0; i < n; ++i) variances[i] = covariance[i * ld + i];
+      initialize(spots, drifts, &variances[0]);
+    }
+
+    MultiAssetGbm(const FactorCovariance& covariance, const double* spots, const double* drifts,
+                  double length, std::size_t steps, const MultiAssetGbmOptions& options = MultiAssetGbmOptions())
+      : n_(covariance.size()), k_(covariance.factors()), steps_(steps), dt_(length / steps), options_(options)
+      , loadings_(covariance.rootLoadings(), covariance.rootLoadings() + n_ * k_), specificRoot_(n_) {
+      std::vector<double> variances(n_);
+      for (std::size_t i = 0; i < n_; ++i) {
+        variances[i] = covariance.covariance(i, i);
+        specificRoot_[i] = std::sqrt(covariance.specificVariance(i));
+      }
+      initialize(spots, drifts, &variances[0]);
+    }
+
+    std::size_t size() const { return n_; }
+    std::size_t steps() const { return steps_; }
+    double dt() const { return dt_; }
+    // normals drawn per path and step
+    std::size_t dimension() const { return k_ ? k_ + n_ : n_; }
+    std::size_t blocks(std::size_t paths) const { return (paths + options_.pathBlock - 1) / options_.pathBlock; }
+    // doubles of buffer one thread needs
+    std::size_t workspaceSize() const { return ((steps_ + 1) * n_ + dimension() + n_) * options_.pathBlock; }
+    unsigned threads() const {
+      return options_.threads ? options_.threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // simulates block `block` of a run of `paths` paths into `workspace` (workspaceSize() doubles)
+    GbmPathBlock simulateBlock(std::size_t block, std::size_t paths, double* workspace) const {
+      std::size_t first = block * options_.pathBlock;
+      if (first >= paths) throw std::out_of_range("path block beyond the end of the run");
+      std::size_t width = std::min(options_.pathBlock, paths - first), d = dimension();
+      double* prices = workspace;
+      double* normals = prices + (steps_ + 1) * n_ * width;
+      double* shocks = normals + d * width;
+
+      std::seed_seq seeds = { static_cast<unsigned long>(options_.seed), static_cast<unsigned long>(block & 0xffffffffUL),
+                              static_cast<unsigned long>(static_cast<unsigned long long>(block) >> 32) };
+      std::mt19937_64 rng(seeds);
+      std::normal_distribution<double> gaussian;
+
+      for (std::size_t i = 0; i < n_; ++i) std::fill(prices + i * width, prices + (i + 1) * width, spots_[i]);
+      for (std::size_t t = 1; t <= steps_; ++t) {
+        for (std::size_t j = 0; j < d * width; ++j) normals[j] = gaussian(rng);
+        correlate(normals, shocks, width);
+        const double* previous = prices + (t - 1) * n_ * width;
+        double* current = prices + t * n_ * width;
+        for (std::size_t i = 0; i < n_; ++i) {
+          const double* x = shocks + i * width;
+          const double* s = previous + i * width;
+          double* y = current + i * width;
+          double driftStep = drift_[i];
+          for (std::size_t p = 0; p < width; ++p) y[p] = s[p] * std::exp(driftStep + x[p]);
+        }
+      }
+      GbmPathBlock result = { prices, steps_, n_, width, block, first };
+      return result;
+    }
+
+    // all blocks of a run, on options.threads threads
+    template <class Visitor>
+    void simulate(std::size_t paths, Visitor& visitor) const {
+      std::size_t count = blocks(paths);
+      unsigned threads = unsigned(std::min<std::size_t>(this->threads(), count));
+      std::atomic<std::size_t> next(0);
+      std::vector<std::thread> workers;
+      for (unsigned p = 1; p < threads; ++p) {
+        workers.push_back(std::thread(&MultiAssetGbm::run<Visitor>, this, paths, count, std::ref(next), std::ref(visitor), p));
+      }
+      run(paths, count, next, visitor, 0);
+      for (std::size_t p = 0; p < workers.size(); ++p) workers[p].join();
+    }
+
+  private:
+    void initialize(const double* spots, const double* drifts, const double* variances) {
+      if (steps_ == 0 || !(dt_ > 0.0)) throw std::invalid_argument("need a positive length and at least one step");
+      if (options_.pathBlock == 0 || options_.assetBlock == 0) throw std::invalid_argument("block sizes must be positive");
+      spots_.assign(spots, spots + n_);
+      drift_.resize(n_);
+      for (std::size_t i = 0; i < n_; ++i) drift_[i] = (drifts[i] - 0.5 * variances[i]) * dt_;
+      // fold sqrt(dt) into the square root once
+      double root = std::sqrt(dt_);
+      if (k_) {
+        for (std::size_t j = 0; j < loadings_.size(); ++j) loadings_[j] *= root;
+        for (std::size_t i = 0; i < n_; ++i) specificRoot_[i] *= root;
+      } else {
+        for (std::size_t j = 0; j < lower_.size(); ++j) lower_[j] *= root;
+      }
+    }
+
+    // shocks (n x width) <- A normals (d x width)
+    void correlate(const double* z, double* x, std::size_t width) const {
+      std::fill(x, x + n_ * width, 0.0);
+      if (k_) {
+        const double* specific = z + k_ * width;
+        for (std::size_t i0 = 0; i0 < n_; i0 += 4) {
+          multiplyRows(&loadings_[i0 * k_], k_, std::min<std::size_t>(4, n_ - i0), 0, k_, z, width, x + i0 * width);
+        }
+        for (std::size_t i = 0; i < n_; ++i) {
+          double* xi = x + i * width;
+          const double* e = specific + i * width;
+          for (std::size_t p = 0; p < width; ++p) xi[p] += specificRoot_[i] * e[p];
+        }
+        return;
+      }
+      std::size_t b = options_.assetBlock;
+      for (std::size_t ib = 0; ib < n_; ib += b) {
+        std::size_t iEnd = std::min(ib + b, n_);
+        for (std::size_t jb = 0; jb < ib; jb += b) {
+          for (std::size_t i0 = ib; i0 < iEnd; i0 += 4) {
+            multiplyRows(&lower_[i0 * n_], n_, std::min<std::size_t>(4, iEnd - i0), jb, jb + b, z, width, x + i0 * width);
+          }
+        }
+        // diagonal tile: row i stops at column i
+        for (std::size_t i = ib; i < iEnd; ++i) multiplyRows(&lower_[i * n_], n_, 1, ib, i + 1, z, width, x + i * width);
+      }
+    }
+
+    // x[r][p] += sum_{j0 <= j < j1} a[r][j] z[j][p] for up to four rows r, four paths at a
+    // time held in registers while j runs
+    static void multiplyRows(const double* a, std::size_t lda, std::size_t rows, std::size_t j0, std::size_t j1,
+                             const double* z, std::size_t width, double* x) {
+      std::size_t p = 0;
+#if defined(__GNUC__)
+      if (rows == 4) {
+        typedef detail::Packed2 Packed2;
+        const double* a0 = a;
+        const double* a1 = a + lda;
+        const double* a2 = a + 2 * lda;
+        const double* a3 = a + 3 * lda;
+        for (; p + 4 <= width; p += 4) {
+          Packed2 x00 = detail::load2(x + p), x01 = detail::load2(x + p + 2);
+          Packed2 x10 = detail::load2(x + width + p), x11 = detail::load2(x + width + p + 2);
+          Packed2 x20 = detail::load2(x + 2 * width + p), x21 = detail::load2(x + 2 * width + p + 2);
+          Packed2 x30 = detail::load2(x + 3 * width + p), x31 = detail::load2(x + 3 * width + p + 2);
+          for (std::size_t j = j0; j < j1; ++j) {
+            Packed2 z0 = detail::load2(z + j * width + p), z1 = detail::load2(z + j * width + p + 2);
+            Packed2 c0 = detail::splat2(a0[j]), c1 = detail::splat2(a1[j]);
+            Packed2 c2 = detail::splat2(a2[j]), c3 = detail::splat2(a3[j]);
+            x00 += c0 * z0; x01 += c0 * z1;
+            x10 += c1 * z0; x11 += c1 * z1;
+            x20 += c2 * z0; x21 += c2 * z1;
+            x30 += c3 * z0; x31 += c3 * z1;
+          }
+          detail::store2(x + p, x00); detail::store2(x + p + 2, x01);
+          detail::store2(x + width + p, x10); detail::store2(x + width + p + 2, x11);
+          detail::store2(x + 2 * width + p, x20); detail::store2(x + 2 * width + p + 2, x21);
+          detail::store2(x + 3 * width + p, x30); detail::store2(x + 3 * width + p + 2, x31);
+        }
+      }
+#endif
+      for (std::size_t r = 0; r < rows; ++r) {
+        const double* ar = a + r * lda;
+        double* xr = x + r * width;
+        for (std::size_t j = j0; j < j1; ++j) {
+          const double* zj = z + j * width;
+          for (std::size_t q = p; q < width; ++q) xr[q] += ar[j] * zj[q];
+        }
+      }
+    }
+
+    template <class Visitor>
+    void run(std::size_t paths, std::size_t count, std::atomic<std::size_t>& next, Visitor& visitor, unsigned thread) const {
+      std::vector<double> workspace(workspaceSize());
+      for (std::size_t block = next++; block < count; block = next++) {
+        visitor(simulateBlock(block, paths, &workspace[0]), thread);
+      }
+    }
+
+    std::size_t n_, k_, steps_;
+    double dt_;
+    MultiAssetGbmOptions options_;
+    std::vector<double> lower_;                        // sqrt(dt) L, dense covariance
+    std::vector<double> loadings_, specificRoot_;      // sqrt(dt) G and sqrt(dt D), factor model
+    std::vector<double> spots_, drift_;                // drift_ is (mu - var/2) dt
+};
+
+}
+
+#endif
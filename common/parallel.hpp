@@ -0,0 +1,68 @@
+#ifndef QLTUTOR_PARALLEL_HPP
+#define QLTUTOR_PARALLEL_HPP
+
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+namespace qltutor {
+
+inline std::size_t defaultThreadCount() {
+  std::size_t n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : n;
+}
+
+// static partition of [begin, end) into contiguous chunks, one per worker;
+// f(chunkBegin, chunkEnd, worker) runs on the calling thread for worker 0.
+// The first exception thrown by any worker is rethrown after all have joined.
+template <class F>
+void parallelFor(std::size_t begin, std::size_t end, std::size_t threads, F f) {
+  if (end <= begin) return;
+  const std::size_t n = end - begin;
+  threads = std::max<std::size_t>(1, std::min(threads, n));
+  if (threads == 1) {
+    f(begin, end, std::size_t(0));
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(threads);
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  const std::size_t chunk = n / threads, extra = n % threads;
+
+  std::size_t from = begin;
+  std::size_t firstEnd = 0;
+  for (std::size_t w = 0; w < threads; ++w) {
+    const std::size_t to = from + chunk + (w < extra ? 1 : 0);
+    if (w == 0) {
+      firstEnd = to;
+    } else {
+      workers.push_back(std::thread([&f, &errors, from, to, w]() {
+        try {
+          f(from, to, w);
+        } catch (...) {
+          errors[w] = std::current_exception();
+        }
+      }));
+    }
+    from = to;
+  }
+
+  try {
+    f(begin, firstEnd, std::size_t(0));
+  } catch (...) {
+    errors[0] = std::current_exception();
+  }
+  for (std::size_t w = 0; w < workers.size(); ++w) {
+    workers[w].join();
+  }
+  for (std::size_t w = 0; w < threads; ++w) {
+    if (errors[w]) std::rethrow_exception(errors[w]);
+  }
+}
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef QLTUTOR_PHILOX_HPP
+#define QLTUTOR_PHILOX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// Philox4x32-10, the counter-based generator of Salmon et al. (Random123).
+//
+// Word block c of stream s under key k is a fixed function of (c, s, k): ten rounds of
+// two 32 x 32 -> 64 bit multiplications and xors over a 128-bit counter (c in the low
+// 64 bits, s in the high 64). There is no state beyond the counter, so skipping ahead
+// is setting it, streams are independent by construction, and any block can be
+// computed by any thread.
+//
+// Bulk generation runs `lanes` counters side by side, each round one loop over the
+// lanes with no dependence between them, which the compiler turns into vector
+// multiplies (four or eight lanes a register with SSE4 / AVX2).
+//
+// Philox4x32 is also a UniformRandomBitGenerator, for the <random> distributions.
+
+namespace qltutor {
+
+class Philox4x32 {
+  public:
+    typedef std::uint32_t result_type;
+    enum { lanes = 8 };
+
+    explicit Philox4x32(std::uint64_t seed = 0, std::uint64_t stream = 0)
+      : key0_(std::uint32_t(seed)), key1_(std::uint32_t(seed >> 32)), stream_(stream), position_(0) {}
+
+    // the four words of block `counter` of `stream` under `seed`
+    static void block(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter, std::uint32_t out[4]) {
+      std::uint32_t c[4] = { std::uint32_t(counter), std::uint32_t(counter >> 32), std::uint32_t(stream), std::uint32_t(stream >> 32) };
+      std::uint32_t k0 = std::uint32_t(seed), k1 = std::uint32_t(seed >> 32);
+      for (int r = 0; r < 10; ++r) {
+        std::uint64_t p0 = std::uint64_t(multiplier0) * c[0], p1 = std::uint64_t(multiplier1) * c[2];
+        std::uint32_t c0 = std::uint32_t(p1 >> 32) ^ c[1] ^ k0, c2 = std::uint32_t(p0 >> 32) ^ c[3] ^ k1;
+        c[1] = std::uint32_t(p1);
+        c[3] = std::uint32_t(p0);
+        c[0] = c0;
+        c[2] = c2;
+        k0 += weyl0;
+        k1 += weyl1;
+      }
+      std::copy(c, c + 4, out);
+    }
+
+    static result_type min() { return 0; }
+    static result_type max() { return std::numeric_limits<std::uint32_t>::max(); }
+
+    result_type operator()() {
+      if (position_ % 4 == 0) block(seed(), stream_, position_ / 4, buffer_);
+      return buffer_[position_++ % 4];
+    }
+
+    // the next n words of the stream
+    void fill(std::uint32_t* out, std::size_t n) {
+      std::size_t i = 0;
+      for (; i < n && position_ % 4 != 0; ++i) out[i] = (*this)();
+      std::size_t blocks = (n - i) / 4;
+      generate(position_ / 4, blocks, out + i);
+      position_ += 4 * blocks;
+      i += 4 * blocks;
+      for (; i < n; ++i) out[i] = (*this)();
+    }
+
+    // n uniforms in (0, 1) with 53 random bits each, two words apiece
+    void fillUniform(double* out, std::size_t n) {
+      std::uint32_t words[2 * chunk];
+      for (std::size_t begin = 0; begin < n; begin += chunk) {
+        std::size_t size = std::min<std::size_t>(chunk, n - begin);
+        fill(words, 2 * size);
+        for (std::size_t i = 0; i < size; ++i) out[begin + i] = toUniform(words[2 * i], words[2 * i + 1]);
+      }
+    }
+
+    static double toUniform(std::uint32_t high, std::uint32_t low) {
+      return ((double(high >> 5) * 67108864.0 + double(low >> 6)) + .5) * (1.0 / 9007199254740992.0);
+    }
+
+    // skipping ahead is moving the counter
+    void discard(std::uint64_t words) {
+      position_ += words;
+      if (position_ % 4 != 0) block(seed(), stream_, position_ / 4, buffer_);
+    }
+    void seek(std::uint64_t stream, std::uint64_t position = 0) {
+      stream_ = stream;
+      position_ = 0;
+      discard(position);
+    }
+
+    std::uint64_t seed() const { return std::uint64_t(key0_) | (std::uint64_t(key1_) << 32); }
+    std::uint64_t stream() const { return stream_; }
+    // words drawn from the stream so far
+    std::uint64_t position() const { return position_; }
+
+  private:
+    enum { chunk = 256 };
+    static const std::uint32_t multiplier0 = 0xD2511F53, multiplier1 = 0xCD9E8D57;
+    static const std::uint32_t weyl0 = 0x9E3779B9, weyl1 = 0xBB67AE85;
+
+    // `blocks` consecutive blocks from `first`, `lanes` at a time
+    void generate(std::uint64_t first, std::size_t blocks, std::uint32_t* out) const {
+      std::uint32_t s0 = std::uint32_t(stream_), s1 = std::uint32_t(stream_ >> 32);
+      std::size_t b = 0;
+      for (; b + lanes <= blocks; b += lanes) {
+        std::uint32_t c0[lanes], c1[lanes], c2[lanes], c3[lanes];
+        for (int l = 0; l < lanes; ++l) {
+          std::uint64_t counter = first + b + l;
+          c0[l] = std::uint32_t(counter);
+          c1[l] = std::uint32_t(counter >> 32);
+          c2[l] = s0;
+          c3[l] = s1;
+        }
+        std::uint32_t k0 = key0_, k1 = key1_;
+        for (int r = 0; r < 10; ++r) {
+          for (int l = 0; l < lanes; ++l) {
+            std::uint64_t p0 = std::uint64_t(multiplier0) * c0[l], p1 = std::uint64_t(multiplier1) * c2[l];
+            std::uint32_t n0 = std::uint32_t(p1 >> 32) ^ c1[l] ^ k0, n2 = std::uint32_t(p0 >> 32) ^ c3[l] ^ k1;
+            c1[l] = std::uint32_t(p1);
+            c3[l] = std::uint32_t(p0);
+            c0[l] = n0;
+            c2[l] = n2;
+          }
+          k0 += weyl0;
+          k1 += weyl1;
+        }
+        for (int l = 0; l < lanes; ++l) {
+          std::uint32_t* o = out + 4 * (b + l);
+          o[0] = c0[l];
+          o[1] = c1[l];
+          o[2] = c2[l];
+          o[3] = c3[l];
+        }
+      }
+      for (; b < blocks; ++b) block(seed(), stream_, first + b, out + 4 * b);
+    }
+
+    std::uint32_t key0_, key1_;
+    std::uint64_t stream_, position_;
+    std::uint32_t buffer_[4];     // block position_ / 4 while position_ is inside it
+};
+
+}
+
+#endif
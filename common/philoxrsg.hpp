@@ -0,0 +1,68 @@
+#ifndef QLTUTOR_PHILOXRSG_HPP
+#define QLTUTOR_PHILOXRSG_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "philox.hpp"
+#include "ziggurat.hpp"
+
+// Sequence generators on Philox4x32, with the interface of QuantLib's
+// RandomSequenceGenerator (sample_type with `value` and `weight`, nextSequence(),
+// lastSequence(), dimension()), so they plug into PathGenerator, InverseCumulativeRsg
+// and the Monte Carlo models as they are.
+//
+// Sequence k is the whole of stream k under the seed: a sequence is filled in one bulk
+// call, and skipTo(k) makes any sequence the next one in O(1), so threads can take
+// disjoint ranges of paths and still reproduce a single-threaded run exactly.
+
+namespace qltutor {
+
+struct SequenceSample {
+  SequenceSample(const std::vector<double>& value, double weight) : value(value), weight(weight) {}
+  std::vector<double> value;
+  double weight;
+};
+
+template <class Fill>
+class PhiloxSequenceGenerator {
+  public:
+    typedef SequenceSample sample_type;
+
+    PhiloxSequenceGenerator(std::size_t dimensionality, std::uint64_t seed = 0)
+      : dimensionality_(dimensionality), generator_(seed), next_(0), sequence_(std::vector<double>(dimensionality), 1.0) {}
+
+    const sample_type& nextSequence() const {
+      generator_.seek(next_++);
+      Fill::fill(generator_, &sequence_.value[0], dimensionality_);
+      return sequence_;
+    }
+    const sample_type& lastSequence() const { return sequence_; }
+    std::size_t dimension() const { return dimensionality_; }
+
+    // the index of the sequence nextSequence() returns
+    std::uint64_t position() const { return next_; }
+    void skipTo(std::uint64_t sequence) { next_ = sequence; }
+
+  private:
+    std::size_t dimensionality_;
+    mutable Philox4x32 generator_;
+    mutable std::uint64_t next_;
+    mutable sample_type sequence_;
+};
+
+namespace detail {
+  struct UniformFill {
+    static void fill(Philox4x32& generator, double* out, std::size_t n) { generator.fillUniform(out, n); }
+  };
+}
+
+// uniforms in (0, 1), for InverseCumulativeRsg
+typedef PhiloxSequenceGenerator<detail::UniformFill> PhiloxUniformRsg;
+// standard normals by the ziggurat, for PathGenerator
+typedef PhiloxSequenceGenerator<ZigguratNormal> PhiloxGaussianRsg;
+
+}
+
+#endif
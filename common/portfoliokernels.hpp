@@ -0,0 +1,155 @@
+#ifndef QLTUTOR_PORTFOLIOKERNELS_HPP
+#define QLTUTOR_PORTFOLIOKERNELS_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+// Portfolio linear algebra on caller-provided buffers.
+//
+// A covariance matrix is n x n, row-major, with `ld` doubles between rows (a
+// QuantLib::Matrix is cov.begin() with ld = cov.columns()); only its lower triangle,
+// diagonal included, is read. Portfolios are n contiguous weights (Array::begin());
+// a batch of k portfolios is k of them back to back. Nothing here allocates.
+//
+// The inner loops run on two-lane vectors with four accumulators, which is SSE2 on
+// any x86-64 and NEON on aarch64. Single-portfolio kernels stream every element of
+// the triangle once, which is already the best order; the batched product walks the
+// triangle in blockSize x blockSize tiles and applies each tile to all k portfolios
+// while it is in cache, so the matrix is read from memory once per batch.
+
+namespace qltutor {
+
+namespace detail {
+
+#if defined(__GNUC__)
+  typedef double Packed2 __attribute__((vector_size(16)));
+
+  inline Packed2 load2(const double* p) { Packed2 v; std::memcpy(&v, p, sizeof(v)); return v; }
+  inline void store2(double* p, Packed2 v) { std::memcpy(p, &v, sizeof(v)); }
+  inline Packed2 splat2(double x) { Packed2 v = { x, x }; return v; }
+  inline double sum2(Packed2 v) { return v[0] + v[1]; }
+#endif
+
+  // sum_j a[j] b[j]
+  inline double dot(const double* a, const double* b, std::size_t n) {
+    std::size_t j = 0;
+    double s = 0.0;
+#if defined(__GNUC__)
+    Packed2 s0 = splat2(0.0), s1 = s0, s2 = s0, s3 = s0;
+    for (; j + 8 <= n; j += 8) {
+      s0 += load2(a + j) * load2(b + j);
+      s1 += load2(a + j + 2) * load2(b + j + 2);
+      s2 += load2(a + j + 4) * load2(b + j + 4);
+      s3 += load2(a + j + 6) * load2(b + j + 6);
+    }
+    s = sum2((s0 + s1) + (s2 + s3));
+#endif
+    for (; j < n; ++j) s += a[j] * b[j];
+    return s;
+  }
+
+  // ab = sum_j a[j] b[j], ac = sum_j a[j] c[j], one pass over a
+  inline void dot2(const double* a, const double* b, const double* c, std::size_t n, double& ab, double& ac) {
+    std::size_t j = 0;
+    ab = ac = 0.0;
+#if defined(__GNUC__)
+    Packed2 b0 = splat2(0.0), b1 = b0, c0 = b0, c1 = b0;
+    for (; j + 4 <= n; j += 4) {
+      Packed2 a0 = load2(a + j), a1 = load2(a + j + 2);
+      b0 += a0 * load2(b + j);
+      b1 += a1 * load2(b + j + 2);
+      c0 += a0 * load2(c + j);
+      c1 += a1 * load2(c + j + 2);
+    }
+    ab = sum2(b0 + b1);
+    ac = sum2(c0 + c1);
+#endif
+    for (; j < n; ++j) {
+      ab += a[j] * b[j];
+      ac += a[j] * c[j];
+    }
+  }
+
+  // returns sum_j a[j] b[j] and adds alpha a[j] to y[j], one pass over a
+  inline double dotAxpy(const double* a, const double* b, double alpha, double* y, std::size_t n) {
+    std::size_t j = 0;
+    double s = 0.0;
+#if defined(__GNUC__)
+    Packed2 s0 = splat2(0.0), s1 = s0, alpha2 = splat2(alpha);
+    for (; j + 4 <= n; j += 4) {
+      Packed2 a0 = load2(a + j), a1 = load2(a + j + 2);
+      s0 += a0 * load2(b + j);
+      s1 += a1 * load2(b + j + 2);
+      store2(y + j, load2(y + j) + alpha2 * a0);
+      store2(y + j + 2, load2(y + j + 2) + alpha2 * a1);
+    }
+    s = sum2(s0 + s1);
+#endif
+    for (; j < n; ++j) {
+      s += a[j] * b[j];
+      y[j] += alpha * a[j];
+    }
+    return s;
+  }
+}
+
+// w' cov w
+inline double quadraticForm(std::size_t n, const double* cov, std::size_t ld, const double* w) {
+  double diagonal = 0.0, offDiagonal = 0.0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const double* row = cov + i * ld;
+    diagonal += row[i] * w[i] * w[i];
+    offDiagonal += w[i] * detail::dot(row, w, i);
+  }
+  return diagonal + 2.0 * offDiagonal;
+}
+
+// w' cov v, the covariance of the returns of two portfolios
+inline double portfolioCovariance(std::size_t n, const double* cov, std::size_t ld, const double* w, const double* v) {
+  double s = 0.0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const double* row = cov + i * ld;
+    double rowV, rowW;
+    detail::dot2(row, v, w, i, rowV, rowW);
+    s += row[i] * w[i] * v[i] + w[i] * rowV + v[i] * rowW;
+  }
+  return s;
+}
+
+// y_p = cov w_p for k portfolios; y must not overlap w
+inline void symmetricMultiply(std::size_t n, const double* cov, std::size_t ld,
+                              const double* w, std::size_t k, double* y, std::size_t blockSize = 64) {
+  std::fill(y, y + n * k, 0.0);
+  for (std::size_t ib = 0; ib < n; ib += blockSize) {
+    std::size_t iEnd = std::min(ib + blockSize, n);
+    for (std::size_t jb = 0; jb <= ib; jb += blockSize) {
+      for (std::size_t p = 0; p < k; ++p) {
+        const double* wp = w + p * n;
+        double* yp = y + p * n;
+        for (std::size_t i = ib; i < iEnd; ++i) {
+          const double* row = cov + i * ld;
+          std::size_t jEnd = jb == ib ? i : std::min(jb + blockSize, n);   // strictly below the diagonal
+          if (jEnd > jb) yp[i] += detail::dotAxpy(row + jb, wp + jb, wp[i], yp + jb, jEnd - jb);
+          if (jb == ib) yp[i] += row[i] * wp[i];
+        }
+      }
+    }
+  }
+}
+
+inline void symmetricMultiply(std::size_t n, const double* cov, std::size_t ld, const double* w, double* y) {
+  symmetricMultiply(n, cov, ld, w, 1, y);
+}
+
+// rc_p[i] = w_p[i] (cov w_p)[i] for k portfolios; each portfolio's contributions add
+// up to its variance. rc must not overlap w.
+inline void riskContributions(std::size_t n, const double* cov, std::size_t ld,
+                              const double* w, std::size_t k, double* rc) {
+  symmetricMultiply(n, cov, ld, w, k, rc);
+  for (std::size_t i = 0; i < n * k; ++i) rc[i] *= w[i];
+}
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef QLTUTOR_QMCPATHS_HPP
+#define QLTUTOR_QMCPATHS_HPP
+
+#include <ql/quantlib.hpp>
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+
+#include "scrambledsobol.hpp"
+#include "parallel.hpp"
+
+// Randomized quasi-Monte Carlo over paths of a one-factor process.
+//
+//   Real discount = std::exp(-r * T);
+//   qltutor::QmcEstimate call = qltutor::qmcPathEstimate(gbm, T, 255, 1 << 14,
+//       [=](const Path& path) { return discount * std::max(path.back() - strike, 0.0); });
+//   // call.value +- call.standardError
+//
+// The normals are Owen-scrambled Sobol points (scrambledsobol.hpp) on QuantLib's
+// Joe-Kuo direction integers, inverted by InverseCumulativeNormal, and PathGenerator
+// builds the path by Brownian bridge: the first coordinate sets the terminal value,
+// the next the midpoint, and so on, so the coordinates where Sobol is most uniform
+// carry most of the variance and the effective dimension of a 255-step path is small.
+//
+// The estimate is the mean over `replicas` independent scramblings of the same point
+// set, and the standard error is from the spread of the replica means, which is
+// unbiased whatever the integrand; a single low-discrepancy sequence has no usable
+// error estimate. Points are taken in blocks (a power of two), each started by
+// skip-ahead on its own generator, so threads take any blocks and the block sums are
+// added in a fixed order: the result does not depend on the number of threads.
+//
+// The functional is copied for each block and called on the block's paths in order.
+
+namespace qltutor {
+
+// 32 direction integers for each of `dimension` dimensions, as ScrambledSobolRsg takes
+// them, read out of QuantLib's SobolRsg: its sequence starts at Sobol point 1, so draw
+// 2^j - 1 is point 2^j, whose Gray code 2^j ^ 2^(j-1) makes it v[j] ^ v[j-1]
+inline std::shared_ptr<const std::vector<std::uint32_t> > sobolDirectionIntegers(
+    QuantLib::Size dimension, QuantLib::SobolRsg::DirectionIntegers integers = QuantLib::SobolRsg::JoeKuoD7) {
+  std::shared_ptr<std::vector<std::uint32_t> > directions(new std::vector<std::uint32_t>(dimension * ScrambledSobolRsg::bits));
+  for (QuantLib::Size j = 0; j < ScrambledSobolRsg::bits; ++j) {
+    QuantLib::SobolRsg sobol(dimension, 0, integers);
+    sobol.skipTo((1UL << j) - 1);
+    const std::vector<std::uint32_t>& point = sobol.nextInt32Sequence();
+    for (QuantLib::Size k = 0; k < dimension; ++k)
+      (*directions)[k * ScrambledSobolRsg::bits + j] = point[k] ^ (j ? (*directions)[k * ScrambledSobolRsg::bits + j - 1] : 0u);
+  }
+  return directions;
+}
+
+struct QmcOptions {
+  QmcOptions() : replicas(16), block(1024), seed(1), brownianBridge(true), threads(defaultThreadCount()) {}
+  QuantLib::Size replicas;     // independent scramblings
+  QuantLib::Size block;        // points per unit of work; keep a power of two
+  std::uint64_t seed;
+  bool brownianBridge;         // only for Gaussian increments
+  QuantLib::Size threads;
+};
+
+struct QmcEstimate {
+  QuantLib::Real value;
+  QuantLib::Real standardError;
+  QuantLib::Size replicas, pointsPerReplica;
+  std::vector<QuantLib::Real> replicaValues;
+};
+
+// E[f(path)] with `points` (best a power of two) scrambled Sobol points per replica;
+// `inverse` maps uniforms to the increments' law, InverseCumulativeNormal by default
+template <class Functional, class IC>
+QmcEstimate qmcPathEstimate(const boost::shared_ptr<QuantLib::StochasticProcess>& process, QuantLib::Time length,
+                            QuantLib::Size timeSteps, QuantLib::Size points, Functional f, const QmcOptions& options,
+                            const IC& inverse) {
+  using namespace QuantLib;
+  typedef InverseCumulativeRsg<ScrambledSobolRsg, IC> Rsg;
+  QL_REQUIRE(process->factors() == 1, "one-factor processes only");
+  QL_REQUIRE(points > 0 && options.replicas > 1 && options.block > 0, "need points, two replicas and a block size");
+
+  std::shared_ptr<const std::vector<std::uint32_t> > directions = sobolDirectionIntegers(timeSteps);
+  std::vector<std::uint64_t> seeds(options.replicas);
+  for (Size r = 0; r < options.replicas; ++r) seeds[r] = options.seed * 0x9e3779b97f4a7c15ULL + r;
+
+  const Size blocksPerReplica = (points + options.block - 1) / options.block;
+  std::vector<Real> sums(options.replicas * blocksPerReplica, 0.0);
+  parallelFor(0, sums.size(), options.threads, [&](std::size_t from, std::size_t to, std::size_t) {
+    for (std::size_t b = from; b < to; ++b) {
+      Size replica = b / blocksPerReplica, first = (b % blocksPerReplica) * options.block;
+      Size size = std::min(options.block, points - first);
+      ScrambledSobolRsg uniforms(directions, timeSteps, seeds[replica]);
+      uniforms.skipTo(first);
+      PathGenerator<Rsg> paths(process, length, timeSteps, Rsg(uniforms, inverse), options.brownianBridge);
+      Functional functional(f);
+      Real sum = 0.0;
+      for (Size i = 0; i < size; ++i) sum += functional(paths.next().value);
+      sums[b] = sum;
+    }
+  });
+
+  QmcEstimate estimate;
+  estimate.replicas = options.replicas;
+  estimate.pointsPerReplica = points;
+  Real mean = 0.0, squares = 0.0;
+  for (Size r = 0; r < options.replicas; ++r) {
+    Real sum = 0.0;
+    for (Size b = 0; b < blocksPerReplica; ++b) sum += sums[r * blocksPerReplica + b];
+    estimate.replicaValues.push_back(sum / points);
+    mean += estimate.replicaValues.back() / options.replicas;
+  }
+  for (Size r = 0; r < options.replicas; ++r) squares += (estimate.replicaValues[r] - mean) * (estimate.replicaValues[r] - mean);
+  estimate.value = mean;
+  estimate.standardError = std::sqrt(squares / (options.replicas - 1) / options.replicas);
+  return estimate;
+}
+
+template <class Functional>
+QmcEstimate qmcPathEstimate(const boost::shared_ptr<QuantLib::StochasticProcess>& process, QuantLib::Time length,
+                            QuantLib::Size timeSteps, QuantLib::Size points, Functional f,
+                            const QmcOptions& options = QmcOptions()) {
+  return qmcPathEstimate(process, length, timeSteps, points, f, options, QuantLib::InverseCumulativeNormal());
+}
+
+}
+
+#endif
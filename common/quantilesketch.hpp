@@ -0,0 +1,163 @@
+#ifndef QLTUTOR_QUANTILESKETCH_HPP
+#define QLTUTOR_QUANTILESKETCH_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+// Mergeable streaming quantiles in bounded memory (the KLL/REQ family of compactor
+// sketches).
+//
+// Level h holds items that each stand for 2^h observations. When a level reaches
+// `capacity` items it is sorted and compacted: of each adjacent pair one survives, the
+// even or the odd ones by a coin flip, and moves up a level. Every compaction is
+// unbiased, the total weight stays exact, and memory is capacity * log2(n / capacity)
+// items. Rank error is about 1/capacity of n.
+//
+// With highRankAccuracy a compaction only touches the lower half of the sorted level
+// and the largest items stay at weight 1, so the error near the top is relative to the
+// number of items above, not to n (as in the REQ sketch). That is the mode for the
+// upper tail of a loss distribution: VaR at 99.9% of 10^7 scenarios needs the top
+// 10^4 ranked accurately, not all 10^7.
+//
+// Sketches with the same capacity and mode merge level by level, in any order.
+
+namespace qltutor {
+
+class QuantileSketch {
+  public:
+    explicit QuantileSketch(std::size_t capacity = 256, bool highRankAccuracy = false, std::uint64_t seed = 1)
+      : capacity_(capacity), highRankAccuracy_(highRankAccuracy), random_(seed | 1), count_(0)
+      , min_(std::numeric_limits<double>::infinity()), max_(-std::numeric_limits<double>::infinity())
+      , levels_(1) {
+      if (capacity_ < 4) throw std::invalid_argument("sketch capacity must be at least 4");
+      levels_[0].reserve(capacity_);
+    }
+
+    void add(double x) {
+      levels_[0].push_back(x);
+      ++count_;
+      min_ = std::min(min_, x);
+      max_ = std::max(max_, x);
+      if (levels_[0].size() >= capacity_) compact(0);
+    }
+
+    void add(const double* x, std::size_t n) {
+      for (std::size_t i = 0; i < n; ++i) add(x[i]);
+    }
+
+    void merge(const QuantileSketch& other) {
+      if (other.capacity_ != capacity_ || other.highRankAccuracy_ != highRankAccuracy_) {
+        throw std::invalid_argument("only sketches of the same capacity and mode merge");
+      }
+      if (other.levels_.size() > levels_.size()) levels_.resize(other.levels_.size());
+      for (std::size_t h = 0; h < other.levels_.size(); ++h) {
+        levels_[h].insert(levels_[h].end(), other.levels_[h].begin(), other.levels_[h].end());
+      }
+      count_ += other.count_;
+      min_ = std::min(min_, other.min_);
+      max_ = std::max(max_, other.max_);
+      random_ ^= other.random_ * 0x9e3779b97f4a7c15ULL;
+      for (std::size_t h = 0; h < levels_.size(); ++h) {
+        if (levels_[h].size() >= capacity_) compact(h);
+      }
+    }
+
+    std::uint64_t count() const { return count_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    std::size_t capacity() const { return capacity_; }
+    // items held, which is what the sketch costs in memory
+    std::size_t retained() const {
+      std::size_t n = 0;
+      for (std::size_t h = 0; h < levels_.size(); ++h) n += levels_[h].size();
+      return n;
+    }
+
+    // smallest retained item with at least a fraction q of the weight at or below it
+    double quantile(double q) const {
+      if (count_ == 0) throw std::logic_error("quantile of an empty sketch");
+      if (q <= 0.0) return min_;
+      if (q >= 1.0) return max_;
+      std::vector<std::pair<double, std::uint64_t> > items = weightedItems();
+      double target = q * double(count_), cumulative = 0.0;
+      for (std::size_t i = 0; i < items.size(); ++i) {
+        cumulative += double(items[i].second);
+        if (cumulative >= target) return items[i].first;
+      }
+      return max_;
+    }
+
+    // estimated fraction of the observations <= x
+    double rank(double x) const {
+      if (count_ == 0) return 0.0;
+      double weight = 0.0;
+      for (std::size_t h = 0; h < levels_.size(); ++h) {
+        for (std::size_t i = 0; i < levels_[h].size(); ++i) {
+          if (levels_[h][i] <= x) weight += double(std::uint64_t(1) << h);
+        }
+      }
+      return weight / double(count_);
+    }
+
+    // mean of the top (1 - q) of the observations: expected shortfall when the items are losses
+    double tailMean(double q) const {
+      if (count_ == 0) throw std::logic_error("tail mean of an empty sketch");
+      double tail = (1.0 - q) * double(count_);
+      if (!(tail > 0.0)) return max_;
+      std::vector<std::pair<double, std::uint64_t> > items = weightedItems();
+      double remaining = tail, sum = 0.0;
+      for (std::size_t i = items.size(); i-- > 0 && remaining > 0.0;) {
+        double w = std::min(remaining, double(items[i].second));
+        sum += w * items[i].first;
+        remaining -= w;
+      }
+      return sum / (tail - remaining);
+    }
+
+  private:
+    void compact(std::size_t h) {
+      if (levels_.size() == h + 1) levels_.push_back(std::vector<double>());
+      std::vector<double>& buffer = levels_[h];
+      std::vector<double>& above = levels_[h + 1];
+      std::sort(buffer.begin(), buffer.end());
+      std::size_t compacted = highRankAccuracy_ ? buffer.size() / 2 : buffer.size();
+      compacted -= compacted % 2;
+      for (std::size_t i = coin(); i < compacted; i += 2) above.push_back(buffer[i]);
+      buffer.erase(buffer.begin(), buffer.begin() + compacted);
+      if (above.size() >= capacity_) compact(h + 1);
+    }
+
+    // xorshift64*
+    std::size_t coin() {
+      random_ ^= random_ >> 12;
+      random_ ^= random_ << 25;
+      random_ ^= random_ >> 27;
+      return std::size_t((random_ * 0x2545f4914f6cdd1dULL) >> 63);
+    }
+
+    std::vector<std::pair<double, std::uint64_t> > weightedItems() const {
+      std::vector<std::pair<double, std::uint64_t> > items;
+      items.reserve(retained());
+      for (std::size_t h = 0; h < levels_.size(); ++h) {
+        for (std::size_t i = 0; i < levels_[h].size(); ++i) items.push_back(std::make_pair(levels_[h][i], std::uint64_t(1) << h));
+      }
+      std::sort(items.begin(), items.end());
+      return items;
+    }
+
+    std::size_t capacity_;
+    bool highRankAccuracy_;
+    std::uint64_t random_;
+    std::uint64_t count_;
+    double min_, max_;
+    std::vector<std::vector<double> > levels_;
+};
+
+}
+
+#endif
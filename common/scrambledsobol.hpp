@@ -0,0 +1,125 @@
+#ifndef QLTUTOR_SCRAMBLEDSOBOL_HPP
+#define QLTUTOR_SCRAMBLEDSOBOL_HPP
+
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+#include "philoxrsg.hpp"
+
+// Sobol points with Owen's nested uniform scrambling, as a sequence generator with the
+// interface of QuantLib's RandomSequenceGenerator (see philoxrsg.hpp).
+//
+// Point n of dimension k is the xor of the direction integers v[k][j] over the bits j
+// of the Gray code of n, so any point is computed directly and skipTo(n) costs one xor
+// per bit and dimension; consecutive points differ by one direction integer
+// (Antonov-Saleev). The direction integers are passed in, 32 per dimension, left
+// aligned; qmcpaths.hpp takes QuantLib's Joe-Kuo tables.
+//
+// Each coordinate is then scrambled by the hash of Laine and Karras as Burley uses it:
+// on the bit-reversed integer, multiplications by even constants and an addition
+// carry information only from lower to higher bits, so digit i of the result is a
+// seeded permutation of digit i depending on digits 1..i-1 only. That is a nested
+// uniform scramble: the points stay a (t, m, s)-net in base 2 at every power of two,
+// each is uniform on (0, 1), and independent seeds give independent replicas whose
+// spread is an honest error estimate. A single fixed seed is a deterministic
+// low-discrepancy sequence, like HaltonRsg.
+//
+// Integers map to (0, 1) at the centre of their 2^-32 cell, so inverse cumulative
+// distributions are finite everywhere.
+
+namespace qltutor {
+
+class ScrambledSobolRsg {
+  public:
+    typedef SequenceSample sample_type;
+    enum { bits = 32 };
+
+    // directions[k * bits + j]: direction integer j of dimension k, for at least
+    // `dimensionality` dimensions
+    ScrambledSobolRsg(const std::shared_ptr<const std::vector<std::uint32_t> >& directions, std::size_t dimensionality,
+                      std::uint64_t seed = 0)
+      : directions_(directions), dimensionality_(dimensionality), seeds_(dimensionality), integers_(dimensionality, 0)
+      , next_(0), sequence_(std::vector<double>(dimensionality), 1.0) {
+      if (!directions_ || directions_->size() < dimensionality * bits)
+        throw std::invalid_argument("not enough direction integers for the dimension");
+      std::uint64_t state = seed;
+      for (std::size_t k = 0; k < dimensionality; ++k) seeds_[k] = std::uint32_t(splitMix(state) >> 32);
+    }
+
+    const sample_type& nextSequence() const {
+      const std::uint32_t* v = &(*directions_)[0];
+      for (std::size_t k = 0; k < dimensionality_; ++k)
+        sequence_.value[k] = (double(scramble(integers_[k], seeds_[k])) + .5) * (1.0 / 4294967296.0);
+      // point next_ + 1 differs from point next_ by the direction of the lowest zero bit of next_
+      std::size_t j = lowestZeroBit(next_++);
+      if (j < bits) {
+        for (std::size_t k = 0; k < dimensionality_; ++k) integers_[k] ^= v[k * bits + j];
+      }
+      return sequence_;
+    }
+    const sample_type& lastSequence() const { return sequence_; }
+    std::size_t dimension() const { return dimensionality_; }
+
+    // the index of the point nextSequence() returns
+    std::uint64_t position() const { return next_; }
+    void skipTo(std::uint64_t n) {
+      if (n >> bits) throw std::out_of_range("Sobol index beyond 2^32");
+      const std::uint32_t* v = &(*directions_)[0];
+      std::uint64_t gray = n ^ (n >> 1);
+      for (std::size_t k = 0; k < dimensionality_; ++k) {
+        std::uint32_t x = 0;
+        for (std::size_t j = 0; j < bits; ++j)
+          if ((gray >> j) & 1) x ^= v[k * bits + j];
+        integers_[k] = x;
+      }
+      next_ = n;
+    }
+
+    // the nested uniform scramble of x, digits from the most significant bit down
+    static std::uint32_t scramble(std::uint32_t x, std::uint32_t seed) {
+      x = reverse(x);
+      x += seed;
+      x ^= x * 0x6c50b47cu;
+      x ^= x * 0xb82f1e52u;
+      x ^= x * 0xc7afe638u;
+      x ^= x * 0x8d22f6e6u;
+      return reverse(x);
+    }
+
+  private:
+    static std::uint32_t reverse(std::uint32_t x) {
+      x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+      x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+      x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+      x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+      return (x >> 16) | (x << 16);
+    }
+    static std::size_t lowestZeroBit(std::uint64_t n) {
+      std::size_t j = 0;
+      while (n & 1) {
+        n >>= 1;
+        ++j;
+      }
+      return j;
+    }
+    static std::uint64_t splitMix(std::uint64_t& state) {
+      std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    std::shared_ptr<const std::vector<std::uint32_t> > directions_;
+    std::size_t dimensionality_;
+    std::vector<std::uint32_t> seeds_;
+    mutable std::vector<std::uint32_t> integers_;   // unscrambled point next_
+    mutable std::uint64_t next_;
+    mutable sample_type sequence_;
+};
+
+}
+
+#endif
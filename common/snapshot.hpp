@@ -0,0 +1,238 @@
+#ifndef QLTUTOR_SNAPSHOT_HPP
+#define QLTUTOR_SNAPSHOT_HPP
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <stdexcept>
+#include <fstream>
+#include <cstdio>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Versioned binary snapshot of bootstrapped market data.
+//
+//   SnapshotHeader | SnapshotSection x sectionCount | payload (8-byte aligned doubles)
+//
+// Every section is a named rows x columns array of doubles (dates are stored as
+// serial numbers). A reader maps the file read-only and hands out pointers into the
+// mapping, so attaching costs one mmap plus, optionally, one checksum pass.
+
+namespace qltutor {
+
+enum SnapshotSectionKind {
+  SnapshotScalars = 1,
+  SnapshotCurveNodes = 2,
+  SnapshotSurfaceGrid = 3,
+  SnapshotReturnPanel = 4,    // observations x assets, oldest first (covest.hpp)
+  SnapshotRunState = 5        // a Monte Carlo run's position and accumulators (mcrun.hpp)
+};
+
+struct SnapshotHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t sectionCount;
+  std::uint64_t fileSize;
+  std::uint64_t checksum;     // over everything after the header
+};
+
+struct SnapshotSection {
+  char name[40];
+  std::uint32_t kind;
+  std::uint32_t rows;
+  std::uint32_t columns;
+  std::uint32_t reserved;
+  std::uint64_t offset;       // from the start of the file
+};
+
+const char snapshotMagic[8] = { 'Q', 'L', 'T', 'S', 'N', 'A', 'P', '\0' };
+const std::uint32_t snapshotVersion = 1;
+
+// FNV-1a over 64-bit words, tail bytes folded in one at a time
+inline std::uint64_t snapshotChecksum(const char* data, std::size_t size) {
+  const std::uint64_t prime = 1099511628211ULL;
+  std::uint64_t hash = 14695981039346656037ULL;
+  std::size_t words = size / 8;
+  for (std::size_t i = 0; i < words; ++i) {
+    std::uint64_t word;
+    std::memcpy(&word, data + 8 * i, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for (std::size_t i = 8 * words; i < size; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+  }
+  return hash;
+}
+
+class SnapshotWriter {
+  public:
+    void add(const std::string& name, SnapshotSectionKind kind,
+             std::size_t rows, std::size_t columns, const double* data) {
+      if (name.size() >= sizeof(SnapshotSection().name)) {
+        throw std::invalid_argument("snapshot section name too long: " + name);
+      }
+      Entry entry = { name, kind, rows, columns, std::vector<double>(data, data + rows * columns) };
+      entries_.push_back(entry);
+    }
+
+    void add(const std::string& name, SnapshotSectionKind kind, const std::vector<double>& values) {
+      add(name, kind, 1, values.size(), values.empty() ? 0 : &values[0]);
+    }
+
+    void write(const std::string& path) const {
+      std::vector<SnapshotSection> sections(entries_.size());
+      std::uint64_t offset = sizeof(SnapshotHeader) + sections.size() * sizeof(SnapshotSection);
+      for (std::size_t i = 0; i < entries_.size(); ++i) {
+        std::memset(&sections[i], 0, sizeof(SnapshotSection));
+        std::strncpy(sections[i].name, entries_[i].name.c_str(), sizeof(sections[i].name) - 1);
+        sections[i].kind = entries_[i].kind;
+        sections[i].rows = std::uint32_t(entries_[i].rows);
+        sections[i].columns = std::uint32_t(entries_[i].columns);
+        sections[i].offset = offset;
+        offset += entries_[i].values.size() * sizeof(double);
+      }
+
+      std::vector<char> file(offset);
+      if (!sections.empty()) {
+        std::memcpy(&file[sizeof(SnapshotHeader)], &sections[0], sections.size() * sizeof(SnapshotSection));
+      }
+      for (std::size_t i = 0; i < entries_.size(); ++i) {
+        if (!entries_[i].values.empty()) {
+          std::memcpy(&file[sections[i].offset], &entries_[i].values[0],
+                      entries_[i].values.size() * sizeof(double));
+        }
+      }
+
+      SnapshotHeader header;
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+      header.version = snapshotVersion;
+      header.sectionCount = std::uint32_t(sections.size());
+      header.fileSize = offset;
+      header.checksum = snapshotChecksum(&file[sizeof(SnapshotHeader)], file.size() - sizeof(SnapshotHeader));
+      std::memcpy(&file[0], &header, sizeof(header));
+
+      // write a sibling file and rename, so a reader never maps a half-written snapshot
+      std::string temporary = path + ".tmp";
+      std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+      out.write(&file[0], file.size());
+      out.close();
+      if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("cannot write snapshot " + path);
+      }
+    }
+
+  private:
+    struct Entry {
+      std::string name;
+      SnapshotSectionKind kind;
+      std::size_t rows, columns;
+      std::vector<double> values;
+    };
+    std::vector<Entry> entries_;
+};
+
+// read-only mapping of a snapshot; arrays point straight into the mapping
+class SnapshotView {
+  public:
+    struct Array {
+      const double* data;
+      std::size_t rows, columns;
+      std::size_t size() const { return rows * columns; }
+      double operator()(std::size_t i, std::size_t j) const { return data[i * columns + j]; }
+      double operator[](std::size_t i) const { return data[i]; }
+    };
+
+    explicit SnapshotView(const std::string& path, bool verifyChecksum = true)
+      : base_(0), size_(0) {
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0) throw std::runtime_error("cannot open snapshot " + path);
+      struct stat info;
+      if (fstat(fd, &info) != 0 || std::size_t(info.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        throw std::runtime_error("snapshot " + path + " is truncated");
+      }
+      size_ = info.st_size;
+      void* mapped = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (mapped == MAP_FAILED) throw std::runtime_error("cannot map snapshot " + path);
+      base_ = static_cast<const char*>(mapped);
+
+      try {
+        validate(path, verifyChecksum);
+      } catch (...) {
+        munmap(const_cast<char*>(base_), size_);
+        throw;
+      }
+    }
+
+    ~SnapshotView() {
+      if (base_) munmap(const_cast<char*>(base_), size_);
+    }
+
+    std::size_t sectionCount() const { return header().sectionCount; }
+    std::uint32_t version() const { return header().version; }
+
+    bool contains(const std::string& name) const { return findSection(name) != 0; }
+
+    Array array(const std::string& name) const {
+      const SnapshotSection* section = findSection(name);
+      if (!section) throw std::runtime_error("snapshot has no section " + name);
+      Array a = { reinterpret_cast<const double*>(base_ + section->offset), section->rows, section->columns };
+      return a;
+    }
+
+  private:
+    SnapshotView(const SnapshotView&);
+    SnapshotView& operator=(const SnapshotView&);
+
+    const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(base_); }
+    const SnapshotSection* sections() const {
+      return reinterpret_cast<const SnapshotSection*>(base_ + sizeof(SnapshotHeader));
+    }
+
+    const SnapshotSection* findSection(const std::string& name) const {
+      for (std::size_t i = 0; i < header().sectionCount; ++i) {
+        if (name == sections()[i].name) return &sections()[i];
+      }
+      return 0;
+    }
+
+    void validate(const std::string& path, bool verifyChecksum) const {
+      const SnapshotHeader& h = header();
+      if (std::memcmp(h.magic, snapshotMagic, sizeof(h.magic)) != 0) {
+        throw std::runtime_error(path + " is not a market snapshot");
+      }
+      if (h.version != snapshotVersion) {
+        throw std::runtime_error(path + " has an unsupported snapshot version");
+      }
+      if (h.fileSize != size_
+          || sizeof(SnapshotHeader) + std::uint64_t(h.sectionCount) * sizeof(SnapshotSection) > size_) {
+        throw std::runtime_error("snapshot " + path + " is truncated");
+      }
+      for (std::size_t i = 0; i < h.sectionCount; ++i) {
+        const SnapshotSection& s = sections()[i];
+        if (s.name[sizeof(s.name) - 1] != '\0' || s.offset % 8 != 0
+            || s.offset + std::uint64_t(s.rows) * s.columns * sizeof(double) > size_) {
+          throw std::runtime_error("snapshot " + path + " has a corrupt section table");
+        }
+      }
+      if (verifyChecksum
+          && snapshotChecksum(base_ + sizeof(SnapshotHeader), size_ - sizeof(SnapshotHeader)) != h.checksum) {
+        throw std::runtime_error("snapshot " + path + " failed its integrity check");
+      }
+    }
+
+    const char* base_;
+    std::size_t size_;
+};
+
+}
+
+#endif
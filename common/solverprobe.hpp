@@ -0,0 +1,227 @@
+#ifndef QLTUTOR_SOLVERPROBE_HPP
+#define QLTUTOR_SOLVERPROBE_HPP
+
+#include <ql/quantlib.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "solverstats.hpp"
+
+#ifdef QLTUTOR_SOLVER_STATS
+#include <chrono>
+#include <sstream>
+#endif
+
+// Probes around QuantLib solves, for solverstats.hpp.
+//
+//   qltutor::SolveProbe probe("Bisection", "06irr/ytm");
+//   Real irr = probe.finish(bisection.solve(probe.counted(f), accuracy, guess, min, max));
+//
+//   qltutor::SolveProbe probe("Simplex", "09lopt/WeightsMV", costFunction, constraint);
+//   Problem problem(probe.costFunction(), probe.constraint(), initialValue);
+//   EndCriteria::Type type = probe.finish(solver.minimize(problem, endCriteria), problem);
+//
+// With QLTUTOR_SOLVER_STATS the probe counts function evaluations and constraint
+// rejections through thin wrappers and records a SolveRecord when the solve finishes
+// (or throws). QuantLib's Simplex and LevenbergMarquardt do not expose their iteration
+// counters, so for them `iterations` counts the evaluations that improved on the best
+// value seen; for a bracketed Bisection it is the halvings, evaluations less the two
+// bracket ends. The cost function wrapper forwards gradients and Jacobians too, so a
+// solver probed still uses the analytic ones; `evaluations` counts the calls that return
+// a value, valueAndGradient() and valuesAndJacobian() included. Without
+// QLTUTOR_SOLVER_STATS the probe hands back its arguments unchanged.
+
+namespace qltutor {
+
+#ifdef QLTUTOR_SOLVER_STATS
+
+namespace detail {
+
+  struct SolveCounters {
+    SolveCounters() : evaluations(0), improvements(0), rejections(0), best(QL_MAX_REAL) {}
+    void evaluated(QuantLib::Real value) const {
+      ++evaluations;
+      if (value < best) {
+        best = value;
+        ++improvements;
+      }
+    }
+    mutable std::uint32_t evaluations, improvements, rejections;
+    mutable QuantLib::Real best;
+  };
+
+  class CountingCostFunction : public QuantLib::CostFunction {
+    public:
+      CountingCostFunction(QuantLib::CostFunction& costFunction, const SolveCounters& counters)
+        : costFunction_(costFunction), counters_(counters) {}
+
+      QuantLib::Real value(const QuantLib::Array& x) const {
+        QuantLib::Real v = costFunction_.value(x);
+        counters_.evaluated(v);
+        return v;
+      }
+
+      QuantLib::Disposable<QuantLib::Array> values(const QuantLib::Array& x) const {
+        QuantLib::Array v = costFunction_.values(x);
+        counters_.evaluated(QuantLib::DotProduct(v, v));
+        return v;
+      }
+
+      void gradient(QuantLib::Array& grad, const QuantLib::Array& x) const {
+        costFunction_.gradient(grad, x);
+      }
+
+      QuantLib::Real valueAndGradient(QuantLib::Array& grad, const QuantLib::Array& x) const {
+        QuantLib::Real v = costFunction_.valueAndGradient(grad, x);
+        counters_.evaluated(v);
+        return v;
+      }
+
+      void jacobian(QuantLib::Matrix& jac, const QuantLib::Array& x) const {
+        costFunction_.jacobian(jac, x);
+      }
+
+      QuantLib::Disposable<QuantLib::Array> valuesAndJacobian(QuantLib::Matrix& jac, const QuantLib::Array& x) const {
+        QuantLib::Array v = costFunction_.valuesAndJacobian(jac, x);
+        counters_.evaluated(QuantLib::DotProduct(v, v));
+        return v;
+      }
+
+    private:
+      QuantLib::CostFunction& costFunction_;
+      const SolveCounters& counters_;
+  };
+
+  class CountingConstraint : public QuantLib::Constraint {
+    private:
+      class Impl : public QuantLib::Constraint::Impl {
+        public:
+          Impl(const QuantLib::Constraint& constraint, const SolveCounters& counters)
+            : constraint_(constraint), counters_(counters) {}
+          bool test(const QuantLib::Array& x) const {
+            bool accepted = constraint_.test(x);
+            if (!accepted) ++counters_.rejections;
+            return accepted;
+          }
+          QuantLib::Disposable<QuantLib::Array> upperBound(const QuantLib::Array& x) const {
+            return constraint_.upperBound(x);
+          }
+          QuantLib::Disposable<QuantLib::Array> lowerBound(const QuantLib::Array& x) const {
+            return constraint_.lowerBound(x);
+          }
+        private:
+          QuantLib::Constraint constraint_;
+          const SolveCounters& counters_;
+      };
+    public:
+      CountingConstraint(const QuantLib::Constraint& constraint, const SolveCounters& counters)
+        : QuantLib::Constraint(boost::shared_ptr<QuantLib::Constraint::Impl>(new Impl(constraint, counters))) {}
+  };
+
+  template <class F>
+  class CountingFunction {
+    public:
+      CountingFunction(const F& f, const SolveCounters& counters) : f_(f), counters_(counters) {}
+      QuantLib::Real operator()(QuantLib::Real x) const {
+        ++counters_.evaluations;
+        return f_(x);
+      }
+    private:
+      F f_;
+      const SolveCounters& counters_;
+  };
+}
+
+class SolveProbe {
+  public:
+    SolveProbe(const char* solver, const char* label)
+      : solver_(solver), label_(label), oneDimensional_(true), finished_(false)
+      , start_(std::chrono::steady_clock::now()) {}
+
+    SolveProbe(const char* solver, const char* label,
+               QuantLib::CostFunction& costFunction, QuantLib::Constraint& constraint)
+      : solver_(solver), label_(label), oneDimensional_(false), finished_(false)
+      , costFunction_(new detail::CountingCostFunction(costFunction, counters_))
+      , constraint_(new detail::CountingConstraint(constraint, counters_))
+      , start_(std::chrono::steady_clock::now()) {}
+
+    ~SolveProbe() {
+      if (!finished_) record(false, "Exception", 0.0);   // the solver threw
+    }
+
+    QuantLib::CostFunction& costFunction() { return *costFunction_; }
+    QuantLib::Constraint& constraint() { return *constraint_; }
+
+    template <class F>
+    detail::CountingFunction<F> counted(const F& f) const { return detail::CountingFunction<F>(f, counters_); }
+
+    QuantLib::Real finish(QuantLib::Real root) {
+      record(true, "Converged", root);
+      return root;
+    }
+
+    QuantLib::EndCriteria::Type finish(QuantLib::EndCriteria::Type type, const QuantLib::Problem& problem) {
+      std::ostringstream name;
+      name << type;
+      bool converged = type != QuantLib::EndCriteria::None && type != QuantLib::EndCriteria::MaxIterations
+                    && type != QuantLib::EndCriteria::Unknown;
+      record(converged, name.str().c_str(), problem.functionValue());
+      return type;
+    }
+
+  private:
+    SolveProbe(const SolveProbe&);
+    SolveProbe& operator=(const SolveProbe&);
+
+    void record(bool converged, const char* termination, double value) {
+      finished_ = true;
+      SolveRecord r;
+      r.solver = solver_;
+      r.label = label_;
+      r.evaluations = counters_.evaluations;
+      r.iterations = oneDimensional_ ? (counters_.evaluations > 2 ? counters_.evaluations - 2 : 0)
+                                     : counters_.improvements;
+      r.rejections = counters_.rejections;
+      r.converged = converged;
+      std::strncpy(r.termination, termination, sizeof(r.termination) - 1);
+      r.termination[sizeof(r.termination) - 1] = '\0';
+      r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+      r.value = value;
+      recordSolve(r);
+    }
+
+    const char* solver_;
+    const char* label_;
+    bool oneDimensional_, finished_;
+    detail::SolveCounters counters_;
+    boost::scoped_ptr<detail::CountingCostFunction> costFunction_;
+    boost::scoped_ptr<detail::CountingConstraint> constraint_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#else
+
+class SolveProbe {
+  public:
+    SolveProbe(const char*, const char*) : costFunction_(0), constraint_(0) {}
+    SolveProbe(const char*, const char*, QuantLib::CostFunction& costFunction, QuantLib::Constraint& constraint)
+      : costFunction_(&costFunction), constraint_(&constraint) {}
+
+    QuantLib::CostFunction& costFunction() { return *costFunction_; }
+    QuantLib::Constraint& constraint() { return *constraint_; }
+
+    template <class F>
+    const F& counted(const F& f) const { return f; }
+
+    QuantLib::Real finish(QuantLib::Real root) { return root; }
+    QuantLib::EndCriteria::Type finish(QuantLib::EndCriteria::Type type, const QuantLib::Problem&) { return type; }
+
+  private:
+    QuantLib::CostFunction* costFunction_;
+    QuantLib::Constraint* constraint_;
+};
+
+#endif
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef QLTUTOR_SOLVERSTATS_HPP
+#define QLTUTOR_SOLVERSTATS_HPP
+
+// Per-solve statistics, recorded only when QLTUTOR_SOLVER_STATS is defined.
+//
+// Every finished solve appends a SolveRecord to a ring buffer owned by the solving
+// thread (the newest records win once it wraps) and adds to that thread's per-label
+// totals. solveSummary() folds the totals of all threads, including ones that have
+// already exited; a program that recorded anything prints the summary to stderr at
+// exit. Without QLTUTOR_SOLVER_STATS none of this is compiled: the probes in
+// solverprobe.hpp reduce to the plain solver calls.
+
+#ifdef QLTUTOR_SOLVER_STATS
+
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <ostream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+namespace qltutor {
+
+struct SolveRecord {
+  const char* solver;        // string literals, never copied
+  const char* label;
+  std::uint32_t iterations;
+  std::uint32_t evaluations;
+  std::uint32_t rejections;  // trial points refused by the constraint
+  bool converged;
+  char termination[28];
+  double seconds;
+  double value;              // root or final cost
+};
+
+struct SolveTotals {
+  SolveTotals() : solves(0), failures(0), iterations(0), evaluations(0), rejections(0)
+                , maxEvaluations(0), seconds(0.0), maxSeconds(0.0) {}
+
+  void add(const SolveRecord& r) {
+    ++solves;
+    if (!r.converged) ++failures;
+    iterations += r.iterations;
+    evaluations += r.evaluations;
+    rejections += r.rejections;
+    maxEvaluations = std::max<std::uint64_t>(maxEvaluations, r.evaluations);
+    seconds += r.seconds;
+    maxSeconds = std::max(maxSeconds, r.seconds);
+    ++terminations[r.termination];
+  }
+
+  void add(const SolveTotals& t) {
+    solves += t.solves;
+    failures += t.failures;
+    iterations += t.iterations;
+    evaluations += t.evaluations;
+    rejections += t.rejections;
+    maxEvaluations = std::max(maxEvaluations, t.maxEvaluations);
+    seconds += t.seconds;
+    maxSeconds = std::max(maxSeconds, t.maxSeconds);
+    for (std::map<std::string, std::uint64_t>::const_iterator i = t.terminations.begin(); i != t.terminations.end(); ++i) {
+      terminations[i->first] += i->second;
+    }
+  }
+
+  std::uint64_t solves, failures, iterations, evaluations, rejections, maxEvaluations;
+  double seconds, maxSeconds;
+  std::map<std::string, std::uint64_t> terminations;
+};
+
+// "<solver> <label>" -> totals
+typedef std::map<std::string, SolveTotals> SolveSummary;
+
+inline void printSolveSummary(std::ostream& out, const SolveSummary& summary) {
+  char line[256];
+  for (SolveSummary::const_iterator i = summary.begin(); i != summary.end(); ++i) {
+    const SolveTotals& t = i->second;
+    std::snprintf(line, sizeof(line),
+                  "%-40s %8llu solves %5llu failed  evals %8.1f/solve (max %llu)  iters %8.1f  rejected %8.1f  %10.3f us/solve (max %.3f)",
+                  i->first.c_str(), static_cast<unsigned long long>(t.solves),
+                  static_cast<unsigned long long>(t.failures), double(t.evaluations) / t.solves,
+                  static_cast<unsigned long long>(t.maxEvaluations), double(t.iterations) / t.solves,
+                  double(t.rejections) / t.solves, 1e6 * t.seconds / t.solves, 1e6 * t.maxSeconds);
+    out << line;
+    for (std::map<std::string, std::uint64_t>::const_iterator j = t.terminations.begin(); j != t.terminations.end(); ++j) {
+      out << "  " << j->first << "=" << j->second;
+    }
+    out << "\n";
+  }
+  out.flush();
+}
+
+namespace detail {
+
+  class SolveLog;
+
+  struct SolveRegistry {
+    std::mutex mutex;
+    std::vector<SolveLog*> logs;
+    SolveSummary retired;      // totals of threads that have exited
+    bool used;
+
+    SolveRegistry() : used(false) {}
+    ~SolveRegistry();
+  };
+
+  inline SolveRegistry& solveRegistry() {
+    static SolveRegistry registry;
+    return registry;
+  }
+
+  class SolveLog {
+    public:
+      static const std::size_t capacity = 4096;
+
+      SolveLog() : records_(capacity), next_(0) {
+        SolveRegistry& registry = solveRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.logs.push_back(this);
+        registry.used = true;
+      }
+
+      ~SolveLog() {
+        SolveRegistry& registry = solveRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.logs.erase(std::remove(registry.logs.begin(), registry.logs.end(), this), registry.logs.end());
+        std::lock_guard<std::mutex> own(mutex_);
+        for (SolveSummary::const_iterator i = totals_.begin(); i != totals_.end(); ++i) {
+          registry.retired[i->first].add(i->second);
+        }
+      }
+
+      void push(const SolveRecord& record) {
+        std::lock_guard<std::mutex> lock(mutex_);   // uncontended except while a summary is taken
+        records_[next_++ % capacity] = record;
+        totals_[std::string(record.solver) + " " + record.label].add(record);
+      }
+
+      // oldest first
+      std::vector<SolveRecord> records() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<SolveRecord> ordered;
+        std::size_t first = next_ > capacity ? next_ - capacity : 0;
+        for (std::size_t i = first; i < next_; ++i) ordered.push_back(records_[i % capacity]);
+        return ordered;
+      }
+
+      void addTotalsTo(SolveSummary& summary) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (SolveSummary::const_iterator i = totals_.begin(); i != totals_.end(); ++i) {
+          summary[i->first].add(i->second);
+        }
+      }
+
+    private:
+      std::mutex mutex_;
+      std::vector<SolveRecord> records_;
+      std::size_t next_;
+      SolveSummary totals_;
+  };
+
+  inline SolveLog& threadSolveLog() {
+    static thread_local SolveLog log;
+    return log;
+  }
+
+  inline SolveRegistry::~SolveRegistry() {
+    if (used && !retired.empty()) {
+      std::cerr << "Solver statistics:" << std::endl;
+      printSolveSummary(std::cerr, retired);
+    }
+  }
+}
+
+inline void recordSolve(const SolveRecord& record) {
+  detail::solveRegistry();   // constructed first, so it outlives every thread's log
+  detail::threadSolveLog().push(record);
+}
+
+// this thread's most recent records, oldest first
+inline std::vector<SolveRecord> recentSolves() {
+  return detail::threadSolveLog().records();
+}
+
+inline SolveSummary solveSummary() {
+  detail::SolveRegistry& registry = detail::solveRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  SolveSummary summary = registry.retired;
+  for (std::size_t i = 0; i < registry.logs.size(); ++i) registry.logs[i]->addTotalsTo(summary);
+  return summary;
+}
+
+inline void dumpSolves(std::ostream& out, const std::vector<SolveRecord>& records) {
+  char line[256];
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    const SolveRecord& r = records[i];
+    std::snprintf(line, sizeof(line), "%-18s %-28s iters %6u evals %6u rejected %6u %-26s %10.3f us value %.10g",
+                  r.solver, r.label, r.iterations, r.evaluations, r.rejections, r.termination,
+                  1e6 * r.seconds, r.value);
+    out << line << "\n";
+  }
+  out.flush();
+}
+
+}
+
+#endif
+
+#endif
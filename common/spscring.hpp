@@ -0,0 +1,75 @@
+#ifndef QLTUTOR_SPSCRING_HPP
+#define QLTUTOR_SPSCRING_HPP
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <cstddef>
+#include <stdexcept>
+
+namespace qltutor {
+
+// bounded single-producer/single-consumer ring buffer.
+// Each side owns one index and keeps a cached copy of the other side's, so the
+// shared cache lines are only touched when the ring looks full or empty.
+template <class T>
+class SpscRing {
+  public:
+    explicit SpscRing(std::size_t capacity)
+      : buffer_(capacity), mask_(capacity - 1)
+      , head_(0), cachedTail_(0), tail_(0), cachedHead_(0) {
+      if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        throw std::invalid_argument("ring capacity must be a power of two");
+      }
+    }
+
+    // producer side
+    bool tryPush(const T& value) {
+      const std::size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - cachedHead_ > mask_) {
+        cachedHead_ = head_.load(std::memory_order_acquire);
+        if (tail - cachedHead_ > mask_) return false;
+      }
+      buffer_[tail & mask_] = value;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    void push(const T& value) {
+      while (!tryPush(value)) std::this_thread::yield();
+    }
+
+    // consumer side
+    bool tryPop(T& value) {
+      const std::size_t head = head_.load(std::memory_order_relaxed);
+      if (head == cachedTail_) {
+        cachedTail_ = tail_.load(std::memory_order_acquire);
+        if (head == cachedTail_) return false;
+      }
+      value = buffer_[head & mask_];
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    void pop(T& value) {
+      while (!tryPop(value)) std::this_thread::yield();
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+  private:
+    std::vector<T> buffer_;
+    const std::size_t mask_;
+
+    // consumer owned
+    alignas(64) std::atomic<std::size_t> head_;
+    std::size_t cachedTail_;
+    // producer owned
+    alignas(64) std::atomic<std::size_t> tail_;
+    std::size_t cachedHead_;
+    char padding_[64 - sizeof(std::size_t)];
+};
+
+}
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef QLTUTOR_STREAMINGSTATS_HPP
+#define QLTUTOR_STREAMINGSTATS_HPP
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "quantilesketch.hpp"
+
+// Sample statistics in constant memory, for when QuantLib's GeneralStatistics, which
+// keeps every sample, would hold millions of paths.
+//
+// MomentAccumulator keeps the count, min, max, mean and the central sums
+// M2, M3 and M4, so it gives the variance, skewness and kurtosis with QuantLib's
+// small-sample corrections. Two accumulators combine exactly (Chan et al., Pebay), in
+// any order: per-thread results merge at the end, and a block of samples is summed
+// on its own, two passes over data in cache, then merged into the running totals. The
+// block loops have no division and are four lanes wide, so they vectorize; add(x) is
+// the one-sample Welford update for when values come one at a time.
+//
+// StreamingStatistics adds a QuantileSketch for percentiles. It has the calls of
+// GeneralStatistics the tutorial uses (add, addSequence, reset, mean, standardDeviation,
+// min, max, percentile, ...) and drops in for it.
+
+namespace qltutor {
+
+class MomentAccumulator {
+  public:
+    // samples summarized together by add(x, n) and addSequence
+    enum { chunk = 256 };
+
+    MomentAccumulator() { reset(); }
+
+    void reset() {
+      n_ = 0.0;
+      mean_ = m2_ = m3_ = m4_ = 0.0;
+      min_ = std::numeric_limits<double>::infinity();
+      max_ = -std::numeric_limits<double>::infinity();
+    }
+
+    void add(double x) {
+      double n1 = n_;
+      n_ += 1.0;
+      double delta = x - mean_, dn = delta / n_, dn2 = dn * dn, term = delta * dn * n1;
+      mean_ += dn;
+      m4_ += term * dn2 * (n_ * n_ - 3.0 * n_ + 3.0) + 6.0 * dn2 * m2_ - 4.0 * dn * m3_;
+      m3_ += term * dn * (n_ - 2.0) - 3.0 * dn * m2_;
+      m2_ += term;
+      min_ = std::min(min_, x);
+      max_ = std::max(max_, x);
+    }
+
+    void add(const double* x, std::size_t n) {
+      for (std::size_t begin = 0; begin < n; begin += chunk) {
+        std::size_t size = std::min<std::size_t>(chunk, n - begin);
+        MomentAccumulator block;
+        block.summarize(x + begin, size);
+        merge(block);
+      }
+    }
+
+    template <class Iterator>
+    void addSequence(Iterator begin, Iterator end) {
+      double buffer[chunk];
+      while (begin != end) {
+        std::size_t size = 0;
+        for (; size < chunk && begin != end; ++begin) buffer[size++] = *begin;
+        add(buffer, size);
+      }
+    }
+
+    void merge(const MomentAccumulator& other) {
+      if (other.n_ == 0.0) return;
+      if (n_ == 0.0) {
+        *this = other;
+        return;
+      }
+      double na = n_, nb = other.n_, n = na + nb;
+      double delta = other.mean_ - mean_, delta2 = delta * delta;
+      m4_ += other.m4_ + delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n)
+           + 6.0 * delta2 * (na * na * other.m2_ + nb * nb * m2_) / (n * n) + 4.0 * delta * (na * other.m3_ - nb * m3_) / n;
+      m3_ += other.m3_ + delta2 * delta * na * nb * (na - nb) / (n * n) + 3.0 * delta * (na * other.m2_ - nb * m2_) / n;
+      m2_ += other.m2_ + delta2 * na * nb / n;
+      mean_ += delta * nb / n;
+      n_ = n;
+      min_ = std::min(min_, other.min_);
+      max_ = std::max(max_, other.max_);
+    }
+
+    // the whole state as doubles, for checkpoints (mcrun.hpp); restoring is exact
+    enum { stateSize = 7 };
+    void saveState(double* out) const {
+      out[0] = n_; out[1] = mean_; out[2] = m2_; out[3] = m3_; out[4] = m4_; out[5] = min_; out[6] = max_;
+    }
+    void restoreState(const double* in) {
+      n_ = in[0]; mean_ = in[1]; m2_ = in[2]; m3_ = in[3]; m4_ = in[4]; min_ = in[5]; max_ = in[6];
+    }
+
+    std::size_t samples() const { return std::size_t(n_); }
+    double weightSum() const { return n_; }
+    double mean() const {
+      if (n_ == 0.0) throw std::logic_error("empty sample set");
+      return mean_;
+    }
+    // unbiased, as GeneralStatistics::variance
+    double variance() const {
+      if (n_ < 2.0) throw std::logic_error("sample number <= 1, unsufficient");
+      return m2_ / (n_ - 1.0);
+    }
+    double standardDeviation() const { return std::sqrt(variance()); }
+    double errorEstimate() const { return std::sqrt(variance() / n_); }
+    double skewness() const {
+      if (n_ < 3.0) throw std::logic_error("sample number <= 2, unsufficient");
+      double s = standardDeviation();
+      return (n_ / (n_ - 1.0)) * (n_ / (n_ - 2.0)) * (m3_ / n_) / (s * s * s);
+    }
+    // excess kurtosis
+    double kurtosis() const {
+      if (n_ < 4.0) throw std::logic_error("sample number <= 3, unsufficient");
+      double variance = this->variance();
+      double c1 = (n_ / (n_ - 1.0)) * (n_ / (n_ - 2.0)) * ((n_ + 1.0) / (n_ - 3.0));
+      double c2 = 3.0 * ((n_ - 1.0) / (n_ - 2.0)) * ((n_ - 1.0) / (n_ - 3.0));
+      return c1 * (m4_ / n_) / (variance * variance) - c2;
+    }
+    double min() const {
+      if (n_ == 0.0) throw std::logic_error("empty sample set");
+      return min_;
+    }
+    double max() const {
+      if (n_ == 0.0) throw std::logic_error("empty sample set");
+      return max_;
+    }
+
+  private:
+    // the statistics of one block from scratch: a pass for the mean, one for the central sums
+    void summarize(const double* x, std::size_t n) {
+      double s[4] = { 0.0, 0.0, 0.0, 0.0 }, lo[4], hi[4];
+      std::fill(lo, lo + 4, std::numeric_limits<double>::infinity());
+      std::fill(hi, hi + 4, -std::numeric_limits<double>::infinity());
+      std::size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        for (std::size_t l = 0; l < 4; ++l) {
+          s[l] += x[i + l];
+          lo[l] = std::min(lo[l], x[i + l]);
+          hi[l] = std::max(hi[l], x[i + l]);
+        }
+      }
+      for (; i < n; ++i) {
+        s[0] += x[i];
+        lo[0] = std::min(lo[0], x[i]);
+        hi[0] = std::max(hi[0], x[i]);
+      }
+      double mean = (s[0] + s[1] + s[2] + s[3]) / double(n);
+
+      double c2[4] = { 0.0, 0.0, 0.0, 0.0 }, c3[4] = { 0.0, 0.0, 0.0, 0.0 }, c4[4] = { 0.0, 0.0, 0.0, 0.0 }, c1[4] = { 0.0, 0.0, 0.0, 0.0 };
+      for (i = 0; i + 4 <= n; i += 4) {
+        for (std::size_t l = 0; l < 4; ++l) {
+          double d = x[i + l] - mean, d2 = d * d;
+          c1[l] += d;
+          c2[l] += d2;
+          c3[l] += d2 * d;
+          c4[l] += d2 * d2;
+        }
+      }
+      for (; i < n; ++i) {
+        double d = x[i] - mean, d2 = d * d;
+        c1[0] += d;
+        c2[0] += d2;
+        c3[0] += d2 * d;
+        c4[0] += d2 * d2;
+      }
+      // the rounding left in the mean, folded back in (the corrected two-pass algorithm)
+      double e = (c1[0] + c1[1] + c1[2] + c1[3]) / double(n);
+      double m2 = c2[0] + c2[1] + c2[2] + c2[3], m3 = c3[0] + c3[1] + c3[2] + c3[3], m4 = c4[0] + c4[1] + c4[2] + c4[3];
+      n_ = double(n);
+      mean_ = mean + e;
+      m2_ = m2 - n_ * e * e;
+      m3_ = m3 - 3.0 * e * m2 + 2.0 * n_ * e * e * e;
+      m4_ = m4 - 4.0 * e * m3 + 6.0 * e * e * m2 - 3.0 * n_ * e * e * e * e;
+      min_ = *std::min_element(lo, lo + 4);
+      max_ = *std::max_element(hi, hi + 4);
+    }
+
+    double n_, mean_, m2_, m3_, m4_, min_, max_;
+};
+
+class StreamingStatistics : public MomentAccumulator {
+  public:
+    explicit StreamingStatistics(std::size_t sketchCapacity = 256) : sketch_(sketchCapacity) {}
+
+    void reset() {
+      MomentAccumulator::reset();
+      sketch_ = QuantileSketch(sketch_.capacity());
+    }
+
+    void add(double x) {
+      MomentAccumulator::add(x);
+      sketch_.add(x);
+    }
+
+    void add(const double* x, std::size_t n) {
+      MomentAccumulator::add(x, n);
+      sketch_.add(x, n);
+    }
+
+    template <class Iterator>
+    void addSequence(Iterator begin, Iterator end) {
+      double buffer[chunk];
+      while (begin != end) {
+        std::size_t size = 0;
+        for (; size < chunk && begin != end; ++begin) buffer[size++] = *begin;
+        add(buffer, size);
+      }
+    }
+
+    void merge(const StreamingStatistics& other) {
+      MomentAccumulator::merge(other);
+      sketch_.merge(other.sketch_);
+    }
+
+    // the value with a fraction p of the samples at or below it, as GeneralStatistics::percentile
+    double percentile(double p) const {
+      if (!(p > 0.0 && p <= 1.0)) throw std::invalid_argument("percentile must be in (0.0, 1.0]");
+      return sketch_.quantile(p);
+    }
+    double median() const { return percentile(.5); }
+
+  private:
+    QuantileSketch sketch_;
+};
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef QLTUTOR_STRIKEINFO_HPP
+#define QLTUTOR_STRIKEINFO_HPP
+
+#include <ql/quantlib.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <utility>
+
+#include "allocations.hpp"
+
+// One listed option of a chain: payoff, bid/ask quotes and the implied vol solved
+// for it. Shared by the ES chain of 14impvol and the Heston calibration of 19heston.
+
+namespace qltutor {
+
+class StrikeInfo {
+  public:
+    typedef std::pair<QuantLib::SimpleQuote, QuantLib::SimpleQuote> BidAsk;
+
+    StrikeInfo(QuantLib::Option::Type optionType, const BidAsk& bidAsk, QuantLib::Real strike)
+      : _payoff(new QuantLib::PlainVanillaPayoff(optionType, strike))
+      , _bidAsk(bidAsk)
+      , _impliedVol(0.0) {}
+
+    StrikeInfo(const StrikeInfo& that)
+      : _payoff(copyPayoff(that.getPayoff()))
+      , _bidAsk(that.getBidAsk())
+      , _impliedVol(that.getImpliedVol()) {}
+
+    StrikeInfo& operator=(StrikeInfo that) {
+      swap(*this, that);
+      return *this;
+    }
+
+    friend void swap(StrikeInfo& first, StrikeInfo& second) {
+      using std::swap;
+      first._payoff.swap(second._payoff);
+      std::swap(first._impliedVol, second._impliedVol);
+      std::swap(first._bidAsk, second._bidAsk);
+    }
+
+    const QuantLib::StrikedTypePayoff& getPayoff() const { return *_payoff; }
+    const BidAsk& getBidAsk()                      const { return _bidAsk; }
+    QuantLib::Real getStrike()                     const { return _payoff->strike(); }
+
+    void setImpliedVol(QuantLib::Volatility impliedVol) { _impliedVol = impliedVol;}
+    const QuantLib::Volatility& getImpliedVol()    const { return _impliedVol; }
+
+  private:
+    static QuantLib::StrikedTypePayoff* copyPayoff(const QuantLib::StrikedTypePayoff& payoff) {
+      AllocationScope scope("StrikeInfo copy");
+      return new QuantLib::PlainVanillaPayoff(payoff.optionType(), payoff.strike());
+    }
+
+    boost::scoped_ptr<QuantLib::StrikedTypePayoff> _payoff;
+    BidAsk _bidAsk;
+    QuantLib::Volatility _impliedVol;
+};
+
+}
+
+#endif
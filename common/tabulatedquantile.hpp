@@ -0,0 +1,242 @@
+#ifndef QLTUTOR_TABULATEDQUANTILE_HPP
+#define QLTUTOR_TABULATEDQUANTILE_HPP
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+// An inverse cumulative distribution function from tables, for sampling laws whose
+// exact quantile is an iterative special-function inversion (Student-t and other
+// heavy-tailed laws in boost::math).
+//
+// Each tail is cut at powers of two of q = min(p, 1 - p): octave k holds
+// q in [2^-(k+1), 2^-k), and is split into equal sub-intervals, each with a Chebyshev
+// expansion of fixed degree of the quantile as a function of q. A power law tail
+// x ~ q^(-1/nu) is smooth over every octave, so a few sub-intervals per octave reach
+// 1e-12 however deep into the tail. The octave is the exponent of q and the
+// sub-interval the top bits of its mantissa, so finding the piece is bit arithmetic.
+//
+// The tables are fitted at build time against the exact quantile and checked on a
+// finer grid; pieces are halved until the checked error is below the tolerance, and
+// maxError() reports the worst error found. Below the last octave (q < 2^-octaves,
+// beyond what a 53-bit uniform reaches) the exact quantile is called.
+//
+// operator() has the signature InverseCumulativeRsg expects. transform() does a whole
+// block in two passes: piece lookup for every element, then the Clenshaw recurrences
+// for every element one degree at a time, a loop of independent lanes.
+
+namespace qltutor {
+
+struct TabulatedInverseCdfOptions {
+  TabulatedInverseCdfOptions() : degree(14), tolerance(1e-12), octaves(56), maxSubdivisions(256) {}
+  std::size_t degree;            // of each Chebyshev expansion
+  double tolerance;              // on |error| / max(1, |x|)
+  std::size_t octaves;           // tabulated down to q = 2^-octaves
+  std::size_t maxSubdivisions;   // per octave
+};
+
+class TabulatedInverseCdf {
+  public:
+    typedef std::function<double (double)> Quantile;
+
+    // a law symmetric about 0: quantile(q) for q <= 1/2 is enough
+    template <class F>
+    explicit TabulatedInverseCdf(F quantile, const TabulatedInverseCdfOptions& options = TabulatedInverseCdfOptions())
+      : tables_(new Tables(options)) {
+      tables_->tail[0].build(Quantile(quantile), *tables_);
+      tables_->symmetric = true;
+    }
+
+    // any law: lower(q) = Q(q) and upper(q) = Q(1 - q), each for q <= 1/2, so that
+    // the upper tail is not computed from 1 - q rounded
+    template <class F, class G>
+    TabulatedInverseCdf(F lower, G upper, const TabulatedInverseCdfOptions& options = TabulatedInverseCdfOptions())
+      : tables_(new Tables(options)) {
+      tables_->tail[0].build(Quantile(lower), *tables_);
+      tables_->tail[1].build(Quantile(upper), *tables_);
+      tables_->symmetric = false;
+    }
+
+    double operator()(double p) const {
+      bool upper = p > .5;
+      double q = upper ? 1.0 - p : p;
+      const Tail& tail = tables_->tail[upper && !tables_->symmetric ? 1 : 0];
+      double sign = upper && tables_->symmetric ? -1.0 : 1.0;
+      double t;
+      std::size_t piece;
+      if (!locate(tail, q, piece, t)) return sign * tail.exact(q);
+      return sign * clenshaw(&tail.coefficients[piece * (tables_->degree + 1)], tables_->degree, t);
+    }
+
+    // x[i] = Q(p[i]); x may be p
+    void transform(const double* p, double* x, std::size_t n) const {
+      const std::size_t degree = tables_->degree, stride = degree + 1;
+      double t[block], b1[block], b2[block], sign[block];
+      const double* c[block];
+      for (std::size_t begin = 0; begin < n; begin += block) {
+        std::size_t size = std::min<std::size_t>(block, n - begin);
+        bool exact = false;
+        for (std::size_t i = 0; i < size; ++i) {
+          double u = p[begin + i];
+          bool upper = u > .5;
+          const Tail& tail = tables_->tail[upper && !tables_->symmetric ? 1 : 0];
+          sign[i] = upper && tables_->symmetric ? -1.0 : 1.0;
+          std::size_t piece;
+          if (locate(tail, upper ? 1.0 - u : u, piece, t[i])) {
+            c[i] = &tail.coefficients[piece * stride];
+          } else {
+            c[i] = 0;
+            t[i] = 0.0;
+            exact = true;
+          }
+          b1[i] = b2[i] = 0.0;
+        }
+        for (std::size_t d = degree; d >= 1; --d) {
+          for (std::size_t i = 0; i < size; ++i) {
+            double b = (c[i] ? c[i][d] : 0.0) + 2.0 * t[i] * b1[i] - b2[i];
+            b2[i] = b1[i];
+            b1[i] = b;
+          }
+        }
+        for (std::size_t i = 0; i < size; ++i) x[begin + i] = sign[i] * ((c[i] ? c[i][0] : 0.0) + t[i] * b1[i] - b2[i]);
+        if (exact) {
+          for (std::size_t i = 0; i < size; ++i) {
+            if (c[i]) continue;
+            double u = p[begin + i];
+            x[begin + i] = u > .5 ? (tables_->symmetric ? -tables_->tail[0].exact(1.0 - u) : tables_->tail[1].exact(1.0 - u))
+                                  : tables_->tail[0].exact(u);
+          }
+        }
+      }
+    }
+
+    // worst error found when the tables were checked, relative to max(1, |x|)
+    double maxError() const { return std::max(tables_->tail[0].maxError, tables_->symmetric ? 0.0 : tables_->tail[1].maxError); }
+    // Chebyshev pieces in both tails
+    std::size_t pieces() const { return memoryBytes() / ((tables_->degree + 1) * sizeof(double)); }
+    std::size_t memoryBytes() const {
+      return (tables_->tail[0].coefficients.size() + tables_->tail[1].coefficients.size()) * sizeof(double);
+    }
+
+  private:
+    enum { block = 64 };
+
+    struct Tables;
+
+    struct Tail {
+      Tail() : maxError(0.0) {}
+
+      void build(const Quantile& quantile, const Tables& tables) {
+        exact = quantile;
+        std::size_t degree = tables.degree;
+        for (std::size_t k = 1; k <= tables.octaves; ++k) {
+          double lo = std::ldexp(1.0, -int(k) - 1), hi = 2.0 * lo;
+          std::vector<double> fitted;
+          double error = 0.0;
+          std::size_t subdivisions = 1;
+          for (;; subdivisions *= 2) {
+            fitted.clear();
+            error = 0.0;
+            for (std::size_t j = 0; j < subdivisions; ++j) {
+              double a = lo + (hi - lo) * j / subdivisions, b = lo + (hi - lo) * (j + 1) / subdivisions;
+              std::size_t first = fitted.size();
+              fit(quantile, a, b, degree, fitted);
+              // check between and beyond the fitting nodes
+              for (std::size_t m = 0; m <= 4 * degree; ++m) {
+                double t = -1.0 + 2.0 * m / (4.0 * degree), q = .5 * (a + b) + .5 * (b - a) * t;
+                double x = quantile(q);
+                error = std::max(error, std::fabs(clenshaw(&fitted[first], degree, t) - x) / std::max(1.0, std::fabs(x)));
+              }
+            }
+            if (error <= tables.tolerance || subdivisions >= tables.maxSubdivisions) break;
+          }
+          maxError = std::max(maxError, error);
+          first.push_back(coefficients.size() / (degree + 1));
+          bits.push_back(log2(subdivisions));
+          coefficients.insert(coefficients.end(), fitted.begin(), fitted.end());
+        }
+      }
+
+      // Chebyshev coefficients of f on [a, b] from its values at the Chebyshev nodes
+      static void fit(const Quantile& f, double a, double b, std::size_t degree, std::vector<double>& out) {
+        const double pi = 3.141592653589793238462643;
+        std::size_t n = degree + 1;
+        std::vector<double> values(n);
+        for (std::size_t j = 0; j < n; ++j) values[j] = f(.5 * (a + b) + .5 * (b - a) * std::cos(pi * (j + .5) / n));
+        for (std::size_t d = 0; d < n; ++d) {
+          double s = 0.0;
+          for (std::size_t j = 0; j < n; ++j) s += values[j] * std::cos(pi * d * (j + .5) / n);
+          out.push_back((d == 0 ? 1.0 : 2.0) * s / n);
+        }
+      }
+
+      static std::size_t log2(std::size_t n) {
+        std::size_t b = 0;
+        while ((std::size_t(1) << b) < n) ++b;
+        return b;
+      }
+
+      Quantile exact;
+      std::vector<std::size_t> first;     // first piece of octave k + 1
+      std::vector<std::size_t> bits;      // log2 of its number of pieces
+      std::vector<double> coefficients;
+      double maxError;
+    };
+
+    struct Tables {
+      explicit Tables(const TabulatedInverseCdfOptions& options)
+        : degree(options.degree), tolerance(options.tolerance), octaves(options.octaves)
+        , maxSubdivisions(options.maxSubdivisions), symmetric(true) {
+        if (degree < 1 || octaves < 1 || octaves > 1000) throw std::invalid_argument("invalid table options");
+      }
+      std::size_t degree;
+      double tolerance;
+      std::size_t octaves, maxSubdivisions;
+      bool symmetric;
+      Tail tail[2];
+    };
+
+    // the piece holding q, and q's position in it in [-1, 1]; false when q is not tabulated
+    static bool locate(const Tail& tail, double q, std::size_t& piece, double& t) {
+      if (!(q > 0.0)) return false;
+      std::uint64_t bits;
+      std::memcpy(&bits, &q, sizeof(double));
+      int exponent = int((bits >> 52) & 0x7ff) - 1023;                 // q in [2^e, 2^(e+1))
+      std::uint64_t mantissa = bits & ((std::uint64_t(1) << 52) - 1);
+      std::size_t k = std::size_t(-exponent - 1);                       // octave [2^-(k+1), 2^-k)
+      if (exponent >= -1) {                                             // q = 1/2: the top of octave 1
+        k = 1;
+        mantissa = (std::uint64_t(1) << 52) - 1;
+      }
+      if (k == 0 || k > tail.first.size()) return false;
+      std::size_t shift = tail.bits[k - 1];
+      std::size_t j = std::size_t(mantissa >> (52 - shift));
+      piece = tail.first[k - 1] + j;
+      // position inside the piece from the remaining mantissa bits
+      double fraction = double(mantissa & ((std::uint64_t(1) << (52 - shift)) - 1)) * std::ldexp(1.0, -int(52 - shift));
+      t = 2.0 * fraction - 1.0;
+      return true;
+    }
+
+    static double clenshaw(const double* c, std::size_t degree, double t) {
+      double b1 = 0.0, b2 = 0.0;
+      for (std::size_t d = degree; d >= 1; --d) {
+        double b = c[d] + 2.0 * t * b1 - b2;
+        b2 = b1;
+        b1 = b;
+      }
+      return c[0] + t * b1 - b2;
+    }
+
+    std::shared_ptr<Tables> tables_;
+};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef QLTUTOR_ZIGGURAT_HPP
+#define QLTUTOR_ZIGGURAT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#include "philox.hpp"
+
+// Standard normals by the ziggurat method (Marsaglia and Tsang), in Doornik's ZIGNOR
+// form with 128 layers.
+//
+// Each attempt takes one 64-bit word: 7 bits pick a layer i, 53 others a uniform u in
+// (-1, 1). When |u| < X[i+1] / X[i], about 98.8% of the time, u X[i] is the normal,
+// at the cost of a multiplication and a compare. Otherwise the point is tested against
+// the density (two exponentials), or drawn from the tail beyond R by Marsaglia's
+// method. No logarithms, square roots or trigonometry on the fast path, unlike
+// Box-Muller.
+//
+// fill() draws the words from a Philox4x32 in bulk, a chunk at a time, so it can hand
+// out the normals of a whole path or block at once. The numbers it returns depend only
+// on the generator's state, not on how they are chunked over calls.
+
+namespace qltutor {
+
+class ZigguratNormal {
+  public:
+    enum { layers = 128 };
+
+    // normals into out[0..n)
+    static void fill(Philox4x32& generator, double* out, std::size_t n) {
+      const Tables& t = tables();
+      Words words(generator);
+      for (std::size_t j = 0; j < n; ++j) {
+        for (;;) {
+          std::uint64_t w = words.next(n - j);
+          std::size_t i = std::size_t(w & (layers - 1));
+          double u = 2.0 * (double(w >> 11) + .5) * (1.0 / 9007199254740992.0) - 1.0;
+          if (std::fabs(u) < t.ratio[i]) {
+            out[j] = u * t.x[i];
+            break;
+          }
+          if (i == 0) {
+            out[j] = tail(words, u < 0.0);
+            break;
+          }
+          double x = u * t.x[i];
+          double f0 = std::exp(-.5 * (t.x[i] * t.x[i] - x * x)), f1 = std::exp(-.5 * (t.x[i + 1] * t.x[i + 1] - x * x));
+          if (f1 + words.uniform() * (f0 - f1) < 1.0) {
+            out[j] = x;
+            break;
+          }
+        }
+      }
+      words.giveBack();
+    }
+
+    static double next(Philox4x32& generator) {
+      double x;
+      fill(generator, &x, 1);
+      return x;
+    }
+
+  private:
+    static constexpr double r = 3.442619855899;          // start of the tail
+    static constexpr double v = 9.91256303526217e-3;     // area of each layer
+
+    struct Tables {
+      Tables() {
+        double f = std::exp(-.5 * r * r);
+        x[0] = v / f;
+        x[1] = r;
+        x[layers] = 0.0;
+        for (int i = 2; i < layers; ++i) {
+          x[i] = std::sqrt(-2.0 * std::log(v / x[i - 1] + f));
+          f = std::exp(-.5 * x[i] * x[i]);
+        }
+        for (int i = 0; i < layers; ++i) ratio[i] = x[i + 1] / x[i];
+      }
+      double x[layers + 1], ratio[layers];
+    };
+
+    static const Tables& tables() {
+      static const Tables t;
+      return t;
+    }
+
+    // 64-bit words from the generator, drawn `chunk` at a time; whatever is left over
+    // is given back by rewinding the counter, so the next call starts where this one ended
+    class Words {
+      public:
+        explicit Words(Philox4x32& generator)
+          : generator_(generator), start_(generator.position()), consumed_(0), used_(0), size_(0) {}
+        // `wanted`: how many more words the caller expects to need, to size the next refill
+        std::uint64_t next(std::size_t wanted = 1) {
+          if (used_ == size_) {
+            size_ = std::min<std::size_t>(chunk, std::max<std::size_t>(wanted, 4));
+            generator_.fill(buffer_, 2 * size_);
+            used_ = 0;
+          }
+          std::uint64_t w = std::uint64_t(buffer_[2 * used_]) << 32 | buffer_[2 * used_ + 1];
+          ++used_;
+          ++consumed_;
+          return w;
+        }
+        double uniform() { return (double(next() >> 11) + .5) * (1.0 / 9007199254740992.0); }
+        void giveBack() { generator_.seek(generator_.stream(), start_ + 2 * consumed_); }
+
+      private:
+        enum { chunk = 256 };
+        Philox4x32& generator_;
+        std::uint64_t start_, consumed_;
+        std::size_t used_, size_;
+        std::uint32_t buffer_[2 * chunk];
+    };
+
+    // |x| > r, Marsaglia's method
+    static double tail(Words& words, bool negative) {
+      double x, y;
+      do {
+        x = std::log(words.uniform()) / r;
+        y = std::log(words.uniform());
+      } while (-2.0 * y < x * x);
+      return negative ? x - r : r - x;
+    }
+};
+
+}
+
+#endif
@@ -12,6 +12,7 @@
 #define BOOST_TEST_MODULE PV
 
 #include <cstdlib>
+#include <cmath>
 #include <iostream>
 #include <ql/quantlib.hpp>
 
@@ -29,6 +30,10 @@
 #include <utility>
 #include <boost/assign/std/vector.hpp>
 
+#include "streamingstats.hpp"
+#include "tabulatedquantile.hpp"
+#include "qmcpaths.hpp"
+
 namespace {
 
     using namespace QuantLib;
@@ -1522,7 +1527,7 @@ namespace {
 				std::back_inserter(logReturns), calcLogReturns);		
 		
 		//calculate some general statistics
-		GeneralStatistics statistics;
+		qltutor::StreamingStatistics statistics;
 
 		//returns statistics
 		statistics.addSequence(logReturns.begin(), logReturns.end());
@@ -1571,15 +1576,16 @@ namespace {
 
 		//instantiate Student T distribution from Boost math library
 		boost::math::students_t_distribution<> studentT(5); //5 degrees of freedom - want fat tails!
-		boost::function<Real (Real)> icd = boost::bind(studentTInverse, studentT, _1); 
+		//tabulated once from boost's quantile: the sampler calls the tables, not the root finder
+		qltutor::TabulatedInverseCdf icd(boost::bind(studentTInverse, studentT, _1));
 
 		//samples random numbers from the Student T distribution		
 		InverseCumulativeRsg<RandomSequenceGenerator<MersenneTwisterUniformRng>, 
-            boost::function<Real (Real)> > invCumRsg(rsg, icd);
+            qltutor::TabulatedInverseCdf> invCumRsg(rsg, icd);
 
 		//generates a single path
 		PathGenerator<InverseCumulativeRsg<RandomSequenceGenerator<MersenneTwisterUniformRng>, 
-            boost::function<Real (Real)> > > gbmPathGenerator(gbm, length, timeSteps, invCumRsg, false);
+            qltutor::TabulatedInverseCdf> > gbmPathGenerator(gbm, length, timeSteps, invCumRsg, false);
 
 		const Path& samplePath = gbmPathGenerator.next().value;
 
@@ -1595,7 +1601,7 @@ namespace {
 		    std::back_inserter(logReturns), calcLogReturns);		
 		
 		//calculate some general statistics
-		GeneralStatistics statistics;
+		qltutor::StreamingStatistics statistics;
 
 		//returns statistics
 		statistics.addSequence(logReturns.begin(), logReturns.end());
@@ -1632,19 +1638,20 @@ namespace {
 		const boost::shared_ptr<StochasticProcess>& gbm =
 			boost::shared_ptr<StochasticProcess > (new GeometricBrownianMotionProcess(startingPrice, mu, scaledSigma));
 
-		//random sequence generator will use the Mersenne Twister algorithm
+		//scrambled Sobol in place of HaltonRsg, whose points degrade over 255 dimensions
 		BigInteger seed = SeedGenerator::instance().get();
-        HaltonRsg rsg(timeSteps);
+		qltutor::ScrambledSobolRsg rsg(qltutor::sobolDirectionIntegers(timeSteps), timeSteps, seed);
         
 		//instantiate Student T distribution from Boost math library
 		boost::math::students_t_distribution<> studentT(5); //5 degrees of freedom - want fat tails!
-		boost::function<Real (Real)> icd = boost::bind(studentTInverse, studentT, _1); 
+		//tabulated once from boost's quantile: the sampler calls the tables, not the root finder
+		qltutor::TabulatedInverseCdf icd(boost::bind(studentTInverse, studentT, _1));
 
 		//samples random numbers from the Student T distribution		
-		InverseCumulativeRsg<HaltonRsg, boost::function<Real (Real)> > invCumRsg(rsg, icd);
+		InverseCumulativeRsg<qltutor::ScrambledSobolRsg, qltutor::TabulatedInverseCdf> invCumRsg(rsg, icd);
 
 		//generates a single path
-		PathGenerator<InverseCumulativeRsg<HaltonRsg, boost::function<Real (Real)> > > gbmPathGenerator(gbm, length, timeSteps, invCumRsg, false);
+		PathGenerator<InverseCumulativeRsg<qltutor::ScrambledSobolRsg, qltutor::TabulatedInverseCdf> > gbmPathGenerator(gbm, length, timeSteps, invCumRsg, false);
 
 		const Path& samplePath = gbmPathGenerator.next().value;
 		
@@ -1660,11 +1667,11 @@ namespace {
 				std::back_inserter(logReturns), calcLogReturns);		
 		
 		//calculate some general statistics
-		GeneralStatistics statistics;
+		qltutor::StreamingStatistics statistics;
 
 		//returns statistics
 		statistics.addSequence(logReturns.begin(), logReturns.end());
-		std::cout << boost::format("Standard deviation of simulated returns(Student-T / Halton): %.4f") % 
+		std::cout << boost::format("Standard deviation of simulated returns(Student-T / Sobol): %.4f") % 
 				(statistics.standardDeviation() * std::sqrt(255)) << std::endl;
 
 		//price statistics
@@ -1672,6 +1679,28 @@ namespace {
 		statistics.addSequence(samplePath.begin(), samplePath.end());
 		std::cout << boost::format("Price statistics: mean=%.2f, min=%.2f, max=%.2f") %
 			statistics.mean() % statistics.min() % statistics.max() << std::endl;  
+
+		//expected log return over 16 independent scramblings of 4096 paths, with a standard error;
+		//no Brownian bridge, which would mix the Student-T increments.
+		//The path takes Euler steps in price, S(i+1) = S(i) (1 + mu dt + scaledSigma sqrt(dt) z), which
+		//go negative for z below about -97: rare, but the scrambled points reach that far in the tail
+		//often enough that log(S(T)/S(0)) is sometimes NaN. The same increments in a log-Euler step,
+		//(mu - sigma^2/2) dt + scaledSigma sqrt(dt) z, give a log return that is always finite and
+		//unbiased: the sum of S(i+1)/S(i) - 1 less sigma^2 T/2 (Student-T variance restores sigma)
+		qltutor::QmcOptions qmcOptions;
+		qmcOptions.brownianBridge = false;
+		qmcOptions.seed = seed;
+		qltutor::QmcEstimate logReturn = qltutor::qmcPathEstimate(gbm, length, timeSteps, 4096,
+			[sigma, length](const Path& path) {
+				Real sum = 0.0;
+				for (Size i = 1; i < path.length(); ++i) sum += path[i] / path[i - 1] - 1.0;
+				return sum - sigma * sigma / 2 * length;
+			}, qmcOptions, icd);
+		Real expectedLogReturn = (mu - sigma * sigma / 2) * length;
+		std::cout << boost::format("Mean log return (Student-T / Sobol, %d x %d paths): %.5f +- %.5f (expected %.5f)") %
+			logReturn.replicas % logReturn.pointsPerReplica % logReturn.value % logReturn.standardError % expectedLogReturn << std::endl;
+		BOOST_CHECK(std::isfinite(logReturn.value));
+		BOOST_CHECK_SMALL(logReturn.value - expectedLogReturn, 5 * logReturn.standardError + 1e-4); //plus the tabulated inverse's error
 		
 		//write results to a file 
 		std::ofstream gbmFile;